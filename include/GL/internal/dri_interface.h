@@ -495,7 +495,7 @@ struct __DRIdamageExtensionRec {
  * SWRast Loader extension.
  */
 #define __DRI_SWRAST_LOADER "DRI_SWRastLoader"
-#define __DRI_SWRAST_LOADER_VERSION 3
+#define __DRI_SWRAST_LOADER_VERSION 4
 struct __DRIswrastLoaderExtensionRec {
     __DRIextension base;
 
@@ -537,6 +537,27 @@ struct __DRIswrastLoaderExtensionRec {
    void (*getImage2)(__DRIdrawable *readable,
 		     int x, int y, int width, int height, int stride,
 		     char *data, void *loaderPrivate);
+
+    /**
+     * Put image to drawable from a SysV shared memory segment
+     *
+     * The image starts \c offset bytes into the segment \c shmid, which is
+     * attached at \c shmaddr in this process.  The loader must be able to
+     * fall back to reading the pixels through \c shmaddr if the server
+     * can't attach the segment.  Loaders only expose this when the server
+     * supports MIT-SHM; drivers may then allocate their back buffers in
+     * shared memory.
+     *
+     * When this returns, the server is done reading the image, and has
+     * attached the segment if it is going to, so the driver may render
+     * into it again or mark the segment for removal.
+     *
+     * \since 4
+     */
+    void (*putImageShm)(__DRIdrawable *drawable, int op,
+                        int x, int y, int width, int height, int stride,
+                        int shmid, char *shmaddr, unsigned offset,
+                        void *loaderPrivate);
 };
 
 /**
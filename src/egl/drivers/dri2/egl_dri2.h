@@ -174,6 +174,7 @@ struct dri2_egl_display
    const __DRI2configQueryExtension *config;
    const __DRI2fenceExtension *fence;
    const __DRI2rendererQueryExtension *rendererQuery;
+   const __DRIcopySubBufferExtension *copy_sub_buffer;
    int                       fd;
 
    int                       own_device;
@@ -127,12 +127,15 @@ swrastGetDrawableInfo(__DRIdrawable * draw,
 }
 
 static void
-swrastPutImage(__DRIdrawable * draw, int op,
-               int x, int y, int w, int h,
-               char *data, void *loaderPrivate)
+swrastPutImage2(__DRIdrawable * draw, int op,
+                int x, int y, int w, int h, int stride,
+                char *data, void *loaderPrivate)
 {
    struct dri2_egl_surface *dri2_surf = loaderPrivate;
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(dri2_surf->base.Resource.Display);
+   const int row = w * dri2_surf->bytes_per_pixel;
+   char *packed = NULL;
+   int i;
 
    xcb_gcontext_t gc;
 
@@ -147,15 +150,42 @@ swrastPutImage(__DRIdrawable * draw, int op,
       return;
    }
 
+   /* The request takes tightly packed rows; sub-rectangles of the driver's
+    * buffer aren't.
+    */
+   if (stride && stride != row) {
+      packed = malloc(row * h);
+      if (!packed) {
+         for (i = 0; i < h; i++)
+            swrastPutImage2(draw, op, x, y + i, w, 1, 0,
+                            data + i * stride, loaderPrivate);
+         return;
+      }
+
+      for (i = 0; i < h; i++)
+         memcpy(packed + i * row, data + i * stride, row);
+      data = packed;
+   }
+
    xcb_put_image(dri2_dpy->conn, XCB_IMAGE_FORMAT_Z_PIXMAP, dri2_surf->drawable,
                  gc, w, h, x, y, 0, dri2_surf->depth,
-                 w*h*dri2_surf->bytes_per_pixel, (const uint8_t *)data);
+                 row * h, (const uint8_t *)data);
+
+   free(packed);
 }
 
 static void
-swrastGetImage(__DRIdrawable * read,
+swrastPutImage(__DRIdrawable * draw, int op,
                int x, int y, int w, int h,
                char *data, void *loaderPrivate)
+{
+   swrastPutImage2(draw, op, x, y, w, h, 0, data, loaderPrivate);
+}
+
+static void
+swrastGetImage2(__DRIdrawable * read,
+                int x, int y, int w, int h, int stride,
+                char *data, void *loaderPrivate)
 {
    struct dri2_egl_surface *dri2_surf = loaderPrivate;
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(dri2_surf->base.Resource.Display);
@@ -176,11 +206,28 @@ swrastGetImage(__DRIdrawable * read,
    } else {
       uint32_t bytes = xcb_get_image_data_length(reply);
       uint8_t *idata = xcb_get_image_data(reply);
-      memcpy(data, idata, bytes);
+      const int row = w * dri2_surf->bytes_per_pixel;
+
+      if (stride && stride != row) {
+         int i;
+
+         for (i = 0; i < h && (uint32_t) ((i + 1) * row) <= bytes; i++)
+            memcpy(data + i * stride, idata + i * row, row);
+      } else {
+         memcpy(data, idata, bytes);
+      }
    }
    free(reply);
 }
 
+static void
+swrastGetImage(__DRIdrawable * read,
+               int x, int y, int w, int h,
+               char *data, void *loaderPrivate)
+{
+   swrastGetImage2(read, x, y, w, h, 0, data, loaderPrivate);
+}
+
 
 static xcb_screen_t *
 get_xcb_screen(xcb_screen_iterator_t iter, int screen)
@@ -879,6 +926,61 @@ dri2_x11_swap_buffers(_EGLDriver *drv, _EGLDisplay *disp, _EGLSurface *draw)
    }
 }
 
+/**
+ * Present only the bounding box of the damage, through the driver's
+ * copySubBuffer(), which puts just that part of the back buffer.
+ */
+static EGLBoolean
+dri2_x11_swrast_swap_buffers_with_damage(_EGLDriver *drv, _EGLDisplay *disp,
+                                         _EGLSurface *draw,
+                                         const EGLint *rects, EGLint n_rects)
+{
+   struct dri2_egl_display *dri2_dpy = dri2_egl_display(disp);
+   struct dri2_egl_surface *dri2_surf = dri2_egl_surface(draw);
+   int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+   EGLint i;
+
+   if (n_rects == 0 || !dri2_dpy->copy_sub_buffer)
+      return dri2_x11_swap_buffers(drv, disp, draw);
+
+   for (i = 0; i < n_rects; i++) {
+      const EGLint *rect = &rects[i * 4];
+
+      if (rect[0] < x0)
+         x0 = rect[0];
+      if (rect[1] < y0)
+         y0 = rect[1];
+      if (rect[0] + rect[2] > x1)
+         x1 = rect[0] + rect[2];
+      if (rect[1] + rect[3] > y1)
+         y1 = rect[1] + rect[3];
+   }
+
+   if (x0 < 0)
+      x0 = 0;
+   if (y0 < 0)
+      y0 = 0;
+   if (x1 <= x0 || y1 <= y0)
+      return EGL_TRUE;
+
+   dri2_dpy->copy_sub_buffer->copySubBuffer(dri2_surf->dri_drawable,
+                                            x0, y0, x1 - x0, y1 - y0);
+   return EGL_TRUE;
+}
+
+static EGLBoolean
+dri2_x11_swrast_post_sub_buffer(_EGLDriver *drv, _EGLDisplay *disp,
+                                _EGLSurface *draw,
+                                EGLint x, EGLint y, EGLint width, EGLint height)
+{
+   const EGLint rect[4] = { x, y, width, height };
+
+   if (x < 0 || y < 0 || width < 0 || height < 0)
+      return _eglError(EGL_BAD_PARAMETER, "eglPostSubBufferNV");
+
+   return dri2_x11_swrast_swap_buffers_with_damage(drv, disp, draw, rect, 1);
+}
+
 static EGLBoolean
 dri2_x11_swap_buffers_region(_EGLDriver *drv, _EGLDisplay *disp,
                              _EGLSurface *draw,
@@ -1112,8 +1214,9 @@ static struct dri2_egl_display_vtbl dri2_x11_swrast_display_vtbl = {
    .create_image = dri2_fallback_create_image_khr,
    .swap_interval = dri2_fallback_swap_interval,
    .swap_buffers = dri2_x11_swap_buffers,
+   .swap_buffers_with_damage = dri2_x11_swrast_swap_buffers_with_damage,
    .swap_buffers_region = dri2_fallback_swap_buffers_region,
-   .post_sub_buffer = dri2_fallback_post_sub_buffer,
+   .post_sub_buffer = dri2_x11_swrast_post_sub_buffer,
    .copy_buffers = dri2_x11_copy_buffers,
    .query_buffer_age = dri2_fallback_query_buffer_age,
    .create_wayland_buffer_from_image = dri2_fallback_create_wayland_buffer_from_image,
@@ -1144,6 +1247,7 @@ static EGLBoolean
 dri2_initialize_x11_swrast(_EGLDriver *drv, _EGLDisplay *disp)
 {
    struct dri2_egl_display *dri2_dpy;
+   unsigned i;
 
    dri2_dpy = calloc(1, sizeof *dri2_dpy);
    if (!dri2_dpy)
@@ -1175,10 +1279,12 @@ dri2_initialize_x11_swrast(_EGLDriver *drv, _EGLDisplay *disp)
       goto cleanup_conn;
 
    dri2_dpy->swrast_loader_extension.base.name = __DRI_SWRAST_LOADER;
-   dri2_dpy->swrast_loader_extension.base.version = 2;
+   dri2_dpy->swrast_loader_extension.base.version = 3;
    dri2_dpy->swrast_loader_extension.getDrawableInfo = swrastGetDrawableInfo;
    dri2_dpy->swrast_loader_extension.putImage = swrastPutImage;
    dri2_dpy->swrast_loader_extension.getImage = swrastGetImage;
+   dri2_dpy->swrast_loader_extension.putImage2 = swrastPutImage2;
+   dri2_dpy->swrast_loader_extension.getImage2 = swrastGetImage2;
 
    dri2_dpy->extensions[0] = &dri2_dpy->swrast_loader_extension.base;
    dri2_dpy->extensions[1] = NULL;
@@ -1190,6 +1296,18 @@ dri2_initialize_x11_swrast(_EGLDriver *drv, _EGLDisplay *disp)
    if (!dri2_x11_add_configs_for_visuals(dri2_dpy, disp, true))
       goto cleanup_configs;
 
+   for (i = 0; dri2_dpy->driver_extensions[i]; i++) {
+      if (strcmp(dri2_dpy->driver_extensions[i]->name,
+                 __DRI_COPY_SUB_BUFFER) == 0)
+         dri2_dpy->copy_sub_buffer = (const __DRIcopySubBufferExtension *)
+            dri2_dpy->driver_extensions[i];
+   }
+
+   if (dri2_dpy->copy_sub_buffer) {
+      disp->Extensions.EXT_swap_buffers_with_damage = EGL_TRUE;
+      disp->Extensions.NV_post_sub_buffer = EGL_TRUE;
+   }
+
    /* Fill vtbl last to prevent accidentally calling virtual function during
     * initialization.
     */
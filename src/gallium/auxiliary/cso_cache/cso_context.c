@@ -36,6 +36,7 @@
   */
 
 #include "pipe/p_state.h"
+#include "util/u_debug.h"
 #include "util/u_draw.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
@@ -61,6 +62,34 @@ struct sampler_info
 };
 
 
+/**
+ * The most recently used state objects of each type.  State trackers
+ * re-set identical state all the time, and these are found by comparing
+ * templates, without hashing them.
+ */
+#define CSO_MRU_SIZE 4
+
+struct cso_mru_entry
+{
+   void *cso;         /**< cso_blend, cso_sampler, etc., NULL if unused */
+   unsigned key_size;
+};
+
+
+/**
+ * Per-type statistics, printed on destruction with GALLIUM_CSO_STATS.
+ */
+struct cso_stats
+{
+   unsigned mru_hits;    /**< Found among the most recently used states */
+   unsigned hashes;      /**< Templates hashed */
+   unsigned cache_hits;  /**< Found in the hash table */
+};
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(cso_stats, "GALLIUM_CSO_STATS", FALSE)
+
+
 
 struct cso_context {
    struct pipe_context *pipe;
@@ -117,9 +146,87 @@ struct cso_context {
    unsigned sample_mask, sample_mask_saved;
    unsigned min_samples, min_samples_saved;
    struct pipe_stencil_ref stencil_ref, stencil_ref_saved;
+
+   struct cso_mru_entry mru[CSO_CACHE_MAX][CSO_MRU_SIZE];
+   struct cso_stats stats[CSO_CACHE_MAX];
 };
 
 
+static void
+cso_mru_add(struct cso_context *ctx, enum cso_cache_type type,
+            void *cso, unsigned key_size)
+{
+   struct cso_mru_entry *mru = ctx->mru[type];
+
+   memmove(&mru[1], &mru[0], (CSO_MRU_SIZE - 1) * sizeof(*mru));
+   mru[0].cso = cso;
+   mru[0].key_size = key_size;
+}
+
+
+static void
+cso_mru_remove(struct cso_context *ctx, enum cso_cache_type type, void *cso)
+{
+   struct cso_mru_entry *mru = ctx->mru[type];
+   unsigned i;
+
+   for (i = 0; i < CSO_MRU_SIZE; i++) {
+      if (mru[i].cso == cso) {
+         memmove(&mru[i], &mru[i + 1],
+                 (CSO_MRU_SIZE - 1 - i) * sizeof(*mru));
+         mru[CSO_MRU_SIZE - 1].cso = NULL;
+         return;
+      }
+   }
+}
+
+
+/**
+ * Look up the state object of a template, first among the most recently
+ * used ones, then in the hash table.
+ *
+ * \return the cso_blend, cso_sampler, etc., or NULL with \p hash_key set
+ *         for cso_insert_state()
+ */
+static void *
+cso_find_cached(struct cso_context *ctx, enum cso_cache_type type,
+                const void *templ, unsigned key_size, unsigned *hash_key)
+{
+   struct cso_mru_entry *mru = ctx->mru[type];
+   struct cso_hash_iter iter;
+   void *cso;
+   unsigned i;
+
+   /* All the cso_* structures start with their template. */
+   for (i = 0; i < CSO_MRU_SIZE && mru[i].cso; i++) {
+      if (mru[i].key_size == key_size &&
+          memcmp(mru[i].cso, templ, key_size) == 0) {
+         cso = mru[i].cso;
+         if (i) {
+            memmove(&mru[1], &mru[0], i * sizeof(*mru));
+            mru[0].cso = cso;
+            mru[0].key_size = key_size;
+         }
+         ctx->stats[type].mru_hits++;
+         return cso;
+      }
+   }
+
+   *hash_key = cso_construct_key((void *) templ, key_size);
+   ctx->stats[type].hashes++;
+
+   iter = cso_find_state_template(ctx->cache, *hash_key, type,
+                                  (void *) templ, key_size);
+   if (cso_hash_iter_is_null(iter))
+      return NULL;
+
+   ctx->stats[type].cache_hits++;
+   cso = cso_hash_iter_data(iter);
+   cso_mru_add(ctx, type, cso, key_size);
+   return cso;
+}
+
+
 static boolean delete_blend_state(struct cso_context *ctx, void *state)
 {
    struct cso_blend *cso = (struct cso_blend *)state;
@@ -223,6 +330,7 @@ sanitize_hash(struct cso_hash *hash, enum cso_cache_type type,
       /*fixme: currently we pick the nodes to remove at random*/
       void *cso = cso_hash_iter_data(iter);
       if (delete_cso(ctx, cso, type)) {
+         cso_mru_remove(ctx, type, cso);
          iter = cso_hash_erase(hash, iter);
          --to_remove;
       } else
@@ -360,6 +468,18 @@ void cso_destroy_context( struct cso_context *ctx )
       pipe_so_target_reference(&ctx->so_targets_saved[i], NULL);
    }
 
+   if (debug_get_option_cso_stats()) {
+      static const char *names[CSO_CACHE_MAX] = {
+         "rasterizer", "blend", "depth_stencil_alpha", "sampler", "velements"
+      };
+
+      for (i = 0; i < CSO_CACHE_MAX; i++) {
+         debug_printf("cso: %-19s %u recent hits, %u hashes, %u cache hits\n",
+                      names[i], ctx->stats[i].mru_hits, ctx->stats[i].hashes,
+                      ctx->stats[i].cache_hits);
+      }
+   }
+
    if (ctx->cache) {
       cso_cache_delete( ctx->cache );
       ctx->cache = NULL;
@@ -386,17 +506,16 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
 {
    unsigned key_size, hash_key;
    struct cso_hash_iter iter;
+   struct cso_blend *cso;
    void *handle;
 
    key_size = templ->independent_blend_enable ?
       sizeof(struct pipe_blend_state) :
       (char *)&(templ->rt[1]) - (char *)templ;
-   hash_key = cso_construct_key((void*)templ, key_size);
-   iter = cso_find_state_template(ctx->cache, hash_key, CSO_BLEND,
-                                  (void*)templ, key_size);
+   cso = cso_find_cached(ctx, CSO_BLEND, templ, key_size, &hash_key);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_blend));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -411,13 +530,11 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
+      cso_mru_add(ctx, CSO_BLEND, cso, key_size);
    }
 
+   handle = cso->data;
+
    if (ctx->blend != handle) {
       ctx->blend = handle;
       ctx->pipe->bind_blend_state(ctx->pipe, handle);
@@ -447,16 +564,16 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
                             const struct pipe_depth_stencil_alpha_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       (void*)templ, key_size);
+   unsigned hash_key;
+   struct cso_hash_iter iter;
+   struct cso_depth_stencil_alpha *cso;
    void *handle;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_depth_stencil_alpha *cso =
-         MALLOC(sizeof(struct cso_depth_stencil_alpha));
+   cso = cso_find_cached(ctx, CSO_DEPTH_STENCIL_ALPHA, templ, key_size,
+                         &hash_key);
+
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_depth_stencil_alpha));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -473,14 +590,11 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_depth_stencil_alpha *)
-                cso_hash_iter_data(iter))->data;
+      cso_mru_add(ctx, CSO_DEPTH_STENCIL_ALPHA, cso, key_size);
    }
 
+   handle = cso->data;
+
    if (ctx->depth_stencil != handle) {
       ctx->depth_stencil = handle;
       ctx->pipe->bind_depth_stencil_alpha_state(ctx->pipe, handle);
@@ -510,15 +624,15 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
                                    const struct pipe_rasterizer_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_rasterizer_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       (void*)templ, key_size);
+   unsigned hash_key;
+   struct cso_hash_iter iter;
+   struct cso_rasterizer *cso;
    void *handle = NULL;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
+   cso = cso_find_cached(ctx, CSO_RASTERIZER, templ, key_size, &hash_key);
+
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_rasterizer));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -533,13 +647,11 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
+      cso_mru_add(ctx, CSO_RASTERIZER, cso, key_size);
    }
 
+   handle = cso->data;
+
    if (ctx->rasterizer != handle) {
       ctx->rasterizer = handle;
       ctx->pipe->bind_rasterizer_state(ctx->pipe, handle);
@@ -915,6 +1027,7 @@ cso_set_vertex_elements(struct cso_context *ctx,
    struct u_vbuf *vbuf = ctx->vbuf;
    unsigned key_size, hash_key;
    struct cso_hash_iter iter;
+   struct cso_velements *cso;
    void *handle;
    struct cso_velems_state velems_state;
 
@@ -932,12 +1045,11 @@ cso_set_vertex_elements(struct cso_context *ctx,
    velems_state.count = count;
    memcpy(velems_state.velems, states,
           sizeof(struct pipe_vertex_element) * count);
-   hash_key = cso_construct_key((void*)&velems_state, key_size);
-   iter = cso_find_state_template(ctx->cache, hash_key, CSO_VELEMENTS,
-                                  (void*)&velems_state, key_size);
+   cso = cso_find_cached(ctx, CSO_VELEMENTS, &velems_state, key_size,
+                         &hash_key);
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_velements *cso = MALLOC(sizeof(struct cso_velements));
+   if (!cso) {
+      cso = MALLOC(sizeof(struct cso_velements));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -953,13 +1065,11 @@ cso_set_vertex_elements(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
-   }
-   else {
-      handle = ((struct cso_velements *)cso_hash_iter_data(iter))->data;
+      cso_mru_add(ctx, CSO_VELEMENTS, cso, key_size);
    }
 
+   handle = cso->data;
+
    if (ctx->velements != handle) {
       ctx->velements = handle;
       ctx->pipe->bind_vertex_elements_state(ctx->pipe, handle);
@@ -1066,6 +1176,20 @@ unsigned cso_get_aux_vertex_buffer_slot(struct cso_context *ctx)
    return ctx->aux_vertex_buffer_index;
 }
 
+void cso_set_vertex_translate_cache_size(struct cso_context *ctx,
+                                         unsigned max_size)
+{
+   if (ctx->vbuf)
+      u_vbuf_set_translate_cache_size(ctx->vbuf, max_size);
+}
+
+void cso_invalidate_vertex_buffer(struct cso_context *ctx,
+                                  struct pipe_resource *buf)
+{
+   if (ctx->vbuf)
+      u_vbuf_invalidate_buffer(ctx->vbuf, buf);
+}
+
 
 /**************** fragment/vertex sampler view state *************************/
 
@@ -1077,14 +1201,14 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
 
    if (templ) {
       unsigned key_size = sizeof(struct pipe_sampler_state);
-      unsigned hash_key = cso_construct_key((void*)templ, key_size);
-      struct cso_hash_iter iter =
-         cso_find_state_template(ctx->cache,
-                                 hash_key, CSO_SAMPLER,
-                                 (void *) templ, key_size);
+      unsigned hash_key;
+      struct cso_hash_iter iter;
+      struct cso_sampler *cso;
 
-      if (cso_hash_iter_is_null(iter)) {
-         struct cso_sampler *cso = MALLOC(sizeof(struct cso_sampler));
+      cso = cso_find_cached(ctx, CSO_SAMPLER, templ, key_size, &hash_key);
+
+      if (!cso) {
+         cso = MALLOC(sizeof(struct cso_sampler));
          if (!cso)
             return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -1099,12 +1223,10 @@ cso_single_sampler(struct cso_context *ctx, unsigned shader_stage,
             FREE(cso);
             return PIPE_ERROR_OUT_OF_MEMORY;
          }
-
-         handle = cso->data;
-      }
-      else {
-         handle = ((struct cso_sampler *)cso_hash_iter_data(iter))->data;
+         cso_mru_add(ctx, CSO_SAMPLER, cso, key_size);
       }
+
+      handle = cso->data;
    }
 
    ctx->samplers[shader_stage].samplers[idx] = handle;
@@ -105,6 +105,14 @@ void cso_save_aux_vertex_buffer_slot(struct cso_context *ctx);
 void cso_restore_aux_vertex_buffer_slot(struct cso_context *ctx);
 unsigned cso_get_aux_vertex_buffer_slot(struct cso_context *ctx);
 
+/* Cache of vertex buffers translated to formats the driver supports, for
+ * when u_vbuf is in use. The state tracker must invalidate buffers it writes
+ * (buf = NULL invalidates all). */
+void cso_set_vertex_translate_cache_size(struct cso_context *ctx,
+                                         unsigned max_size);
+void cso_invalidate_vertex_buffer(struct cso_context *ctx,
+                                  struct pipe_resource *buf);
+
 
 void cso_set_stream_outputs(struct cso_context *ctx,
                             unsigned num_targets,
@@ -31,8 +31,12 @@
  *
  * The HUD is controlled with the GALLIUM_HUD environment variable.
  * Set GALLIUM_HUD=help for more info.
+ *
+ * The same values can be streamed to a file or pipe instead of being drawn,
+ * see GALLIUM_HUD_DUMP.
  */
 
+#include <inttypes.h>
 #include <signal.h>
 #include <stdio.h>
 
@@ -41,6 +45,7 @@
 #include "hud/font.h"
 
 #include "cso_cache/cso_context.h"
+#include "os/os_time.h"
 #include "util/u_draw_quad.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -97,8 +102,18 @@ struct hud_context {
       unsigned max_num_vertices;
       unsigned num_vertices;
    } text, bg, whitelines;
+
+   /* GALLIUM_HUD_DUMP: one record per update of the graphs */
+   FILE *dump_file;
+   boolean dump_binary;
+   uint64_t num_frames;
+   uint64_t last_dump_flush;   /* in microseconds */
 };
 
+#define HUD_DUMP_MAGIC 0x42445548  /* "HUDB" in little endian */
+#define HUD_DUMP_VERSION 1
+#define HUD_DUMP_FLUSH_PERIOD (1000 * 1000)  /* microseconds */
+
 #ifdef PIPE_OS_UNIX
 static void
 signal_visible_handler(int sig, siginfo_t *siginfo, void *context)
@@ -435,6 +450,142 @@ hud_alloc_vertices(struct hud_context *hud, struct vertex_queue *v,
                   (void**)&v->vertices);
 }
 
+/**
+ * Read new values of all graphs.  Query results are only read once they are
+ * available, so this never waits for the GPU.
+ */
+static void
+hud_update_graphs(struct hud_context *hud)
+{
+   struct hud_pane *pane;
+   struct hud_graph *gr;
+
+   hud_batch_query_update(hud->batch_query);
+
+   LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
+      LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
+         gr->query_new_value(gr);
+      }
+   }
+}
+
+/**
+ * Open the GALLIUM_HUD_DUMP stream and write its header: a CSV line with the
+ * column names, or for the binary format
+ *
+ *    uint32 magic, version, number of graphs
+ *    per graph: uint32 name length, name (not terminated)
+ *
+ * followed by records of
+ *
+ *    uint64 frame, time in nanoseconds, value of each graph
+ *
+ * All binary fields are in native byte order.
+ */
+static void
+hud_dump_open(struct hud_context *hud, const char *filename,
+              const char *format)
+{
+   struct hud_pane *pane;
+   struct hud_graph *gr;
+   uint32_t num_graphs = 0;
+
+   hud->dump_binary = format && strcmp(format, "binary") == 0;
+
+   if (strcmp(filename, "-") == 0)
+      hud->dump_file = stdout;
+   else
+      hud->dump_file = fopen(filename, hud->dump_binary ? "wb" : "w");
+
+   if (!hud->dump_file) {
+      fprintf(stderr, "gallium_hud: can't open %s for writing\n", filename);
+      return;
+   }
+
+   LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head)
+      num_graphs += pane->num_graphs;
+
+   if (hud->dump_binary) {
+      const uint32_t header[3] = {
+         HUD_DUMP_MAGIC, HUD_DUMP_VERSION, num_graphs
+      };
+
+      fwrite(header, sizeof(header), 1, hud->dump_file);
+      LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
+         LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
+            const uint32_t len = strlen(gr->name);
+
+            fwrite(&len, sizeof(len), 1, hud->dump_file);
+            fwrite(gr->name, 1, len, hud->dump_file);
+         }
+      }
+   }
+   else {
+      fputs("frame,time_ns", hud->dump_file);
+      LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
+         LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
+            fprintf(hud->dump_file, ",%s", gr->name);
+         }
+      }
+      fputc('\n', hud->dump_file);
+   }
+
+   fflush(hud->dump_file);
+   hud->last_dump_flush = os_time_get();
+}
+
+/**
+ * Write a record if any graph got a new value.  The stream is flushed at
+ * most once per HUD_DUMP_FLUSH_PERIOD to keep the overhead low.
+ */
+static void
+hud_dump_values(struct hud_context *hud)
+{
+   struct hud_pane *pane;
+   struct hud_graph *gr;
+   boolean pending = FALSE;
+   uint64_t now;
+
+   LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
+      LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
+         pending |= gr->dump_pending;
+      }
+   }
+
+   if (!pending)
+      return;
+
+   now = os_time_get_nano();
+
+   if (hud->dump_binary) {
+      const uint64_t record[2] = { hud->num_frames, now };
+
+      fwrite(record, sizeof(record), 1, hud->dump_file);
+   }
+   else {
+      fprintf(hud->dump_file, "%"PRIu64",%"PRIu64, hud->num_frames, now);
+   }
+
+   LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
+      LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
+         if (hud->dump_binary)
+            fwrite(&gr->current_value, sizeof(uint64_t), 1, hud->dump_file);
+         else
+            fprintf(hud->dump_file, ",%"PRIu64, gr->current_value);
+         gr->dump_pending = FALSE;
+      }
+   }
+
+   if (!hud->dump_binary)
+      fputc('\n', hud->dump_file);
+
+   now /= 1000;
+   if (now - hud->last_dump_flush >= HUD_DUMP_FLUSH_PERIOD) {
+      fflush(hud->dump_file);
+      hud->last_dump_flush = now;
+   }
+}
+
 /**
  * Draw the HUD to the texture \p tex.
  * The texture is usually the back buffer being displayed.
@@ -450,7 +601,17 @@ hud_draw(struct hud_context *hud, struct pipe_resource *tex)
    const struct pipe_sampler_state *sampler_states[] =
          { &hud->font_sampler_state };
    struct hud_pane *pane;
-   struct hud_graph *gr;
+
+   if (!huds_visible && !hud->dump_file)
+      return;
+
+   hud->num_frames++;
+
+   /* prepare all graphs */
+   hud_update_graphs(hud);
+
+   if (hud->dump_file)
+      hud_dump_values(hud);
 
    if (!huds_visible)
       return;
@@ -523,14 +684,7 @@ hud_draw(struct hud_context *hud, struct pipe_resource *tex)
    hud_alloc_vertices(hud, &hud->whitelines, 4 * 256, 2 * sizeof(float));
    hud_alloc_vertices(hud, &hud->text, 4 * 512, 4 * sizeof(float));
 
-   /* prepare all graphs */
-   hud_batch_query_update(hud->batch_query);
-
    LIST_FOR_EACH_ENTRY(pane, &hud->pane_list, head) {
-      LIST_FOR_EACH_ENTRY(gr, &pane->graph_list, head) {
-         gr->query_new_value(gr);
-      }
-
       hud_pane_accumulate_vertices(hud, pane);
    }
 
@@ -722,6 +876,7 @@ void
 hud_graph_add_value(struct hud_graph *gr, uint64_t value)
 {
    gr->current_value = value;
+   gr->dump_pending = TRUE;
    value = value > gr->pane->ceiling ? gr->pane->ceiling : value;
 
    if (gr->index == gr->pane->max_num_vertices) {
@@ -1100,6 +1255,11 @@ print_help(struct pipe_screen *screen)
    puts("");
    puts("  Example: GALLIUM_HUD=\".w256.h64.x1600.y520.d.c1000fps+cpu,.datom-count\"");
    puts("");
+   puts("  GALLIUM_HUD_DUMP=file streams the values to a file or pipe (\"-\" is");
+   puts("  stdout) instead of drawing them, one record each time the graphs");
+   puts("  are updated (see GALLIUM_HUD_PERIOD). GALLIUM_HUD_DUMP_FORMAT");
+   puts("  selects \"csv\" (default) or \"binary\" records.");
+   puts("");
    puts("  Available names:");
    puts("    fps");
    puts("    cpu");
@@ -1155,12 +1315,14 @@ hud_create(struct pipe_context *pipe, struct cso_context *cso)
    struct pipe_sampler_view view_templ;
    unsigned i;
    const char *env = debug_get_option("GALLIUM_HUD", NULL);
+   const char *dump = debug_get_option("GALLIUM_HUD_DUMP", NULL);
    unsigned signo = debug_get_num_option("GALLIUM_HUD_TOGGLE_SIGNAL", 0);
 #ifdef PIPE_OS_UNIX
    static boolean sig_handled = FALSE;
    struct sigaction action = {};
 #endif
-   huds_visible = debug_get_bool_option("GALLIUM_HUD_VISIBLE", TRUE);
+   /* Dumping the values is meant to replace drawing them. */
+   huds_visible = debug_get_bool_option("GALLIUM_HUD_VISIBLE", !dump);
 
    if (!env || !*env)
       return NULL;
@@ -1320,6 +1482,10 @@ hud_create(struct pipe_context *pipe, struct cso_context *cso)
 #endif
 
    hud_parse_env_var(hud, env);
+
+   if (dump && *dump)
+      hud_dump_open(hud, dump, debug_get_option("GALLIUM_HUD_DUMP_FORMAT",
+                                                "csv"));
    return hud;
 }
 
@@ -1339,6 +1505,13 @@ hud_destroy(struct hud_context *hud)
       FREE(pane);
    }
 
+   if (hud->dump_file) {
+      if (hud->dump_file == stdout)
+         fflush(stdout);
+      else
+         fclose(hud->dump_file);
+   }
+
    hud_batch_query_cleanup(&hud->batch_query);
    pipe->delete_fs_state(pipe, hud->fs_color);
    pipe->delete_fs_state(pipe, hud->fs_text);
@@ -48,6 +48,7 @@ struct hud_graph {
    unsigned num_vertices;
    unsigned index; /* vertex index being updated */
    uint64_t current_value;
+   boolean dump_pending; /* current_value hasn't been dumped yet */
 };
 
 struct hud_pane {
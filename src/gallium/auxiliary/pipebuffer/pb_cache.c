@@ -26,11 +26,54 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+#include <limits.h>
+
 #include "pb_cache.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_time.h"
 
 
+DEBUG_GET_ONCE_BOOL_OPTION(pb_cache_stats, "GALLIUM_PB_CACHE_STATS", FALSE)
+
+/* How many buffers that don't fit are skipped in a bucket before giving up
+ * on it.
+ */
+#define PB_CACHE_MAX_SKIPPED 16
+
+
+/**
+ * Return the size class of a buffer size: PB_CACHE_SIZE_CLASS_STEPS classes
+ * per power of two, in increasing order of size.
+ */
+static unsigned
+pb_cache_size_class(pb_size size)
+{
+   const unsigned shift = util_logbase2(PB_CACHE_SIZE_CLASS_STEPS);
+   unsigned log2;
+
+   if (size < PB_CACHE_SIZE_CLASS_STEPS)
+      return size;
+
+   log2 = util_logbase2(size);
+   return ((log2 - shift + 1) << shift) +
+          ((size >> (log2 - shift)) & (PB_CACHE_SIZE_CLASS_STEPS - 1));
+}
+
+/**
+ * The largest buffer that may be handed out for a request of \p size.
+ */
+static pb_size
+pb_cache_max_size(struct pb_cache *mgr, pb_size size)
+{
+   /* be lenient with size */
+   double max_size = (double) mgr->size_factor * size;
+
+   return max_size >= UINT_MAX ? UINT_MAX : (pb_size) max_size;
+}
+
 /**
  * Actually destroy the buffer.
  */
@@ -42,9 +85,11 @@ destroy_buffer_locked(struct pb_cache_entry *entry)
    assert(!pipe_is_referenced(&entry->buffer->reference));
    if (entry->head.next) {
       LIST_DEL(&entry->head);
+      LIST_DEL(&entry->bucket_head);
       assert(mgr->num_buffers);
       --mgr->num_buffers;
       mgr->cache_size -= entry->buffer->size;
+      ++mgr->num_evictions;
    }
    entry->mgr->destroy_buffer(entry->buffer);
 }
@@ -76,6 +121,30 @@ release_expired_buffers_locked(struct pb_cache *mgr)
    }
 }
 
+/**
+ * Return the bucket holding buffers of the given size class and usage,
+ * creating it if needed.
+ */
+static struct pb_cache_bucket *
+get_bucket_locked(struct pb_cache *mgr, unsigned size_class, unsigned usage)
+{
+   struct pb_cache_bucket *bucket;
+
+   LIST_FOR_EACH_ENTRY(bucket, &mgr->size_classes[size_class], head) {
+      if (bucket->usage == usage)
+         return bucket;
+   }
+
+   bucket = CALLOC_STRUCT(pb_cache_bucket);
+   if (!bucket)
+      return NULL;
+
+   LIST_INITHEAD(&bucket->buffers);
+   bucket->usage = usage;
+   LIST_ADDTAIL(&bucket->head, &mgr->size_classes[size_class]);
+   return bucket;
+}
+
 /**
  * Add a buffer to the cache. This is typically done when the buffer is
  * being released.
@@ -84,15 +153,20 @@ void
 pb_cache_add_buffer(struct pb_cache_entry *entry)
 {
    struct pb_cache *mgr = entry->mgr;
+   struct pb_buffer *buf = entry->buffer;
+   struct pb_cache_bucket *bucket;
 
    pipe_mutex_lock(mgr->mutex);
-   assert(!pipe_is_referenced(&entry->buffer->reference));
+   assert(!pipe_is_referenced(&buf->reference));
 
    release_expired_buffers_locked(mgr);
 
    /* Directly release any buffer that exceeds the limit. */
-   if (mgr->cache_size + entry->buffer->size > mgr->max_cache_size) {
-      entry->mgr->destroy_buffer(entry->buffer);
+   if (mgr->cache_size + buf->size > mgr->max_cache_size ||
+       !(bucket = get_bucket_locked(mgr, pb_cache_size_class(buf->size),
+                                    buf->usage))) {
+      ++mgr->num_evictions;
+      entry->mgr->destroy_buffer(buf);
       pipe_mutex_unlock(mgr->mutex);
       return;
    }
@@ -100,99 +174,98 @@ pb_cache_add_buffer(struct pb_cache_entry *entry)
    entry->start = os_time_get();
    entry->end = entry->start + mgr->usecs;
    LIST_ADDTAIL(&entry->head, &mgr->cache);
+   LIST_ADDTAIL(&entry->bucket_head, &bucket->buffers);
    ++mgr->num_buffers;
-   mgr->cache_size += entry->buffer->size;
+   mgr->cache_size += buf->size;
    pipe_mutex_unlock(mgr->mutex);
 }
 
 /**
- * \return 1   if compatible and can be reclaimed
- *         0   if incompatible
- *        -1   if compatible and can't be reclaimed
+ * Find a buffer in \p bucket that fits the request.
+ *
+ * \return the entry, or NULL if there is none or the least recently used
+ *         fitting buffer can't be reclaimed yet
  */
-static int
-pb_cache_is_buffer_compat(struct pb_cache_entry *entry,
-                          pb_size size, unsigned alignment, unsigned usage)
+static struct pb_cache_entry *
+find_in_bucket_locked(struct pb_cache *mgr, struct pb_cache_bucket *bucket,
+                      pb_size size, pb_size max_size, unsigned alignment)
 {
-   struct pb_buffer *buf = entry->buffer;
+   struct pb_cache_entry *entry;
+   unsigned skipped = 0;
 
-   if (usage & entry->mgr->bypass_usage)
-      return 0;
+   LIST_FOR_EACH_ENTRY(entry, &bucket->buffers, bucket_head) {
+      struct pb_buffer *buf = entry->buffer;
 
-   if (buf->size < size)
-      return 0;
+      if (buf->size < size || buf->size > max_size ||
+          !pb_check_alignment(alignment, buf->alignment)) {
+         /* Don't walk a long list of buffers that are a bit too small for
+          * the first size class or too big for the last; a bigger class may
+          * well have one that fits right away.
+          */
+         if (++skipped == PB_CACHE_MAX_SKIPPED)
+            return NULL;
+         continue;
+      }
 
-   /* be lenient with size */
-   if (buf->size > (unsigned) (entry->mgr->size_factor * size))
-      return 0;
+      /* Buffers of this bucket released later are probably busy too. */
+      return mgr->can_reclaim(buf) ? entry : NULL;
+   }
+   return NULL;
+}
+
+/**
+ * Find a buffer of size class \p size_class that fits the request, in the
+ * buckets whose usage is compatible.
+ */
+static struct pb_cache_entry *
+find_in_class_locked(struct pb_cache *mgr, unsigned size_class,
+                     pb_size size, pb_size max_size, unsigned alignment,
+                     unsigned usage)
+{
+   struct pb_cache_bucket *bucket;
 
-   if (!pb_check_alignment(alignment, buf->alignment))
-      return 0;
+   LIST_FOR_EACH_ENTRY(bucket, &mgr->size_classes[size_class], head) {
+      struct pb_cache_entry *entry;
 
-   if (!pb_check_usage(usage, buf->usage))
-      return 0;
+      if (!pb_check_usage(usage, bucket->usage))
+         continue;
 
-   return entry->mgr->can_reclaim(buf) ? 1 : -1;
+      entry = find_in_bucket_locked(mgr, bucket, size, max_size, alignment);
+      if (entry)
+         return entry;
+   }
+   return NULL;
 }
 
 /**
  * Find a compatible buffer in the cache, return it, and remove it
  * from the cache.
+ *
+ * Only the size classes between \p size and size_factor times \p size are
+ * looked at, smallest first so that the buffer handed out wastes as little
+ * memory as possible, and within those only the buckets whose usage is
+ * compatible.
  */
 struct pb_buffer *
 pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
                         unsigned alignment, unsigned usage)
 {
-   struct pb_cache_entry *entry;
-   struct pb_cache_entry *cur_entry;
-   struct list_head *cur, *next;
-   int64_t now;
-   int ret = 0;
+   struct pb_cache_entry *entry = NULL;
+   pb_size max_size;
+   unsigned first, last, i;
 
-   pipe_mutex_lock(mgr->mutex);
-
-   entry = NULL;
-   cur = mgr->cache.next;
-   next = cur->next;
-
-   /* search in the expired buffers, freeing them in the process */
-   now = os_time_get();
-   while (cur != &mgr->cache) {
-      cur_entry = LIST_ENTRY(struct pb_cache_entry, cur, head);
-
-      if (!entry && (ret = pb_cache_is_buffer_compat(cur_entry, size,
-                                                     alignment, usage) > 0))
-         entry = cur_entry;
-      else if (os_time_timeout(cur_entry->start, cur_entry->end, now))
-         destroy_buffer_locked(cur_entry);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
+   if (usage & mgr->bypass_usage)
+      return NULL;
 
-      /* the buffer is busy (and probably all remaining ones too) */
-      if (ret == -1)
-         break;
+   max_size = pb_cache_max_size(mgr, size);
+   first = pb_cache_size_class(size);
+   last = MIN2(pb_cache_size_class(max_size), PB_CACHE_NUM_SIZE_CLASSES - 1);
 
-      cur = next;
-      next = cur->next;
-   }
+   pipe_mutex_lock(mgr->mutex);
 
-   /* keep searching in the hot buffers */
-   if (!entry && ret != -1) {
-      while (cur != &mgr->cache) {
-         cur_entry = LIST_ENTRY(struct pb_cache_entry, cur, head);
-         ret = pb_cache_is_buffer_compat(cur_entry, size, alignment, usage);
-
-         if (ret > 0) {
-            entry = cur_entry;
-            break;
-         }
-         if (ret == -1)
-            break;
-         /* no need to check the timeout here */
-         cur = next;
-         next = cur->next;
-      }
+   for (i = first; i <= last && !entry; i++) {
+      entry = find_in_class_locked(mgr, i, size, max_size, alignment,
+                                   usage);
    }
 
    /* found a compatible buffer, return it */
@@ -201,13 +274,18 @@ pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
 
       mgr->cache_size -= buf->size;
       LIST_DEL(&entry->head);
+      LIST_DEL(&entry->bucket_head);
       --mgr->num_buffers;
+      ++mgr->num_hits;
+      release_expired_buffers_locked(mgr);
       pipe_mutex_unlock(mgr->mutex);
       /* Increase refcount */
       pipe_reference_init(&buf->reference, 1);
       return buf;
    }
 
+   ++mgr->num_misses;
+   release_expired_buffers_locked(mgr);
    pipe_mutex_unlock(mgr->mutex);
    return NULL;
 }
@@ -263,7 +341,11 @@ pb_cache_init(struct pb_cache *mgr, uint usecs, float size_factor,
               void (*destroy_buffer)(struct pb_buffer *buf),
               bool (*can_reclaim)(struct pb_buffer *buf))
 {
+   unsigned i;
+
    LIST_INITHEAD(&mgr->cache);
+   for (i = 0; i < PB_CACHE_NUM_SIZE_CLASSES; i++)
+      LIST_INITHEAD(&mgr->size_classes[i]);
    pipe_mutex_init(mgr->mutex);
    mgr->cache_size = 0;
    mgr->max_cache_size = maximum_cache_size;
@@ -271,6 +353,9 @@ pb_cache_init(struct pb_cache *mgr, uint usecs, float size_factor,
    mgr->num_buffers = 0;
    mgr->bypass_usage = bypass_usage;
    mgr->size_factor = size_factor;
+   mgr->num_hits = 0;
+   mgr->num_misses = 0;
+   mgr->num_evictions = 0;
    mgr->destroy_buffer = destroy_buffer;
    mgr->can_reclaim = can_reclaim;
 }
@@ -281,6 +366,20 @@ pb_cache_init(struct pb_cache *mgr, uint usecs, float size_factor,
 void
 pb_cache_deinit(struct pb_cache *mgr)
 {
+   struct pb_cache_bucket *bucket, *next;
+   unsigned i;
+
    pb_cache_release_all_buffers(mgr);
+
+   if (debug_get_option_pb_cache_stats()) {
+      debug_printf("pb_cache: %"PRIu64" hits, %"PRIu64" misses, "
+                   "%"PRIu64" evictions\n",
+                   mgr->num_hits, mgr->num_misses, mgr->num_evictions);
+   }
+
+   for (i = 0; i < PB_CACHE_NUM_SIZE_CLASSES; i++) {
+      LIST_FOR_EACH_ENTRY_SAFE(bucket, next, &mgr->size_classes[i], head)
+         FREE(bucket);
+   }
    pipe_mutex_destroy(mgr->mutex);
 }
@@ -33,12 +33,34 @@
 #include "util/list.h"
 #include "os/os_thread.h"
 
+/**
+ * Cached buffers are sorted into size classes, PB_CACHE_SIZE_CLASS_STEPS per
+ * power of two, so that a buffer within the size factor of a request is
+ * found by looking at a handful of short lists.
+ */
+#define PB_CACHE_SIZE_CLASS_STEPS 8
+/* Sizes below 8 get one class each, then 8 classes for each power of two
+ * from 2^3 to 2^31.
+ */
+#define PB_CACHE_NUM_SIZE_CLASSES (PB_CACHE_SIZE_CLASS_STEPS * 30)
+
+/**
+ * Cached buffers of one size class and usage, least recently used first.
+ */
+struct pb_cache_bucket
+{
+   struct list_head head;    /**< Link in pb_cache::size_classes */
+   struct list_head buffers; /**< List of pb_cache_entry::bucket_head */
+   unsigned usage;
+};
+
 /**
  * Statically inserted into the driver-specific buffer structure.
  */
 struct pb_cache_entry
 {
-   struct list_head head;
+   struct list_head head;        /**< Link in pb_cache::cache */
+   struct list_head bucket_head; /**< Link in pb_cache_bucket::buffers */
    struct pb_buffer *buffer; /**< Pointer to the structure this is part of. */
    struct pb_cache *mgr;
    int64_t start, end; /**< Caching time interval */
@@ -46,7 +68,10 @@ struct pb_cache_entry
 
 struct pb_cache
 {
+   /** All cached buffers, least recently used first, for expiration. */
    struct list_head cache;
+   /** Lists of pb_cache_bucket, one bucket per usage. */
+   struct list_head size_classes[PB_CACHE_NUM_SIZE_CLASSES];
    pipe_mutex mutex;
    uint64_t cache_size;
    uint64_t max_cache_size;
@@ -55,6 +80,11 @@ struct pb_cache
    unsigned bypass_usage;
    float size_factor;
 
+   /* Statistics, see GALLIUM_PB_CACHE_STATS. */
+   uint64_t num_hits;
+   uint64_t num_misses;
+   uint64_t num_evictions;
+
    void (*destroy_buffer)(struct pb_buffer *buf);
    bool (*can_reclaim)(struct pb_buffer *buf);
 };
@@ -29,6 +29,7 @@
 #define PP_EXTERNAL_FILTERS_H
 
 #include "postprocess/postprocess.h"
+#include "postprocess/pp_filters.h"
 
 #define PP_FILTERS 6            /* Increment this if you add filters */
 #define PP_MAX_PASSES 6
@@ -37,6 +38,8 @@
 typedef bool (*pp_init_func) (struct pp_queue_t *, unsigned int,
                               unsigned int);
 typedef void (*pp_free_func) (struct pp_queue_t *, unsigned int);
+typedef void (*pp_pixel_emit_func) (struct ureg_program *, struct ureg_dst);
+typedef void (*pp_pixel_cpu_func) (float (*)[4], unsigned int);
 
 struct pp_filter_t
 {
@@ -47,18 +50,23 @@ struct pp_filter_t
    pp_init_func init;           /* Init function */
    pp_func main;                /* Run function */
    pp_free_func free;           /* Free function */
+
+   /* Only for filters which map each pixel to itself. Consecutive ones are
+    * fused into a single pass, see pp_pixel.c. */
+   pp_pixel_emit_func emit;     /* Shader code */
+   pp_pixel_cpu_func cpu;       /* The same on the CPU */
 };
 
 /*	Order matters. Put new filters in a suitable place. */
 
 static const struct pp_filter_t pp_filters[PP_FILTERS] = {
-/*    name			inner	shaders	verts	init			run                       free   */
-   { "pp_noblue",		0,	2,	1,	pp_noblue_init,		pp_nocolor,               pp_nocolor_free },
-   { "pp_nogreen",		0,	2,	1,	pp_nogreen_init,	pp_nocolor,               pp_nocolor_free },
-   { "pp_nored",		0,	2,	1,	pp_nored_init,		pp_nocolor,               pp_nocolor_free },
-   { "pp_celshade",		0,	2,	1,	pp_celshade_init,	pp_nocolor,               pp_celshade_free },
-   { "pp_jimenezmlaa",		2,	5,	2,	pp_jimenezmlaa_init,	pp_jimenezmlaa,           pp_jimenezmlaa_free },
-   { "pp_jimenezmlaa_color",	2,	5,	2,	pp_jimenezmlaa_init_color, pp_jimenezmlaa_color,  pp_jimenezmlaa_free },
+/*    name			inner	shaders	verts	init			run                       free			emit			cpu */
+   { "pp_noblue",		0,	2,	1,	pp_pixel_chain_init,	pp_pixel_chain,           pp_nocolor_free,	pp_noblue_emit,		pp_noblue_cpu },
+   { "pp_nogreen",		0,	2,	1,	pp_pixel_chain_init,	pp_pixel_chain,           pp_nocolor_free,	pp_nogreen_emit,	pp_nogreen_cpu },
+   { "pp_nored",		0,	2,	1,	pp_pixel_chain_init,	pp_pixel_chain,           pp_nocolor_free,	pp_nored_emit,		pp_nored_cpu },
+   { "pp_celshade",		0,	2,	1,	pp_pixel_chain_init,	pp_pixel_chain,           pp_celshade_free,	pp_celshade_emit,	pp_celshade_cpu },
+   { "pp_jimenezmlaa",		2,	5,	2,	pp_jimenezmlaa_init,	pp_jimenezmlaa,           pp_jimenezmlaa_free,	NULL,			NULL },
+   { "pp_jimenezmlaa_color",	2,	5,	2,	pp_jimenezmlaa_init_color, pp_jimenezmlaa_color,  pp_jimenezmlaa_free,	NULL,			NULL },
 };
 
 #endif
@@ -66,6 +66,9 @@ void pp_init_fbos(struct pp_queue_t *, unsigned int, unsigned int);
 void pp_nocolor(struct pp_queue_t *, struct pipe_resource *,
                 struct pipe_resource *, unsigned int);
 
+void pp_pixel_chain(struct pp_queue_t *, struct pipe_resource *,
+                    struct pipe_resource *, unsigned int);
+
 void pp_jimenezmlaa(struct pp_queue_t *, struct pipe_resource *,
                     struct pipe_resource *, unsigned int);
 void pp_jimenezmlaa_color(struct pp_queue_t *, struct pipe_resource *,
@@ -73,11 +76,7 @@ void pp_jimenezmlaa_color(struct pp_queue_t *, struct pipe_resource *,
 
 /* The filter init functions */
 
-bool pp_celshade_init(struct pp_queue_t *, unsigned int, unsigned int);
-
-bool pp_nored_init(struct pp_queue_t *, unsigned int, unsigned int);
-bool pp_nogreen_init(struct pp_queue_t *, unsigned int, unsigned int);
-bool pp_noblue_init(struct pp_queue_t *, unsigned int, unsigned int);
+bool pp_pixel_chain_init(struct pp_queue_t *, unsigned int, unsigned int);
 
 bool pp_jimenezmlaa_init(struct pp_queue_t *, unsigned int, unsigned int);
 bool pp_jimenezmlaa_init_color(struct pp_queue_t *, unsigned int,
@@ -26,18 +26,116 @@
  **************************************************************************/
 
 #include "postprocess/postprocess.h"
-#include "postprocess/pp_celshade.h"
 #include "postprocess/pp_filters.h"
 #include "postprocess/pp_private.h"
 
-/** Init function */
-bool
-pp_celshade_init(struct pp_queue_t *ppq, unsigned int n, unsigned int val)
+#include "util/u_math.h"
+
+/*
+ * The luminance is quantized to steps of 0.25, with a smoothstep over the
+ * 0.025 wide band at the edge of each step:
+ *
+ *    lum = dot(rgb, (0.2126, 0.7152, 0.0722))
+ *    q = round(lum * 4) / 4
+ *    d = lum - q
+ *
+ *    d > 0.1:  level = q + 0.125 * smoothstep((d - 0.1) / 0.025)
+ *    d < -0.1: level = q - 0.125 * (1 - smoothstep((d + 0.125) / 0.025))
+ *    else:     level = q
+ *
+ *    color = color * (level * 2 + 0.1)
+ */
+
+/** Shader code */
+void
+pp_celshade_emit(struct ureg_program *ureg, struct ureg_dst color)
 {
-   ppq->shaders[n][1] =
-      pp_tgsi_to_state(ppq->p->pipe, celshade, false, "celshade");
+   struct ureg_dst lum = ureg_DECL_temporary(ureg);
+   struct ureg_dst level = ureg_DECL_temporary(ureg);
+   struct ureg_dst t = ureg_DECL_temporary(ureg);
+   struct ureg_dst lum_x = ureg_writemask(lum, TGSI_WRITEMASK_X);
+   struct ureg_dst diff_y = ureg_writemask(lum, TGSI_WRITEMASK_Y);
+   struct ureg_dst level_x = ureg_writemask(level, TGSI_WRITEMASK_X);
+   struct ureg_dst s_x = ureg_writemask(t, TGSI_WRITEMASK_X);
+   struct ureg_dst t_y = ureg_writemask(t, TGSI_WRITEMASK_Y);
+   struct ureg_src diff = ureg_scalar(ureg_src(lum), TGSI_SWIZZLE_Y);
+   struct ureg_src q = ureg_scalar(ureg_src(level), TGSI_SWIZZLE_X);
+   struct ureg_src s = ureg_scalar(ureg_src(t), TGSI_SWIZZLE_X);
+   struct ureg_src smooth = ureg_scalar(ureg_src(t), TGSI_SWIZZLE_Y);
+   unsigned int label;
+   int branch;
+
+   ureg_DP3(ureg, lum_x, ureg_src(color),
+            ureg_imm3f(ureg, 0.2126f, 0.7152f, 0.0722f));
+   ureg_MUL(ureg, level_x, ureg_scalar(ureg_src(lum), TGSI_SWIZZLE_X),
+            ureg_imm1f(ureg, 4.0f));
+   ureg_ROUND(ureg, level_x, q);
+   ureg_MUL(ureg, level_x, q, ureg_imm1f(ureg, 0.25f));
+   ureg_ADD(ureg, diff_y, ureg_scalar(ureg_src(lum), TGSI_SWIZZLE_X),
+            ureg_negate(q));
+
+   for (branch = 0; branch < 2; branch++) {
+      if (branch == 0) {
+         ureg_SGT(ureg, s_x, diff, ureg_imm1f(ureg, 0.1f));
+         ureg_IF(ureg, s, &label);
+         ureg_MAD(ureg, s_x, diff, ureg_imm1f(ureg, 40.0f),
+                  ureg_imm1f(ureg, -4.0f));
+      } else {
+         ureg_SLT(ureg, s_x, diff, ureg_imm1f(ureg, -0.1f));
+         ureg_IF(ureg, s, &label);
+         ureg_MAD(ureg, s_x, diff, ureg_imm1f(ureg, 40.0f),
+                  ureg_imm1f(ureg, 5.0f));
+         ureg_ADD(ureg, level_x, q, ureg_imm1f(ureg, -0.125f));
+      }
+
+      /* smoothstep(s) = s * s * (3 - 2 * s) */
+      ureg_MAD(ureg, t_y, s, ureg_imm1f(ureg, -2.0f), ureg_imm1f(ureg, 3.0f));
+      ureg_MUL(ureg, t_y, smooth, s);
+      ureg_MUL(ureg, t_y, smooth, s);
+      ureg_MAD(ureg, level_x, smooth, ureg_imm1f(ureg, 0.125f), q);
+
+      ureg_fixup_label(ureg, label, ureg_get_instruction_number(ureg));
+      ureg_ENDIF(ureg);
+   }
+
+   ureg_MAD(ureg, level_x, q, ureg_imm1f(ureg, 2.0f), ureg_imm1f(ureg, 0.1f));
+   ureg_MUL(ureg, color, ureg_src(color), q);
+
+   ureg_release_temporary(ureg, lum);
+   ureg_release_temporary(ureg, level);
+   ureg_release_temporary(ureg, t);
+}
+
+static inline float
+pp_smoothstep(float s)
+{
+   return s * s * (3.0f - 2.0f * s);
+}
+
+/** The same on the CPU */
+void
+pp_celshade_cpu(float (*rgba)[4], unsigned int count)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; i++) {
+      float lum = 0.2126f * rgba[i][0] + 0.7152f * rgba[i][1] +
+                  0.0722f * rgba[i][2];
+      float level = util_iround(lum * 4.0f) * 0.25f;
+      float diff = lum - level;
+      float factor;
+
+      if (diff > 0.1f)
+         level += 0.125f * pp_smoothstep((diff - 0.1f) * 40.0f);
+      else if (diff < -0.1f)
+         level -= 0.125f * (1.0f - pp_smoothstep((diff + 0.125f) * 40.0f));
 
-   return (ppq->shaders[n][1] != NULL) ? TRUE : FALSE;
+      factor = level * 2.0f + 0.1f;
+      rgba[i][0] *= factor;
+      rgba[i][1] *= factor;
+      rgba[i][2] *= factor;
+      rgba[i][3] *= factor;
+   }
 }
 
 /** Free function */
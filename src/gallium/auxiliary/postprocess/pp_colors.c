@@ -26,7 +26,6 @@
  **************************************************************************/
 
 #include "postprocess/postprocess.h"
-#include "postprocess/pp_colors.h"
 #include "postprocess/pp_filters.h"
 #include "postprocess/pp_private.h"
 
@@ -56,35 +55,66 @@ pp_nocolor(struct pp_queue_t *ppq, struct pipe_resource *in,
 }
 
 
-/* Init functions */
+/* Shader code */
 
-bool
-pp_nored_init(struct pp_queue_t *ppq, unsigned int n, unsigned int val)
+static void
+pp_clear_channel(struct ureg_program *ureg, struct ureg_dst color,
+                 unsigned int writemask)
 {
-   ppq->shaders[n][1] =
-      pp_tgsi_to_state(ppq->p->pipe, nored, false, "nored");
+   ureg_MOV(ureg, ureg_writemask(color, writemask), ureg_imm1f(ureg, 0.0f));
+}
+
 
-   return (ppq->shaders[n][1] != NULL) ? TRUE : FALSE;
+void
+pp_nored_emit(struct ureg_program *ureg, struct ureg_dst color)
+{
+   pp_clear_channel(ureg, color, TGSI_WRITEMASK_X);
 }
 
 
-bool
-pp_nogreen_init(struct pp_queue_t *ppq, unsigned int n, unsigned int val)
+void
+pp_nogreen_emit(struct ureg_program *ureg, struct ureg_dst color)
 {
-   ppq->shaders[n][1] =
-      pp_tgsi_to_state(ppq->p->pipe, nogreen, false, "nogreen");
+   pp_clear_channel(ureg, color, TGSI_WRITEMASK_Y);
+}
 
-   return (ppq->shaders[n][1] != NULL) ? TRUE : FALSE;
+
+void
+pp_noblue_emit(struct ureg_program *ureg, struct ureg_dst color)
+{
+   pp_clear_channel(ureg, color, TGSI_WRITEMASK_Z);
 }
 
 
-bool
-pp_noblue_init(struct pp_queue_t *ppq, unsigned int n, unsigned int val)
+/* CPU functions */
+
+void
+pp_nored_cpu(float (*rgba)[4], unsigned int count)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; i++)
+      rgba[i][0] = 0.0f;
+}
+
+
+void
+pp_nogreen_cpu(float (*rgba)[4], unsigned int count)
+{
+   unsigned int i;
+
+   for (i = 0; i < count; i++)
+      rgba[i][1] = 0.0f;
+}
+
+
+void
+pp_noblue_cpu(float (*rgba)[4], unsigned int count)
 {
-   ppq->shaders[n][1] =
-      pp_tgsi_to_state(ppq->p->pipe, noblue, false, "noblue");
+   unsigned int i;
 
-   return (ppq->shaders[n][1] != NULL) ? TRUE : FALSE;
+   for (i = 0; i < count; i++)
+      rgba[i][2] = 0.0f;
 }
 
 /* Free functions */
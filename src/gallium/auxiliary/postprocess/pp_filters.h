@@ -35,6 +35,7 @@
 #include "pipe/p_shader_tokens.h"
 #include "pipe/p_state.h"
 #include "tgsi/tgsi_text.h"
+#include "tgsi/tgsi_ureg.h"
 #include "util/u_memory.h"
 #include "util/u_draw_quad.h"
 
@@ -54,4 +55,19 @@ void pp_filter_set_fb(struct pp_program *);
 void pp_filter_set_clear_fb(struct pp_program *);
 
 
+/* Per-pixel filters. The emit functions append shader code transforming
+ * the color in the given temporary, the CPU functions do the same to an
+ * array of RGBA pixels. */
+
+void pp_nored_emit(struct ureg_program *, struct ureg_dst);
+void pp_nogreen_emit(struct ureg_program *, struct ureg_dst);
+void pp_noblue_emit(struct ureg_program *, struct ureg_dst);
+void pp_celshade_emit(struct ureg_program *, struct ureg_dst);
+
+void pp_nored_cpu(float (*)[4], unsigned int);
+void pp_nogreen_cpu(float (*)[4], unsigned int);
+void pp_noblue_cpu(float (*)[4], unsigned int);
+void pp_celshade_cpu(float (*)[4], unsigned int);
+
+
 #endif
@@ -37,6 +37,89 @@
 #include "util/u_memory.h"
 #include "cso_cache/cso_context.h"
 
+/** Set up the per-pass timing for PP_PROFILE. */
+static void
+pp_profile_init(struct pp_queue_t *ppq)
+{
+   struct pipe_context *pipe = ppq->p->pipe;
+   struct pipe_screen *screen = ppq->p->screen;
+   unsigned int i;
+
+   ppq->stats = CALLOC(ppq->n_filters, sizeof(struct pp_pass_stats));
+   ppq->filter_cpu_ns = CALLOC(PP_FILTERS, sizeof(uint64_t));
+
+   if (!ppq->stats || !ppq->filter_cpu_ns) {
+      FREE(ppq->stats);
+      FREE(ppq->filter_cpu_ns);
+      ppq->stats = NULL;
+      ppq->filter_cpu_ns = NULL;
+      return;
+   }
+
+   if (screen->get_param(screen, PIPE_CAP_QUERY_TIME_ELAPSED)) {
+      for (i = 0; i < ppq->n_filters; i++)
+         ppq->stats[i].query =
+            pipe->create_query(pipe, PIPE_QUERY_TIME_ELAPSED, 0);
+   }
+}
+
+/** Print the average time of each pass, and of each filter if known. */
+static void
+pp_profile_report(struct pp_queue_t *ppq)
+{
+   unsigned int i, j;
+
+   for (i = 0; i < ppq->n_filters; i++) {
+      const struct pp_pass_stats *stats = &ppq->stats[i];
+
+      if (!stats->runs)
+         continue;
+
+      _debug_printf("pp: pass %u (", i);
+      if (ppq->pixel_filters[i]) {
+         const char *sep = "";
+
+         for (j = 0; j < PP_FILTERS; j++) {
+            if (ppq->pixel_filters[i] & (1 << j)) {
+               _debug_printf("%s%s", sep, pp_filters[j].name);
+               sep = " + ";
+            }
+         }
+      } else {
+         _debug_printf("%s", pp_filters[ppq->filters[i]].name);
+      }
+      _debug_printf("): %u frames, CPU %.3f ms", stats->runs,
+                    stats->cpu_ns / (stats->runs * 1000000.0));
+      if (stats->gpu_runs)
+         _debug_printf(", GPU %.3f ms",
+                       stats->gpu_ns / (stats->gpu_runs * 1000000.0));
+      _debug_printf("\n");
+
+      for (j = 0; j < PP_FILTERS; j++) {
+         if ((ppq->pixel_filters[i] & (1 << j)) && ppq->filter_cpu_ns[j])
+            _debug_printf("pp:    %s: %.3f ms on CPU tiles\n",
+                          pp_filters[j].name,
+                          ppq->filter_cpu_ns[j] / (stats->runs * 1000000.0));
+      }
+   }
+}
+
+static void
+pp_profile_free(struct pp_queue_t *ppq)
+{
+   unsigned int i;
+
+   for (i = 0; i < ppq->n_filters; i++) {
+      if (ppq->stats[i].query)
+         ppq->p->pipe->destroy_query(ppq->p->pipe, ppq->stats[i].query);
+   }
+
+   FREE(ppq->stats);
+   FREE(ppq->filter_cpu_ns);
+   ppq->stats = NULL;
+   ppq->filter_cpu_ns = NULL;
+}
+
 /** Initialize the post-processing queue. */
 struct pp_queue_t *
 pp_init(struct pipe_context *pipe, const unsigned int *enabled,
@@ -45,6 +128,7 @@ pp_init(struct pipe_context *pipe, const unsigned int *enabled,
    unsigned int num_filters = 0;
    unsigned int curpos = 0, i, tmp_req = 0;
    struct pp_queue_t *ppq;
+   bool fuse;
 
    pp_debug("Initializing the post-processing queue.\n");
 
@@ -71,9 +155,11 @@ pp_init(struct pipe_context *pipe, const unsigned int *enabled,
 
    ppq->shaders = CALLOC(num_filters, sizeof(void *));
    ppq->filters = CALLOC(num_filters, sizeof(unsigned int));
+   ppq->pixel_filters = CALLOC(num_filters, sizeof(unsigned int));
 
    if ((ppq->shaders == NULL) ||
-       (ppq->filters == NULL)) {
+       (ppq->filters == NULL) ||
+       (ppq->pixel_filters == NULL)) {
       pp_debug("Unable to allocate memory for shaders and filter arrays.\n");
       goto error;
    }
@@ -84,13 +170,28 @@ pp_init(struct pipe_context *pipe, const unsigned int *enabled,
       goto error;
    }
 
-   /* Add the enabled filters to the queue, in order */
+   fuse = !debug_get_bool_option("PP_NO_FUSE", FALSE);
+   ppq->cpu_tiles = debug_get_bool_option("PP_CPU_TILES", FALSE);
+
+   /*
+    * Add the enabled filters to the queue, in order. Consecutive per-pixel
+    * filters share one pass, which is initialized once all of them are
+    * known.
+    */
    curpos = 0;
    for (i = 0; i < PP_FILTERS; i++) {
       if (enabled[i]) {
+         if (fuse && pp_filters[i].emit && curpos &&
+             ppq->pixel_filters[curpos - 1]) {
+            ppq->pixel_filters[curpos - 1] |= 1 << i;
+            continue;
+         }
+
          ppq->pp_queue[curpos] = pp_filters[i].main;
          tmp_req = MAX2(tmp_req, pp_filters[i].inner_tmps);
          ppq->filters[curpos] = i;
+         if (pp_filters[i].emit)
+            ppq->pixel_filters[curpos] = 1 << i;
 
          if (pp_filters[i].shaders) {
             ppq->shaders[curpos] =
@@ -101,16 +202,20 @@ pp_init(struct pipe_context *pipe, const unsigned int *enabled,
             }
          }
 
-         /* Call the initialization function for the filter. */
-         if (!pp_filters[i].init(ppq, curpos, enabled[i])) {
-            pp_debug("Initialization for filter %u failed.\n", i);
-            goto error;
-         }           
-
          curpos++;
       }
    }
 
+   for (i = 0; i < curpos; i++) {
+      unsigned int filter = ppq->filters[i];
+
+      /* Call the initialization function for the filter. */
+      if (!pp_filters[filter].init(ppq, i, enabled[filter])) {
+         pp_debug("Initialization for filter %u failed.\n", filter);
+         goto error;
+      }
+   }
+
    ppq->n_filters = curpos;
    ppq->n_tmp = (curpos > 2 ? 2 : 1);
    ppq->n_inner_tmp = tmp_req;
@@ -120,7 +225,11 @@ pp_init(struct pipe_context *pipe, const unsigned int *enabled,
    for (i = 0; i < curpos; i++)
       ppq->shaders[i][0] = ppq->p->passvs;
 
-   pp_debug("Queue successfully allocated. %u filter(s).\n", curpos);
+   if (debug_get_bool_option("PP_PROFILE", FALSE))
+      pp_profile_init(ppq);
+
+   pp_debug("Queue successfully allocated. %u filter(s) in %u pass(es).\n",
+            num_filters, curpos);
    
    return ppq;
 
@@ -175,6 +284,11 @@ pp_free(struct pp_queue_t *ppq)
 
    pp_free_fbos(ppq);
 
+   if (ppq->stats) {
+      pp_profile_report(ppq);
+      pp_profile_free(ppq);
+   }
+
    if (ppq->p) {
       if (ppq->p->pipe && ppq->filters && ppq->shaders) {
          for (i = 0; i < ppq->n_filters; i++) {
@@ -228,6 +342,7 @@ pp_free(struct pp_queue_t *ppq)
     * in the create path.
     */
    FREE(ppq->filters);
+   FREE(ppq->pixel_filters);
    FREE(ppq->shaders);
    FREE(ppq->pp_queue);
   
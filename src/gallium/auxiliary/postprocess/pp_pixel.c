@@ -0,0 +1,189 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Per-pixel filters only look at the pixel they write, so any run of them
+ * is done in a single pass: one shader that samples the input once and
+ * appends the code of each filter, or with PP_CPU_TILES a loop over 64x64
+ * tiles which runs every filter on a tile while it is still in cache.
+ * The latter is meant for software drivers, where each extra full screen
+ * pass costs a write and a read of the whole framebuffer.
+ */
+
+#include "postprocess/filters.h"
+#include "postprocess/pp_private.h"
+
+#include "os/os_time.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "util/u_tile.h"
+
+#define PP_TILE_SIZE 64
+
+
+/** Can the tile functions convert this format to and from floats? */
+static bool
+pp_tile_format_supported(const struct pipe_resource *res)
+{
+   const struct util_format_description *desc =
+      util_format_description(res->format);
+
+   return desc && desc->layout == UTIL_FORMAT_LAYOUT_PLAIN &&
+          !util_format_is_pure_integer(res->format) &&
+          !util_format_is_depth_or_stencil(res->format) &&
+          res->nr_samples <= 1;
+}
+
+
+/** Run the fused filters of pass n on a tile. */
+static void
+pp_pixel_chain_tile(struct pp_queue_t *ppq, unsigned int n,
+                    float (*rgba)[4], unsigned int count)
+{
+   unsigned int i;
+
+   for (i = 0; i < PP_FILTERS; i++) {
+      if (!(ppq->pixel_filters[n] & (1 << i)))
+         continue;
+
+      if (ppq->filter_cpu_ns) {
+         int64_t start = os_time_get_nano();
+
+         pp_filters[i].cpu(rgba, count);
+         ppq->filter_cpu_ns[i] += os_time_get_nano() - start;
+      } else {
+         pp_filters[i].cpu(rgba, count);
+      }
+   }
+}
+
+
+/**
+ * Run pass n on the CPU, one tile at a time. Returns false if the
+ * resources can't be handled here, in which case nothing was written.
+ */
+static bool
+pp_pixel_chain_cpu(struct pp_queue_t *ppq, struct pipe_resource *in,
+                   struct pipe_resource *out, unsigned int n)
+{
+   struct pipe_context *pipe = ppq->p->pipe;
+   unsigned int w = ppq->p->framebuffer.width;
+   unsigned int h = ppq->p->framebuffer.height;
+   struct pipe_transfer *in_transfer, *out_transfer;
+   void *in_map, *out_map;
+   float (*tile)[4];
+   unsigned int x, y;
+
+   if (!pp_tile_format_supported(in) || !pp_tile_format_supported(out))
+      return false;
+
+   tile = MALLOC(PP_TILE_SIZE * PP_TILE_SIZE * sizeof(*tile));
+   if (!tile)
+      return false;
+
+   in_map = pipe_transfer_map(pipe, in, 0, 0, PIPE_TRANSFER_READ,
+                              0, 0, w, h, &in_transfer);
+   if (!in_map) {
+      FREE(tile);
+      return false;
+   }
+
+   out_map = pipe_transfer_map(pipe, out, 0, 0,
+                               PIPE_TRANSFER_WRITE |
+                               PIPE_TRANSFER_DISCARD_RANGE,
+                               0, 0, w, h, &out_transfer);
+   if (!out_map) {
+      pipe_transfer_unmap(pipe, in_transfer);
+      FREE(tile);
+      return false;
+   }
+
+   for (y = 0; y < h; y += PP_TILE_SIZE) {
+      for (x = 0; x < w; x += PP_TILE_SIZE) {
+         unsigned int tw = MIN2(PP_TILE_SIZE, w - x);
+         unsigned int th = MIN2(PP_TILE_SIZE, h - y);
+
+         pipe_get_tile_rgba(in_transfer, in_map, x, y, tw, th, &tile[0][0]);
+         pp_pixel_chain_tile(ppq, n, tile, tw * th);
+         pipe_put_tile_rgba(out_transfer, out_map, x, y, tw, th, &tile[0][0]);
+      }
+   }
+
+   pipe_transfer_unmap(pipe, out_transfer);
+   pipe_transfer_unmap(pipe, in_transfer);
+   FREE(tile);
+   return true;
+}
+
+
+/** The run function of the fused per-pixel filters */
+void
+pp_pixel_chain(struct pp_queue_t *ppq, struct pipe_resource *in,
+               struct pipe_resource *out, unsigned int n)
+{
+   if (ppq->cpu_tiles && pp_pixel_chain_cpu(ppq, in, out, n))
+      return;
+
+   pp_nocolor(ppq, in, out, n);
+}
+
+
+/** Init function, builds the fragment shader of the fused filters */
+bool
+pp_pixel_chain_init(struct pp_queue_t *ppq, unsigned int n, unsigned int val)
+{
+   struct ureg_program *ureg;
+   struct ureg_src tex, sampler;
+   struct ureg_dst color, out;
+   unsigned int i;
+
+   ureg = ureg_create(TGSI_PROCESSOR_FRAGMENT);
+   if (!ureg)
+      return FALSE;
+
+   ureg_property(ureg, TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS, 1);
+
+   tex = ureg_DECL_fs_input(ureg, TGSI_SEMANTIC_GENERIC, 0,
+                            TGSI_INTERPOLATE_PERSPECTIVE);
+   sampler = ureg_DECL_sampler(ureg, 0);
+   out = ureg_DECL_output(ureg, TGSI_SEMANTIC_COLOR, 0);
+   color = ureg_DECL_temporary(ureg);
+
+   ureg_TEX(ureg, color, TGSI_TEXTURE_2D, tex, sampler);
+
+   for (i = 0; i < PP_FILTERS; i++) {
+      if (ppq->pixel_filters[n] & (1 << i))
+         pp_filters[i].emit(ureg, color);
+   }
+
+   ureg_MOV(ureg, out, ureg_src(color));
+   ureg_END(ureg);
+
+   ppq->shaders[n][1] = ureg_create_shader_and_destroy(ureg, ppq->p->pipe);
+
+   return (ppq->shaders[n][1] != NULL) ? TRUE : FALSE;
+}
@@ -61,6 +61,19 @@ struct pp_program
 
 
 
+/**
+ * Timing of one pass, with PP_PROFILE set.
+ */
+struct pp_pass_stats
+{
+   struct pipe_query *query;    /* GPU time, NULL if unsupported */
+   bool query_pending;          /* Waiting for the result of the query */
+
+   unsigned int runs, gpu_runs;
+   uint64_t cpu_ns, gpu_ns;
+};
+
+
 /**
  * The main post-processing queue.
  */
@@ -83,9 +96,14 @@ struct pp_queue_t
 
    void ***shaders;             /* Shaders in TGSI form */
    unsigned int *filters;       /* Active filter to filters.h mapping. */
+   unsigned int *pixel_filters; /* Mask of filters fused into a pass */
    struct pp_program *p;
 
    bool fbos_init;
+   bool cpu_tiles;              /* Run fused pixel passes on the CPU */
+
+   struct pp_pass_stats *stats; /* Per pass, NULL unless profiling */
+   uint64_t *filter_cpu_ns;     /* Per filters.h entry, CPU tile mode */
 };
 
 
@@ -29,6 +29,7 @@
 #include "postprocess/pp_filters.h"
 #include "postprocess/pp_private.h"
 
+#include "os/os_time.h"
 #include "util/u_inlines.h"
 #include "util/u_sampler.h"
 
@@ -74,6 +75,52 @@ pp_blit(struct pipe_context *pipe,
    pipe->blit(pipe, &blit);
 }
 
+/**
+ * Run one pass of the queue. With PP_PROFILE, add its CPU time and, from
+ * a query read back a frame later without stalling, its GPU time.
+ */
+static void
+pp_run_pass(struct pp_queue_t *ppq, unsigned int n,
+            struct pipe_resource *in, struct pipe_resource *out)
+{
+   struct pipe_context *pipe = ppq->p->pipe;
+   struct pp_pass_stats *stats;
+   bool query;
+   int64_t start;
+
+   if (!ppq->stats) {
+      ppq->pp_queue[n] (ppq, in, out, n);
+      return;
+   }
+
+   stats = &ppq->stats[n];
+
+   if (stats->query_pending) {
+      union pipe_query_result result;
+
+      if (pipe->get_query_result(pipe, stats->query, FALSE, &result)) {
+         stats->gpu_ns += result.u64;
+         stats->gpu_runs++;
+         stats->query_pending = false;
+      }
+   }
+
+   /* Skip the GPU timing of this frame if the last one isn't back yet. */
+   query = stats->query && !stats->query_pending;
+   if (query)
+      pipe->begin_query(pipe, stats->query);
+
+   start = os_time_get_nano();
+   ppq->pp_queue[n] (ppq, in, out, n);
+   stats->cpu_ns += os_time_get_nano() - start;
+   stats->runs++;
+
+   if (query) {
+      pipe->end_query(pipe, stats->query);
+      stats->query_pending = true;
+   }
+}
+
 /**
 *	Main run function of the PP queue. Called on swapbuffers/flush.
 *
@@ -156,31 +203,31 @@ pp_run(struct pp_queue_t *ppq, struct pipe_resource *in,
       /* Failsafe, but never reached. */
       break;
    case 1:                     /* No temp buf */
-      ppq->pp_queue[0] (ppq, in, out, 0);
+      pp_run_pass(ppq, 0, in, out);
       break;
    case 2:                     /* One temp buf */
 
-      ppq->pp_queue[0] (ppq, in, ppq->tmp[0], 0);
-      ppq->pp_queue[1] (ppq, ppq->tmp[0], out, 1);
+      pp_run_pass(ppq, 0, in, ppq->tmp[0]);
+      pp_run_pass(ppq, 1, ppq->tmp[0], out);
 
       break;
    default:                    /* Two temp bufs */
       assert(ppq->tmp[1]);
-      ppq->pp_queue[0] (ppq, in, ppq->tmp[0], 0);
+      pp_run_pass(ppq, 0, in, ppq->tmp[0]);
 
       for (i = 1; i < (ppq->n_filters - 1); i++) {
          if (i % 2 == 0)
-            ppq->pp_queue[i] (ppq, ppq->tmp[1], ppq->tmp[0], i);
+            pp_run_pass(ppq, i, ppq->tmp[1], ppq->tmp[0]);
 
          else
-            ppq->pp_queue[i] (ppq, ppq->tmp[0], ppq->tmp[1], i);
+            pp_run_pass(ppq, i, ppq->tmp[0], ppq->tmp[1]);
       }
 
       if (i % 2 == 0)
-         ppq->pp_queue[i] (ppq, ppq->tmp[1], out, i);
+         pp_run_pass(ppq, i, ppq->tmp[1], out);
 
       else
-         ppq->pp_queue[i] (ppq, ppq->tmp[0], out, i);
+         pp_run_pass(ppq, i, ppq->tmp[0], out);
 
       break;
    }
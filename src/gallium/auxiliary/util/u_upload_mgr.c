@@ -32,12 +32,26 @@
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
 #include "u_upload_mgr.h"
 
 
+/* A persistently mapped buffer of the ring. */
+struct u_upload_ring_buffer {
+   struct pipe_resource *buffer;
+   struct pipe_transfer *transfer;
+   uint8_t *map;
+   struct pipe_fence_handle *fence; /* Signalled when the GPU is done with
+                                     * the buffer. */
+   boolean full;    /* Filled up and not fenced or reused yet. */
+   int num_refs;    /* References held by the ring itself, including the
+                     * one the driver may hold for the mapping. */
+};
+
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -52,6 +66,13 @@ struct u_upload_mgr {
    uint8_t *map;    /* Pointer to the mapped upload buffer. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   unsigned num_ring_buffers; /* Zero unless created by u_upload_create_ring.
+                               */
+   unsigned ring_current;     /* Index of the ring buffer being filled. */
+   struct u_upload_ring_buffer ring[U_UPLOAD_MAX_RING_BUFFERS];
+
+   struct u_upload_stats stats; /* Since the last u_upload_end_frame. */
 };
 
 
@@ -87,6 +108,25 @@ u_upload_create(struct pipe_context *pipe, unsigned default_size,
 }
 
 
+struct u_upload_mgr *
+u_upload_create_ring(struct pipe_context *pipe, unsigned default_size,
+                     unsigned bind, unsigned usage, unsigned num_buffers)
+{
+   struct u_upload_mgr *upload = u_upload_create(pipe, default_size,
+                                                 bind, usage);
+   if (!upload)
+      return NULL;
+
+   /* Buffers can only be reused without mapping them again if they stay
+    * mapped.
+    */
+   if (upload->map_persistent && num_buffers >= 2)
+      upload->num_ring_buffers = MIN2(num_buffers, U_UPLOAD_MAX_RING_BUFFERS);
+
+   return upload;
+}
+
+
 static void upload_unmap_internal(struct u_upload_mgr *upload, boolean destroying)
 {
    if (!destroying && upload->map_persistent)
@@ -121,28 +161,81 @@ static void u_upload_release_buffer(struct u_upload_mgr *upload)
 }
 
 
+static void
+u_upload_ring_release(struct u_upload_mgr *upload,
+                      struct u_upload_ring_buffer *ring)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+
+   if (ring->transfer)
+      pipe_transfer_unmap(upload->pipe, ring->transfer);
+   pipe_resource_reference(&ring->buffer, NULL);
+   if (ring->fence)
+      screen->fence_reference(screen, &ring->fence, NULL);
+   memset(ring, 0, sizeof(*ring));
+}
+
+
 void u_upload_destroy( struct u_upload_mgr *upload )
 {
+   unsigned i;
+
+   if (upload->num_ring_buffers) {
+      /* The mapping belongs to the ring buffer. */
+      upload->transfer = NULL;
+      upload->map = NULL;
+
+      for (i = 0; i < upload->num_ring_buffers; i++)
+         u_upload_ring_release(upload, &upload->ring[i]);
+   }
+
    u_upload_release_buffer( upload );
    FREE( upload );
 }
 
 
-static void
-u_upload_alloc_buffer(struct u_upload_mgr *upload,
-                      unsigned min_size)
+boolean
+u_upload_needs_fence(struct u_upload_mgr *upload)
+{
+   unsigned i;
+
+   for (i = 0; i < upload->num_ring_buffers; i++) {
+      if (upload->ring[i].full && !upload->ring[i].fence)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
+void
+u_upload_fence(struct u_upload_mgr *upload, struct pipe_fence_handle *fence)
 {
    struct pipe_screen *screen = upload->pipe->screen;
-   struct pipe_resource buffer;
-   unsigned size;
+   unsigned i;
 
-   /* Release the old buffer, if present:
-    */
-   u_upload_release_buffer( upload );
+   for (i = 0; i < upload->num_ring_buffers; i++) {
+      struct u_upload_ring_buffer *ring = &upload->ring[i];
+
+      if (ring->full && !ring->fence)
+         screen->fence_reference(screen, &ring->fence, fence);
+   }
+}
 
-   /* Allocate a new one: 
-    */
-   size = align(MAX2(upload->default_size, min_size), 4096);
+
+void
+u_upload_end_frame(struct u_upload_mgr *upload, struct u_upload_stats *stats)
+{
+   if (stats)
+      *stats = upload->stats;
+   memset(&upload->stats, 0, sizeof(upload->stats));
+}
+
+
+static struct pipe_resource *
+u_upload_create_buffer(struct u_upload_mgr *upload, unsigned size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct pipe_resource buffer;
 
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
@@ -159,7 +252,26 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload,
                      PIPE_RESOURCE_FLAG_MAP_COHERENT;
    }
 
-   upload->buffer = screen->resource_create(screen, &buffer);
+   upload->stats.num_buffers_created++;
+   return screen->resource_create(screen, &buffer);
+}
+
+
+static void
+u_upload_alloc_buffer(struct u_upload_mgr *upload,
+                      unsigned min_size)
+{
+   unsigned size;
+
+   /* Release the old buffer, if present:
+    */
+   u_upload_release_buffer( upload );
+
+   /* Allocate a new one: 
+    */
+   size = align(MAX2(upload->default_size, min_size), 4096);
+
+   upload->buffer = u_upload_create_buffer(upload, size);
    if (upload->buffer == NULL)
       return;
 
@@ -176,6 +288,96 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload,
    upload->offset = 0;
 }
 
+
+/**
+ * Whether the ring buffer can be filled again with \p min_size bytes.
+ */
+static boolean
+u_upload_ring_is_reusable(struct u_upload_mgr *upload,
+                          struct u_upload_ring_buffer *ring,
+                          unsigned min_size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+
+   if (!ring->buffer || ring->buffer->width0 < min_size)
+      return FALSE;
+
+   /* Full, but still referenced by unflushed commands. */
+   if (ring->full && !ring->fence)
+      return FALSE;
+
+   /* Still bound somewhere, e.g. a constant buffer that stays bound across
+    * flushes.  The fence only covers the commands submitted so far, the
+    * next draw would read whatever the buffer is overwritten with.
+    */
+   if (p_atomic_read(&ring->buffer->reference.count) != ring->num_refs)
+      return FALSE;
+
+   return !ring->fence || screen->fence_finish(screen, ring->fence, 0);
+}
+
+
+/**
+ * Switch to the next buffer of the ring, reusing an idle one if there is
+ * one and allocating one otherwise.
+ */
+static void
+u_upload_ring_next(struct u_upload_mgr *upload, unsigned min_size)
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct u_upload_ring_buffer *ring = NULL;
+   unsigned i, index = 0;
+
+   if (upload->buffer) {
+      upload->ring[upload->ring_current].full = TRUE;
+      pipe_resource_reference(&upload->buffer, NULL);
+      upload->transfer = NULL;
+      upload->map = NULL;
+   }
+
+   for (i = 1; i <= upload->num_ring_buffers; i++) {
+      index = (upload->ring_current + i) % upload->num_ring_buffers;
+      if (u_upload_ring_is_reusable(upload, &upload->ring[index], min_size)) {
+         ring = &upload->ring[index];
+         break;
+      }
+   }
+
+   if (!ring) {
+      /* Everything is busy or too small: replace the next buffer in
+       * rotation, the GPU keeps the old one alive as long as needed.
+       */
+      unsigned size = align(MAX2(upload->default_size, min_size), 4096);
+
+      index = (upload->ring_current + 1) % upload->num_ring_buffers;
+      ring = &upload->ring[index];
+      u_upload_ring_release(upload, ring);
+
+      ring->buffer = u_upload_create_buffer(upload, size);
+      if (!ring->buffer)
+         return;
+
+      ring->map = pipe_buffer_map_range(upload->pipe, ring->buffer, 0, size,
+                                        upload->map_flags, &ring->transfer);
+      if (!ring->map) {
+         ring->transfer = NULL;
+         pipe_resource_reference(&ring->buffer, NULL);
+         return;
+      }
+      ring->num_refs = p_atomic_read(&ring->buffer->reference.count);
+   }
+
+   if (ring->fence)
+      screen->fence_reference(screen, &ring->fence, NULL);
+   ring->full = FALSE;
+
+   upload->ring_current = index;
+   pipe_resource_reference(&upload->buffer, ring->buffer);
+   upload->transfer = ring->transfer;
+   upload->map = ring->map;
+   upload->offset = 0;
+}
+
 void
 u_upload_alloc(struct u_upload_mgr *upload,
                unsigned min_out_offset,
@@ -197,7 +399,10 @@ u_upload_alloc(struct u_upload_mgr *upload,
     * for the sub-allocation.
     */
    if (unlikely(!upload->buffer || offset + size > buffer_size)) {
-      u_upload_alloc_buffer(upload, min_out_offset + size);
+      if (upload->num_ring_buffers)
+         u_upload_ring_next(upload, min_out_offset + size);
+      else
+         u_upload_alloc_buffer(upload, min_out_offset + size);
 
       if (unlikely(!upload->buffer)) {
          *out_offset = ~0;
@@ -237,6 +442,7 @@ u_upload_alloc(struct u_upload_mgr *upload,
    *out_offset = offset;
 
    upload->offset = offset + size;
+   upload->stats.bytes_uploaded += size;
 }
 
 void u_upload_data(struct u_upload_mgr *upload,
@@ -35,8 +35,20 @@
 #include "pipe/p_compiler.h"
 
 struct pipe_context;
+struct pipe_fence_handle;
 struct pipe_resource;
 
+/** The most buffers u_upload_create_ring() rotates through. */
+#define U_UPLOAD_MAX_RING_BUFFERS 8
+
+/**
+ * Upload statistics, see u_upload_end_frame().
+ */
+struct u_upload_stats {
+   uint64_t bytes_uploaded;
+   unsigned num_buffers_created;
+};
+
 
 /**
  * Create the upload manager.
@@ -50,6 +62,41 @@ struct u_upload_mgr *
 u_upload_create(struct pipe_context *pipe, unsigned default_size,
                 unsigned bind, unsigned usage);
 
+/**
+ * Create an upload manager that keeps up to \p num_buffers persistently
+ * mapped buffers and reuses them in rotation, so that steady-state
+ * streaming neither creates nor maps buffers.
+ *
+ * A full buffer is only reused once the fence given to u_upload_fence()
+ * after it filled up has signalled and nothing but the upload manager holds
+ * a reference to it, so the owner must call u_upload_fence() on flushes and
+ * buffers stay intact while they are bound.  Without persistent mappings
+ * this is the same as u_upload_create().
+ */
+struct u_upload_mgr *
+u_upload_create_ring(struct pipe_context *pipe, unsigned default_size,
+                     unsigned bind, unsigned usage, unsigned num_buffers);
+
+/**
+ * Whether u_upload_fence() would do anything, i.e. whether there are full
+ * ring buffers that aren't covered by a fence yet.
+ */
+boolean u_upload_needs_fence(struct u_upload_mgr *upload);
+
+/**
+ * Guard the ring buffers that filled up since the last call with \p fence,
+ * which must signal after all the commands submitted so far.
+ */
+void u_upload_fence(struct u_upload_mgr *upload,
+                    struct pipe_fence_handle *fence);
+
+/**
+ * Return the statistics since the previous call in \p stats (if not NULL)
+ * and reset them.
+ */
+void u_upload_end_frame(struct u_upload_mgr *upload,
+                        struct u_upload_stats *stats);
+
 /**
  * Destroy the upload manager.
  */
@@ -81,12 +81,24 @@
  * rate down.
  *
  *
+ * 3) Translated vertex buffer cache (u_vbuf_translate_cached)
+ *
+ * If enabled with u_vbuf_set_translate_cache_size, translated vertices of
+ * static (PIPE_USAGE_DEFAULT or IMMUTABLE, not persistently mapped) vertex
+ * buffers are kept in their own buffers, keyed by the source buffers, their
+ * offsets and strides and the translate key, so that draws of static
+ * geometry in unsupported formats don't translate anything in the steady
+ * state. The state tracker must call u_vbuf_invalidate_buffer whenever
+ * a source buffer may have been written.
+ *
+ *
  * If there is nothing to do, it forwards every command to the driver.
  * The module also has its own CSO cache of vertex element states.
  */
 
 #include "util/u_vbuf.h"
 
+#include "util/list.h"
 #include "util/u_dump.h"
 #include "util/u_format.h"
 #include "util/u_inlines.h"
@@ -133,6 +145,36 @@ struct u_vbuf_elements {
    void *driver_cso;
 };
 
+/* A vertex element of a cached translation along with the vertex buffer
+ * it's fetched from. */
+struct u_vbuf_cache_elem {
+   struct translate_element te;
+   struct pipe_resource *buffer;
+   unsigned buffer_offset;
+   unsigned stride;
+};
+
+struct u_vbuf_cache_key {
+   unsigned output_stride;
+   unsigned nr_elements;
+   struct u_vbuf_cache_elem element[TRANSLATE_MAX_ATTRIBS];
+};
+
+/* Translated vertices kept across draws. Vertex i is stored at offset
+ * key.output_stride * i of the buffer for every i in [start, end), so any
+ * draw within that range can use the buffer as is. */
+struct u_vbuf_cache_entry {
+   struct list_head head; /* in the LRU list, most recently used first */
+   unsigned hash;
+   int start, end;
+   unsigned size;
+   struct pipe_resource *buffer;
+
+   /* Only the first key_size bytes of the key are allocated. */
+   unsigned key_size;
+   struct u_vbuf_cache_key key;
+};
+
 enum {
    VB_VERTEX = 0,
    VB_INSTANCE = 1,
@@ -184,6 +226,12 @@ struct u_vbuf {
    uint32_t incompatible_vb_mask; /* each bit describes a corresp. buffer */
    /* Which buffer has a non-zero stride. */
    uint32_t nonzero_stride_vb_mask; /* each bit describes a corresp. buffer */
+
+   /* Translated vertex buffer cache. Disabled if the max size is 0. */
+   struct cso_hash *translate_cache_hash;
+   struct list_head translate_cache_lru;
+   unsigned translate_cache_size;
+   unsigned translate_cache_max_size;
 };
 
 static void *
@@ -313,6 +361,7 @@ u_vbuf_create(struct pipe_context *pipe,
    mgr->cso_cache = cso_cache_create();
    mgr->translate_cache = translate_cache_create();
    memset(mgr->fallback_vbs, ~0, sizeof(mgr->fallback_vbs));
+   LIST_INITHEAD(&mgr->translate_cache_lru);
 
    mgr->uploader = u_upload_create(pipe, 1024 * 1024,
                                    PIPE_BIND_VERTEX_BUFFER,
@@ -389,35 +438,30 @@ void u_vbuf_destroy(struct u_vbuf *mgr)
    }
    pipe_resource_reference(&mgr->aux_vertex_buffer_saved.buffer, NULL);
 
+   u_vbuf_set_translate_cache_size(mgr, 0);
+   if (mgr->translate_cache_hash)
+      cso_hash_delete(mgr->translate_cache_hash);
+
    translate_cache_destroy(mgr->translate_cache);
    u_upload_destroy(mgr->uploader);
    cso_cache_delete(mgr->cso_cache);
    FREE(mgr);
 }
 
-static enum pipe_error
-u_vbuf_translate_buffers(struct u_vbuf *mgr, struct translate_key *key,
-                         unsigned vb_mask, unsigned out_vb,
-                         int start_vertex, unsigned num_vertices,
-                         int start_index, unsigned num_indices, int min_index,
-                         boolean unroll_indices)
+/* Map the vertex buffers in vb_mask starting at start_vertex and set them
+ * as the translate inputs. */
+static void
+u_vbuf_translate_map_buffers(struct u_vbuf *mgr, struct translate *tr,
+                             unsigned vb_mask, int start_vertex,
+                             unsigned num_vertices, int min_index,
+                             boolean unroll_indices,
+                             struct pipe_transfer **vb_transfer)
 {
-   struct translate *tr;
-   struct pipe_transfer *vb_transfer[PIPE_MAX_ATTRIBS] = {0};
-   struct pipe_resource *out_buffer = NULL;
-   uint8_t *out_map;
-   unsigned out_offset, mask;
-
-   /* Get a translate object. */
-   tr = translate_cache_find(mgr->translate_cache, key);
-
-   /* Map buffers we want to translate. */
-   mask = vb_mask;
-   while (mask) {
+   while (vb_mask) {
       struct pipe_vertex_buffer *vb;
       unsigned offset;
       uint8_t *map;
-      unsigned i = u_bit_scan(&mask);
+      unsigned i = u_bit_scan(&vb_mask);
 
       vb = &mgr->vertex_buffer[i];
       offset = vb->buffer_offset + vb->stride * start_vertex;
@@ -443,6 +487,40 @@ u_vbuf_translate_buffers(struct u_vbuf *mgr, struct translate_key *key,
 
       tr->set_buffer(tr, i, map, vb->stride, ~0);
    }
+}
+
+static void
+u_vbuf_translate_unmap_buffers(struct u_vbuf *mgr, unsigned vb_mask,
+                               struct pipe_transfer **vb_transfer)
+{
+   while (vb_mask) {
+      unsigned i = u_bit_scan(&vb_mask);
+
+      if (vb_transfer[i]) {
+         pipe_buffer_unmap(mgr->pipe, vb_transfer[i]);
+      }
+   }
+}
+
+static enum pipe_error
+u_vbuf_translate_buffers(struct u_vbuf *mgr, struct translate_key *key,
+                         unsigned vb_mask, unsigned out_vb,
+                         int start_vertex, unsigned num_vertices,
+                         int start_index, unsigned num_indices, int min_index,
+                         boolean unroll_indices)
+{
+   struct translate *tr;
+   struct pipe_transfer *vb_transfer[PIPE_MAX_ATTRIBS] = {0};
+   struct pipe_resource *out_buffer = NULL;
+   uint8_t *out_map;
+   unsigned out_offset;
+
+   /* Get a translate object. */
+   tr = translate_cache_find(mgr->translate_cache, key);
+
+   /* Map buffers we want to translate. */
+   u_vbuf_translate_map_buffers(mgr, tr, vb_mask, start_vertex, num_vertices,
+                                min_index, unroll_indices, vb_transfer);
 
    /* Translate. */
    if (unroll_indices) {
@@ -500,14 +578,7 @@ u_vbuf_translate_buffers(struct u_vbuf *mgr, struct translate_key *key,
    }
 
    /* Unmap all buffers. */
-   mask = vb_mask;
-   while (mask) {
-      unsigned i = u_bit_scan(&mask);
-
-      if (vb_transfer[i]) {
-         pipe_buffer_unmap(mgr->pipe, vb_transfer[i]);
-      }
-   }
+   u_vbuf_translate_unmap_buffers(mgr, vb_mask, vb_transfer);
 
    /* Setup the new vertex buffer. */
    mgr->real_vertex_buffer[out_vb].buffer_offset = out_offset;
@@ -521,6 +592,216 @@ u_vbuf_translate_buffers(struct u_vbuf *mgr, struct translate_key *key,
    return PIPE_OK;
 }
 
+/* Whether translations of the buffer may be cached. Only static buffers are
+ * worth it, and writes through persistent mappings can't be tracked. */
+static boolean
+u_vbuf_buffer_is_cacheable(const struct pipe_resource *buf)
+{
+   return (buf->usage == PIPE_USAGE_DEFAULT ||
+           buf->usage == PIPE_USAGE_IMMUTABLE) &&
+          !(buf->flags & PIPE_RESOURCE_FLAG_MAP_PERSISTENT);
+}
+
+static void
+u_vbuf_cache_entry_destroy(struct u_vbuf *mgr,
+                           struct u_vbuf_cache_entry *entry)
+{
+   struct cso_hash_iter iter =
+      cso_hash_find(mgr->translate_cache_hash, entry->hash);
+   unsigned i;
+
+   while (!cso_hash_iter_is_null(iter) &&
+          cso_hash_iter_data(iter) != entry) {
+      iter = cso_hash_iter_next(iter);
+   }
+   assert(!cso_hash_iter_is_null(iter));
+   cso_hash_erase(mgr->translate_cache_hash, iter);
+
+   LIST_DEL(&entry->head);
+   mgr->translate_cache_size -= entry->size;
+
+   pipe_resource_reference(&entry->buffer, NULL);
+   for (i = 0; i < entry->key.nr_elements; i++) {
+      pipe_resource_reference(&entry->key.element[i].buffer, NULL);
+   }
+   FREE(entry);
+}
+
+static void
+u_vbuf_cache_evict(struct u_vbuf *mgr, unsigned max_size)
+{
+   while (mgr->translate_cache_size > max_size) {
+      struct u_vbuf_cache_entry *last =
+         LIST_ENTRY(struct u_vbuf_cache_entry,
+                    mgr->translate_cache_lru.prev, head);
+
+      u_vbuf_cache_entry_destroy(mgr, last);
+   }
+}
+
+void u_vbuf_set_translate_cache_size(struct u_vbuf *mgr, unsigned max_size)
+{
+   if (max_size && !mgr->translate_cache_hash) {
+      mgr->translate_cache_hash = cso_hash_create();
+      if (!mgr->translate_cache_hash)
+         return;
+   }
+
+   mgr->translate_cache_max_size = max_size;
+   u_vbuf_cache_evict(mgr, max_size);
+}
+
+void u_vbuf_invalidate_buffer(struct u_vbuf *mgr, struct pipe_resource *buf)
+{
+   struct u_vbuf_cache_entry *entry, *next;
+   unsigned i;
+
+   if (buf && !u_vbuf_buffer_is_cacheable(buf))
+      return;
+
+   LIST_FOR_EACH_ENTRY_SAFE(entry, next, &mgr->translate_cache_lru, head) {
+      for (i = 0; i < entry->key.nr_elements; i++) {
+         if (!buf || entry->key.element[i].buffer == buf) {
+            u_vbuf_cache_entry_destroy(mgr, entry);
+            break;
+         }
+      }
+   }
+}
+
+/* Translate the vertices [start, start+count) of the buffers in vb_mask
+ * through the translated vertex buffer cache and bind the result to
+ * the out_vb slot. Returns FALSE if the buffers can't be cached. */
+static boolean
+u_vbuf_translate_cached(struct u_vbuf *mgr, struct translate_key *tkey,
+                        unsigned vb_mask, unsigned out_vb,
+                        int start, unsigned count)
+{
+   struct u_vbuf_cache_key key;
+   struct u_vbuf_cache_entry *entry = NULL;
+   struct cso_hash_iter iter;
+   unsigned i, hash, key_size;
+
+   if (start < 0 || !count)
+      return FALSE;
+
+   key.output_stride = tkey->output_stride;
+   key.nr_elements = tkey->nr_elements;
+   for (i = 0; i < tkey->nr_elements; i++) {
+      struct pipe_vertex_buffer *vb =
+         &mgr->vertex_buffer[tkey->element[i].input_buffer];
+
+      if (vb->user_buffer || !vb->buffer ||
+          !u_vbuf_buffer_is_cacheable(vb->buffer))
+         return FALSE;
+
+      key.element[i].te = tkey->element[i];
+      key.element[i].buffer = vb->buffer;
+      key.element[i].buffer_offset = vb->buffer_offset;
+      key.element[i].stride = vb->stride;
+   }
+   key_size = offsetof(struct u_vbuf_cache_key, element) +
+              key.nr_elements * sizeof(key.element[0]);
+   hash = cso_construct_key(&key, key_size);
+
+   iter = cso_hash_find(mgr->translate_cache_hash, hash);
+   while (!cso_hash_iter_is_null(iter) &&
+          cso_hash_iter_key(iter) == hash) {
+      struct u_vbuf_cache_entry *e = cso_hash_iter_data(iter);
+
+      if (e->key_size == key_size && !memcmp(&e->key, &key, key_size)) {
+         entry = e;
+         break;
+      }
+      iter = cso_hash_iter_next(iter);
+   }
+
+   if (entry && entry->start <= start && start + count <= entry->end) {
+      /* Hit. */
+      LIST_DEL(&entry->head);
+      LIST_ADD(&entry->head, &mgr->translate_cache_lru);
+   } else {
+      struct pipe_transfer *vb_transfer[PIPE_MAX_ATTRIBS] = {0};
+      struct pipe_transfer *out_transfer;
+      struct pipe_resource *out_buffer;
+      struct translate *tr;
+      uint8_t *out_map;
+      int new_start = start, new_end = start + count;
+      unsigned size;
+
+      /* Translate the union of the cached and the requested range, so that
+       * draws of different parts of the same buffers share one entry. */
+      if (entry) {
+         new_start = MIN2(new_start, entry->start);
+         new_end = MAX2(new_end, entry->end);
+      }
+
+      size = key.output_stride * new_end;
+      if (size > mgr->translate_cache_max_size)
+         return FALSE;
+
+      out_buffer = pipe_buffer_create(mgr->pipe->screen,
+                                      PIPE_BIND_VERTEX_BUFFER,
+                                      PIPE_USAGE_DEFAULT, size);
+      if (!out_buffer)
+         return FALSE;
+
+      out_map = pipe_buffer_map_range(mgr->pipe, out_buffer,
+                                      key.output_stride * new_start,
+                                      key.output_stride *
+                                      (new_end - new_start),
+                                      PIPE_TRANSFER_WRITE |
+                                      PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE,
+                                      &out_transfer);
+      if (!out_map) {
+         pipe_resource_reference(&out_buffer, NULL);
+         return FALSE;
+      }
+
+      tr = translate_cache_find(mgr->translate_cache, tkey);
+      u_vbuf_translate_map_buffers(mgr, tr, vb_mask, new_start,
+                                   new_end - new_start, 0, FALSE,
+                                   vb_transfer);
+      tr->run(tr, 0, new_end - new_start, 0, 0, out_map);
+      u_vbuf_translate_unmap_buffers(mgr, vb_mask, vb_transfer);
+      pipe_buffer_unmap(mgr->pipe, out_transfer);
+
+      if (entry)
+         u_vbuf_cache_entry_destroy(mgr, entry);
+      u_vbuf_cache_evict(mgr, mgr->translate_cache_max_size - size);
+
+      entry = MALLOC(offsetof(struct u_vbuf_cache_entry, key) + key_size);
+      if (!entry) {
+         pipe_resource_reference(&out_buffer, NULL);
+         return FALSE;
+      }
+
+      entry->hash = hash;
+      entry->start = new_start;
+      entry->end = new_end;
+      entry->size = size;
+      entry->buffer = out_buffer;
+      entry->key_size = key_size;
+      memcpy(&entry->key, &key, key_size);
+      for (i = 0; i < key.nr_elements; i++) {
+         entry->key.element[i].buffer = NULL;
+         pipe_resource_reference(&entry->key.element[i].buffer,
+                                 key.element[i].buffer);
+      }
+
+      cso_hash_insert(mgr->translate_cache_hash, hash, entry);
+      LIST_ADD(&entry->head, &mgr->translate_cache_lru);
+      mgr->translate_cache_size += size;
+   }
+
+   /* Setup the new vertex buffer. */
+   mgr->real_vertex_buffer[out_vb].buffer_offset = 0;
+   mgr->real_vertex_buffer[out_vb].stride = key.output_stride;
+   pipe_resource_reference(&mgr->real_vertex_buffer[out_vb].buffer,
+                           entry->buffer);
+   return TRUE;
+}
+
 static boolean
 u_vbuf_translate_find_free_vb_slots(struct u_vbuf *mgr,
                                     unsigned mask[VB_NUM])
@@ -667,12 +948,21 @@ u_vbuf_translate_begin(struct u_vbuf *mgr,
    /* Translate buffers. */
    for (type = 0; type < VB_NUM; type++) {
       if (key[type].nr_elements) {
-         enum pipe_error err;
-         err = u_vbuf_translate_buffers(mgr, &key[type], mask[type],
-                                        mgr->fallback_vbs[type],
-                                        start[type], num[type],
-                                        start_index, num_indices, min_index,
-                                        unroll_indices && type == VB_VERTEX);
+         enum pipe_error err = PIPE_OK;
+
+         if (!mgr->translate_cache_max_size ||
+             (unroll_indices && type == VB_VERTEX) ||
+             !u_vbuf_translate_cached(mgr, &key[type], mask[type],
+                                      mgr->fallback_vbs[type],
+                                      start[type], num[type])) {
+            err = u_vbuf_translate_buffers(mgr, &key[type], mask[type],
+                                           mgr->fallback_vbs[type],
+                                           start[type], num[type],
+                                           start_index, num_indices,
+                                           min_index,
+                                           unroll_indices &&
+                                           type == VB_VERTEX);
+         }
          if (err != PIPE_OK)
             return FALSE;
 
@@ -63,6 +63,11 @@ u_vbuf_create(struct pipe_context *pipe,
 
 void u_vbuf_destroy(struct u_vbuf *mgr);
 
+/* Translated vertex buffer cache. A max_size of 0 disables it. */
+void u_vbuf_set_translate_cache_size(struct u_vbuf *mgr, unsigned max_size);
+/* Must be called when buf may have been written. NULL means all buffers. */
+void u_vbuf_invalidate_buffer(struct u_vbuf *mgr, struct pipe_resource *buf);
+
 /* State and draw functions. */
 void u_vbuf_set_vertex_elements(struct u_vbuf *mgr, unsigned count,
                                 const struct pipe_vertex_element *states);
@@ -35,6 +35,7 @@
 #include <limits.h>
 
 #include "pipe/p_defines.h"
+#include "util/u_box.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -146,6 +147,44 @@ void lp_setup_reset( struct lp_setup_context *setup )
 }
 
 
+/**
+ * Record the tiles of the scene that have commands binned as damage of the
+ * color buffers, for resource_get_damage().
+ */
+static void
+lp_setup_add_damage( struct lp_scene *scene )
+{
+   unsigned x, y, i;
+   int x0 = INT_MAX, y0 = INT_MAX, x1 = -1, y1 = -1;
+   struct pipe_box box;
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         if (lp_scene_get_bin(scene, x, y)->head) {
+            x0 = MIN2(x0, (int) x);
+            y0 = MIN2(y0, (int) y);
+            x1 = MAX2(x1, (int) x);
+            y1 = MAX2(y1, (int) y);
+         }
+      }
+   }
+
+   if (x1 < 0)
+      return;
+
+   u_box_2d(x0 * TILE_SIZE, y0 * TILE_SIZE,
+            (x1 - x0 + 1) * TILE_SIZE, (y1 - y0 + 1) * TILE_SIZE, &box);
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+
+      if (cbuf && cbuf->texture->target != PIPE_BUFFER &&
+          cbuf->u.tex.level == 0)
+         llvmpipe_resource_add_damage(cbuf->texture, &box);
+   }
+}
+
+
 /** Rasterize all scene's bins */
 static void
 lp_setup_rasterize_scene( struct lp_setup_context *setup )
@@ -158,6 +197,7 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
           scene->num_active_queries * sizeof(scene->active_queries[0]));
 
    lp_scene_end_binning(scene);
+   lp_setup_add_damage(scene);
 
    lp_fence_reference(&setup->last_fence, scene->fence);
 
@@ -36,6 +36,7 @@
 #include "pipe/p_defines.h"
 
 #include "util/u_inlines.h"
+#include "util/u_box.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
@@ -482,6 +483,51 @@ no_lpr:
 }
 
 
+/**
+ * Grow the damaged region of level 0 of \p resource to include \p box.
+ */
+void
+llvmpipe_resource_add_damage(struct pipe_resource *resource,
+                             const struct pipe_box *box)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+
+   if (box->width <= 0 || box->height <= 0)
+      return;
+
+   if (lpr->damage.width == 0)
+      lpr->damage = *box;
+   else
+      u_box_union_2d(&lpr->damage, &lpr->damage, box);
+}
+
+
+static boolean
+llvmpipe_resource_get_damage(struct pipe_screen *screen,
+                             struct pipe_resource *resource,
+                             struct pipe_box *box)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+
+   u_box_2d(0, 0, 0, 0, box);
+
+   if (lpr->damage.width) {
+      /* Rendering damages whole tiles, which may go past the edges. */
+      const int x1 = MIN2(lpr->damage.x + lpr->damage.width,
+                          (int) resource->width0);
+      const int y1 = MIN2(lpr->damage.y + lpr->damage.height,
+                          (int) resource->height0);
+
+      if (x1 > lpr->damage.x && y1 > lpr->damage.y)
+         u_box_2d(lpr->damage.x, lpr->damage.y,
+                  x1 - lpr->damage.x, y1 - lpr->damage.y, box);
+   }
+
+   memset(&lpr->damage, 0, sizeof(lpr->damage));
+   return TRUE;
+}
+
+
 static boolean
 llvmpipe_resource_get_handle(struct pipe_screen *screen,
                             struct pipe_resource *pt,
@@ -603,6 +649,9 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+
+      if (level == 0)
+         llvmpipe_resource_add_damage(resource, box);
    }
 
    map +=
@@ -805,10 +854,11 @@ llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen)
 #endif
 
    screen->resource_create = llvmpipe_resource_create;
-/*   screen->resource_create_front = llvmpipe_resource_create_front; */
+   screen->resource_create_front = llvmpipe_resource_create_front;
    screen->resource_destroy = llvmpipe_resource_destroy;
    screen->resource_from_handle = llvmpipe_resource_from_handle;
    screen->resource_get_handle = llvmpipe_resource_get_handle;
+   screen->resource_get_damage = llvmpipe_resource_get_damage;
    screen->can_create_resource = llvmpipe_can_create_resource;
 }
 
@@ -88,6 +88,12 @@ struct llvmpipe_resource
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
+   /**
+    * Region of level 0 written since the last resource_get_damage() call,
+    * in pixels.  Rendering adds whole tiles.
+    */
+   struct pipe_box damage;
+
    unsigned id;  /**< temporary, for debugging */
 
 #ifdef DEBUG
@@ -130,6 +136,10 @@ llvmpipe_transfer(struct pipe_transfer *pt)
 void llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen);
 void llvmpipe_init_context_resource_funcs(struct pipe_context *pipe);
 
+void
+llvmpipe_resource_add_damage(struct pipe_resource *resource,
+                             const struct pipe_box *box);
+
 
 static inline boolean
 llvmpipe_resource_is_texture(const struct pipe_resource *resource)
@@ -207,6 +207,16 @@ struct pipe_screen {
 				  struct pipe_resource *tex,
 				  struct winsys_handle *handle);
 
+   /**
+    * Return the region of level 0 of a resource that was written since the
+    * previous call, and start over.  An empty box means nothing changed.
+    * Rendering must have been flushed and finished.  Optional; if this is
+    * NULL or returns FALSE, the whole resource may have changed.
+    */
+   boolean (*resource_get_damage)(struct pipe_screen *,
+                                  struct pipe_resource *resource,
+                                  struct pipe_box *box);
+
 
    void (*resource_destroy)(struct pipe_screen *,
 			    struct pipe_resource *pt);
@@ -415,6 +415,24 @@ struct st_context_iface
     */
    boolean (*get_resource_for_egl_image)(struct st_context_iface *stctxi,
                                          struct st_context_resource *stres);
+
+   /**
+    * Start the worker thread if the API supports one (glthread).
+    * Called after the context has been created and fully initialized on
+    * both sides (e.g. st/mesa and st/dri).
+    *
+    * This function is optional.
+    */
+   void (*start_thread)(struct st_context_iface *stctxi);
+
+   /**
+    * Wait for all commands queued to the worker thread to be executed, so
+    * that the context and its pipe can be used from the calling thread.
+    * Called from the application thread.
+    *
+    * This function is optional.
+    */
+   void (*thread_finish)(struct st_context_iface *stctxi);
 };
 
 
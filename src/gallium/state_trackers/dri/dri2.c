@@ -1185,6 +1185,9 @@ dri2_blit_image(__DRIcontext *context, __DRIimage *dst, __DRIimage *src,
    if (!dst || !src)
       return;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    memset(&blit, 0, sizeof(blit));
    blit.dst.resource = dst->texture;
    blit.dst.box.x = dstx0;
@@ -1301,12 +1304,16 @@ struct dri2_fence {
 static void *
 dri2_create_fence(__DRIcontext *_ctx)
 {
-   struct pipe_context *ctx = dri_context(_ctx)->st->pipe;
+   struct st_context_iface *stapi = dri_context(_ctx)->st;
+   struct pipe_context *ctx = stapi->pipe;
    struct dri2_fence *fence = CALLOC_STRUCT(dri2_fence);
 
    if (!fence)
       return NULL;
 
+   if (stapi->thread_finish)
+      stapi->thread_finish(stapi);
+
    ctx->flush(ctx, &fence->pipe_fence, 0);
 
    if (!fence->pipe_fence) {
@@ -156,6 +156,12 @@ dri_create_context(gl_api api, const struct gl_config * visual,
       ctx->hud = hud_create(ctx->st->pipe, ctx->st->cso_context);
    }
 
+   /* Do this last. */
+   if (ctx->st->start_thread &&
+       driQueryOptionb(&screen->optionCache, "mesa_glthread")) {
+      ctx->st->start_thread(ctx->st);
+   }
+
    *error = __DRI_CTX_ERROR_SUCCESS;
    return GL_TRUE;
 
@@ -172,6 +178,9 @@ dri_destroy_context(__DRIcontext * cPriv)
 {
    struct dri_context *ctx = dri_context(cPriv);
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (ctx->hud) {
       hud_destroy(ctx->hud);
    }
@@ -223,8 +232,11 @@ dri_make_current(__DRIcontext * cPriv,
    struct st_context_iface *old_st = ctx->stapi->get_current(ctx->stapi);
 
    /* Flush the old context here so we don't have to flush on unbind() */
-   if (old_st && old_st != ctx->st)
+   if (old_st && old_st != ctx->st) {
+      if (old_st->thread_finish)
+         old_st->thread_finish(old_st);
       old_st->flush(old_st, ST_FLUSH_FRONT, NULL);
+   }
 
    ++ctx->bind_count;
 
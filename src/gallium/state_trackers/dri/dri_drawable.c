@@ -220,6 +220,9 @@ dri_set_tex_buffer2(__DRIcontext *pDRICtx, GLint target,
    struct dri_drawable *drawable = dri_drawable(dPriv);
    struct pipe_resource *pt;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    dri_drawable_validate_att(ctx, drawable, ST_ATTACHMENT_FRONT_LEFT);
 
    /* Use the pipe resource associated with the X drawable */
@@ -451,6 +454,9 @@ dri_flush(__DRIcontext *cPriv,
       return;
    }
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (drawable) {
       /* prevent recursion */
       if (drawable->flushing)
@@ -28,10 +28,10 @@
 
 /* TODO:
  *
- * xshm / EGLImage:
+ * EGLImage:
  *
- * Allow the loaders to use the XSHM extension. It probably requires callbacks
- * for createImage/destroyImage similar to DRI2 getBuffers.
+ * It probably requires callbacks for createImage/destroyImage similar to
+ * DRI2 getBuffers.
  */
 
 #include "util/u_format.h"
@@ -85,6 +85,18 @@ put_image2(__DRIdrawable *dPriv, void *data, int x, int y,
                      data, dPriv->loaderPrivate);
 }
 
+static inline void
+put_image_shm(__DRIdrawable *dPriv, int shmid, char *shmaddr, unsigned offset,
+              int x, int y, unsigned width, unsigned height, unsigned stride)
+{
+   __DRIscreen *sPriv = dPriv->driScreenPriv;
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
+
+   loader->putImageShm(dPriv, __DRI_SWRAST_IMAGE_OP_SWAP,
+                       x, y, width, height, stride,
+                       shmid, shmaddr, offset, dPriv->loaderPrivate);
+}
+
 static inline void
 get_image(__DRIdrawable *dPriv, int x, int y, int width, int height, void *data)
 {
@@ -151,6 +163,17 @@ drisw_put_image2(struct dri_drawable *drawable,
    put_image2(dPriv, data, x, y, width, height, stride);
 }
 
+static void
+drisw_put_image_shm(struct dri_drawable *drawable,
+                    int shmid, char *shmaddr, unsigned offset,
+                    int x, int y, unsigned width, unsigned height,
+                    unsigned stride)
+{
+   __DRIdrawable *dPriv = drawable->dPriv;
+
+   put_image_shm(dPriv, shmid, shmaddr, offset, x, y, width, height, stride);
+}
+
 static inline void
 drisw_present_texture(__DRIdrawable *dPriv,
                       struct pipe_resource *ptex, struct pipe_box *sub_box)
@@ -197,6 +220,9 @@ drisw_swap_buffers(__DRIdrawable *dPriv)
    if (!ctx)
       return;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    ptex = drawable->textures[ST_ATTACHMENT_BACK_LEFT];
 
    if (ptex) {
@@ -220,6 +246,9 @@ drisw_copy_sub_buffer(__DRIdrawable *dPriv, int x, int y,
    if (!ctx)
       return;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    ptex = drawable->textures[ST_ATTACHMENT_BACK_LEFT];
 
    if (ptex) {
@@ -229,7 +258,26 @@ drisw_copy_sub_buffer(__DRIdrawable *dPriv, int x, int y,
       ctx->st->flush(ctx->st, ST_FLUSH_FRONT, NULL);
 
       u_box_2d(x, dPriv->h - y - h, w, h, &box);
-      drisw_present_texture(dPriv, ptex, &box);
+
+      /* Don't present past the edges of the back buffer. */
+      if (box.x < 0) {
+         box.width += box.x;
+         box.x = 0;
+      }
+      if (box.y < 0) {
+         box.height += box.y;
+         box.y = 0;
+      }
+      box.width = MIN2(box.width, (int) ptex->width0 - box.x);
+      box.height = MIN2(box.height, (int) ptex->height0 - box.y);
+
+      if (box.width > 0 && box.height > 0)
+         drisw_present_texture(dPriv, ptex, &box);
+
+      /* EGL uses this for damage-limited swaps, so pick up resizes as
+       * swap_buffers does.
+       */
+      drisw_invalidate_drawable(dPriv);
    }
 }
 
@@ -378,12 +426,24 @@ static struct drisw_loader_funcs drisw_lf = {
    .put_image2 = drisw_put_image2
 };
 
+/* Loader functions for loaders that can present from shared memory, which
+ * makes the winsys allocate display targets there.
+ */
+static struct drisw_loader_funcs drisw_shm_lf = {
+   .get_image = drisw_get_image,
+   .put_image = drisw_put_image,
+   .put_image2 = drisw_put_image2,
+   .put_image_shm = drisw_put_image_shm
+};
+
 static const __DRIconfig **
 drisw_init_screen(__DRIscreen * sPriv)
 {
+   const __DRIswrastLoaderExtension *loader = sPriv->swrast_loader;
    const __DRIconfig **configs;
    struct dri_screen *screen;
    struct pipe_screen *pscreen = NULL;
+   struct drisw_loader_funcs *lf = &drisw_lf;
 
    screen = CALLOC_STRUCT(dri_screen);
    if (!screen)
@@ -397,7 +457,10 @@ drisw_init_screen(__DRIscreen * sPriv)
    sPriv->driverPrivate = (void *)screen;
    sPriv->extensions = drisw_screen_extensions;
 
-   if (pipe_loader_sw_probe_dri(&screen->dev, &drisw_lf))
+   if (loader->base.version >= 4 && loader->putImageShm)
+      lf = &drisw_shm_lf;
+
+   if (pipe_loader_sw_probe_dri(&screen->dev, lf))
       pscreen = pipe_loader_create_screen(screen->dev);
 
    if (!pscreen)
@@ -64,12 +64,16 @@
 #include "util/u_format.h"
 #include "util/u_memory.h"
 
+#include "hud/hud_context.h"
+
 #include "postprocess/filters.h"
 #include "postprocess/postprocess.h"
 
 #include "state_tracker/st_api.h"
 #include "state_tracker/st_gl_api.h"
 
+#include "sw/null/null_sw_winsys.h"
+
 
 
 extern struct pipe_screen *
@@ -86,6 +90,18 @@ struct osmesa_buffer
    struct pipe_resource *textures[ST_ATTACHMENT_COUNT];
 
    void *map;
+   unsigned stride;       /**< of the user's buffer, in bytes */
+   GLboolean y_up;
+
+   /**
+    * The user memory the front-left resource renders into, or NULL if it is
+    * a regular resource whose contents are copied on flush.
+    */
+   void *front_map;
+   unsigned front_stride;
+
+   /** Copy everything on the next flush, not just the damaged region */
+   boolean full_copy;
 
    struct osmesa_buffer *next;  /**< next in linked list */
 };
@@ -110,6 +126,9 @@ struct osmesa_context
    /** Which postprocessing filters are enabled. */
    unsigned pp_enabled[PP_FILTERS];
    struct pp_queue_t *pp;
+
+   /** GALLIUM_HUD, usually just streaming its values (GALLIUM_HUD_DUMP) */
+   struct hud_context *hud;
 };
 
 
@@ -299,6 +318,55 @@ stfbi_to_osbuffer(struct st_framebuffer_iface *stfbi)
 }
 
 
+/**
+ * Can the color buffer be rendered straight into the user's buffer?
+ * The driver writes whole 4x4 pixel blocks, so the rows must be padded to
+ * a multiple of four pixels, and the image can't be flipped.
+ */
+static boolean
+osmesa_can_render_to_user_buffer(const struct osmesa_buffer *osbuffer)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+   const unsigned bpp = util_format_get_blocksize(osbuffer->visual.color_format);
+
+   return screen->resource_create_front &&
+          osbuffer->map &&
+          !osbuffer->y_up &&
+          osbuffer->height % 4 == 0 &&
+          osbuffer->stride >= align(osbuffer->width, 4) * bpp &&
+          osbuffer->stride % 16 == 0 &&
+          ((uintptr_t) osbuffer->map) % 16 == 0;
+}
+
+
+/**
+ * Record the user's buffer and layout.  If anything changed, the next flush
+ * copies the whole image, and the framebuffer is revalidated if the front
+ * buffer renders, or could render, into user memory.
+ */
+static void
+osmesa_set_user_buffer(OSMesaContext osmesa, struct osmesa_buffer *osbuffer,
+                       void *map)
+{
+   const unsigned bpp = util_format_get_blocksize(osbuffer->visual.color_format);
+   const unsigned stride = bpp * (osmesa->user_row_length ?
+                                  osmesa->user_row_length : osbuffer->width);
+
+   if (map == osbuffer->map &&
+       stride == osbuffer->stride &&
+       osmesa->y_up == osbuffer->y_up)
+      return;
+
+   osbuffer->map = map;
+   osbuffer->stride = stride;
+   osbuffer->y_up = osmesa->y_up;
+   osbuffer->full_copy = TRUE;
+
+   if (osbuffer->front_map || osmesa_can_render_to_user_buffer(osbuffer))
+      p_atomic_inc(&osbuffer->stfb->stamp);
+}
+
+
 /**
  * Called via glFlush/glFinish.  This is where we copy the contents
  * of the driver's color buffer into the user-specified buffer.
@@ -311,9 +379,10 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
    OSMesaContext osmesa = OSMesaGetCurrentContext();
    struct osmesa_buffer *osbuffer = stfbi_to_osbuffer(stfbi);
    struct pipe_context *pipe = stctx->pipe;
+   struct pipe_screen *screen = pipe->screen;
    struct pipe_resource *res = osbuffer->textures[statt];
    struct pipe_transfer *transfer = NULL;
-   struct pipe_box box;
+   struct pipe_box box, damage;
    void *map;
    ubyte *src, *dst;
    unsigned y, bytes, bpp;
@@ -341,30 +410,59 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
       pp_run(osmesa->pp, res, res, zsbuf);
    }
 
+   if (osmesa->hud)
+      hud_draw(osmesa->hud, res);
+
+   if (statt == ST_ATTACHMENT_FRONT_LEFT &&
+       osbuffer->front_map == osbuffer->map &&
+       osbuffer->front_stride == osbuffer->stride &&
+       !osbuffer->y_up) {
+      /* The driver renders into the user's buffer; just wait for it. */
+      struct pipe_fence_handle *fence = NULL;
+
+      pipe->flush(pipe, &fence, 0);
+      if (fence) {
+         screen->fence_finish(screen, fence, PIPE_TIMEOUT_INFINITE);
+         screen->fence_reference(screen, &fence, NULL);
+      }
+      return TRUE;
+   }
+
    u_box_2d(0, 0, res->width0, res->height0, &box);
 
    map = pipe->transfer_map(pipe, res, 0, PIPE_TRANSFER_READ, &box,
                             &transfer);
 
+   /* Mapping finished rendering, so the damage is complete.  Query it even
+    * for a full copy, to start tracking again.
+    */
+   damage = box;
+   if (screen->resource_get_damage &&
+       screen->resource_get_damage(screen, res, &damage) &&
+       !osbuffer->full_copy) {
+      box = damage;
+   }
+   osbuffer->full_copy = FALSE;
+
    /*
     * Copy the color buffer from the resource to the user's buffer.
     */
    bpp = util_format_get_blocksize(osbuffer->visual.color_format);
-   src = map;
-   dst = osbuffer->map;
-   if (osmesa->user_row_length)
-      dst_stride = bpp * osmesa->user_row_length;
-   else
-      dst_stride = bpp * osbuffer->width;
-   bytes = bpp * res->width0;
-
-   if (osmesa->y_up) {
+   dst_stride = osbuffer->stride;
+   src = (ubyte *) map + box.y * transfer->stride + box.x * bpp;
+   dst = (ubyte *) osbuffer->map + box.x * bpp;
+   bytes = bpp * box.width;
+
+   if (osbuffer->y_up) {
       /* need to flip image upside down */
-      dst = dst + (res->height0 - 1) * dst_stride;
+      dst = dst + (res->height0 - 1 - box.y) * dst_stride;
       dst_stride = -dst_stride;
    }
+   else {
+      dst = dst + box.y * dst_stride;
+   }
 
-   for (y = 0; y < res->height0; y++) {
+   for (y = 0; y < box.height; y++) {
       memcpy(dst, src, bytes);
       dst += dst_stride;
       src += transfer->stride;
@@ -432,6 +530,30 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
 
       templat.format = format;
       templat.bind = bind;
+
+      if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
+         osbuffer->front_map = NULL;
+         osbuffer->front_stride = 0;
+         osbuffer->full_copy = TRUE;
+
+         if (osmesa_can_render_to_user_buffer(osbuffer)) {
+            struct null_sw_user_memory mem;
+
+            mem.data = osbuffer->map;
+            mem.stride = osbuffer->stride;
+            templat.bind |= PIPE_BIND_DISPLAY_TARGET;
+
+            out[i] = screen->resource_create_front(screen, &templat, &mem);
+            if (out[i]) {
+               osbuffer->textures[statts[i]] = out[i];
+               osbuffer->front_map = mem.data;
+               osbuffer->front_stride = mem.stride;
+               continue;
+            }
+            templat.bind = bind;
+         }
+      }
+
       out[i] = osbuffer->textures[statts[i]] =
          screen->resource_create(screen, &templat);
    }
@@ -694,6 +816,8 @@ OSMesaCreateContextAttribs(const int *attribList, OSMesaContext sharelist)
 
    osmesa->stctx->st_manager_private = osmesa;
 
+   osmesa->hud = hud_create(osmesa->stctx->pipe, osmesa->stctx->cso_context);
+
    osmesa->format = format;
    osmesa->user_row_length = 0;
    osmesa->y_up = GL_TRUE;
@@ -713,6 +837,8 @@ OSMesaDestroyContext(OSMesaContext osmesa)
 {
    if (osmesa) {
       pp_free(osmesa->pp);
+      if (osmesa->hud)
+         hud_destroy(osmesa->hud);
       osmesa->stctx->destroy(osmesa->stctx);
       FREE(osmesa);
    }
@@ -776,7 +902,7 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
 
    osbuffer->width = width;
    osbuffer->height = height;
-   osbuffer->map = buffer;
+   osmesa_set_user_buffer(osmesa, osbuffer, buffer);
 
    /* XXX unused for now */
    (void) osmesa_destroy_buffer;
@@ -840,6 +966,10 @@ OSMesaPixelStore(GLint pname, GLint value)
       fprintf(stderr, "Invalid pname in OSMesaPixelStore()\n");
       return;
    }
+
+   if (osmesa->current_buffer)
+      osmesa_set_user_buffer(osmesa, osmesa->current_buffer,
+                             osmesa->current_buffer->map);
 }
 
 
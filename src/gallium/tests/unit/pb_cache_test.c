@@ -0,0 +1,360 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Test case and benchmark for pb_cache, caching pb_malloc_buffer_create()
+ * buffers the way the radeon and amdgpu winsyses cache buffer objects.
+ */
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipebuffer/pb_buffer.h"
+#include "pipebuffer/pb_bufmgr.h"
+#include "pipebuffer/pb_cache.h"
+#include "util/u_memory.h"
+#include "util/u_time.h"
+
+
+struct test_buffer
+{
+   struct pb_buffer base;
+   struct pb_buffer *buffer;
+   struct pb_cache_entry cache_entry;
+   bool busy;
+};
+
+
+static struct test_buffer *
+test_buffer(struct pb_buffer *buf)
+{
+   return (struct test_buffer *)buf;
+}
+
+
+static void
+test_buffer_destroy(struct pb_buffer *buf)
+{
+   pb_cache_add_buffer(&test_buffer(buf)->cache_entry);
+}
+
+
+static void *
+test_buffer_map(struct pb_buffer *buf, unsigned flags, void *flush_ctx)
+{
+   return pb_map(test_buffer(buf)->buffer, flags, flush_ctx);
+}
+
+
+static void
+test_buffer_unmap(struct pb_buffer *buf)
+{
+   pb_unmap(test_buffer(buf)->buffer);
+}
+
+
+static enum pipe_error
+test_buffer_validate(struct pb_buffer *buf, struct pb_validate *vl,
+                     unsigned flags)
+{
+   return PIPE_ERROR;
+}
+
+
+static void
+test_buffer_fence(struct pb_buffer *buf, struct pipe_fence_handle *fence)
+{
+}
+
+
+static void
+test_buffer_get_base_buffer(struct pb_buffer *buf,
+                            struct pb_buffer **base_buf, pb_size *offset)
+{
+   pb_get_base_buffer(test_buffer(buf)->buffer, base_buf, offset);
+}
+
+
+static const struct pb_vtbl
+test_buffer_vtbl = {
+   test_buffer_destroy,
+   test_buffer_map,
+   test_buffer_unmap,
+   test_buffer_validate,
+   test_buffer_fence,
+   test_buffer_get_base_buffer
+};
+
+
+static void
+test_destroy_buffer(struct pb_buffer *buf)
+{
+   pb_reference(&test_buffer(buf)->buffer, NULL);
+   FREE(buf);
+}
+
+
+static bool
+test_can_reclaim(struct pb_buffer *buf)
+{
+   return !test_buffer(buf)->busy;
+}
+
+
+static struct pb_buffer *
+test_create_buffer(struct pb_cache *cache, pb_size size, unsigned alignment,
+                   unsigned usage)
+{
+   struct pb_desc desc;
+   struct test_buffer *buf;
+
+   buf = (struct test_buffer *)
+         pb_cache_reclaim_buffer(cache, size, alignment, usage);
+   if (buf)
+      return &buf->base;
+
+   buf = CALLOC_STRUCT(test_buffer);
+   desc.alignment = alignment;
+   desc.usage = usage;
+   buf->buffer = pb_malloc_buffer_create(size, &desc);
+
+   pipe_reference_init(&buf->base.reference, 1);
+   buf->base.alignment = alignment;
+   buf->base.usage = usage;
+   buf->base.size = size;
+   buf->base.vtbl = &test_buffer_vtbl;
+   pb_cache_init_entry(cache, &buf->cache_entry, &buf->base);
+   return &buf->base;
+}
+
+
+static int failures;
+
+#define CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         failures++; \
+      } \
+   } while (0)
+
+
+static void
+test_reclaim(void)
+{
+   struct pb_cache cache;
+   struct pb_buffer *a = NULL, *b = NULL;
+   struct test_buffer *cached;
+
+   pb_cache_init(&cache, 1000000, 2.0f, PB_USAGE_CPU_READ, 1 << 20,
+                 test_destroy_buffer, test_can_reclaim);
+
+   /* Same size and usage. */
+   a = test_create_buffer(&cache, 1000, 64, PB_USAGE_GPU_READ_WRITE);
+   pb_reference(&a, NULL);
+   b = test_create_buffer(&cache, 1000, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(cache.num_hits == 1 && cache.num_buffers == 0);
+   pb_reference(&b, NULL);
+
+   /* Larger buffers within the size factor, compatible alignment and a
+    * superset of the usage are hits.
+    */
+   b = test_create_buffer(&cache, 600, 16, PB_USAGE_GPU_READ);
+   CHECK(cache.num_hits == 2 && b->size == 1000);
+   pb_reference(&b, NULL);
+
+   /* Too small, too big, too loosely aligned or the wrong usage. */
+   a = test_create_buffer(&cache, 1001, 64, PB_USAGE_GPU_READ_WRITE);
+   cached = test_buffer(a);
+   pb_reference(&a, NULL);
+   b = test_create_buffer(&cache, 499, 64, PB_USAGE_GPU_READ_WRITE);
+   pb_reference(&b, NULL);
+   b = test_create_buffer(&cache, 1000, 128, PB_USAGE_GPU_READ_WRITE);
+   pb_reference(&b, NULL);
+   b = test_create_buffer(&cache, 1000, 64, PB_USAGE_CPU_WRITE);
+   pb_reference(&b, NULL);
+   CHECK(cache.num_hits == 2 && cache.num_misses == 5);
+
+   /* Bypassed usage. */
+   b = test_create_buffer(&cache, 1000, 64, PB_USAGE_CPU_READ);
+   CHECK(cache.num_hits == 2);
+   pb_reference(&b, NULL);
+
+   /* The least recently used fitting buffer is busy. */
+   cached->busy = true;
+   b = test_create_buffer(&cache, 1001, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(b != &cached->base && cache.num_misses == 6);
+   pb_reference(&b, NULL);
+   cached->busy = false;
+
+   /* Over the cache size limit. */
+   a = test_create_buffer(&cache, 1 << 20, 64, PB_USAGE_GPU_READ_WRITE);
+   pb_reference(&a, NULL);
+   CHECK(cache.num_evictions == 1);
+
+   pb_cache_release_all_buffers(&cache);
+   CHECK(cache.num_buffers == 0 && cache.cache_size == 0);
+   pb_cache_deinit(&cache);
+}
+
+
+/**
+ * Size classes are searched smallest first, and a busy buffer only ends
+ * the search in its own bucket.
+ */
+static void
+test_reclaim_order(void)
+{
+   struct pb_cache cache;
+   struct pb_buffer *a = NULL, *b = NULL, *c = NULL;
+   struct test_buffer *exact;
+
+   pb_cache_init(&cache, 1000000, 2.0f, 0, 1 << 20,
+                 test_destroy_buffer, test_can_reclaim);
+
+   /* An idle buffer of the requested size wins over a bigger one that was
+    * released earlier.
+    */
+   a = test_create_buffer(&cache, 1500, 64, PB_USAGE_GPU_READ_WRITE);
+   b = test_create_buffer(&cache, 1000, 64, PB_USAGE_GPU_READ_WRITE);
+   exact = test_buffer(b);
+   pb_reference(&a, NULL);
+   pb_reference(&b, NULL);
+   b = test_create_buffer(&cache, 1000, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(b == &exact->base && cache.num_hits == 1);
+
+   /* A busy buffer of the requested size doesn't hide the bigger one. */
+   exact->busy = true;
+   pb_reference(&b, NULL);
+   c = test_create_buffer(&cache, 1000, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(c->size == 1500 && cache.num_hits == 2);
+   pb_reference(&c, NULL);
+
+   /* A busy bigger buffer doesn't hide a smaller idle one either. */
+   exact->busy = false;
+   a = test_create_buffer(&cache, 1500, 64, PB_USAGE_GPU_READ_WRITE);
+   test_buffer(a)->busy = true;
+   pb_reference(&a, NULL);
+   b = test_create_buffer(&cache, 900, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(b == &exact->base && cache.num_hits == 4);
+   pb_reference(&b, NULL);
+
+   pb_cache_release_all_buffers(&cache);
+   pb_cache_deinit(&cache);
+}
+
+
+static void
+test_expiration(void)
+{
+   struct pb_cache cache;
+   struct pb_buffer *a = NULL;
+
+   pb_cache_init(&cache, 1000, 2.0f, 0, 1 << 20,
+                 test_destroy_buffer, test_can_reclaim);
+
+   a = test_create_buffer(&cache, 4096, 64, PB_USAGE_GPU_READ_WRITE);
+   pb_reference(&a, NULL);
+   CHECK(cache.num_buffers == 1);
+
+   os_time_sleep(2000);
+   a = test_create_buffer(&cache, 64, 64, PB_USAGE_GPU_READ_WRITE);
+   CHECK(cache.num_buffers == 0 && cache.num_evictions == 1);
+   pb_reference(&a, NULL);
+
+   pb_cache_deinit(&cache);
+}
+
+
+/**
+ * Streaming uploads: a window of live buffers of random sizes between 4 KB
+ * and 1 MB, with many more buffers sitting in the cache.
+ */
+static void
+bench_streaming(unsigned num_cached)
+{
+   const unsigned num_live = 64, iterations = 200000;
+   struct pb_buffer *live[64] = { NULL };
+   struct pb_buffer **fill = CALLOC(num_cached, sizeof(*fill));
+   struct pb_cache cache;
+   int64_t start, end;
+   unsigned i;
+
+   pb_cache_init(&cache, 10000000, 2.0f, 0, ~0ull,
+                 test_destroy_buffer, test_can_reclaim);
+   srand(42);
+
+   /* Fill the cache. */
+   for (i = 0; i < num_cached; i++) {
+      fill[i] = test_create_buffer(&cache, 4096 * (1 + rand() % 256), 4096,
+                                   PB_USAGE_GPU_READ_WRITE);
+   }
+   for (i = 0; i < num_cached; i++)
+      pb_reference(&fill[i], NULL);
+   FREE(fill);
+   cache.num_misses = 0;
+
+   start = os_time_get_nano();
+   for (i = 0; i < iterations; i++) {
+      pb_reference(&live[i % num_live], NULL);
+      live[i % num_live] =
+         test_create_buffer(&cache, 4096 * (1 + rand() % 256), 4096,
+                            PB_USAGE_GPU_READ_WRITE);
+   }
+   end = os_time_get_nano();
+
+   printf("%5u cached buffers: %8.2f M allocations/s, "
+          "%"PRIu64" hits, %"PRIu64" misses, %"PRIu64" evictions\n",
+          num_cached, iterations * 1e3 / (end - start),
+          cache.num_hits, cache.num_misses, cache.num_evictions);
+
+   for (i = 0; i < num_live; i++)
+      pb_reference(&live[i], NULL);
+   pb_cache_deinit(&cache);
+}
+
+
+int main(int argc, char **argv)
+{
+   unsigned num_cached;
+
+   test_reclaim();
+   test_reclaim_order();
+   test_expiration();
+
+   for (num_cached = 256; num_cached <= 8192; num_cached *= 2)
+      bench_streaming(num_cached);
+
+   if (failures) {
+      printf("%d check(s) failed\n", failures);
+      return 1;
+   }
+   return 0;
+}
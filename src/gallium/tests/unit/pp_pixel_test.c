@@ -0,0 +1,331 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Test case for the fused per-pixel postprocessing filters.
+ *
+ * Runs chains of the color and celshade filters three ways with tgsi_exec
+ * and compares the results:
+ *
+ *  - the TGSI shaders the filters used before they were fused, one after
+ *    the other,
+ *  - the single shader pp_pixel_chain_init() builds from the filters' emit
+ *    functions,
+ *  - the filters' CPU functions used by PP_CPU_TILES.
+ *
+ * tgsi_exec needs interpolation setup to run fragment shaders, so the
+ * shaders are run as vertex shaders, with the texture fetch replaced by a
+ * vertex input.
+ */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "postprocess/postprocess.h"
+#include "postprocess/pp_filters.h"
+#include "postprocess/pp_private.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "tgsi/tgsi_ureg.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define NUM_TOKENS 1024
+
+
+/* The shaders of pp_colors.h and pp_celshade.h before the fusion. */
+
+static const char nored[] = "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], GENERIC[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM FLT32 {    0.0000,     0.0000,     0.0000,     0.0000}\n"
+   "  0: MOV TEMP[0], IN[0]\n"
+   "  1: MOV TEMP[0].x, IMM[0].xxxx\n"
+   "  2: MOV OUT[0], TEMP[0]\n"
+   "  3: END\n";
+
+static const char nogreen[] = "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], GENERIC[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM FLT32 {    0.0000,     0.0000,     0.0000,     0.0000}\n"
+   "  0: MOV TEMP[0], IN[0]\n"
+   "  1: MOV TEMP[0].y, IMM[0].xxxx\n"
+   "  2: MOV OUT[0], TEMP[0]\n"
+   "  3: END\n";
+
+static const char noblue[] = "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], GENERIC[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM FLT32 {    0.0000,     0.0000,     0.0000,     0.0000}\n"
+   "  0: MOV TEMP[0], IN[0]\n"
+   "  1: MOV TEMP[0].z, IMM[0].xxxx\n"
+   "  2: MOV OUT[0], TEMP[0]\n"
+   "  3: END\n";
+
+static const char celshade[] = "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], GENERIC[0]\n"
+   "DCL TEMP[0..4]\n"
+   "IMM FLT32 {    0.2126,     0.7152,     0.0722,     4.0000}\n"
+   "IMM FLT32 {    0.5000,     2.0000,     1.0000,    -0.1250}\n"
+   "IMM FLT32 {    0.2500,     0.1000,     0.1250,     3.0000}\n"
+   "  0: MOV TEMP[0], IN[0]\n"
+   "  1: DP3 TEMP[1].x, TEMP[0].xyzz, IMM[0]\n"
+   "  2: MUL TEMP[3].x, TEMP[1].xxxx, IMM[0].wwww\n"
+   "  3: ROUND TEMP[2].x, TEMP[3].xxxx\n"
+   "  4: MUL TEMP[3].x, TEMP[2].xxxx, IMM[2].xxxx\n"
+   "  5: MOV TEMP[2].x, TEMP[3].xxxx\n"
+   "  6: ADD TEMP[4].x, TEMP[1].xxxx, -TEMP[3].xxxx\n"
+   "  7: SGT TEMP[1].w, TEMP[4].xxxx, IMM[2].yyyy\n"
+   "  8: IF TEMP[1].wwww :19\n"
+   "  9:   ADD TEMP[4].y, TEMP[3].xxxx, IMM[2].yyyy\n"
+   " 10:   ADD TEMP[1].z, TEMP[1].xxxx, -TEMP[4].yyyy\n"
+   " 11:   ADD TEMP[1].y, TEMP[3].xxxx, IMM[2].zzzz\n"
+   " 12:   ADD TEMP[2].x, TEMP[1].yyyy, -TEMP[4].yyyy\n"
+   " 13:   RCP TEMP[4].y, TEMP[2].xxxx\n"
+   " 14:   MUL TEMP[2].x, TEMP[1].zzzz, TEMP[4].yyyy\n"
+   " 15:   MAD TEMP[1].y, -IMM[1].yyyy, TEMP[2].xxxx, IMM[2].wwww\n"
+   " 16:   MUL TEMP[1].z, TEMP[2].xxxx, TEMP[1].yyyy\n"
+   " 17:   MUL TEMP[1].y, TEMP[2].xxxx, TEMP[1].zzzz\n"
+   " 18:   MAD TEMP[2].x, TEMP[1].yyyy, IMM[2].zzzz, TEMP[3].xxxx\n"
+   " 19: ENDIF\n"
+   " 20: SLT TEMP[3].x, TEMP[4].xxxx, -IMM[2].yyyy\n"
+   " 21: IF TEMP[3].xxxx :34\n"
+   " 22:   ADD TEMP[3].x, TEMP[2].xxxx, -IMM[2].zzzz\n"
+   " 23:   ADD TEMP[4].x, TEMP[1].xxxx, -TEMP[3].xxxx\n"
+   " 24:   ADD TEMP[1].x, TEMP[2].xxxx, -IMM[2].yyyy\n"
+   " 25:   ADD TEMP[4].y, TEMP[1].xxxx, -TEMP[3].xxxx\n"
+   " 26:   RCP TEMP[3].x, TEMP[4].yyyy\n"
+   " 27:   MUL TEMP[1].x, TEMP[4].xxxx, TEMP[3].xxxx\n"
+   " 28:   MAD TEMP[4].x, -IMM[1].yyyy, TEMP[1].xxxx, IMM[2].wwww\n"
+   " 29:   MUL TEMP[3].x, TEMP[1].xxxx, TEMP[4].xxxx\n"
+   " 30:   MUL TEMP[4].x, TEMP[1].xxxx, TEMP[3].xxxx\n"
+   " 31:   ADD TEMP[3].x, IMM[1].zzzz, -TEMP[4].xxxx\n"
+   " 32:   MAD TEMP[1].x, TEMP[3].xxxx, -IMM[2].zzzz, TEMP[2].xxxx\n"
+   " 33:   MOV TEMP[2].x, TEMP[1].xxxx\n"
+   " 34: ENDIF\n"
+   " 35: MAD TEMP[1].x, TEMP[2].xxxx, IMM[1].yyyy, IMM[2].yyyy\n"
+   " 36: MUL OUT[0], TEMP[0], TEMP[1].xxxx\n"
+   " 37: END\n";
+
+
+/* In the order of pp_filters[]. */
+static const struct {
+   const char *name;
+   const char *tgsi;
+   void (*emit)(struct ureg_program *, struct ureg_dst);
+   void (*cpu)(float (*)[4], unsigned int);
+} filters[] = {
+   { "noblue",   noblue,   pp_noblue_emit,   pp_noblue_cpu },
+   { "nogreen",  nogreen,  pp_nogreen_emit,  pp_nogreen_cpu },
+   { "nored",    nored,    pp_nored_emit,    pp_nored_cpu },
+   { "celshade", celshade, pp_celshade_emit, pp_celshade_cpu },
+};
+
+#define NUM_FILTERS ARRAY_SIZE(filters)
+
+/* Allowed difference; the CPU functions don't round like tgsi_exec. */
+#define TOLERANCE 1e-5f
+
+#define NUM_PIXELS 4096
+
+
+static int failures;
+
+
+#define CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         failures++; \
+      } \
+   } while (0)
+
+
+/** The vertex shader version of what pp_pixel_chain_init() builds. */
+static const struct tgsi_token *
+fused_shader(unsigned int mask)
+{
+   struct ureg_program *ureg = ureg_create(TGSI_PROCESSOR_VERTEX);
+   struct ureg_src in;
+   struct ureg_dst color, out;
+   const struct tgsi_token *tokens;
+   unsigned int i;
+
+   if (!ureg)
+      return NULL;
+
+   in = ureg_DECL_vs_input(ureg, 0);
+   out = ureg_DECL_output(ureg, TGSI_SEMANTIC_GENERIC, 0);
+   color = ureg_DECL_temporary(ureg);
+
+   ureg_MOV(ureg, color, in);
+
+   for (i = 0; i < NUM_FILTERS; i++) {
+      if (mask & (1 << i))
+         filters[i].emit(ureg, color);
+   }
+
+   ureg_MOV(ureg, out, ureg_src(color));
+   ureg_END(ureg);
+
+   tokens = ureg_get_tokens(ureg, NULL);
+   ureg_destroy(ureg);
+   return tokens;
+}
+
+
+/** Run a shader on the four pixels of a quad, in place. */
+static void
+run_shader(struct tgsi_exec_machine *mach, const struct tgsi_token *tokens,
+           float (*rgba)[4])
+{
+   unsigned int j, c;
+
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL);
+
+   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (c = 0; c < 4; c++)
+         mach->Inputs[0].xyzw[c].f[j] = rgba[j][c];
+   }
+
+   tgsi_exec_machine_run(mach);
+
+   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (c = 0; c < 4; c++)
+         rgba[j][c] = mach->Outputs[0].xyzw[c].f[j];
+   }
+}
+
+
+/** Pixel i of the test input, covering [0, 1] including both ends. */
+static void
+test_pixel(unsigned int i, float *rgba)
+{
+   unsigned int c;
+
+   for (c = 0; c < 4; c++) {
+      if (i < 8)
+         rgba[c] = (i >> (c % 3) & 1) ? 1.0f : 0.0f;
+      else
+         rgba[c] = ((i * 2654435761u) >> (c * 8) & 0xff) / 255.0f;
+   }
+}
+
+
+static void
+test_chain(struct tgsi_exec_machine *mach, unsigned int mask)
+{
+   struct tgsi_token old_tokens[NUM_FILTERS][NUM_TOKENS];
+   const struct tgsi_token *fused;
+   float max_err_fused = 0.0f, max_err_cpu = 0.0f;
+   unsigned int i, j, c, n;
+
+   for (i = 0; i < NUM_FILTERS; i++) {
+      if ((mask & (1 << i)) &&
+          !tgsi_text_translate(filters[i].tgsi, old_tokens[i], NUM_TOKENS)) {
+         printf("%s: can't translate the shader\n", filters[i].name);
+         failures++;
+         return;
+      }
+   }
+
+   fused = fused_shader(mask);
+   CHECK(fused != NULL);
+   if (!fused)
+      return;
+
+   for (n = 0; n < NUM_PIXELS; n += TGSI_QUAD_SIZE) {
+      float old[TGSI_QUAD_SIZE][4], fuse[TGSI_QUAD_SIZE][4];
+      float cpu[TGSI_QUAD_SIZE][4];
+
+      for (j = 0; j < TGSI_QUAD_SIZE; j++)
+         test_pixel(n + j, old[j]);
+      memcpy(fuse, old, sizeof(old));
+      memcpy(cpu, old, sizeof(old));
+
+      for (i = 0; i < NUM_FILTERS; i++) {
+         if (mask & (1 << i)) {
+            run_shader(mach, old_tokens[i], old);
+            filters[i].cpu(cpu, TGSI_QUAD_SIZE);
+         }
+      }
+      run_shader(mach, fused, fuse);
+
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         for (c = 0; c < 4; c++) {
+            max_err_fused = MAX2(max_err_fused, fabsf(fuse[j][c] - old[j][c]));
+            max_err_cpu = MAX2(max_err_cpu, fabsf(cpu[j][c] - old[j][c]));
+         }
+      }
+   }
+
+   if (max_err_fused > TOLERANCE || max_err_cpu > TOLERANCE) {
+      printf("filters 0x%x: max error %g fused, %g on the CPU\n",
+             mask, max_err_fused, max_err_cpu);
+      failures++;
+   }
+
+   ureg_free_tokens(fused);
+}
+
+
+int main(int argc, char **argv)
+{
+   struct tgsi_exec_machine *mach = tgsi_exec_machine_create();
+   unsigned int i;
+
+   if (!mach) {
+      printf("can't create the tgsi_exec machine\n");
+      return 1;
+   }
+
+   /* Each filter on its own, then chains of them as they would be fused. */
+   for (i = 0; i < NUM_FILTERS; i++)
+      test_chain(mach, 1 << i);
+
+   test_chain(mach, 0x9);    /* noblue, celshade */
+   test_chain(mach, 0x6);    /* nogreen, nored */
+   test_chain(mach, 0xf);    /* all of them */
+
+   tgsi_exec_machine_destroy(mach);
+
+   if (failures) {
+      printf("%d check(s) failed\n", failures);
+      return 1;
+   }
+
+   printf("all checks passed\n");
+   return 0;
+}
@@ -0,0 +1,252 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Test case for u_upload_create_ring(), on a fake driver that keeps its
+ * buffers in malloc'ed memory and whose fences signal when told to.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_upload_mgr.h"
+
+
+struct test_resource
+{
+   struct pipe_resource base;
+   uint8_t *data;
+};
+
+
+/* The only fence; signalled or not depending on the test. */
+static struct pipe_fence_handle *test_fence =
+   (struct pipe_fence_handle *)&test_fence;
+static boolean test_fence_signalled;
+
+/* Whether transfers hold a reference to their resource, which some drivers
+ * do and others don't.
+ */
+static boolean test_transfer_takes_reference;
+
+
+static int
+test_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return param == PIPE_CAP_BUFFER_MAP_PERSISTENT_COHERENT;
+}
+
+
+static struct pipe_resource *
+test_resource_create(struct pipe_screen *screen,
+                     const struct pipe_resource *templat)
+{
+   struct test_resource *res = CALLOC_STRUCT(test_resource);
+
+   res->base = *templat;
+   res->base.screen = screen;
+   pipe_reference_init(&res->base.reference, 1);
+   res->data = CALLOC(1, templat->width0);
+   return &res->base;
+}
+
+
+static void
+test_resource_destroy(struct pipe_screen *screen, struct pipe_resource *pt)
+{
+   struct test_resource *res = (struct test_resource *)pt;
+
+   FREE(res->data);
+   FREE(res);
+}
+
+
+static void
+test_fence_reference(struct pipe_screen *screen,
+                     struct pipe_fence_handle **ptr,
+                     struct pipe_fence_handle *fence)
+{
+   *ptr = fence;
+}
+
+
+static boolean
+test_fence_finish(struct pipe_screen *screen,
+                  struct pipe_fence_handle *fence, uint64_t timeout)
+{
+   return test_fence_signalled;
+}
+
+
+static void *
+test_transfer_map(struct pipe_context *pipe, struct pipe_resource *resource,
+                  unsigned level, unsigned usage, const struct pipe_box *box,
+                  struct pipe_transfer **out_transfer)
+{
+   struct pipe_transfer *transfer = CALLOC_STRUCT(pipe_transfer);
+
+   if (test_transfer_takes_reference)
+      pipe_resource_reference(&transfer->resource, resource);
+   else
+      transfer->resource = resource;
+   transfer->usage = usage;
+   transfer->box = *box;
+   *out_transfer = transfer;
+   return ((struct test_resource *)resource)->data + box->x;
+}
+
+
+static void
+test_transfer_flush_region(struct pipe_context *pipe,
+                           struct pipe_transfer *transfer,
+                           const struct pipe_box *box)
+{
+}
+
+
+static void
+test_transfer_unmap(struct pipe_context *pipe, struct pipe_transfer *transfer)
+{
+   if (test_transfer_takes_reference)
+      pipe_resource_reference(&transfer->resource, NULL);
+   FREE(transfer);
+}
+
+
+static int failures;
+
+#define CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         failures++; \
+      } \
+   } while (0)
+
+
+/**
+ * What the constant buffer setup of st_atom_constbuf.c does: upload the
+ * constants once and keep the buffer bound across flushes, while other
+ * uploads stream through the ring.
+ */
+static void
+test_bound_buffer(struct pipe_context *pipe)
+{
+   const unsigned size = 4096, num_buffers = 4;
+   static const float constants[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+   uint8_t garbage[4096];
+   struct u_upload_mgr *upload;
+   struct u_upload_stats stats;
+   struct pipe_resource *bound = NULL, *buf = NULL;
+   unsigned bound_offset, offset, i;
+
+   upload = u_upload_create_ring(pipe, size, PIPE_BIND_CONSTANT_BUFFER,
+                                 PIPE_USAGE_STREAM, num_buffers);
+   memset(garbage, 0xff, sizeof(garbage));
+
+   /* Bind the constants and draw. */
+   u_upload_data(upload, 0, sizeof(constants), 16, constants,
+                 &bound_offset, &bound);
+   u_upload_unmap(upload);
+
+   /* Stream through more than a full rotation of the ring, flushing with a
+    * fence that has signalled by the time the ring wraps around.
+    */
+   test_fence_signalled = TRUE;
+   for (i = 0; i < 2 * num_buffers; i++) {
+      u_upload_data(upload, 0, size, 16, garbage, &offset, &buf);
+      u_upload_unmap(upload);
+      pipe_resource_reference(&buf, NULL);
+      u_upload_fence(upload, test_fence);
+   }
+
+   /* Draw again with the constants that are still bound. */
+   CHECK(memcmp(((struct test_resource *)bound)->data + bound_offset,
+                constants, sizeof(constants)) == 0);
+
+   /* Once unbound, the buffers are reused instead of created. */
+   pipe_resource_reference(&bound, NULL);
+   u_upload_end_frame(upload, NULL);
+   for (i = 0; i < 2 * num_buffers; i++) {
+      u_upload_data(upload, 0, size, 16, garbage, &offset, &buf);
+      u_upload_unmap(upload);
+      pipe_resource_reference(&buf, NULL);
+      u_upload_fence(upload, test_fence);
+   }
+   u_upload_end_frame(upload, &stats);
+   CHECK(stats.num_buffers_created == 0);
+
+   /* Nothing is reused while the fence hasn't signalled. */
+   test_fence_signalled = FALSE;
+   for (i = 0; i < num_buffers; i++) {
+      u_upload_data(upload, 0, size, 16, garbage, &offset, &buf);
+      u_upload_unmap(upload);
+      pipe_resource_reference(&buf, NULL);
+      u_upload_fence(upload, test_fence);
+   }
+   u_upload_end_frame(upload, &stats);
+   CHECK(stats.num_buffers_created == num_buffers);
+
+   u_upload_destroy(upload);
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+
+   memset(&screen, 0, sizeof(screen));
+   screen.get_param = test_get_param;
+   screen.resource_create = test_resource_create;
+   screen.resource_destroy = test_resource_destroy;
+   screen.fence_reference = test_fence_reference;
+   screen.fence_finish = test_fence_finish;
+
+   memset(&pipe, 0, sizeof(pipe));
+   pipe.screen = &screen;
+   pipe.transfer_map = test_transfer_map;
+   pipe.transfer_flush_region = test_transfer_flush_region;
+   pipe.transfer_unmap = test_transfer_unmap;
+
+   test_transfer_takes_reference = FALSE;
+   test_bound_buffer(&pipe);
+   test_transfer_takes_reference = TRUE;
+   test_bound_buffer(&pipe);
+
+   if (failures) {
+      printf("%d check(s) failed\n", failures);
+      return 1;
+   }
+   return 0;
+}
@@ -26,6 +26,9 @@
  *
  **************************************************************************/
 
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
 #include "pipe/p_compiler.h"
 #include "pipe/p_format.h"
 #include "util/u_inlines.h"
@@ -45,6 +48,8 @@ struct dri_sw_displaytarget
    unsigned stride;
 
    unsigned map_flags;
+   int shmid;           /**< -1 unless data is a shared memory segment */
+   boolean shm_removed; /**< IPC_RMID done, see dri_sw_displaytarget_display */
    void *data;
    void *mapped;
    const void *front_private;
@@ -79,6 +84,29 @@ dri_sw_is_displaytarget_format_supported( struct sw_winsys *ws,
    return TRUE;
 }
 
+/**
+ * Allocate the image in a SysV shared memory segment, which the loader can
+ * present without copying the pixels through the X socket.
+ */
+static char *
+alloc_shm(struct dri_sw_displaytarget *dri_sw_dt, unsigned size)
+{
+   char *addr;
+
+   dri_sw_dt->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if (dri_sw_dt->shmid < 0)
+      return NULL;
+
+   addr = (char *) shmat(dri_sw_dt->shmid, NULL, 0);
+   if (addr == (char *) -1) {
+      shmctl(dri_sw_dt->shmid, IPC_RMID, NULL);
+      dri_sw_dt->shmid = -1;
+      return NULL;
+   }
+
+   return addr;
+}
+
 static struct sw_displaytarget *
 dri_sw_displaytarget_create(struct sw_winsys *winsys,
                             unsigned tex_usage,
@@ -88,6 +116,7 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
                             const void *front_private,
                             unsigned *stride)
 {
+   struct dri_sw_winsys *ws = dri_sw_winsys(winsys);
    struct dri_sw_displaytarget *dri_sw_dt;
    unsigned nblocksy, size, format_stride;
 
@@ -99,6 +128,7 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
    dri_sw_dt->width = width;
    dri_sw_dt->height = height;
    dri_sw_dt->front_private = front_private;
+   dri_sw_dt->shmid = -1;
 
    format_stride = util_format_get_stride(format, width);
    dri_sw_dt->stride = align(format_stride, alignment);
@@ -106,7 +136,12 @@ dri_sw_displaytarget_create(struct sw_winsys *winsys,
    nblocksy = util_format_get_nblocksy(format, height);
    size = dri_sw_dt->stride * nblocksy;
 
-   dri_sw_dt->data = align_malloc(size, alignment);
+   if (ws->lf->put_image_shm)
+      dri_sw_dt->data = alloc_shm(dri_sw_dt, size);
+
+   if (!dri_sw_dt->data)
+      dri_sw_dt->data = align_malloc(size, alignment);
+
    if(!dri_sw_dt->data)
       goto no_data;
 
@@ -125,7 +160,13 @@ dri_sw_displaytarget_destroy(struct sw_winsys *ws,
 {
    struct dri_sw_displaytarget *dri_sw_dt = dri_sw_displaytarget(dt);
 
-   FREE(dri_sw_dt->data);
+   if (dri_sw_dt->shmid >= 0) {
+      if (!dri_sw_dt->shm_removed)
+         shmctl(dri_sw_dt->shmid, IPC_RMID, NULL);
+      shmdt(dri_sw_dt->data);
+   }
+   else
+      align_free(dri_sw_dt->data);
 
    FREE(dri_sw_dt);
 }
@@ -198,6 +239,33 @@ dri_sw_displaytarget_display(struct sw_winsys *ws,
 
    height = dri_sw_dt->height;
 
+   if (dri_sw_dt->shmid >= 0) {
+      unsigned offset = 0;
+
+      if (box) {
+         offset = dri_sw_dt->stride * box->y + box->x * blsize;
+         dri_sw_ws->lf->put_image_shm(dri_drawable, dri_sw_dt->shmid,
+                                      dri_sw_dt->data, offset,
+                                      box->x, box->y, box->width, box->height,
+                                      dri_sw_dt->stride);
+      } else {
+         dri_sw_ws->lf->put_image_shm(dri_drawable, dri_sw_dt->shmid,
+                                      dri_sw_dt->data, offset,
+                                      0, 0, width, height,
+                                      dri_sw_dt->stride);
+      }
+
+      /* Now that the server has attached the segment, mark it for deletion
+       * so that it doesn't outlive a crash; it stays until the last detach.
+       * Only Linux allows attaching a segment after IPC_RMID.
+       */
+      if (!dri_sw_dt->shm_removed) {
+         shmctl(dri_sw_dt->shmid, IPC_RMID, NULL);
+         dri_sw_dt->shm_removed = TRUE;
+      }
+      return;
+   }
+
    if (box) {
        void *data;
        data = dri_sw_dt->data + (dri_sw_dt->stride * box->y) + box->x * blsize;
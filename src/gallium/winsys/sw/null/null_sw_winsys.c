@@ -30,7 +30,8 @@
  * Null software rasterizer winsys.
  * 
  * There is no present support. Framebuffer data needs to be obtained via
- * transfers.
+ * transfers, or rendered straight into client memory handed in as
+ * struct null_sw_user_memory.
  *
  * @author Jose Fonseca
  */
@@ -43,6 +44,20 @@
 #include "null_sw_winsys.h"
 
 
+/** A displaytarget wrapping client memory */
+struct null_sw_displaytarget
+{
+   struct null_sw_user_memory mem;
+};
+
+
+static inline struct null_sw_displaytarget *
+null_sw_displaytarget(struct sw_displaytarget *dt)
+{
+   return (struct null_sw_displaytarget *) dt;
+}
+
+
 static boolean
 null_sw_is_displaytarget_format_supported(struct sw_winsys *ws,
                                           unsigned tex_usage,
@@ -57,8 +72,7 @@ null_sw_displaytarget_map(struct sw_winsys *ws,
                           struct sw_displaytarget *dt,
                           unsigned flags )
 {
-   assert(0);
-   return NULL;
+   return null_sw_displaytarget(dt)->mem.data;
 }
 
 
@@ -66,7 +80,6 @@ static void
 null_sw_displaytarget_unmap(struct sw_winsys *ws,
                             struct sw_displaytarget *dt )
 {
-   assert(0);
 }
 
 
@@ -74,7 +87,7 @@ static void
 null_sw_displaytarget_destroy(struct sw_winsys *winsys,
                               struct sw_displaytarget *dt)
 {
-   assert(0);
+   FREE(dt);
 }
 
 
@@ -87,8 +100,21 @@ null_sw_displaytarget_create(struct sw_winsys *winsys,
                              const void *front_private,
                              unsigned *stride)
 {
-   fprintf(stderr, "null_sw_displaytarget_create() returning NULL\n");
-   return NULL;
+   const struct null_sw_user_memory *mem = front_private;
+   struct null_sw_displaytarget *dt;
+
+   if (!mem) {
+      fprintf(stderr, "null_sw_displaytarget_create() returning NULL\n");
+      return NULL;
+   }
+
+   dt = CALLOC_STRUCT(null_sw_displaytarget);
+   if (!dt)
+      return NULL;
+
+   dt->mem = *mem;
+   *stride = mem->stride;
+   return (struct sw_displaytarget *) dt;
 }
 
 
@@ -33,6 +33,19 @@
 struct sw_winsys;
 
 
+/**
+ * Client memory to render into, passed as the front_private argument of
+ * displaytarget_create() (i.e. of pipe_screen::resource_create_front).
+ * The memory must stay valid for the lifetime of the displaytarget, and the
+ * driver may write up to its own block alignment past the width and height.
+ */
+struct null_sw_user_memory
+{
+   void *data;
+   unsigned stride;  /**< in bytes */
+};
+
+
 struct sw_winsys *
 null_sw_create(void);
 
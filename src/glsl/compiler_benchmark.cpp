@@ -0,0 +1,943 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file compiler_benchmark.cpp
+ *
+ * Compile time benchmark for the standalone compiler.
+ *
+ * Every shader_test file, or loose .vert/.frag/... file, found in the corpus
+ * is compiled and linked a number of times (and, on request, translated to
+ * NIR and optimized), and the median and minimum time of each stage are
+ * reported together with the number of IR instructions the stage produced.
+ * The output is one CSV row per program and stage:
+ *
+ *    program,stage,median_us,min_us,size
+ *
+ * Rows whose program is "(corpus)" describe the whole corpus: the summed
+ * stage times, the time per iteration spent in every GLSL IR and NIR
+ * optimization pass, and the peak RSS of the process in kB.
+ *
+ * Given the CSV output of an earlier run as a baseline, every row that got
+ * slower by more than the threshold is reported and the exit status is
+ * non-zero, so that compile time regressions can be caught in scripts.
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "compiler_benchmark.h"
+#include "glsl_parser_extras.h"
+#include "ir_optimization.h"
+#include "ir_hierarchical_visitor.h"
+#include "program.h"
+#include "program/hash_table.h"
+#include "standalone_scaffolding.h"
+#include "nir/nir.h"
+#include "nir/glsl_to_nir.h"
+#include "util/u_clock.h"
+
+#define CORPUS_PROGRAM "(corpus)"
+
+enum bench_stage {
+   BENCH_COMPILE,
+   BENCH_LINK,
+   BENCH_NIR,
+   BENCH_NUM_STAGES
+};
+
+static const char *const bench_stage_names[BENCH_NUM_STAGES] = {
+   "compile",
+   "link",
+   "nir",
+};
+
+struct corpus_shader {
+   GLenum type;
+   const char *source;
+};
+
+struct corpus_program {
+   const char *name;
+   unsigned num_shaders;
+   struct corpus_shader *shaders;
+};
+
+struct corpus {
+   void *mem_ctx;
+   unsigned num_programs;
+   struct corpus_program *programs;
+};
+
+struct bench_row {
+   const char *program;
+   const char *stage;
+   double median_us;    /**< Negative if not applicable */
+   double min_us;       /**< Negative if not applicable */
+   long size;           /**< Negative if not applicable */
+};
+
+struct bench_results {
+   void *mem_ctx;
+   unsigned num_rows;
+   struct bench_row *rows;
+};
+
+
+/* Returned string will have 'mem_ctx' as its ralloc owner. */
+static char *
+read_file(void *mem_ctx, const char *path)
+{
+   FILE *fp = fopen(path, "rb");
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0L, SEEK_END);
+   long size = ftell(fp);
+   fseek(fp, 0L, SEEK_SET);
+
+   char *text = NULL;
+   if (size >= 0) {
+      text = (char *) ralloc_size(mem_ctx, size + 1);
+      if (fread(text, 1, size, fp) != (size_t) size) {
+         ralloc_free(text);
+         text = NULL;
+      } else {
+         text[size] = '\0';
+      }
+   }
+
+   fclose(fp);
+   return text;
+}
+
+static bool
+has_suffix(const char *str, const char *suffix)
+{
+   const size_t len = strlen(str);
+   const size_t suffix_len = strlen(suffix);
+
+   return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+static GLenum
+shader_type_for_file(const char *path)
+{
+   if (has_suffix(path, ".vert"))
+      return GL_VERTEX_SHADER;
+   else if (has_suffix(path, ".tesc"))
+      return GL_TESS_CONTROL_SHADER;
+   else if (has_suffix(path, ".tese"))
+      return GL_TESS_EVALUATION_SHADER;
+   else if (has_suffix(path, ".geom"))
+      return GL_GEOMETRY_SHADER;
+   else if (has_suffix(path, ".frag"))
+      return GL_FRAGMENT_SHADER;
+   else if (has_suffix(path, ".comp"))
+      return GL_COMPUTE_SHADER;
+   else
+      return 0;
+}
+
+static void
+add_shader(void *mem_ctx, struct corpus_program *prog, GLenum type,
+           const char *source)
+{
+   prog->shaders = reralloc(mem_ctx, prog->shaders, struct corpus_shader,
+                            prog->num_shaders + 1);
+   prog->shaders[prog->num_shaders].type = type;
+   prog->shaders[prog->num_shaders].source = source;
+   prog->num_shaders++;
+}
+
+static const struct {
+   const char *header;
+   GLenum type;
+} shader_test_sections[] = {
+   { "[vertex shader]",                  GL_VERTEX_SHADER },
+   { "[tessellation control shader]",    GL_TESS_CONTROL_SHADER },
+   { "[tessellation evaluation shader]", GL_TESS_EVALUATION_SHADER },
+   { "[geometry shader]",                GL_GEOMETRY_SHADER },
+   { "[fragment shader]",                GL_FRAGMENT_SHADER },
+   { "[compute shader]",                 GL_COMPUTE_SHADER },
+};
+
+/**
+ * Extract the shaders of a piglit shader_test file.
+ *
+ * Every "[<stage> shader]" section starts a shader that runs until the next
+ * section.  Everything else, including generated passthrough shaders, is
+ * ignored.
+ */
+static void
+parse_shader_test(void *mem_ctx, struct corpus_program *prog,
+                  const char *text)
+{
+   const char *source = NULL;
+   GLenum type = 0;
+
+   for (const char *line = text; *line != '\0'; ) {
+      const char *end = strchr(line, '\n');
+      const char *next = end ? end + 1 : line + strlen(line);
+
+      if (line[0] == '[') {
+         if (source != NULL)
+            add_shader(mem_ctx, prog, type,
+                       ralloc_strndup(mem_ctx, source, line - source));
+         source = NULL;
+
+         for (unsigned i = 0; i < ARRAY_SIZE(shader_test_sections); i++) {
+            const char *header = shader_test_sections[i].header;
+            if (strncmp(line, header, strlen(header)) == 0) {
+               type = shader_test_sections[i].type;
+               source = next;
+               break;
+            }
+         }
+      }
+
+      line = next;
+   }
+
+   if (source != NULL)
+      add_shader(mem_ctx, prog, type, ralloc_strdup(mem_ctx, source));
+}
+
+static int
+compare_strings(const void *a, const void *b)
+{
+   return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+static void
+add_corpus_path(struct corpus *corpus, const char *path)
+{
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "Cannot open \"%s\"\n", path);
+      return;
+   }
+
+   if (S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(path);
+      if (dir == NULL) {
+         fprintf(stderr, "Cannot open \"%s\"\n", path);
+         return;
+      }
+
+      char **names = NULL;
+      unsigned num_names = 0;
+      for (struct dirent *entry = readdir(dir); entry != NULL;
+           entry = readdir(dir)) {
+         if (entry->d_name[0] == '.')
+            continue;
+
+         names = reralloc(corpus->mem_ctx, names, char *, num_names + 1);
+         names[num_names++] = ralloc_asprintf(corpus->mem_ctx, "%s/%s",
+                                              path, entry->d_name);
+      }
+      closedir(dir);
+
+      /* Sort the entries so that runs over the same corpus line up */
+      qsort(names, num_names, sizeof(names[0]), compare_strings);
+
+      for (unsigned i = 0; i < num_names; i++)
+         add_corpus_path(corpus, names[i]);
+
+      ralloc_free(names);
+      return;
+   }
+
+   const bool shader_test = has_suffix(path, ".shader_test");
+   const GLenum type = shader_type_for_file(path);
+   if (!shader_test && type == 0) {
+      /* Unlike glsl_compiler, don't guess the stage of a .glsl file */
+      if (has_suffix(path, ".glsl"))
+         fprintf(stderr, "Skipping \"%s\": unknown shader stage\n", path);
+      return;
+   }
+
+   char *text = read_file(corpus->mem_ctx, path);
+   if (text == NULL) {
+      fprintf(stderr, "Cannot read \"%s\"\n", path);
+      return;
+   }
+
+   struct corpus_program prog;
+   prog.name = path;
+   prog.num_shaders = 0;
+   prog.shaders = NULL;
+
+   if (shader_test)
+      parse_shader_test(corpus->mem_ctx, &prog, text);
+   else
+      add_shader(corpus->mem_ctx, &prog, type, text);
+
+   if (prog.num_shaders == 0)
+      return;
+
+   corpus->programs = reralloc(corpus->mem_ctx, corpus->programs,
+                               struct corpus_program,
+                               corpus->num_programs + 1);
+   corpus->programs[corpus->num_programs++] = prog;
+}
+
+
+static void
+count_ir_instruction(ir_instruction *ir, void *data)
+{
+   (*(long *) data)++;
+}
+
+static long
+count_ir_instructions(exec_list *instructions)
+{
+   long count = 0;
+
+   foreach_in_list(ir_instruction, node, instructions)
+      visit_tree(node, count_ir_instruction, &count);
+
+   return count;
+}
+
+static bool
+count_nir_block(nir_block *block, void *data)
+{
+   nir_foreach_instr(block, instr)
+      (*(long *) data)++;
+
+   return true;
+}
+
+static long
+count_nir_instructions(nir_shader *shader)
+{
+   long count = 0;
+
+   nir_foreach_function(shader, function) {
+      if (function->impl)
+         nir_foreach_block(function->impl, count_nir_block, &count);
+   }
+
+   return count;
+}
+
+
+static bool
+lower_var_copies(nir_shader *shader)
+{
+   nir_lower_var_copies(shader);
+   return false;
+}
+
+static bool
+lower_vars_to_ssa(nir_shader *shader)
+{
+   nir_lower_vars_to_ssa(shader);
+   return false;
+}
+
+struct nir_bench_pass {
+   const char *name;
+   bool (*run)(nir_shader *shader);
+   unsigned runs;
+   unsigned progress;
+   int64_t time_ns;
+};
+
+#define NIR_BENCH_PASS(name, pass) { name, pass, 0, 0, 0 }
+
+/* Run once, in order, right after glsl_to_nir() */
+static struct nir_bench_pass nir_lowering_passes[] = {
+   NIR_BENCH_PASS("lower_global_vars_to_local", nir_lower_global_vars_to_local),
+   NIR_BENCH_PASS("split_var_copies", nir_split_var_copies),
+   NIR_BENCH_PASS("lower_var_copies", lower_var_copies),
+   NIR_BENCH_PASS("lower_vars_to_ssa", lower_vars_to_ssa),
+};
+
+/* Run until none of them makes progress, like the loops in the drivers */
+static struct nir_bench_pass nir_opt_passes[] = {
+   NIR_BENCH_PASS("copy_prop", nir_copy_prop),
+   NIR_BENCH_PASS("opt_dce", nir_opt_dce),
+   NIR_BENCH_PASS("opt_cse", nir_opt_cse),
+   NIR_BENCH_PASS("opt_peephole_select", nir_opt_peephole_select),
+   NIR_BENCH_PASS("opt_algebraic", nir_opt_algebraic),
+   NIR_BENCH_PASS("opt_constant_folding", nir_opt_constant_folding),
+   NIR_BENCH_PASS("opt_dead_cf", nir_opt_dead_cf),
+   NIR_BENCH_PASS("opt_remove_phis", nir_opt_remove_phis),
+   NIR_BENCH_PASS("opt_undef", nir_opt_undef),
+};
+
+/* Like the GLSL pass statistics, only counted outside the warm-up run */
+static bool nir_stats_enabled;
+
+static bool
+run_nir_pass(struct nir_bench_pass *pass, nir_shader *shader)
+{
+   if (!nir_stats_enabled)
+      return pass->run(shader);
+
+   const int64_t start = util_get_time_nano();
+   const bool progress = pass->run(shader);
+
+   pass->time_ns += util_get_time_nano() - start;
+   pass->runs++;
+   if (progress)
+      pass->progress++;
+
+   return progress;
+}
+
+static void
+optimize_nir(nir_shader *shader)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(nir_lowering_passes); i++)
+      run_nir_pass(&nir_lowering_passes[i], shader);
+
+   bool progress;
+   do {
+      progress = false;
+      for (unsigned i = 0; i < ARRAY_SIZE(nir_opt_passes); i++)
+         progress |= run_nir_pass(&nir_opt_passes[i], shader);
+   } while (progress);
+}
+
+
+/** Time and IR size of one compile/link of one program */
+struct program_run {
+   int64_t time_ns[BENCH_NUM_STAGES];
+   long size[BENCH_NUM_STAGES];
+};
+
+static bool
+compile_program(struct gl_context *ctx, const struct corpus_program *prog,
+                struct gl_shader_program *whole_program,
+                struct program_run *run, bool verbose)
+{
+   whole_program->Shaders =
+      rzalloc_array(whole_program, struct gl_shader *, prog->num_shaders);
+
+   const int64_t start = util_get_time_nano();
+   for (unsigned i = 0; i < prog->num_shaders; i++) {
+      struct gl_shader *shader = rzalloc(whole_program, gl_shader);
+
+      shader->Type = prog->shaders[i].type;
+      shader->Stage = _mesa_shader_enum_to_shader_stage(shader->Type);
+      shader->Source = prog->shaders[i].source;
+      whole_program->Shaders[whole_program->NumShaders++] = shader;
+
+      _mesa_glsl_compile_shader(ctx, shader, false, false);
+
+      if (!shader->CompileStatus) {
+         if (verbose)
+            fprintf(stderr, "%s: %s shader failed to compile:\n%s\n",
+                    prog->name, _mesa_shader_stage_to_string(shader->Stage),
+                    shader->InfoLog);
+         return false;
+      }
+   }
+   run->time_ns[BENCH_COMPILE] = util_get_time_nano() - start;
+
+   for (unsigned i = 0; i < whole_program->NumShaders; i++)
+      run->size[BENCH_COMPILE] +=
+         count_ir_instructions(whole_program->Shaders[i]->ir);
+
+   return true;
+}
+
+static bool
+link_program(struct gl_context *ctx, const struct corpus_program *prog,
+             struct gl_shader_program *whole_program,
+             struct program_run *run, bool verbose)
+{
+   _mesa_clear_shader_program_data(whole_program);
+
+   const int64_t start = util_get_time_nano();
+   link_shaders(ctx, whole_program);
+   run->time_ns[BENCH_LINK] = util_get_time_nano() - start;
+
+   if (!whole_program->LinkStatus) {
+      if (verbose)
+         fprintf(stderr, "%s: failed to link:\n%s\n", prog->name,
+                 whole_program->InfoLog);
+      return false;
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (whole_program->_LinkedShaders[i])
+         run->size[BENCH_LINK] +=
+            count_ir_instructions(whole_program->_LinkedShaders[i]->ir);
+   }
+
+   return true;
+}
+
+static void
+translate_program_to_nir(struct gl_shader_program *whole_program,
+                         struct program_run *run)
+{
+   static const nir_shader_compiler_options nir_options = { };
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_shader *sh = whole_program->_LinkedShaders[i];
+      if (!sh)
+         continue;
+
+      /* glsl_to_nir() reads the shader info from the gl_program that a
+       * driver would have created at link time.
+       */
+      if (!sh->Program) {
+         sh->Program = rzalloc(sh, struct gl_program);
+         do_set_program_inouts(sh->ir, sh->Program, (gl_shader_stage) i);
+      }
+
+      const int64_t start = util_get_time_nano();
+      nir_shader *nir = glsl_to_nir(whole_program, (gl_shader_stage) i,
+                                    &nir_options);
+      optimize_nir(nir);
+      run->time_ns[BENCH_NIR] += util_get_time_nano() - start;
+
+      run->size[BENCH_NIR] += count_nir_instructions(nir);
+      ralloc_free(nir);
+   }
+}
+
+/**
+ * Compile, link and optionally translate one program once.
+ *
+ * Returns false if any step failed, in which case \c run is incomplete.
+ */
+static bool
+run_program(struct gl_context *ctx, const struct corpus_program *prog,
+            bool nir, struct program_run *run, bool verbose)
+{
+   memset(run, 0, sizeof(*run));
+
+   struct gl_shader_program *whole_program =
+      rzalloc(NULL, struct gl_shader_program);
+   whole_program->InfoLog = ralloc_strdup(whole_program, "");
+
+   /* Created just to avoid segmentation faults */
+   whole_program->AttributeBindings = new string_to_uint_map;
+   whole_program->FragDataBindings = new string_to_uint_map;
+   whole_program->FragDataIndexBindings = new string_to_uint_map;
+
+   bool ok = compile_program(ctx, prog, whole_program, run, verbose) &&
+             link_program(ctx, prog, whole_program, run, verbose);
+
+   if (ok && nir)
+      translate_program_to_nir(whole_program, run);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      ralloc_free(whole_program->_LinkedShaders[i]);
+
+   delete whole_program->AttributeBindings;
+   delete whole_program->FragDataBindings;
+   delete whole_program->FragDataIndexBindings;
+
+   ralloc_free(whole_program);
+
+   return ok;
+}
+
+
+static void
+add_row(struct bench_results *results, const char *program,
+        const char *stage, double median_us, double min_us, long size)
+{
+   results->rows = reralloc(results->mem_ctx, results->rows,
+                            struct bench_row, results->num_rows + 1);
+
+   struct bench_row *row = &results->rows[results->num_rows++];
+   row->program = program;
+   row->stage = stage;
+   row->median_us = median_us;
+   row->min_us = min_us;
+   row->size = size;
+}
+
+static int
+compare_int64(const void *a, const void *b)
+{
+   const int64_t x = *(const int64_t *) a;
+   const int64_t y = *(const int64_t *) b;
+
+   return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void
+add_pass_rows(struct bench_results *results, const char *prefix,
+              const char *name, unsigned runs, int64_t time_ns,
+              unsigned iterations)
+{
+   if (runs == 0)
+      return;
+
+   add_row(results, CORPUS_PROGRAM,
+           ralloc_asprintf(results->mem_ctx, "%s:%s", prefix, name),
+           time_ns / 1000.0 / iterations, -1.0, -1);
+}
+
+static void
+print_csv_field(const char *str)
+{
+   if (strpbrk(str, ",\"\n") == NULL) {
+      fputs(str, stdout);
+      return;
+   }
+
+   putchar('"');
+   for (const char *c = str; *c != '\0'; c++) {
+      if (*c == '"')
+         putchar('"');
+      putchar(*c);
+   }
+   putchar('"');
+}
+
+static void
+print_csv_number(double value, const char *format)
+{
+   putchar(',');
+   if (value >= 0.0)
+      printf(format, value);
+}
+
+static void
+print_csv(const struct bench_results *results)
+{
+   printf("program,stage,median_us,min_us,size\n");
+
+   for (unsigned i = 0; i < results->num_rows; i++) {
+      const struct bench_row *row = &results->rows[i];
+
+      print_csv_field(row->program);
+      putchar(',');
+      print_csv_field(row->stage);
+      print_csv_number(row->median_us, "%.3f");
+      print_csv_number(row->min_us, "%.3f");
+      print_csv_number(row->size, "%.0f");
+      putchar('\n');
+   }
+}
+
+static void
+print_json_string(const char *str)
+{
+   putchar('"');
+   for (const char *c = str; *c != '\0'; c++) {
+      if (*c == '"' || *c == '\\')
+         printf("\\%c", *c);
+      else if ((unsigned char) *c < 0x20)
+         printf("\\u%04x", *c);
+      else
+         putchar(*c);
+   }
+   putchar('"');
+}
+
+static void
+print_json_number(const char *name, double value, const char *format)
+{
+   printf(", \"%s\": ", name);
+   if (value >= 0.0)
+      printf(format, value);
+   else
+      printf("null");
+}
+
+static void
+print_json(const struct bench_results *results)
+{
+   printf("[\n");
+
+   for (unsigned i = 0; i < results->num_rows; i++) {
+      const struct bench_row *row = &results->rows[i];
+
+      printf("  { \"program\": ");
+      print_json_string(row->program);
+      printf(", \"stage\": ");
+      print_json_string(row->stage);
+      print_json_number("median_us", row->median_us, "%.3f");
+      print_json_number("min_us", row->min_us, "%.3f");
+      print_json_number("size", row->size, "%.0f");
+      printf(" }%s\n", i + 1 < results->num_rows ? "," : "");
+   }
+
+   printf("]\n");
+}
+
+/**
+ * Split one CSV line, as written by print_csv(), into at most
+ * \c max_fields fields.  The line is modified in place.
+ */
+static unsigned
+split_csv_line(char *line, char **fields, unsigned max_fields)
+{
+   unsigned num_fields = 0;
+   char *c = line;
+
+   while (num_fields < max_fields) {
+      char *out = c;
+      fields[num_fields++] = c;
+
+      if (*c == '"') {
+         c++;
+         while (*c != '\0') {
+            if (*c == '"' && c[1] != '"')
+               break;
+            if (*c == '"')
+               c++;
+            *out++ = *c++;
+         }
+         if (*c == '"')
+            c++;
+      } else {
+         while (*c != '\0' && *c != ',')
+            *out++ = *c++;
+      }
+
+      const bool last = *c != ',';
+      if (!last)
+         c++;
+      *out = '\0';
+
+      if (last)
+         break;
+   }
+
+   return num_fields;
+}
+
+/**
+ * Compare the results with the CSV output of an earlier run.
+ *
+ * Returns the number of rows that got slower by more than \c threshold
+ * percent, or -1 if the baseline could not be read.
+ */
+static int
+compare_with_baseline(const struct bench_results *results, const char *path,
+                      double threshold)
+{
+   char *text = read_file(results->mem_ctx, path);
+   if (text == NULL) {
+      fprintf(stderr, "Cannot read baseline \"%s\"\n", path);
+      return -1;
+   }
+
+   struct hash_table *rows =
+      hash_table_ctor(0, hash_table_string_hash, hash_table_string_compare);
+   for (unsigned i = 0; i < results->num_rows; i++) {
+      const struct bench_row *row = &results->rows[i];
+      hash_table_insert(rows, (void *) row,
+                        ralloc_asprintf(results->mem_ctx, "%s\n%s",
+                                        row->program, row->stage));
+   }
+
+   int regressions = 0;
+   unsigned improvements = 0;
+   unsigned compared = 0;
+
+   char *saveptr;
+   for (char *line = strtok_r(text, "\r\n", &saveptr); line != NULL;
+        line = strtok_r(NULL, "\r\n", &saveptr)) {
+      char *fields[5];
+      if (split_csv_line(line, fields, 5) != 5 ||
+          strcmp(fields[0], "program") == 0)
+         continue;
+
+      char *key = ralloc_asprintf(results->mem_ctx, "%s\n%s",
+                                  fields[0], fields[1]);
+      const struct bench_row *row =
+         (const struct bench_row *) hash_table_find(rows, key);
+      ralloc_free(key);
+      if (row == NULL)
+         continue;
+
+      if (fields[4][0] != '\0' && row->size > strtol(fields[4], NULL, 10)) {
+         fprintf(stderr, "size: %s %s: %s -> %ld\n",
+                 row->program, row->stage, fields[4], row->size);
+      }
+
+      if (fields[2][0] == '\0' || row->median_us < 0.0)
+         continue;
+
+      const double base = strtod(fields[2], NULL);
+      const double change = base > 0.0 ?
+         (row->median_us - base) * 100.0 / base : 0.0;
+
+      compared++;
+
+      /* Differences below a microsecond are noise whatever the ratio */
+      if (fabs(row->median_us - base) < 1.0)
+         continue;
+
+      if (change > threshold) {
+         fprintf(stderr, "regression: %s %s: %.3f us -> %.3f us (%+.1f%%)\n",
+                 row->program, row->stage, base, row->median_us, change);
+         regressions++;
+      } else if (change < -threshold) {
+         improvements++;
+      }
+   }
+
+   hash_table_dtor(rows);
+
+   fprintf(stderr, "Compared %u rows with %s: %d regressions, "
+           "%u improvements above %.1f%%\n",
+           compared, path, regressions, improvements, threshold);
+
+   return regressions;
+}
+
+
+int
+run_compiler_benchmark(struct gl_context *ctx,
+                       const struct compiler_benchmark_options *options)
+{
+   struct corpus corpus;
+   corpus.mem_ctx = ralloc_context(NULL);
+   corpus.num_programs = 0;
+   corpus.programs = NULL;
+
+   add_corpus_path(&corpus, options->corpus);
+
+   if (corpus.num_programs == 0) {
+      fprintf(stderr, "No shaders found in \"%s\"\n", options->corpus);
+      ralloc_free(corpus.mem_ctx);
+      return EXIT_FAILURE;
+   }
+
+   const unsigned iterations = MAX2(options->iterations, 1);
+   const unsigned num_stages = options->nir ? BENCH_NUM_STAGES : BENCH_NIR;
+
+   struct bench_results results;
+   results.mem_ctx = corpus.mem_ctx;
+   results.num_rows = 0;
+   results.rows = NULL;
+
+   int64_t *times = ralloc_array(corpus.mem_ctx, int64_t, iterations);
+   double total_median_us[BENCH_NUM_STAGES] = { 0 };
+   double total_min_us[BENCH_NUM_STAGES] = { 0 };
+   long total_size[BENCH_NUM_STAGES] = { 0 };
+   unsigned failed = 0;
+
+   _mesa_glsl_reset_opt_stats();
+
+   for (unsigned p = 0; p < corpus.num_programs; p++) {
+      const struct corpus_program *prog = &corpus.programs[p];
+      struct program_run *runs =
+         ralloc_array(corpus.mem_ctx, struct program_run, iterations);
+
+      /* An untimed warm-up run, which also keeps programs that fail to
+       * compile or link out of the pass statistics.
+       */
+      if (!run_program(ctx, prog, options->nir, &runs[0], true)) {
+         failed++;
+         ralloc_free(runs);
+         continue;
+      }
+
+      _mesa_glsl_enable_opt_stats(true);
+      nir_stats_enabled = true;
+      for (unsigned i = 0; i < iterations; i++)
+         run_program(ctx, prog, options->nir, &runs[i], false);
+      _mesa_glsl_enable_opt_stats(false);
+      nir_stats_enabled = false;
+
+      for (unsigned s = 0; s < num_stages; s++) {
+         for (unsigned i = 0; i < iterations; i++)
+            times[i] = runs[i].time_ns[s];
+         qsort(times, iterations, sizeof(times[0]), compare_int64);
+
+         const double median_us = times[iterations / 2] / 1000.0;
+         const double min_us = times[0] / 1000.0;
+         const long size = runs[iterations - 1].size[s];
+
+         add_row(&results, prog->name, bench_stage_names[s],
+                 median_us, min_us, size);
+
+         total_median_us[s] += median_us;
+         total_min_us[s] += min_us;
+         total_size[s] += size;
+      }
+
+      ralloc_free(runs);
+   }
+
+   for (unsigned s = 0; s < num_stages; s++) {
+      add_row(&results, CORPUS_PROGRAM, bench_stage_names[s],
+              total_median_us[s], total_min_us[s], total_size[s]);
+   }
+
+   unsigned num_passes, loops, opt_iterations;
+   const struct glsl_opt_pass_stats *stats =
+      _mesa_glsl_get_opt_stats(&num_passes, &loops, &opt_iterations);
+   for (unsigned i = 0; i < num_passes; i++) {
+      add_pass_rows(&results, "glsl", stats[i].name, stats[i].runs,
+                    stats[i].time_ns, iterations);
+   }
+
+   if (options->nir) {
+      for (unsigned i = 0; i < ARRAY_SIZE(nir_lowering_passes); i++) {
+         add_pass_rows(&results, "nir", nir_lowering_passes[i].name,
+                       nir_lowering_passes[i].runs,
+                       nir_lowering_passes[i].time_ns, iterations);
+      }
+      for (unsigned i = 0; i < ARRAY_SIZE(nir_opt_passes); i++) {
+         add_pass_rows(&results, "nir", nir_opt_passes[i].name,
+                       nir_opt_passes[i].runs,
+                       nir_opt_passes[i].time_ns, iterations);
+      }
+   }
+
+#ifndef _WIN32
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) == 0)
+      add_row(&results, CORPUS_PROGRAM, "peak_rss_kb", -1.0, -1.0,
+              usage.ru_maxrss);
+#endif
+
+   if (options->json)
+      print_json(&results);
+   else
+      print_csv(&results);
+
+   fprintf(stderr, "%u programs, %u failed, %u iterations\n",
+           corpus.num_programs, failed, iterations);
+
+   int status = EXIT_SUCCESS;
+   if (options->baseline &&
+       compare_with_baseline(&results, options->baseline,
+                             options->threshold) != 0)
+      status = EXIT_FAILURE;
+
+   ralloc_free(corpus.mem_ctx);
+
+   return status;
+}
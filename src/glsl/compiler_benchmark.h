@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef COMPILER_BENCHMARK_H
+#define COMPILER_BENCHMARK_H
+
+struct gl_context;
+
+struct compiler_benchmark_options {
+   /** Directory or file holding the shader corpus */
+   const char *corpus;
+
+   /** Number of times every program is compiled and linked */
+   unsigned iterations;
+
+   /** Print JSON rather than CSV */
+   bool json;
+
+   /** Also translate linked shaders to NIR and optimize them */
+   bool nir;
+
+   /** CSV output of an earlier run to compare against, or NULL */
+   const char *baseline;
+
+   /** Slowdown, in percent, above which a stage counts as a regression */
+   double threshold;
+};
+
+int run_compiler_benchmark(struct gl_context *ctx,
+                           const struct compiler_benchmark_options *options);
+
+#endif /* COMPILER_BENCHMARK_H */
@@ -30,6 +30,7 @@
 #include "main/shaderobj.h"
 #include "util/u_atomic.h" /* for p_atomic_cmpxchg */
 #include "util/ralloc.h"
+#include "util/u_clock.h"
 #include "ast.h"
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
@@ -67,6 +68,7 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    this->info_log = ralloc_strdup(mem_ctx, "");
    this->error = false;
    this->loop_nesting_ast = NULL;
+   this->debug_output = true;
 
    this->struct_specifier_depth = 0;
 
@@ -477,7 +479,8 @@ _mesa_glsl_msg(const YYLTYPE *locp, _mesa_glsl_parse_state *state,
    struct gl_context *ctx = state->ctx;
 
    /* Report the error via GL_ARB_debug_output. */
-   _mesa_shader_debug(ctx, type, &msg_id, msg);
+   if (state->debug_output)
+      _mesa_shader_debug(ctx, type, &msg_id, msg);
 
    ralloc_strcat(&state->info_log, "\n");
 }
@@ -1758,6 +1761,8 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
    const char *source = shader->Source;
 
+   state->debug_output = !shader->CompileAsync;
+
    if (ctx->Const.GenerateTemporaryNames)
       (void) p_atomic_cmpxchg(&ir_variable::temporaries_allocate_names,
                               false, true);
@@ -1801,9 +1806,8 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+      do_common_optimization_loop(shader->ir, false, false, options,
+                                  ctx->Const.NativeIntegers);
 
       validate_ir_tree(shader->ir);
 
@@ -1878,6 +1882,196 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 }
 
 } /* extern "C" */
+
+namespace {
+
+struct common_opt_params {
+   bool linked;
+   bool uniform_locations_assigned;
+   const struct gl_shader_compiler_options *options;
+   bool native_integers;
+};
+
+typedef bool (*common_opt_func)(exec_list *ir, const common_opt_params *p);
+
+enum common_opt_pass_flags {
+   COMMON_OPT_LINKED   = 1 << 0, /**< Only run on linked shaders */
+   COMMON_OPT_UNLINKED = 1 << 1, /**< Only run on unlinked shaders */
+   COMMON_OPT_AOS      = 1 << 2, /**< Only run if OptimizeForAOS is set */
+};
+
+struct common_opt_pass {
+   const char *name;
+   common_opt_func run;
+   unsigned flags;
+};
+
+} /* anonymous namespace */
+
+#define SIMPLE_PASS(func)                                               \
+   static bool                                                         \
+   run_##func(exec_list *ir, const common_opt_params *)                \
+   {                                                                   \
+      return func(ir);                                                 \
+   }
+
+SIMPLE_PASS(do_function_inlining)
+SIMPLE_PASS(do_dead_functions)
+SIMPLE_PASS(do_structure_splitting)
+SIMPLE_PASS(do_if_simplification)
+SIMPLE_PASS(opt_flatten_nested_if_blocks)
+SIMPLE_PASS(opt_conditional_discard)
+SIMPLE_PASS(do_copy_propagation)
+SIMPLE_PASS(do_copy_propagation_elements)
+SIMPLE_PASS(opt_flip_matrices)
+SIMPLE_PASS(do_vectorize)
+SIMPLE_PASS(do_dead_code_unlinked)
+SIMPLE_PASS(do_dead_code_local)
+SIMPLE_PASS(do_tree_grafting)
+SIMPLE_PASS(do_constant_propagation)
+SIMPLE_PASS(do_constant_variable)
+SIMPLE_PASS(do_constant_variable_unlinked)
+SIMPLE_PASS(do_constant_folding)
+SIMPLE_PASS(do_minmax_prune)
+SIMPLE_PASS(do_rebalance_tree)
+SIMPLE_PASS(do_lower_jumps)
+SIMPLE_PASS(do_vec_index_to_swizzle)
+SIMPLE_PASS(do_swizzle_swizzle)
+SIMPLE_PASS(do_noop_swizzle)
+SIMPLE_PASS(optimize_redundant_jumps)
+
+#undef SIMPLE_PASS
+
+static bool
+run_lower_sub(exec_list *ir, const common_opt_params *)
+{
+   return lower_instructions(ir, SUB_TO_ADD_NEG);
+}
+
+static bool
+run_do_dead_code(exec_list *ir, const common_opt_params *p)
+{
+   return do_dead_code(ir, p->uniform_locations_assigned);
+}
+
+static bool
+run_do_algebraic(exec_list *ir, const common_opt_params *p)
+{
+   return do_algebraic(ir, p->native_integers, p->options);
+}
+
+static bool
+run_lower_vector_insert(exec_list *ir, const common_opt_params *)
+{
+   return lower_vector_insert(ir, false);
+}
+
+static bool
+run_optimize_split_arrays(exec_list *ir, const common_opt_params *p)
+{
+   return optimize_split_arrays(ir, p->linked);
+}
+
+static bool
+run_loop_unrolling(exec_list *ir, const common_opt_params *p)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = set_loop_controls(ir, ls) || progress;
+      progress = unroll_loops(ir, ls, p->options) || progress;
+   }
+   delete ls;
+
+   return progress;
+}
+
+/**
+ * The passes of do_common_optimization(), in the order they are run.
+ */
+static const common_opt_pass common_opt_passes[] = {
+   { "lower_sub",                     run_lower_sub, 0 },
+   { "function_inlining",             run_do_function_inlining,
+                                      COMMON_OPT_LINKED },
+   { "dead_functions",                run_do_dead_functions,
+                                      COMMON_OPT_LINKED },
+   { "structure_splitting",           run_do_structure_splitting,
+                                      COMMON_OPT_LINKED },
+   { "if_simplification",             run_do_if_simplification, 0 },
+   { "flatten_nested_if_blocks",      run_opt_flatten_nested_if_blocks, 0 },
+   { "conditional_discard",           run_opt_conditional_discard, 0 },
+   { "copy_propagation",              run_do_copy_propagation, 0 },
+   { "copy_propagation_elements",     run_do_copy_propagation_elements, 0 },
+   { "flip_matrices",                 run_opt_flip_matrices,
+                                      COMMON_OPT_UNLINKED | COMMON_OPT_AOS },
+   { "vectorize",                     run_do_vectorize,
+                                      COMMON_OPT_LINKED | COMMON_OPT_AOS },
+   { "dead_code",                     run_do_dead_code,
+                                      COMMON_OPT_LINKED },
+   { "dead_code_unlinked",            run_do_dead_code_unlinked,
+                                      COMMON_OPT_UNLINKED },
+   { "dead_code_local",               run_do_dead_code_local, 0 },
+   { "tree_grafting",                 run_do_tree_grafting, 0 },
+   { "constant_propagation",          run_do_constant_propagation, 0 },
+   { "constant_variable",             run_do_constant_variable,
+                                      COMMON_OPT_LINKED },
+   { "constant_variable_unlinked",    run_do_constant_variable_unlinked,
+                                      COMMON_OPT_UNLINKED },
+   { "constant_folding",              run_do_constant_folding, 0 },
+   { "minmax_prune",                  run_do_minmax_prune, 0 },
+   { "rebalance_tree",                run_do_rebalance_tree, 0 },
+   { "algebraic",                     run_do_algebraic, 0 },
+   { "lower_jumps",                   run_do_lower_jumps, 0 },
+   { "vec_index_to_swizzle",          run_do_vec_index_to_swizzle, 0 },
+   { "lower_vector_insert",           run_lower_vector_insert, 0 },
+   { "swizzle_swizzle",               run_do_swizzle_swizzle, 0 },
+   { "noop_swizzle",                  run_do_noop_swizzle, 0 },
+   { "split_arrays",                  run_optimize_split_arrays, 0 },
+   { "redundant_jumps",               run_optimize_redundant_jumps, 0 },
+   { "loop_unrolling",                run_loop_unrolling, 0 },
+};
+
+#define NUM_COMMON_OPT_PASSES ARRAY_SIZE(common_opt_passes)
+
+/* Set with p_atomic_set() by _mesa_glsl_enable_opt_stats() and read with
+ * p_atomic_read() from whichever thread is compiling.
+ */
+static int opt_stats_enabled;
+static glsl_opt_pass_stats opt_stats[NUM_COMMON_OPT_PASSES];
+static unsigned opt_stats_loops;
+static unsigned opt_stats_iterations;
+
+static bool
+common_opt_pass_applies(const common_opt_pass *pass,
+                        const common_opt_params *p)
+{
+   if ((pass->flags & COMMON_OPT_LINKED) && !p->linked)
+      return false;
+   if ((pass->flags & COMMON_OPT_UNLINKED) && p->linked)
+      return false;
+   if ((pass->flags & COMMON_OPT_AOS) && !p->options->OptimizeForAOS)
+      return false;
+   return true;
+}
+
+static bool
+run_common_opt_pass(unsigned i, exec_list *ir, const common_opt_params *p)
+{
+   if (!p_atomic_read(&opt_stats_enabled))
+      return common_opt_passes[i].run(ir, p);
+
+   const int64_t start = util_get_time_nano();
+   const bool progress = common_opt_passes[i].run(ir, p);
+
+   p_atomic_add(&opt_stats[i].time_ns, util_get_time_nano() - start);
+   p_atomic_inc(&opt_stats[i].runs);
+   if (progress)
+      p_atomic_inc(&opt_stats[i].progress);
+
+   return progress;
+}
+
 /**
  * Do the set of common optimizations passes
  *
@@ -1902,60 +2096,127 @@ do_common_optimization(exec_list *ir, bool linked,
                        const struct gl_shader_compiler_options *options,
                        bool native_integers)
 {
-   GLboolean progress = GL_FALSE;
+   const common_opt_params p = {
+      linked, uniform_locations_assigned, options, native_integers
+   };
+   bool progress = false;
+
+   for (unsigned i = 0; i < NUM_COMMON_OPT_PASSES; i++) {
+      if (common_opt_pass_applies(&common_opt_passes[i], &p))
+         progress = run_common_opt_pass(i, ir, &p) || progress;
+   }
 
-   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
+   return progress;
+}
 
-   if (linked) {
-      progress = do_function_inlining(ir) || progress;
-      progress = do_dead_functions(ir) || progress;
-      progress = do_structure_splitting(ir) || progress;
-   }
-   progress = do_if_simplification(ir) || progress;
-   progress = opt_flatten_nested_if_blocks(ir) || progress;
-   progress = opt_conditional_discard(ir) || progress;
-   progress = do_copy_propagation(ir) || progress;
-   progress = do_copy_propagation_elements(ir) || progress;
+/**
+ * Run the do_common_optimization() passes until none of them makes progress.
+ *
+ * This is
+ *
+ *    while (do_common_optimization(ir, ...))
+ *       ;
+ *
+ * except that it stops in the middle of the pass list instead of at its
+ * end: the loop wraps around the list and ends at the first pass that has
+ * already run on the current IR.  That only skips the passes behind the
+ * last one to make progress, and only in the final, progress-free trip
+ * through the list; every earlier trip runs every pass.  Skipping them
+ * relies on a pass making no progress on IR it has just left unchanged,
+ * which the while loop above relies on to terminate as well.
+ *
+ * The arguments are the same as for do_common_optimization().
+ */
+void
+do_common_optimization_loop(exec_list *ir, bool linked,
+                            bool uniform_locations_assigned,
+                            const struct gl_shader_compiler_options *options,
+                            bool native_integers)
+{
+   const common_opt_params p = {
+      linked, uniform_locations_assigned, options, native_integers
+   };
 
-   if (options->OptimizeForAOS && !linked)
-      progress = opt_flip_matrices(ir) || progress;
+   /* Bumped whenever a pass makes progress.  seen[i] is the generation of
+    * the IR pass i last ran on, or ~0 if it hasn't run yet.
+    */
+   unsigned generation = 0;
+   unsigned seen[NUM_COMMON_OPT_PASSES];
+   unsigned iterations = 0;
+   const bool stats = p_atomic_read(&opt_stats_enabled);
 
-   if (linked && options->OptimizeForAOS) {
-      progress = do_vectorize(ir) || progress;
-   }
+   memset(seen, 0xff, sizeof(seen));
 
-   if (linked)
-      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
-   else
-      progress = do_dead_code_unlinked(ir) || progress;
-   progress = do_dead_code_local(ir) || progress;
-   progress = do_tree_grafting(ir) || progress;
-   progress = do_constant_propagation(ir) || progress;
-   if (linked)
-      progress = do_constant_variable(ir) || progress;
-   else
-      progress = do_constant_variable_unlinked(ir) || progress;
-   progress = do_constant_folding(ir) || progress;
-   progress = do_minmax_prune(ir) || progress;
-   progress = do_rebalance_tree(ir) || progress;
-   progress = do_algebraic(ir, native_integers, options) || progress;
-   progress = do_lower_jumps(ir) || progress;
-   progress = do_vec_index_to_swizzle(ir) || progress;
-   progress = lower_vector_insert(ir, false) || progress;
-   progress = do_swizzle_swizzle(ir) || progress;
-   progress = do_noop_swizzle(ir) || progress;
-
-   progress = optimize_split_arrays(ir, linked) || progress;
-   progress = optimize_redundant_jumps(ir) || progress;
+   for (;;) {
+      bool ran_any = false;
 
-   loop_state *ls = analyze_loop_variables(ir);
-   if (ls->loop_found) {
-      progress = set_loop_controls(ir, ls) || progress;
-      progress = unroll_loops(ir, ls, options) || progress;
+      for (unsigned i = 0; i < NUM_COMMON_OPT_PASSES; i++) {
+         if (!common_opt_pass_applies(&common_opt_passes[i], &p))
+            continue;
+
+         if (seen[i] == generation) {
+            if (stats)
+               p_atomic_inc(&opt_stats[i].skipped);
+            continue;
+         }
+
+         seen[i] = generation;
+         ran_any = true;
+
+         if (run_common_opt_pass(i, ir, &p))
+            generation++;
+      }
+
+      if (!ran_any)
+         break;
+
+      iterations++;
    }
-   delete ls;
 
-   return progress;
+   if (stats) {
+      p_atomic_inc(&opt_stats_loops);
+      p_atomic_add(&opt_stats_iterations, iterations);
+   }
+}
+
+/**
+ * Start or stop collecting the per-pass statistics of
+ * do_common_optimization() and do_common_optimization_loop().
+ */
+void
+_mesa_glsl_enable_opt_stats(bool enable)
+{
+   p_atomic_set(&opt_stats_enabled, enable);
+}
+
+/**
+ * Return the per-pass optimization statistics, one entry per pass, in the
+ * order the passes are run.
+ *
+ * \param loops       Returns the number of do_common_optimization_loop()
+ *                    calls.
+ * \param iterations  Returns the number of times those calls went through
+ *                    the list of passes.
+ */
+const struct glsl_opt_pass_stats *
+_mesa_glsl_get_opt_stats(unsigned *num_passes, unsigned *loops,
+                         unsigned *iterations)
+{
+   for (unsigned i = 0; i < NUM_COMMON_OPT_PASSES; i++)
+      opt_stats[i].name = common_opt_passes[i].name;
+
+   *num_passes = NUM_COMMON_OPT_PASSES;
+   *loops = opt_stats_loops;
+   *iterations = opt_stats_iterations;
+   return opt_stats;
+}
+
+void
+_mesa_glsl_reset_opt_stats(void)
+{
+   memset(opt_stats, 0, sizeof(opt_stats));
+   opt_stats_loops = 0;
+   opt_stats_iterations = 0;
 }
 
 extern "C" {
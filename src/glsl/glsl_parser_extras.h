@@ -269,6 +269,13 @@ struct _mesa_glsl_parse_state {
                                   const char *ident);
 
    struct gl_context *const ctx;
+
+   /**
+    * Whether messages are reported via GL_ARB_debug_output.  Cleared for
+    * compiles running on a compile thread, see gl_shader::CompileAsync.
+    */
+   bool debug_output;
+
    void *scanner;
    exec_list translation_unit;
    glsl_symbol_table *symbols;
@@ -76,6 +76,28 @@ bool do_common_optimization(exec_list *ir, bool linked,
 			    bool uniform_locations_assigned,
                             const struct gl_shader_compiler_options *options,
                             bool native_integers);
+void do_common_optimization_loop(exec_list *ir, bool linked,
+                                 bool uniform_locations_assigned,
+                                 const struct gl_shader_compiler_options *options,
+                                 bool native_integers);
+
+/**
+ * Statistics of one do_common_optimization() pass, see
+ * _mesa_glsl_enable_opt_stats().
+ */
+struct glsl_opt_pass_stats {
+   const char *name;
+   unsigned runs;       /**< Number of times the pass was run */
+   unsigned progress;   /**< Number of those runs that made progress */
+   unsigned skipped;    /**< Runs do_common_optimization_loop() skipped */
+   uint64_t time_ns;    /**< Total time spent in the pass */
+};
+
+void _mesa_glsl_enable_opt_stats(bool enable);
+const struct glsl_opt_pass_stats *
+_mesa_glsl_get_opt_stats(unsigned *num_passes, unsigned *loops,
+                         unsigned *iterations);
+void _mesa_glsl_reset_opt_stats(void);
 
 bool do_rebalance_tree(exec_list *instructions);
 bool do_algebraic(exec_list *instructions, bool native_integers,
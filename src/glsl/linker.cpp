@@ -4315,10 +4315,9 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_tess_level(prog->_LinkedShaders[i]);
       }
 
-      while (do_common_optimization(prog->_LinkedShaders[i]->ir, true, false,
-                                    &ctx->Const.ShaderCompilerOptions[i],
-                                    ctx->Const.NativeIntegers))
-	 ;
+      do_common_optimization_loop(prog->_LinkedShaders[i]->ir, true, false,
+                                  &ctx->Const.ShaderCompilerOptions[i],
+                                  ctx->Const.NativeIntegers);
 
       lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir);
    }
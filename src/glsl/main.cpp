@@ -38,6 +38,9 @@
 #include "program/hash_table.h"
 #include "loop_analysis.h"
 #include "standalone_scaffolding.h"
+#ifdef HAVE_COMPILER_BENCHMARK
+#include "compiler_benchmark.h"
+#endif
 
 static int glsl_version = 330;
 
@@ -257,6 +260,9 @@ int dump_ast = 0;
 int dump_hir = 0;
 int dump_lir = 0;
 int do_link = 0;
+#ifdef HAVE_COMPILER_BENCHMARK
+int benchmark_nir = 0;
+#endif
 
 const struct option compiler_opts[] = {
    { "dump-ast", no_argument, &dump_ast, 1 },
@@ -264,6 +270,14 @@ const struct option compiler_opts[] = {
    { "dump-lir", no_argument, &dump_lir, 1 },
    { "link",     no_argument, &do_link,  1 },
    { "version",  required_argument, NULL, 'v' },
+#ifdef HAVE_COMPILER_BENCHMARK
+   { "benchmark", required_argument, NULL, 'b' },
+   { "iterations", required_argument, NULL, 'i' },
+   { "format",   required_argument, NULL, 'f' },
+   { "baseline", required_argument, NULL, 'B' },
+   { "threshold", required_argument, NULL, 't' },
+   { "nir",      no_argument, &benchmark_nir, 1 },
+#endif
    { NULL, 0, NULL, 0 }
 };
 
@@ -276,9 +290,13 @@ usage_fail(const char *name)
 
    const char *header =
       "usage: %s [options] <file.vert | file.tesc | file.tese | file.geom | file.frag | file.comp>\n"
+#ifdef HAVE_COMPILER_BENCHMARK
+      "       %s --benchmark <directory> [--iterations <n>] [--format <csv | json>]\n"
+      "                  [--baseline <file.csv>] [--threshold <percent>] [--nir]\n"
+#endif
       "\n"
       "Possible options are:\n";
-   printf(header, name);
+   printf(header, name, name);
    for (const struct option *o = compiler_opts; o->name != 0; ++o) {
       printf("    --%s\n", o->name);
    }
@@ -309,6 +327,13 @@ main(int argc, char **argv)
    struct gl_context local_ctx;
    struct gl_context *ctx = &local_ctx;
    bool glsl_es = false;
+#ifdef HAVE_COMPILER_BENCHMARK
+   struct compiler_benchmark_options benchmark_options;
+
+   memset(&benchmark_options, 0, sizeof(benchmark_options));
+   benchmark_options.iterations = 5;
+   benchmark_options.threshold = 5.0;
+#endif
 
    int c;
    int idx = 0;
@@ -335,11 +360,44 @@ main(int argc, char **argv)
             break;
          }
          break;
+#ifdef HAVE_COMPILER_BENCHMARK
+      case 'b':
+         benchmark_options.corpus = optarg;
+         break;
+      case 'i':
+         benchmark_options.iterations = strtol(optarg, NULL, 10);
+         break;
+      case 'f':
+         if (strcmp(optarg, "json") == 0)
+            benchmark_options.json = true;
+         else if (strcmp(optarg, "csv") != 0)
+            usage_fail(argv[0]);
+         break;
+      case 'B':
+         benchmark_options.baseline = optarg;
+         break;
+      case 't':
+         benchmark_options.threshold = strtod(optarg, NULL);
+         break;
+#endif
       default:
          break;
       }
    }
 
+#ifdef HAVE_COMPILER_BENCHMARK
+   if (benchmark_options.corpus != NULL) {
+      benchmark_options.nir = benchmark_nir;
+
+      initialize_context(ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL_COMPAT);
+      status = run_compiler_benchmark(ctx, &benchmark_options);
+
+      _mesa_glsl_release_types();
+      _mesa_glsl_release_builtin_functions();
+
+      return status;
+   }
+#endif
 
    if (argc <= optind)
       usage_fail(argv[0]);
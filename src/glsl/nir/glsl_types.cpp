@@ -26,13 +26,158 @@
 #include "glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
+
+
+/**
+ * Insert-only hash table of the derived types (arrays, records, interfaces
+ * and subroutines).
+ *
+ * Searching does not take glsl_type::mutex.  Slots are only ever filled,
+ * never emptied, and a type is published with an atomic compare-and-swap
+ * once it is fully constructed.  When the table has to grow, the entries
+ * are copied into a new table which is then published the same way.  The
+ * old table stays allocated in glsl_type::mem_ctx, so a reader still walking
+ * it sees a consistent, if possibly incomplete, set of types; a search that
+ * misses falls back to type_table_insert(), which searches again with the
+ * mutex held.
+ *
+ * The table and slot pointers are published with p_atomic_cmpxchg(), which
+ * is a full barrier, and read without the mutex through load_acquire(), so
+ * a reader that sees a pointer also sees what it points to.
+ */
+struct glsl_type_table_slot {
+   unsigned hash;    /**< Only used to rehash when the table grows */
+   const glsl_type *type;
+};
+
+struct glsl_type_table {
+   unsigned size;       /**< Number of slots, always a power of two */
+   unsigned entries;    /**< Number of filled slots */
+   glsl_type_table_slot *slots;
+};
+
+typedef bool (*type_key_equal_func)(const glsl_type *type, const void *key);
+
+template<typename T>
+static inline T
+load_acquire(const T *ptr)
+{
+#if defined(__GNUC__)
+   return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else
+   /* MSVC gives volatile reads acquire semantics. */
+   return *(const volatile T *) ptr;
+#endif
+}
+
+static const glsl_type *
+type_table_search(const glsl_type_table *table, unsigned hash,
+                  type_key_equal_func equal, const void *key)
+{
+   if (table == NULL)
+      return NULL;
+
+   const unsigned mask = table->size - 1;
+
+   /* The table is never more than half full, so this finds an empty slot
+    * before wrapping around.
+    */
+   for (unsigned i = hash & mask; ; i = (i + 1) & mask) {
+      const glsl_type *t = load_acquire(&table->slots[i].type);
+
+      if (t == NULL)
+         return NULL;
+
+      if (equal(t, key))
+         return t;
+   }
+}
+
+static void
+type_table_add(glsl_type_table *table, unsigned hash, const glsl_type *t)
+{
+   const unsigned mask = table->size - 1;
+   unsigned i = hash & mask;
+
+   while (table->slots[i].type != NULL)
+      i = (i + 1) & mask;
+
+   table->slots[i].hash = hash;
+   /* Full barrier: the hash and the type are visible before the slot is. */
+   (void) p_atomic_cmpxchg(&table->slots[i].type, (const glsl_type *) NULL, t);
+   table->entries++;
+}
+
+/**
+ * Free a type that was never added to a table, along with the name and
+ * fields its constructor allocated from glsl_type::mem_ctx.
+ *
+ * Must be called with glsl_type::mutex held.
+ */
+static void
+free_unused_type(const glsl_type *t)
+{
+   if (t->base_type == GLSL_TYPE_STRUCT || t->base_type == GLSL_TYPE_INTERFACE)
+      ralloc_free(t->fields.structure);
+
+   ralloc_free((void *) t->name);
+   ralloc_free((void *) t);
+}
+
+/**
+ * Add \c t to the table, unless another thread added a matching type in the
+ * meantime, in which case \c t is freed.
+ *
+ * Must be called with glsl_type::mutex held.
+ *
+ * \return the type now in the table for \c key
+ */
+static const glsl_type *
+type_table_insert(glsl_type_table **table_ptr, void *mem_ctx, unsigned hash,
+                  type_key_equal_func equal, const void *key,
+                  const glsl_type *t)
+{
+   glsl_type_table *table = *table_ptr;
+
+   const glsl_type *existing = type_table_search(table, hash, equal, key);
+   if (existing != NULL) {
+      free_unused_type(t);
+      return existing;
+   }
+
+   if (table == NULL || (table->entries + 1) * 2 > table->size) {
+      glsl_type_table *grown = ralloc(mem_ctx, glsl_type_table);
+
+      grown->size = table != NULL ? table->size * 2 : 64;
+      grown->entries = 0;
+      grown->slots = rzalloc_array(grown, glsl_type_table_slot, grown->size);
+
+      if (table != NULL) {
+         for (unsigned i = 0; i < table->size; i++) {
+            if (table->slots[i].type != NULL)
+               type_table_add(grown, table->slots[i].hash,
+                              table->slots[i].type);
+         }
+      }
+
+      /* The old table is deliberately not freed, readers may still be in
+       * it.
+       */
+      (void) p_atomic_cmpxchg(table_ptr, table, grown);
+      table = grown;
+   }
+
+   type_table_add(table, hash, t);
+   return t;
+}
 
 
 mtx_t glsl_type::mutex = _MTX_INITIALIZER_NP;
-hash_table *glsl_type::array_types = NULL;
-hash_table *glsl_type::record_types = NULL;
-hash_table *glsl_type::interface_types = NULL;
-hash_table *glsl_type::subroutine_types = NULL;
+glsl_type_table *glsl_type::array_types = NULL;
+glsl_type_table *glsl_type::record_types = NULL;
+glsl_type_table *glsl_type::interface_types = NULL;
+glsl_type_table *glsl_type::subroutine_types = NULL;
 void *glsl_type::mem_ctx = NULL;
 
 void
@@ -163,6 +308,11 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
       this->fields.structure[i].sample = fields[i].sample;
       this->fields.structure[i].matrix_layout = fields[i].matrix_layout;
       this->fields.structure[i].patch = fields[i].patch;
+      this->fields.structure[i].image_read_only = fields[i].image_read_only;
+      this->fields.structure[i].image_write_only = fields[i].image_write_only;
+      this->fields.structure[i].image_coherent = fields[i].image_coherent;
+      this->fields.structure[i].image_volatile = fields[i].image_volatile;
+      this->fields.structure[i].image_restrict = fields[i].image_restrict;
       this->fields.structure[i].precision = fields[i].precision;
    }
 
@@ -368,21 +518,14 @@ _mesa_glsl_release_types(void)
    /* Should only be called during atexit (either when unloading shared
     * object, or if process terminates), so no mutex-locking should be
     * necessary.
+    *
+    * The tables themselves live in glsl_type::mem_ctx, which is freed
+    * along with the types.
     */
-   if (glsl_type::array_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::array_types, NULL);
-      glsl_type::array_types = NULL;
-   }
-
-   if (glsl_type::record_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::record_types, NULL);
-      glsl_type::record_types = NULL;
-   }
-
-   if (glsl_type::interface_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::interface_types, NULL);
-      glsl_type::interface_types = NULL;
-   }
+   glsl_type::array_types = NULL;
+   glsl_type::record_types = NULL;
+   glsl_type::interface_types = NULL;
+   glsl_type::subroutine_types = NULL;
 }
 
 
@@ -680,42 +823,107 @@ glsl_type::get_sampler_instance(enum glsl_sampler_dim dim,
    unreachable("switch statement above should be complete");
 }
 
-const glsl_type *
-glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
+namespace {
+
+/**
+ * Key for the array type table.
+ *
+ * The base type is compared by pointer rather than by name because the name
+ * of the base type may not be unique across shaders.  For example, two
+ * shaders may have different record types named 'foo'.
+ */
+struct array_key {
+   const glsl_type *base;
+   unsigned array_size;
+};
+
+/** Key for the record, interface and subroutine type tables. */
+struct record_key {
+   const glsl_struct_field *fields;
+   unsigned num_fields;
+   unsigned packing;
+   const char *name;
+};
+
+} /* anonymous namespace */
+
+static unsigned
+array_key_hash(const array_key *key)
 {
-   /* Generate a name using the base type pointer in the key.  This is
-    * done because the name of the base type may not be unique across
-    * shaders.  For example, two shaders may have different record types
-    * named 'foo'.
-    */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
+   uintptr_t hash = (uintptr_t) key->base * 31 + key->array_size;
 
-   mtx_lock(&glsl_type::mutex);
+   if (sizeof(hash) == 8)
+      return (hash & 0xffffffff) ^ ((uint64_t) hash >> 32);
+   else
+      return hash;
+}
 
-   if (array_types == NULL) {
-      array_types = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
-                                            _mesa_key_string_equal);
-   }
+static bool
+array_key_equal(const glsl_type *type, const void *data)
+{
+   const array_key *key = (const array_key *) data;
 
-   const struct hash_entry *entry = _mesa_hash_table_search(array_types, key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(base, array_size);
-      mtx_lock(&glsl_type::mutex);
+   return type->fields.array == key->base && type->length == key->array_size;
+}
 
-      entry = _mesa_hash_table_insert(array_types,
-                                      ralloc_strdup(mem_ctx, key),
-                                      (void *) t);
+/**
+ * Generate an integer hash value for a structure type.
+ */
+static unsigned
+record_key_hash(const record_key *key)
+{
+   uintptr_t hash = key->num_fields;
+
+   for (unsigned i = 0; i < key->num_fields; i++) {
+      /* casting pointer to uintptr_t */
+      hash = (hash * 13 ) + (uintptr_t) key->fields[i].type;
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_ARRAY);
-   assert(((glsl_type *) entry->data)->length == array_size);
-   assert(((glsl_type *) entry->data)->fields.array == base);
+   if (sizeof(hash) == 8)
+      return (hash & 0xffffffff) ^ ((uint64_t) hash >> 32);
+   else
+      return hash;
+}
 
-   mtx_unlock(&glsl_type::mutex);
+static bool
+record_fields_equal(const glsl_struct_field *a, const glsl_struct_field *b,
+                    unsigned num_fields);
 
-   return (glsl_type *) entry->data;
+static bool
+record_key_equal(const glsl_type *type, const void *data)
+{
+   const record_key *key = (const record_key *) data;
+
+   return type->length == key->num_fields &&
+          type->interface_packing == key->packing &&
+          strcmp(type->name, key->name) == 0 &&
+          record_fields_equal(type->fields.structure, key->fields,
+                              key->num_fields);
+}
+
+
+const glsl_type *
+glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
+{
+   const array_key key = { base, array_size };
+   const unsigned hash = array_key_hash(&key);
+
+   const glsl_type *t = type_table_search(load_acquire(&array_types), hash,
+                                          array_key_equal, &key);
+   if (t == NULL) {
+      const glsl_type *created = new glsl_type(base, array_size);
+
+      mtx_lock(&glsl_type::mutex);
+      t = type_table_insert(&array_types, mem_ctx, hash,
+                            array_key_equal, &key, created);
+      mtx_unlock(&glsl_type::mutex);
+   }
+
+   assert(t->base_type == GLSL_TYPE_ARRAY);
+   assert(t->length == array_size);
+   assert(t->fields.array == base);
+
+   return t;
 }
 
 
@@ -742,47 +950,43 @@ glsl_type::record_compare(const glsl_type *b) const
       if (strcmp(this->name, b->name) != 0)
          return false;
 
-   for (unsigned i = 0; i < this->length; i++) {
-      if (this->fields.structure[i].type != b->fields.structure[i].type)
+   return record_fields_equal(this->fields.structure, b->fields.structure,
+                              this->length);
+}
+
+
+static bool
+record_fields_equal(const glsl_struct_field *a, const glsl_struct_field *b,
+                    unsigned num_fields)
+{
+   for (unsigned i = 0; i < num_fields; i++) {
+      if (a[i].type != b[i].type)
          return false;
-      if (strcmp(this->fields.structure[i].name,
-                 b->fields.structure[i].name) != 0)
+      if (strcmp(a[i].name, b[i].name) != 0)
          return false;
-      if (this->fields.structure[i].matrix_layout
-         != b->fields.structure[i].matrix_layout)
+      if (a[i].matrix_layout != b[i].matrix_layout)
         return false;
-      if (this->fields.structure[i].location
-          != b->fields.structure[i].location)
+      if (a[i].location != b[i].location)
          return false;
-      if (this->fields.structure[i].interpolation
-          != b->fields.structure[i].interpolation)
+      if (a[i].interpolation != b[i].interpolation)
          return false;
-      if (this->fields.structure[i].centroid
-          != b->fields.structure[i].centroid)
+      if (a[i].centroid != b[i].centroid)
          return false;
-      if (this->fields.structure[i].sample
-          != b->fields.structure[i].sample)
+      if (a[i].sample != b[i].sample)
          return false;
-      if (this->fields.structure[i].patch
-          != b->fields.structure[i].patch)
+      if (a[i].patch != b[i].patch)
          return false;
-      if (this->fields.structure[i].image_read_only
-          != b->fields.structure[i].image_read_only)
+      if (a[i].image_read_only != b[i].image_read_only)
          return false;
-      if (this->fields.structure[i].image_write_only
-          != b->fields.structure[i].image_write_only)
+      if (a[i].image_write_only != b[i].image_write_only)
          return false;
-      if (this->fields.structure[i].image_coherent
-          != b->fields.structure[i].image_coherent)
+      if (a[i].image_coherent != b[i].image_coherent)
          return false;
-      if (this->fields.structure[i].image_volatile
-          != b->fields.structure[i].image_volatile)
+      if (a[i].image_volatile != b[i].image_volatile)
          return false;
-      if (this->fields.structure[i].image_restrict
-          != b->fields.structure[i].image_restrict)
+      if (a[i].image_restrict != b[i].image_restrict)
          return false;
-      if (this->fields.structure[i].precision
-          != b->fields.structure[i].precision)
+      if (a[i].precision != b[i].precision)
          return false;
    }
 
@@ -790,71 +994,30 @@ glsl_type::record_compare(const glsl_type *b) const
 }
 
 
-bool
-glsl_type::record_key_compare(const void *a, const void *b)
-{
-   const glsl_type *const key1 = (glsl_type *) a;
-   const glsl_type *const key2 = (glsl_type *) b;
-
-   return strcmp(key1->name, key2->name) == 0 && key1->record_compare(key2);
-}
-
-
-/**
- * Generate an integer hash value for a glsl_type structure type.
- */
-unsigned
-glsl_type::record_key_hash(const void *a)
-{
-   const glsl_type *const key = (glsl_type *) a;
-   uintptr_t hash = key->length;
-   unsigned retval;
-
-   for (unsigned i = 0; i < key->length; i++) {
-      /* casting pointer to uintptr_t */
-      hash = (hash * 13 ) + (uintptr_t) key->fields.structure[i].type;
-   }
-
-   if (sizeof(hash) == 8)
-      retval = (hash & 0xffffffff) ^ ((uint64_t) hash >> 32);
-   else
-      retval = hash;
-
-   return retval;
-}
-
-
 const glsl_type *
 glsl_type::get_record_instance(const glsl_struct_field *fields,
                                unsigned num_fields,
                                const char *name)
 {
-   const glsl_type key(fields, num_fields, name);
+   const record_key key = { fields, num_fields, 0, name };
+   const unsigned hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::mutex);
+   const glsl_type *t = type_table_search(load_acquire(&record_types), hash,
+                                          record_key_equal, &key);
+   if (t == NULL) {
+      const glsl_type *created = new glsl_type(fields, num_fields, name);
 
-   if (record_types == NULL) {
-      record_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                             record_key_compare);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(record_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(fields, num_fields, name);
       mtx_lock(&glsl_type::mutex);
-
-      entry = _mesa_hash_table_insert(record_types, t, (void *) t);
+      t = type_table_insert(&record_types, mem_ctx, hash,
+                            record_key_equal, &key, created);
+      mtx_unlock(&glsl_type::mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_STRUCT);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
+   assert(t->base_type == GLSL_TYPE_STRUCT);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, name) == 0);
 
-   mtx_unlock(&glsl_type::mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -864,63 +1027,50 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
                                   enum glsl_interface_packing packing,
                                   const char *block_name)
 {
-   const glsl_type key(fields, num_fields, packing, block_name);
+   const record_key key = { fields, num_fields, (unsigned) packing,
+                            block_name };
+   const unsigned hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::mutex);
-
-   if (interface_types == NULL) {
-      interface_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                record_key_compare);
-   }
+   const glsl_type *t = type_table_search(load_acquire(&interface_types),
+                                          hash, record_key_equal, &key);
+   if (t == NULL) {
+      const glsl_type *created = new glsl_type(fields, num_fields,
+                                               packing, block_name);
 
-   const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(fields, num_fields,
-                                         packing, block_name);
       mtx_lock(&glsl_type::mutex);
-
-      entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
+      t = type_table_insert(&interface_types, mem_ctx, hash,
+                            record_key_equal, &key, created);
+      mtx_unlock(&glsl_type::mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_INTERFACE);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
-
-   mtx_unlock(&glsl_type::mutex);
+   assert(t->base_type == GLSL_TYPE_INTERFACE);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, block_name) == 0);
 
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 const glsl_type *
 glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
-   const glsl_type key(subroutine_name);
+   const record_key key = { NULL, 0, 0, subroutine_name };
+   const unsigned hash = _mesa_hash_string(subroutine_name);
 
-   mtx_lock(&glsl_type::mutex);
+   const glsl_type *t = type_table_search(load_acquire(&subroutine_types),
+                                          hash, record_key_equal, &key);
+   if (t == NULL) {
+      const glsl_type *created = new glsl_type(subroutine_name);
 
-   if (subroutine_types == NULL) {
-      subroutine_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                 record_key_compare);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(subroutine_name);
       mtx_lock(&glsl_type::mutex);
-
-      entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
+      t = type_table_insert(&subroutine_types, mem_ctx, hash,
+                            record_key_equal, &key, created);
+      mtx_unlock(&glsl_type::mutex);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
-   assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
-
-   mtx_unlock(&glsl_type::mutex);
+   assert(t->base_type == GLSL_TYPE_SUBROUTINE);
+   assert(strcmp(t->name, subroutine_name) == 0);
 
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -35,6 +35,7 @@ extern "C" {
 
 struct _mesa_glsl_parse_state;
 struct glsl_symbol_table;
+struct glsl_type_table;
 
 extern void
 _mesa_glsl_initialize_types(struct _mesa_glsl_parse_state *state);
@@ -764,20 +765,18 @@ private:
    /** Constructor for subroutine types */
    glsl_type(const char *name);
 
-   /** Hash table containing the known array types. */
-   static struct hash_table *array_types;
-
-   /** Hash table containing the known record types. */
-   static struct hash_table *record_types;
-
-   /** Hash table containing the known interface types. */
-   static struct hash_table *interface_types;
-
-   /** Hash table containing the known subroutine types. */
-   static struct hash_table *subroutine_types;
-
-   static bool record_key_compare(const void *a, const void *b);
-   static unsigned record_key_hash(const void *key);
+   /**
+    * \name Tables of the known derived types
+    *
+    * These can be searched without holding \c mutex, see
+    * \c glsl_type_table.
+    */
+   /*@{*/
+   static struct glsl_type_table *array_types;
+   static struct glsl_type_table *record_types;
+   static struct glsl_type_table *interface_types;
+   static struct glsl_type_table *subroutine_types;
+   /*@}*/
 
    /**
     * \name Built-in type flyweights
@@ -863,7 +862,9 @@ struct glsl_struct_field {
    glsl_struct_field(const struct glsl_type *_type, const char *_name)
       : type(_type), name(_name), location(-1), interpolation(0), centroid(0),
         sample(0), matrix_layout(GLSL_MATRIX_LAYOUT_INHERITED), patch(0),
-        precision(GLSL_PRECISION_NONE)
+        precision(GLSL_PRECISION_NONE), image_read_only(0),
+        image_write_only(0), image_coherent(0), image_volatile(0),
+        image_restrict(0)
    {
       /* empty */
    }
@@ -2067,6 +2067,9 @@ bool nir_lower_gs_intrinsics(nir_shader *shader);
 bool nir_normalize_cubemap_coords(nir_shader *shader);
 
 void nir_live_ssa_defs_impl(nir_function_impl *impl);
+/* Only for passes that remove code without touching the CFG, like DCE */
+void nir_live_ssa_def_clear(nir_ssa_def *def);
+void nir_live_ssa_def_update(nir_ssa_def *def);
 bool nir_ssa_defs_interfere(nir_ssa_def *a, nir_ssa_def *b);
 
 void nir_convert_to_ssa_impl(nir_function_impl *impl);
@@ -233,6 +233,171 @@ nir_live_ssa_defs_impl(nir_function_impl *impl)
    nir_block_worklist_fini(&state.worklist);
 }
 
+/*
+ * Incremental liveness updates for dead code elimination.
+ *
+ * These only handle uses and definitions going away with the CFG left
+ * alone, which is all nir_opt_dce does: a live range can then only shrink,
+ * and the live range of a removed value has to be dropped.  Inserting
+ * instructions, splitting blocks or adding phis is not handled; passes doing
+ * that must still invalidate nir_metadata_live_ssa_defs.
+ *
+ * A live range is cleared by walking forward from the definition through
+ * the blocks it is live in, and rebuilt by walking backwards from each
+ * remaining use, so only the blocks in which the def was live are touched.
+ */
+
+static void
+mark_live_in(nir_block *block, nir_ssa_def *def, nir_block_worklist *worklist)
+{
+   nir_block *def_block = def->parent_instr->block;
+
+   /* A def is never live coming into the block that defines it, except for
+    * phis which, as far as liveness is concerned, are defined on the edge
+    * into their block.
+    */
+   if (block == def_block && def->parent_instr->type != nir_instr_type_phi)
+      return;
+
+   if (BITSET_TEST(block->live_in, def->live_index))
+      return;
+
+   BITSET_SET(block->live_in, def->live_index);
+
+   if (block != def_block)
+      nir_block_worklist_push_tail(worklist, block);
+}
+
+static void
+mark_live_out(nir_block *block, nir_ssa_def *def, nir_block_worklist *worklist)
+{
+   if (BITSET_TEST(block->live_out, def->live_index))
+      return;
+
+   BITSET_SET(block->live_out, def->live_index);
+   mark_live_in(block, def, worklist);
+}
+
+/* Clears the def from the live sets of the blocks it is live in.  Every
+ * such block is reached from the defining block through edges the def is
+ * live across, so there is no need to look at the other blocks.
+ */
+static void
+clear_live_range(nir_ssa_def *def, nir_block_worklist *worklist)
+{
+   nir_block *def_block = def->parent_instr->block;
+
+   BITSET_CLEAR(def_block->live_in, def->live_index);
+   nir_block_worklist_push_tail(worklist, def_block);
+
+   while (!nir_block_worklist_is_empty(worklist)) {
+      nir_block *block = nir_block_worklist_pop_head(worklist);
+
+      if (!BITSET_TEST(block->live_out, def->live_index))
+         continue;
+
+      BITSET_CLEAR(block->live_out, def->live_index);
+
+      for (unsigned i = 0; i < 2; i++) {
+         nir_block *succ = block->successors[i];
+
+         if (succ && BITSET_TEST(succ->live_in, def->live_index)) {
+            BITSET_CLEAR(succ->live_in, def->live_index);
+            nir_block_worklist_push_tail(worklist, succ);
+         }
+      }
+   }
+}
+
+/* Returns the function containing the def if its liveness is valid, so that
+ * passes can call the functions below unconditionally.
+ */
+static nir_function_impl *
+live_ssa_defs_impl(nir_ssa_def *def)
+{
+   nir_function_impl *impl =
+      nir_cf_node_get_function(&def->parent_instr->block->cf_node);
+
+   if (!(impl->valid_metadata & nir_metadata_live_ssa_defs))
+      return NULL;
+
+   /* undefined variables are never live */
+   if (def->live_index == 0)
+      return NULL;
+
+   nir_metadata_require(impl, nir_metadata_block_index);
+   return impl;
+}
+
+/**
+ * Removes a def from the live sets.  Called on the defs of an instruction
+ * that is about to be removed along with all of its uses, while it is still
+ * in its block.
+ */
+void
+nir_live_ssa_def_clear(nir_ssa_def *def)
+{
+   nir_function_impl *impl = live_ssa_defs_impl(def);
+   if (!impl)
+      return;
+
+   nir_block_worklist worklist;
+   nir_block_worklist_init(&worklist, impl->num_blocks, NULL);
+
+   clear_live_range(def, &worklist);
+
+   nir_block_worklist_fini(&worklist);
+}
+
+/**
+ * Recomputes the live range of a def after some of its uses were removed.
+ */
+void
+nir_live_ssa_def_update(nir_ssa_def *def)
+{
+   nir_function_impl *impl = live_ssa_defs_impl(def);
+   if (!impl)
+      return;
+
+   nir_block_worklist worklist;
+   nir_block_worklist_init(&worklist, impl->num_blocks, NULL);
+
+   clear_live_range(def, &worklist);
+
+   nir_foreach_use(def, use_src) {
+      nir_instr *use = use_src->parent_instr;
+
+      if (use->type == nir_instr_type_phi) {
+         /* Phi sources are live out of the corresponding predecessor */
+         nir_foreach_phi_src(nir_instr_as_phi(use), phi_src) {
+            if (&phi_src->src == use_src) {
+               mark_live_out(phi_src->pred, def, &worklist);
+               break;
+            }
+         }
+      } else {
+         mark_live_in(use->block, def, &worklist);
+      }
+   }
+
+   nir_foreach_if_use(def, use_src) {
+      /* An if condition is read at the end of the block preceding the if */
+      nir_block *block =
+         nir_cf_node_as_block(nir_cf_node_prev(&use_src->parent_if->cf_node));
+      mark_live_in(block, def, &worklist);
+   }
+
+   while (!nir_block_worklist_is_empty(&worklist)) {
+      nir_block *block = nir_block_worklist_pop_head(&worklist);
+
+      struct set_entry *entry;
+      set_foreach(block->predecessors, entry)
+         mark_live_out((nir_block *)entry->key, def, &worklist);
+   }
+
+   nir_block_worklist_fini(&worklist);
+}
+
 static bool
 src_does_not_use_def(nir_src *src, void *def)
 {
@@ -130,15 +130,44 @@ init_block_cb(nir_block *block, void *_state)
    return true;
 }
 
+struct delete_state {
+   bool progress;
+
+   /* Live instructions' defs that lost a use, if liveness is kept valid */
+   struct set *shrunk_defs;
+};
+
+static bool
+add_shrunk_def_cb(nir_src *src, void *_state)
+{
+   struct delete_state *state = (struct delete_state *) _state;
+
+   if (src->is_ssa && src->ssa->parent_instr->pass_flags)
+      _mesa_set_add(state->shrunk_defs, src->ssa);
+
+   return true;
+}
+
+static bool
+clear_dead_def_cb(nir_ssa_def *def, void *_state)
+{
+   nir_live_ssa_def_clear(def);
+   return true;
+}
+
 static bool
 delete_block_cb(nir_block *block, void *_state)
 {
-   bool *progress = (bool *) _state;
+   struct delete_state *state = (struct delete_state *) _state;
 
    nir_foreach_instr_safe(block, instr) {
       if (!instr->pass_flags) {
+         if (state->shrunk_defs) {
+            nir_foreach_ssa_def(instr, clear_dead_def_cb, NULL);
+            nir_foreach_src(instr, add_shrunk_def_cb, state);
+         }
          nir_instr_remove(instr);
-         *progress = true;
+         state->progress = true;
       }
    }
 
@@ -160,14 +189,33 @@ nir_opt_dce_impl(nir_function_impl *impl)
 
    ralloc_free(worklist);
 
-   bool progress = false;
-   nir_foreach_block(impl, delete_block_cb, &progress);
+   /* Removing dead instructions only drops their own live ranges and
+    * shortens those of the values they read, so if liveness is around,
+    * patch up just those instead of making the next user recompute it from
+    * scratch.
+    */
+   struct delete_state state;
+   state.progress = false;
+   state.shrunk_defs = NULL;
+   if (impl->valid_metadata & nir_metadata_live_ssa_defs)
+      state.shrunk_defs = _mesa_set_create(NULL, _mesa_hash_pointer,
+                                           _mesa_key_pointer_equal);
+
+   nir_foreach_block(impl, delete_block_cb, &state);
+
+   if (state.shrunk_defs) {
+      struct set_entry *entry;
+      set_foreach(state.shrunk_defs, entry)
+         nir_live_ssa_def_update((nir_ssa_def *) entry->key);
+      _mesa_set_destroy(state.shrunk_defs, NULL);
+   }
 
-   if (progress)
+   if (state.progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_live_ssa_defs);
 
-   return progress;
+   return state.progress;
 }
 
 bool
@@ -0,0 +1,227 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <vector>
+#include "nir.h"
+#include "nir_builder.h"
+
+class nir_liveness_test : public ::testing::Test {
+protected:
+   nir_liveness_test();
+   ~nir_liveness_test();
+
+   void build_if_else();
+   std::vector<bool> get_liveness();
+
+   nir_builder b;
+   nir_variable *out;
+
+   nir_ssa_def *x;
+   nir_if *nif;
+};
+
+nir_liveness_test::nir_liveness_test()
+{
+   static const nir_shader_compiler_options options = { };
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_VERTEX, &options);
+
+   out = nir_variable_create(b.shader, nir_var_shader_out,
+                             glsl_float_type(), "out");
+}
+
+nir_liveness_test::~nir_liveness_test()
+{
+   ralloc_free(b.shader);
+}
+
+/* Creates IR:
+ *
+ * x = 1.0;
+ * if (1) { out = x + x; } else { out = x * x; }
+ *
+ * and leaves the cursor after the if.
+ */
+void
+nir_liveness_test::build_if_else()
+{
+   x = nir_imm_float(&b, 1.0f);
+   nir_ssa_def *c = nir_imm_int(&b, 1);
+
+   nif = nir_if_create(b.shader);
+   nif->condition = nir_src_for_ssa(c);
+   nir_builder_cf_insert(&b, &nif->cf_node);
+
+   b.cursor = nir_after_cf_list(&nif->then_list);
+   nir_store_var(&b, out, nir_fadd(&b, x, x), 1);
+
+   b.cursor = nir_after_cf_list(&nif->else_list);
+   nir_store_var(&b, out, nir_fmul(&b, x, x), 1);
+
+   b.cursor = nir_after_cf_node(&nif->cf_node);
+}
+
+struct liveness_snapshot {
+   std::vector<nir_block *> blocks;
+   std::vector<nir_ssa_def *> defs;
+};
+
+static bool
+add_def(nir_ssa_def *def, void *state)
+{
+   if (def->live_index != 0)
+      ((liveness_snapshot *) state)->defs.push_back(def);
+   return true;
+}
+
+static bool
+add_block(nir_block *block, void *state)
+{
+   ((liveness_snapshot *) state)->blocks.push_back(block);
+
+   nir_foreach_instr(block, instr)
+      nir_foreach_ssa_def(instr, add_def, state);
+
+   return true;
+}
+
+/* Returns the live in and live out bit of every def in every block, in a
+ * form that does not depend on which live indices were handed out.
+ */
+std::vector<bool>
+nir_liveness_test::get_liveness()
+{
+   liveness_snapshot snapshot;
+   nir_foreach_block(b.impl, add_block, &snapshot);
+
+   std::vector<bool> live;
+   for (nir_block *block : snapshot.blocks) {
+      for (nir_ssa_def *def : snapshot.defs) {
+         live.push_back(BITSET_TEST(block->live_in, def->live_index));
+         live.push_back(BITSET_TEST(block->live_out, def->live_index));
+      }
+   }
+   return live;
+}
+
+TEST_F(nir_liveness_test, dce_keeps_liveness_exact)
+{
+   build_if_else();
+
+   /* A dead use of x after the if, which DCE is going to remove */
+   nir_fadd(&b, x, x);
+
+   nir_metadata_require(b.impl, (nir_metadata) (nir_metadata_block_index |
+                                               nir_metadata_live_ssa_defs));
+
+   nir_block *then_block =
+      nir_cf_node_as_block(nir_if_first_then_node(nif));
+   EXPECT_TRUE(BITSET_TEST(then_block->live_out, x->live_index));
+
+   ASSERT_TRUE(nir_opt_dce(b.shader));
+   ASSERT_TRUE(b.impl->valid_metadata & nir_metadata_live_ssa_defs);
+   EXPECT_FALSE(BITSET_TEST(then_block->live_out, x->live_index));
+
+   std::vector<bool> incremental = get_liveness();
+
+   nir_live_ssa_defs_impl(b.impl);
+   EXPECT_EQ(get_liveness(), incremental);
+}
+
+TEST_F(nir_liveness_test, dce_in_loop_keeps_liveness_exact)
+{
+   x = nir_imm_float(&b, 1.0f);
+
+   /* x is read in the loop and by a dead instruction after it, so DCE
+    * shrinks its live range to end in the loop body.
+    */
+   nir_loop *loop = nir_loop_create(b.shader);
+   nir_builder_cf_insert(&b, &loop->cf_node);
+
+   b.cursor = nir_after_cf_list(&loop->body);
+   nir_store_var(&b, out, nir_fadd(&b, x, x), 1);
+   nir_jump_instr *brk = nir_jump_instr_create(b.shader, nir_jump_break);
+   nir_builder_instr_insert(&b, &brk->instr);
+
+   b.cursor = nir_after_cf_node(&loop->cf_node);
+   nir_fmul(&b, x, x);
+
+   nir_metadata_require(b.impl, (nir_metadata) (nir_metadata_block_index |
+                                               nir_metadata_live_ssa_defs));
+
+   nir_block *after_block =
+      nir_cf_node_as_block(nir_cf_node_next(&loop->cf_node));
+   EXPECT_TRUE(BITSET_TEST(after_block->live_in, x->live_index));
+
+   ASSERT_TRUE(nir_opt_dce(b.shader));
+   ASSERT_TRUE(b.impl->valid_metadata & nir_metadata_live_ssa_defs);
+   EXPECT_FALSE(BITSET_TEST(after_block->live_in, x->live_index));
+
+   std::vector<bool> incremental = get_liveness();
+
+   nir_live_ssa_defs_impl(b.impl);
+   EXPECT_EQ(get_liveness(), incremental);
+}
+
+TEST_F(nir_liveness_test, dce_clears_removed_defs)
+{
+   x = nir_imm_float(&b, 1.0f);
+
+   /* y is only read by a dead instruction in the then branch, so it is live
+    * into that branch until DCE removes both.
+    */
+   nir_ssa_def *y = nir_fadd(&b, x, x);
+   nir_ssa_def *c = nir_imm_int(&b, 1);
+
+   nif = nir_if_create(b.shader);
+   nif->condition = nir_src_for_ssa(c);
+   nir_builder_cf_insert(&b, &nif->cf_node);
+
+   b.cursor = nir_after_cf_list(&nif->then_list);
+   nir_fmul(&b, y, y);
+   nir_store_var(&b, out, x, 1);
+
+   b.cursor = nir_after_cf_node(&nif->cf_node);
+
+   nir_metadata_require(b.impl, (nir_metadata) (nir_metadata_block_index |
+                                               nir_metadata_live_ssa_defs));
+
+   nir_block *then_block =
+      nir_cf_node_as_block(nir_if_first_then_node(nif));
+   const unsigned y_index = y->live_index;
+   EXPECT_TRUE(BITSET_TEST(then_block->live_in, y_index));
+
+   ASSERT_TRUE(nir_opt_dce(b.shader));
+   ASSERT_TRUE(b.impl->valid_metadata & nir_metadata_live_ssa_defs);
+
+   liveness_snapshot snapshot;
+   nir_foreach_block(b.impl, add_block, &snapshot);
+   for (nir_block *block : snapshot.blocks) {
+      EXPECT_FALSE(BITSET_TEST(block->live_in, y_index));
+      EXPECT_FALSE(BITSET_TEST(block->live_out, y_index));
+   }
+
+   std::vector<bool> incremental = get_liveness();
+
+   nir_live_ssa_defs_impl(b.impl);
+   EXPECT_EQ(get_liveness(), incremental);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file test_type_contention.cpp
+ *
+ * Contention benchmark for the glsl_type interning tables.
+ *
+ * This file provides the "type_contention" command for the standalone
+ * glsl_test app.  Every thread looks up the same set of array, record and
+ * interface types over and over, the way concurrent compiles of similar
+ * shaders do.  The first round creates the types, the following rounds only
+ * hit the lock-free search path.  The time per lookup is printed, and the
+ * command fails if two threads were handed different types for the same
+ * key.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "c11/threads.h"
+#include "glsl_types.h"
+#include "test_type_contention.h"
+
+#define NUM_ARRAY_SIZES 64
+#define MAX_THREADS 64
+
+struct contention_thread {
+   thrd_t thread;
+   unsigned iterations;
+   const glsl_type *arrays[NUM_ARRAY_SIZES];
+   const glsl_type *record;
+   const glsl_type *interface;
+};
+
+static int64_t
+get_time_usec(void)
+{
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int
+contention_thread_func(void *data)
+{
+   struct contention_thread *t = (struct contention_thread *) data;
+   const glsl_struct_field fields[2] = {
+      glsl_struct_field(glsl_type::vec4_type, "position"),
+      glsl_struct_field(glsl_type::get_array_instance(glsl_type::mat4_type, 16),
+                        "bones"),
+   };
+
+   for (unsigned i = 0; i < t->iterations; i++) {
+      for (unsigned j = 0; j < NUM_ARRAY_SIZES; j++)
+         t->arrays[j] = glsl_type::get_array_instance(glsl_type::vec4_type,
+                                                      j + 1);
+
+      t->record = glsl_type::get_record_instance(fields, 2, "Vertex");
+      t->interface =
+         glsl_type::get_interface_instance(fields, 2,
+                                           GLSL_INTERFACE_PACKING_STD140,
+                                           "VertexBlock");
+   }
+
+   return 0;
+}
+
+int
+test_type_contention(int argc, char **argv)
+{
+   unsigned iterations = argc > 2 ? atoi(argv[2]) : 10000;
+   unsigned max_threads = argc > 1 ? atoi(argv[1]) : 8;
+   static struct contention_thread threads[MAX_THREADS];
+   bool ok = true;
+
+   if (max_threads < 1 || max_threads > MAX_THREADS || iterations < 1) {
+      printf("*** usage: %s type_contention [threads] [iterations]\n",
+             argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   printf("threads  lookups/thread  ns/lookup\n");
+
+   for (unsigned num_threads = 1; num_threads <= max_threads;
+        num_threads *= 2) {
+      const int64_t start = get_time_usec();
+
+      for (unsigned i = 0; i < num_threads; i++) {
+         threads[i].iterations = iterations;
+         if (thrd_create(&threads[i].thread, contention_thread_func,
+                         &threads[i]) != thrd_success) {
+            printf("can't create thread %u\n", i);
+
+            for (unsigned j = 0; j < i; j++)
+               thrd_join(threads[j].thread, NULL);
+            return EXIT_FAILURE;
+         }
+      }
+
+      for (unsigned i = 0; i < num_threads; i++)
+         thrd_join(threads[i].thread, NULL);
+
+      const int64_t elapsed = get_time_usec() - start;
+      const unsigned lookups = iterations * (NUM_ARRAY_SIZES + 2);
+
+      printf("%7u  %14u  %9.1f\n", num_threads, lookups,
+             elapsed * 1000.0 / lookups);
+
+      for (unsigned i = 1; i < num_threads; i++) {
+         if (memcmp(threads[i].arrays, threads[0].arrays,
+                    sizeof(threads[0].arrays)) != 0 ||
+             threads[i].record != threads[0].record ||
+             threads[i].interface != threads[0].interface) {
+            printf("thread %u got different types than thread 0\n", i);
+            ok = false;
+         }
+      }
+   }
+
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,6 +24,7 @@
 #if defined(GLX_DIRECT_RENDERING) && !defined(GLX_USE_APPLEGL)
 
 #include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
 #include "glxclient.h"
 #include <dlfcn.h>
 #include "dri_common.h"
@@ -73,12 +74,19 @@ XCreateDrawable(struct drisw_drawable * pdp,
   if (pdp->ximage->bits_per_pixel == 24)
      pdp->ximage->bits_per_pixel = 32;
 
+   pdp->shminfo.shmid = -1;
+
    return True;
 }
 
 static void
 XDestroyDrawable(struct drisw_drawable * pdp, Display * dpy, XID drawable)
 {
+   if (pdp->shminfo.shmid >= 0)
+      XShmDetach(dpy, &pdp->shminfo);
+   if (pdp->shm_ximage)
+      XDestroyImage(pdp->shm_ximage);
+
    XDestroyImage(pdp->ximage);
    free(pdp->visinfo);
 
@@ -176,6 +184,122 @@ swrastPutImage(__DRIdrawable * draw, int op,
    swrastPutImage2(draw, op, x, y, w, h, 0, data, loaderPrivate);
 }
 
+static volatile int XShmErrorFlag = 0;
+
+static int
+handle_xshm_error(Display *dpy, XErrorEvent *event)
+{
+   (void) dpy;
+   (void) event;
+   XShmErrorFlag = 1;
+   return 0;
+}
+
+/**
+ * Make sure the server has the driver's segment attached, and return false
+ * if it can't attach segments at all (e.g. on a remote display).
+ */
+static Bool
+swrastAttachShm(struct drisw_drawable *pdp, Display *dpy,
+                int shmid, char *shmaddr)
+{
+   int (*old_handler)(Display *, XErrorEvent *);
+
+   if (pdp->shm_failed)
+      return False;
+
+   if (pdp->shminfo.shmid == shmid && pdp->shminfo.shmaddr == shmaddr)
+      return True;
+
+   if (!pdp->shm_ximage) {
+      pdp->shm_ximage = XShmCreateImage(dpy, pdp->visinfo->visual,
+                                        pdp->visinfo->depth, ZPixmap, NULL,
+                                        &pdp->shminfo, 0, 0);
+      if (!pdp->shm_ximage) {
+         pdp->shm_failed = True;
+         return False;
+      }
+      if (pdp->shm_ximage->bits_per_pixel == 24)
+         pdp->shm_ximage->bits_per_pixel = 32;
+   }
+
+   /* The driver reallocated its back buffer; drop the old segment. */
+   if (pdp->shminfo.shmid >= 0)
+      XShmDetach(dpy, &pdp->shminfo);
+
+   pdp->shminfo.shmid = shmid;
+   pdp->shminfo.shmaddr = shmaddr;
+   pdp->shminfo.readOnly = True;
+
+   XShmErrorFlag = 0;
+   old_handler = XSetErrorHandler(handle_xshm_error);
+   /* This may trigger the X protocol error we're ready to catch: */
+   XShmAttach(dpy, &pdp->shminfo);
+   XSync(dpy, False);
+   (void) XSetErrorHandler(old_handler);
+
+   if (XShmErrorFlag) {
+      /* we are on a remote display, this error is normal, don't print it */
+      XShmErrorFlag = 0;
+      pdp->shminfo.shmid = -1;
+      pdp->shm_failed = True;
+      return False;
+   }
+
+   return True;
+}
+
+static void
+swrastPutImageShm(__DRIdrawable * draw, int op,
+                  int x, int y, int w, int h, int stride,
+                  int shmid, char *shmaddr, unsigned offset,
+                  void *loaderPrivate)
+{
+   struct drisw_drawable *pdp = loaderPrivate;
+   __GLXDRIdrawable *pdraw = &(pdp->base);
+   Display *dpy = pdraw->psc->dpy;
+   XImage *ximage;
+   GC gc;
+
+   if (!swrastAttachShm(pdp, dpy, shmid, shmaddr)) {
+      swrastPutImage2(draw, op, x, y, w, h, stride, shmaddr + offset,
+                      loaderPrivate);
+      return;
+   }
+
+   switch (op) {
+   case __DRI_SWRAST_IMAGE_OP_DRAW:
+      gc = pdp->gc;
+      break;
+   case __DRI_SWRAST_IMAGE_OP_SWAP:
+      gc = pdp->swapgc;
+      break;
+   default:
+      return;
+   }
+
+   /* Describe the segment from its start, and pick the sub-image by source
+    * position, since XShmPutImage() derives the offset in the segment from
+    * the image data pointer.
+    */
+   ximage = pdp->shm_ximage;
+   ximage->data = shmaddr;
+   ximage->bytes_per_line = stride;
+   ximage->width = stride * 8 / ximage->bits_per_pixel;
+   ximage->height = offset / stride + h;
+
+   XShmPutImage(dpy, pdraw->xDrawable, gc, ximage,
+                (offset % stride) * 8 / ximage->bits_per_pixel,
+                offset / stride, x, y, w, h, False);
+
+   /* The server reads the segment asynchronously, and the driver renders
+    * the next frame into the same memory as soon as we return.
+    */
+   XSync(dpy, False);
+
+   ximage->data = NULL;
+}
+
 static void
 swrastGetImage2(__DRIdrawable * read,
                 int x, int y, int w, int h, int stride,
@@ -218,12 +342,29 @@ static const __DRIswrastLoaderExtension swrastLoaderExtension = {
    .getImage2           = swrastGetImage2,
 };
 
+static const __DRIswrastLoaderExtension swrastLoaderExtension_shm = {
+   .base = {__DRI_SWRAST_LOADER, 4 },
+
+   .getDrawableInfo     = swrastGetDrawableInfo,
+   .putImage            = swrastPutImage,
+   .getImage            = swrastGetImage,
+   .putImage2           = swrastPutImage2,
+   .getImage2           = swrastGetImage2,
+   .putImageShm         = swrastPutImageShm,
+};
+
 static const __DRIextension *loader_extensions[] = {
    &systemTimeExtension.base,
    &swrastLoaderExtension.base,
    NULL
 };
 
+static const __DRIextension *loader_extensions_shm[] = {
+   &systemTimeExtension.base,
+   &swrastLoaderExtension_shm.base,
+   NULL
+};
+
 /**
  * GLXDRI functions
  */
@@ -655,6 +796,7 @@ driswCreateScreen(int screen, struct glx_display *priv)
    __GLXDRIscreen *psp;
    const __DRIconfig **driver_configs;
    const __DRIextension **extensions;
+   const __DRIextension **loader_exts = loader_extensions;
    struct drisw_screen *psc;
    struct glx_config *configs = NULL, *visuals = NULL;
    int i;
@@ -690,14 +832,20 @@ driswCreateScreen(int screen, struct glx_display *priv)
       goto handle_error;
    }
 
+   /* Let the driver put its back buffers in shared memory if the server
+    * might be able to attach them.
+    */
+   if (XShmQueryExtension(priv->dpy))
+      loader_exts = loader_extensions_shm;
+
    if (psc->swrast->base.version >= 4) {
       psc->driScreen =
-         psc->swrast->createNewScreen2(screen, loader_extensions,
+         psc->swrast->createNewScreen2(screen, loader_exts,
                                        extensions,
                                        &driver_configs, psc);
    } else {
       psc->driScreen =
-         psc->swrast->createNewScreen(screen, loader_extensions,
+         psc->swrast->createNewScreen(screen, loader_exts,
                                       &driver_configs, psc);
    }
    if (psc->driScreen == NULL) {
@@ -23,6 +23,8 @@
  * SOFTWARE.
  */
 
+#include <X11/extensions/XShm.h>
+
 struct drisw_display
 {
    __GLXDRIdisplay base;
@@ -62,6 +64,11 @@ struct drisw_drawable
    __DRIdrawable *driDrawable;
    XVisualInfo *visinfo;
    XImage *ximage;
+
+   /* MIT-SHM presents of the driver's shared memory back buffer */
+   XImage *shm_ximage;
+   XShmSegmentInfo shminfo;  /**< shmid is -1 if nothing is attached */
+   Bool shm_failed;          /**< the server can't attach our segments */
 };
 
 _X_HIDDEN int
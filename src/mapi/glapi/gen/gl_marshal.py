@@ -0,0 +1,409 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2016 The Mesa Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates the files marshal_generated.c and
+# marshal_generated.h, which contain the glthread command marshalling code:
+# for every GL function, a _mesa_marshal_* entry point that either records
+# the call in the current glthread batch or synchronizes with the worker
+# thread, the matching _mesa_unmarshal_* function executed by the worker,
+# and _mesa_create_marshal_table() that builds the client dispatch table.
+
+import argparse
+import license
+import gl_XML
+import marshal_XML
+
+
+header = """
+#include "api_exec.h"
+#include "context.h"
+#include "dispatch.h"
+#include "glthread.h"
+#include "marshal.h"
+#include "marshal_generated.h"
+"""
+
+
+current_indent = 0
+
+
+def out(str):
+    if str:
+        print ' '*current_indent + str
+    else:
+        print ''
+
+
+def indent(delta = 3):
+    global current_indent
+    current_indent += delta
+
+
+def outdent(delta = 3):
+    global current_indent
+    current_indent -= delta
+
+
+def base_type(p):
+    """C type of one element of a counted pointer parameter."""
+    t = p.get_base_type_string()
+    if t in ('GLvoid', 'void'):
+        return 'GLubyte'
+    return t
+
+
+def fixed_elements(p):
+    return p.count * p.count_scale
+
+
+def is_fixed_array(p):
+    return p.is_pointer() and p.count
+
+
+def variable_size(p, prefix = ''):
+    """C expression for the size in bytes of a variable length parameter,
+    or -1 if it would overflow or is negative."""
+    elem = 'sizeof({0})'.format(base_type(p))
+    if p.count_scale > 1:
+        elem = '{0} * {1}'.format(p.count_scale, elem)
+    return 'safe_mul({0}{1}, {2})'.format(prefix, p.counter, elem)
+
+
+def call_args(func):
+    return ', '.join(p.name for p in func.parameters if not p.is_padding)
+
+
+class PrintCode(gl_XML.gl_print_base):
+    def __init__(self):
+        super(PrintCode, self).__init__()
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2016 The Mesa Authors', 'THE AUTHORS')
+
+    def printRealHeader(self):
+        print header
+        print '#ifdef HAVE_PTHREAD'
+        print ''
+
+    def printRealFooter(self):
+        print ''
+        print '#endif /* HAVE_PTHREAD */'
+
+    def print_direct_call(self, func):
+        call = 'CALL_{0}(ctx->CurrentDispatch, ({1}))'.format(
+            func.name, call_args(func))
+        if func.return_type == 'void':
+            out('{0};'.format(call))
+        else:
+            out('{0} result = {1};'.format(func.return_type, call))
+
+    def print_marshal_fail(self, func):
+        if not func.marshal_fail:
+            return
+        out('if ({0}) {{'.format(func.marshal_fail))
+        indent()
+        out('_mesa_glthread_disable(ctx, "{0}");'.format(func.name))
+        if func.return_type == 'void':
+            self.print_direct_call(func)
+            out('return;')
+        else:
+            out('return CALL_{0}(ctx->CurrentDispatch, ({1}));'.format(
+                func.name, call_args(func)))
+        outdent()
+        out('}')
+
+    def print_sync_call(self, func):
+        out('_mesa_glthread_finish(ctx);')
+        self.print_direct_call(func)
+        out('_mesa_glthread_restore_dispatch(ctx);')
+        if func.marshal_call_after:
+            out(func.marshal_call_after)
+        if func.return_type != 'void':
+            out('return result;')
+
+    def print_sync_body(self, func):
+        out('/* {0}: marshalled synchronously */'.format(func.name))
+        out('static {0} GLAPIENTRY'.format(func.return_type))
+        out('_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string()))
+        out('{')
+        indent()
+        out('GET_CURRENT_CONTEXT(ctx);')
+        self.print_marshal_fail(func)
+        self.print_sync_call(func)
+        outdent()
+        out('}')
+        out('')
+
+    def print_async_struct(self, func):
+        out('/* {0}: marshalled asynchronously */'.format(func.name))
+        out('struct marshal_cmd_{0}'.format(func.name))
+        out('{')
+        indent()
+        out('struct marshal_cmd_base cmd_base;')
+        for p in func.fixed_params:
+            if is_fixed_array(p):
+                out('{0} {1}[{2}];'.format(
+                    base_type(p), p.name, fixed_elements(p)))
+            else:
+                out('{0} {1};'.format(p.type_string(), p.name))
+        for p in func.variable_params:
+            out('bool {0}_null; /* If set, no data follows for "{0}" */'.format(
+                p.name))
+        for p in func.variable_params:
+            out('/* Next {0} bytes are {1} {2}[{3}] */'.format(
+                variable_size(p), base_type(p), p.name, p.counter))
+        outdent()
+        out('};')
+
+    def print_async_unmarshal(self, func):
+        out('static inline void')
+        out(('_mesa_unmarshal_{0}(struct gl_context *ctx, '
+             'const struct marshal_cmd_{0} *cmd)').format(func.name))
+        out('{')
+        indent()
+        for p in func.fixed_params:
+            if is_fixed_array(p):
+                out('const {0} * {1} = cmd->{1};'.format(base_type(p), p.name))
+            elif p.is_pointer():
+                out('{0} {1} = cmd->{1};'.format(p.type_string(), p.name))
+            else:
+                out('const {0} {1} = cmd->{1};'.format(
+                    p.type_string(), p.name))
+        if func.variable_params:
+            for p in func.variable_params:
+                out('{0} {1};'.format(p.type_string(), p.name))
+            out('const char *variable_data = (const char *) (cmd + 1);')
+            for i, p in enumerate(func.variable_params):
+                out('{0} = cmd->{0}_null ? NULL : ({1}) variable_data;'.format(
+                    p.name, p.type_string()))
+                if i + 1 < len(func.variable_params):
+                    out('if (!cmd->{0}_null)'.format(p.name))
+                    out('   variable_data += {0};'.format(variable_size(p)))
+
+        out('CALL_{0}(ctx->CurrentDispatch, ({1}));'.format(
+            func.name, call_args(func)))
+        outdent()
+        out('}')
+
+    def print_async_copy(self, func):
+        for p in func.fixed_params:
+            if is_fixed_array(p):
+                out('memcpy(cmd->{0}, {0}, sizeof(cmd->{0}));'.format(p.name))
+            else:
+                out('cmd->{0} = {0};'.format(p.name))
+        if func.variable_params:
+            out('variable_data = (char *) (cmd + 1);')
+            for i, p in enumerate(func.variable_params):
+                out('cmd->{0}_null = !{0};'.format(p.name))
+                out('if (!cmd->{0}_null) {{'.format(p.name))
+                indent()
+                out('memcpy(variable_data, {0}, {0}_size);'.format(p.name))
+                if i + 1 < len(func.variable_params):
+                    out('variable_data += {0}_size;'.format(p.name))
+                outdent()
+                out('}')
+        if func.marshal_call_after:
+            out(func.marshal_call_after)
+
+    def print_async_marshal(self, func):
+        out('static void GLAPIENTRY')
+        out('_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string()))
+        out('{')
+        indent()
+        out('GET_CURRENT_CONTEXT(ctx);')
+        for p in func.variable_params:
+            out('int64_t {0}_size = {0} ? {1} : 0;'.format(
+                p.name, variable_size(p)))
+        if not func.fixed_params and not func.variable_params:
+            self.print_marshal_fail(func)
+            out(('_mesa_glthread_allocate_command(ctx, DISPATCH_CMD_{0}, '
+                 'sizeof(struct marshal_cmd_{0}));').format(func.name))
+            self.print_async_copy(func)
+            outdent()
+            out('}')
+            return
+        out('struct marshal_cmd_{0} *cmd;'.format(func.name))
+        if func.variable_params:
+            out('size_t cmd_size;')
+            out('char *variable_data;')
+        self.print_marshal_fail(func)
+
+        if not func.variable_params:
+            # Fixed size commands always fit in a batch.
+            out(('cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_{0}, '
+                 'sizeof(*cmd));').format(func.name))
+            self.print_async_copy(func)
+            outdent()
+            out('}')
+            return
+
+        # Negative or overflowing sizes, and commands that don't fit in a
+        # batch, are executed directly so that errors are reported by the
+        # usual code.
+        conditions = ['{0}_size >= 0'.format(p.name)
+                      for p in func.variable_params]
+        out('if ({0}) {{'.format(' && '.join(conditions)))
+        indent()
+        size_terms = ['sizeof(*cmd)']
+        size_terms.extend('{0}_size'.format(p.name)
+                          for p in func.variable_params)
+        out('cmd_size = {0};'.format(' + '.join(size_terms)))
+        out('if (cmd_size <= MARSHAL_MAX_CMD_SIZE) {')
+        indent()
+        out(('cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_{0}, '
+             'cmd_size);').format(func.name))
+        self.print_async_copy(func)
+        out('return;')
+        outdent()
+        out('}')
+        outdent()
+        out('}')
+        out('')
+        self.print_sync_call(func)
+        outdent()
+        out('}')
+
+    def print_async_body(self, func):
+        self.print_async_struct(func)
+        out('')
+        self.print_async_unmarshal(func)
+        self.print_async_marshal(func)
+        out('')
+
+    def print_unmarshal_dispatch_cmd(self, api):
+        out('size_t')
+        out('_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, '
+            'const void *cmd)')
+        out('{')
+        indent()
+        out('const struct marshal_cmd_base *cmd_base = cmd;')
+        out('switch (cmd_base->cmd_id) {')
+        for func in api.functionIterateByOffset():
+            if func.marshal_flavor() != 'async':
+                continue
+            out('case DISPATCH_CMD_{0}:'.format(func.name))
+            indent()
+            out(('_mesa_unmarshal_{0}(ctx, (const struct marshal_cmd_{0} *)'
+                 ' cmd);').format(func.name))
+            out('break;')
+            outdent()
+        out('default:')
+        indent()
+        out('assert(!"Unrecognized command ID");')
+        out('break;')
+        outdent()
+        out('}')
+        out('')
+        out('return cmd_base->cmd_size;')
+        outdent()
+        out('}')
+        out('')
+        out('')
+
+    def print_create_marshal_table(self, api):
+        out('struct _glapi_table *')
+        out('_mesa_create_marshal_table(void)')
+        out('{')
+        indent()
+        out('struct _glapi_table *table;')
+        out('')
+        out('table = _mesa_alloc_dispatch_table();')
+        out('if (table == NULL)')
+        out('   return NULL;')
+        out('')
+        for func in api.functionIterateByOffset():
+            if func.marshal_flavor() == 'skip':
+                continue
+            out('SET_{0}(table, _mesa_marshal_{0});'.format(func.name))
+        out('')
+        out('return table;')
+        outdent()
+        out('}')
+        out('')
+
+    def printBody(self, api):
+        for func in api.functionIterateByOffset():
+            flavor = func.marshal_flavor()
+            if flavor == 'skip':
+                continue
+            elif flavor == 'async':
+                self.print_async_body(func)
+            elif flavor == 'sync':
+                self.print_sync_body(func)
+            else:
+                raise Exception('Unrecognized marshal flavor {0!r} for {1}'
+                                .format(flavor, func.name))
+        self.print_unmarshal_dispatch_cmd(api)
+        self.print_create_marshal_table(api)
+
+
+class PrintHeader(gl_XML.gl_print_base):
+    def __init__(self):
+        super(PrintHeader, self).__init__()
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2016 The Mesa Authors', 'THE AUTHORS')
+        self.header_tag = 'MARSHAL_GENERATED_H'
+
+    def printBody(self, api):
+        print 'enum marshal_dispatch_cmd_id'
+        print '{'
+        for func in api.functionIterateByOffset():
+            if func.marshal_flavor() == 'async':
+                print '   DISPATCH_CMD_{0},'.format(func.name)
+        print '   NUM_DISPATCH_CMD'
+        print '};'
+
+
+def _parser():
+    """Parse arguments and return namespace."""
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f',
+                        dest='filename',
+                        default='gl_and_es_API.xml',
+                        help='an xml file describing an API')
+    parser.add_argument('-m',
+                        dest='mode',
+                        choices=['code', 'header'],
+                        default='code',
+                        help='generate the .c (code) or .h (header) file')
+    return parser.parse_args()
+
+
+def main():
+    """Main function."""
+    args = _parser()
+    if args.mode == 'header':
+        printer = PrintHeader()
+    else:
+        printer = PrintCode()
+    api = gl_XML.parse_GL_API(args.filename, marshal_XML.marshal_item_factory())
+    printer.Print(api)
+
+
+if __name__ == '__main__':
+    main()
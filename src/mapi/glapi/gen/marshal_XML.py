@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2016 The Mesa Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This file contains helper functions for interpreting the XML annotations
+# used by the glthread command marshalling code (gl_marshal.py).
+
+import gl_XML
+
+
+class marshal_item_factory(gl_XML.gl_item_factory):
+    """Factory to create objects derived from gl_item containing
+    information necessary to generate thread marshalling code."""
+
+    def create_function(self, element, context):
+        return marshal_function(element, context)
+
+
+class marshal_function(gl_XML.gl_function):
+    def __init__(self, element, context):
+        self.marshal = None
+        self.marshal_fail = None
+        self.marshal_call_after = None
+
+        gl_XML.gl_function.__init__(self, element, context)
+
+
+    def process_element(self, element):
+        # Do normal processing.
+        super(marshal_function, self).process_element(element)
+
+        # Only the annotations of the function itself (not of its aliases)
+        # are taken into account.
+        if element.get('name') != self.name:
+            return
+
+        # Classify fixed and variable parameters.
+        self.fixed_params = []
+        self.variable_params = []
+        for p in self.parameters:
+            if p.is_padding:
+                continue
+            if p.is_variable_length():
+                self.variable_params.append(p)
+            else:
+                self.fixed_params.append(p)
+
+        # Store the "marshal" attribute, if present.
+        self.marshal = element.get('marshal')
+        self.marshal_fail = element.get('marshal_fail')
+        self.marshal_call_after = element.get('marshal_call_after')
+
+
+    def marshal_flavor(self):
+        """Find out how this function should be marshalled between
+        client and server threads.
+
+        'skip' means the function is not put in the marshal table.
+        'sync' means the client thread waits for the server thread to
+        become idle and then calls the function directly.
+        'async' means the parameters are copied into the command buffer
+        and the function is executed later by the server thread.
+        """
+        # If a "marshal" attribute was present, that overrides any
+        # determination that would otherwise be made by this function.
+        if self.marshal is not None:
+            return self.marshal
+
+        if self.exec_flavor == 'skip':
+            # Functions marked exec="skip" are not yet implemented in
+            # Mesa, so don't bother trying to marshal them.
+            return 'skip'
+
+        if self.return_type != 'void':
+            return 'sync'
+
+        for p in self.parameters:
+            if p.is_output:
+                return 'sync'
+            if not p.is_pointer():
+                continue
+            if p.count_parameter_list:
+                # The size depends on an enum; we can't compute it.
+                return 'sync'
+            if not p.type_string().startswith('const '):
+                # The function may write through the pointer.
+                return 'sync'
+            if p.type_string().count('*') > 1:
+                # Pointers to client pointers can't be copied.
+                return 'sync'
+            if not p.count and not p.counter:
+                # An unknown amount of client memory is read.
+                return 'sync'
+        return 'async'
@@ -34,6 +34,7 @@
 #include "main/api_exec.h"
 #include "main/context.h"
 #include "main/fbobject.h"
+#include "main/glthread.h"
 #include "main/extensions.h"
 #include "main/imports.h"
 #include "main/macros.h"
@@ -990,6 +991,10 @@ brwCreateContext(gl_api api,
    vbo_use_buffer_objects(ctx);
    vbo_always_unmap_buffers(ctx);
 
+   /* Do this last, once the context is fully initialized. */
+   if (driQueryOptionb(&brw->optionCache, "mesa_glthread"))
+      _mesa_glthread_init(ctx);
+
    return true;
 }
 
@@ -1000,6 +1005,9 @@ intelDestroyContext(__DRIcontext * driContextPriv)
       (struct brw_context *) driContextPriv->driverPrivate;
    struct gl_context *ctx = &brw->ctx;
 
+   /* The worker thread must be gone before the context is torn down. */
+   _mesa_glthread_destroy(ctx);
+
    /* Dump a final BMP in case the application doesn't call SwapBuffers */
    if (INTEL_DEBUG & DEBUG_AUB) {
       intel_batchbuffer_flush(brw);
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include "main/context.h"
 #include "main/framebuffer.h"
+#include "main/glthread.h"
 #include "main/renderbuffer.h"
 #include "main/texobj.h"
 #include "main/hash.h"
@@ -60,6 +61,8 @@ DRI_CONF_BEGIN
       DRI_CONF_OPT_BEGIN_B(hiz, "true")
 	 DRI_CONF_DESC(en, "Enable Hierarchical Z on gen6+")
       DRI_CONF_OPT_END
+
+      DRI_CONF_MESA_GLTHREAD("false")
    DRI_CONF_SECTION_END
 
    DRI_CONF_SECTION_QUALITY
@@ -168,6 +171,8 @@ intel_dri2_flush_with_flags(__DRIcontext *cPriv,
 
    struct gl_context *ctx = &brw->ctx;
 
+   _mesa_glthread_finish(ctx);
+
    FLUSH_VERTICES(ctx, 0);
 
    if (flags & __DRI2_FLUSH_DRAWABLE)
@@ -38,6 +38,7 @@
  * performance bottleneck, though.
  */
 
+#include "main/glthread.h"
 #include "main/imports.h"
 
 #include "brw_context.h"
@@ -214,6 +215,7 @@ intel_dri_create_fence(__DRIcontext *ctx)
    if (!fence)
       return NULL;
 
+   _mesa_glthread_finish(&brw->ctx);
    brw_fence_insert(brw, fence);
 
    return fence;
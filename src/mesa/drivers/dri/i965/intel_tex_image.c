@@ -5,6 +5,7 @@
 #include "main/bufferobj.h"
 #include "main/context.h"
 #include "main/formats.h"
+#include "main/glthread.h"
 #include "main/image.h"
 #include "main/pbo.h"
 #include "main/renderbuffer.h"
@@ -213,6 +214,8 @@ intelSetTexBuffer2(__DRIcontext *pDRICtx, GLint target,
    int level = 0, internalFormat = 0;
    mesa_format texFormat = MESA_FORMAT_NONE;
 
+   _mesa_glthread_finish(ctx);
+
    texObj = _mesa_get_current_tex_object(ctx, target);
 
    if (!texObj)
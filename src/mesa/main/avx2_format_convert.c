@@ -0,0 +1,232 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/avx2_format_convert.h"
+#include "main/formats.h"
+#include "util/half_float.h"
+#include <immintrin.h>
+#include <string.h>
+
+/**
+ * Build the VPSHUFB control applying \p swizzle to each of the eight 4-byte
+ * pixels of a register, and the value to OR in afterwards for
+ * MESA_FORMAT_SWIZZLE_ONE channels.
+ */
+static void
+build_ubyte4_shuffle(const uint8_t swizzle[4], uint8_t one,
+                     __m256i *shuffle, __m256i *ones)
+{
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   unsigned p, c;
+
+   for (p = 0; p < 4; p++) {
+      for (c = 0; c < 4; c++) {
+         if (swizzle[c] <= MESA_FORMAT_SWIZZLE_W) {
+            shuffle_bytes[p * 4 + c] = p * 4 + swizzle[c];
+            ones_bytes[p * 4 + c] = 0;
+         } else {
+            shuffle_bytes[p * 4 + c] = 0x80;
+            ones_bytes[p * 4 + c] =
+               swizzle[c] == MESA_FORMAT_SWIZZLE_ONE ? one : 0;
+         }
+      }
+   }
+
+   /* VPSHUFB shuffles within each 128-bit lane, which never splits a
+    * pixel, so both lanes use the same control.
+    */
+   *shuffle = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *) shuffle_bytes));
+   *ones = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *) ones_bytes));
+}
+
+static inline __m128i
+load_pixel(const void *src)
+{
+   int32_t pixel;
+
+   memcpy(&pixel, src, sizeof(pixel));
+   return _mm_cvtsi32_si128(pixel);
+}
+
+static inline void
+store_pixel(void *dst, __m128i v)
+{
+   const int32_t pixel = _mm_cvtsi128_si32(v);
+
+   memcpy(dst, &pixel, sizeof(pixel));
+}
+
+static inline __m128i
+swizzle_pixel(__m128i px, __m256i shuffle, __m256i ones)
+{
+   return _mm_or_si128(_mm_shuffle_epi8(px, _mm256_castsi256_si128(shuffle)),
+                       _mm256_castsi256_si128(ones));
+}
+
+void
+_mesa_avx2_swizzle_ubyte4(uint8_t *dst, const uint8_t *src,
+                          const uint8_t swizzle[4], uint8_t one,
+                          unsigned count)
+{
+   __m256i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, one, &shuffle, &ones);
+
+   for (; i + 8 <= count; i += 8) {
+      __m256i px = _mm256_loadu_si256((const __m256i *) &src[i * 4]);
+      px = _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) &dst[i * 4], px);
+   }
+
+   for (; i < count; i++)
+      store_pixel(&dst[i * 4],
+                  swizzle_pixel(load_pixel(&src[i * 4]), shuffle, ones));
+}
+
+void
+_mesa_avx2_ubyte4_to_float4(float *dst, const uint8_t *src,
+                            const uint8_t swizzle[4], bool normalized,
+                            unsigned count)
+{
+   /* Same expression as _mesa_unorm_to_float(). */
+   const __m256 scale = _mm256_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+   __m256i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, normalized ? 255 : 1, &shuffle, &ones);
+
+   for (; i + 8 <= count; i += 8) {
+      __m256i px = _mm256_loadu_si256((const __m256i *) &src[i * 4]);
+      __m128i half;
+      unsigned p;
+
+      px = _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), ones);
+
+      /* Two pixels per conversion. */
+      for (p = 0; p < 8; p += 2) {
+         __m256 f;
+
+         half = p < 4 ? _mm256_castsi256_si128(px) :
+                        _mm256_extracti128_si256(px, 1);
+         if (p & 2)
+            half = _mm_srli_si128(half, 8);
+
+         f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(half));
+         _mm256_storeu_ps(&dst[(i + p) * 4], _mm256_mul_ps(f, scale));
+      }
+   }
+
+   for (; i < count; i++) {
+      const __m128i px = swizzle_pixel(load_pixel(&src[i * 4]),
+                                       shuffle, ones);
+      const __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(px));
+
+      _mm_storeu_ps(&dst[i * 4], _mm_mul_ps(f, _mm256_castps256_ps128(scale)));
+   }
+}
+
+/**
+ * Equivalent of _mesa_float_to_unorm(x, 8): MAXPS returns its second
+ * operand when the first is NaN, and CVTPS2DQ rounds to nearest even.
+ */
+static inline __m256i
+float8_to_unorm8(__m256 f)
+{
+   f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()),
+                     _mm256_set1_ps(1.0f));
+   return _mm256_cvtps_epi32(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)));
+}
+
+void
+_mesa_avx2_float4_to_unorm8_4(uint8_t *dst, const float *src,
+                              const uint8_t swizzle[4], unsigned count)
+{
+   /* The in-lane packs leave pixel 2*k in lane 0 and pixel 2*k+1 in lane 1
+    * of each dword position k; this puts them back in order.
+    */
+   const __m256i unpermute = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+   __m256i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, 255, &shuffle, &ones);
+
+   for (; i + 8 <= count; i += 8) {
+      const __m256i p01 = float8_to_unorm8(_mm256_loadu_ps(&src[i * 4 + 0]));
+      const __m256i p23 = float8_to_unorm8(_mm256_loadu_ps(&src[i * 4 + 8]));
+      const __m256i p45 = float8_to_unorm8(_mm256_loadu_ps(&src[i * 4 + 16]));
+      const __m256i p67 = float8_to_unorm8(_mm256_loadu_ps(&src[i * 4 + 24]));
+      __m256i px = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23),
+                                       _mm256_packus_epi32(p45, p67));
+
+      px = _mm256_permutevar8x32_epi32(px, unpermute);
+      px = _mm256_or_si256(_mm256_shuffle_epi8(px, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) &dst[i * 4], px);
+   }
+
+   for (; i < count; i++) {
+      __m128 f = _mm_loadu_ps(&src[i * 4]);
+      __m128i p;
+
+      f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+      p = _mm_cvtps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.0f)));
+      p = _mm_packus_epi16(_mm_packus_epi32(p, p), p);
+      store_pixel(&dst[i * 4], swizzle_pixel(p, shuffle, ones));
+   }
+}
+
+/* F16C converts with round-to-nearest-even and keeps denormals, like
+ * _mesa_float_to_half() and _mesa_half_to_float(); only NaN payloads may
+ * differ.
+ */
+
+void
+_mesa_avx2_half_to_float(float *dst, const uint16_t *src, unsigned count)
+{
+   unsigned i = 0;
+
+   for (; i + 8 <= count; i += 8) {
+      const __m128i h = _mm_loadu_si128((const __m128i *) &src[i]);
+      _mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(h));
+   }
+
+   for (; i < count; i++)
+      dst[i] = _mesa_half_to_float(src[i]);
+}
+
+void
+_mesa_avx2_float_to_half(uint16_t *dst, const float *src, unsigned count)
+{
+   unsigned i = 0;
+
+   for (; i + 8 <= count; i += 8) {
+      const __m256 f = _mm256_loadu_ps(&src[i]);
+      _mm_storeu_si128((__m128i *) &dst[i],
+                       _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+   }
+
+   for (; i < count; i++)
+      dst[i] = _mesa_float_to_half(src[i]);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* AVX2 and F16C versions of the kernels in sse_format_convert.h, plus
+ * half <-> float conversion of arrays of channels.
+ */
+
+#ifndef AVX2_FORMAT_CONVERT_H
+#define AVX2_FORMAT_CONVERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void
+_mesa_avx2_swizzle_ubyte4(uint8_t *dst, const uint8_t *src,
+                          const uint8_t swizzle[4], uint8_t one,
+                          unsigned count);
+
+void
+_mesa_avx2_ubyte4_to_float4(float *dst, const uint8_t *src,
+                            const uint8_t swizzle[4], bool normalized,
+                            unsigned count);
+
+void
+_mesa_avx2_float4_to_unorm8_4(uint8_t *dst, const float *src,
+                              const uint8_t swizzle[4], unsigned count);
+
+/* These need F16C in addition to AVX2. */
+void
+_mesa_avx2_half_to_float(float *dst, const uint16_t *src, unsigned count);
+
+void
+_mesa_avx2_float_to_half(uint16_t *dst, const float *src, unsigned count);
+
+#endif /* AVX2_FORMAT_CONVERT_H */
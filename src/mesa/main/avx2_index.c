@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "main/avx2_index.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+static inline __m256i
+splat(unsigned value, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm256_set1_epi8(value);
+   case 2:
+      return _mm256_set1_epi16(value);
+   default:
+      return _mm256_set1_epi32(value);
+   }
+}
+
+static inline __m256i
+cmpeq(__m256i a, __m256i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm256_cmpeq_epi8(a, b);
+   case 2:
+      return _mm256_cmpeq_epi16(a, b);
+   default:
+      return _mm256_cmpeq_epi32(a, b);
+   }
+}
+
+static inline unsigned
+read_index(const uint8_t *indices, unsigned i, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return indices[i];
+   case 2:
+      return ((const uint16_t *) indices)[i];
+   default:
+      return ((const uint32_t *) indices)[i];
+   }
+}
+
+/* Same as the SSE 4.1 version, on 128 bytes per iteration. */
+static inline unsigned
+find_index(const uint8_t *indices, unsigned index_size,
+           unsigned i, unsigned end, unsigned value)
+{
+   const unsigned per_vec = 32 / index_size;
+   const __m256i v = splat(value, index_size);
+
+   for (; i + 4 * per_vec <= end; i += 4 * per_vec) {
+      const __m256i *p = (const __m256i *) &indices[i * index_size];
+      const __m256i eq0 = cmpeq(_mm256_loadu_si256(p + 0), v, index_size);
+      const __m256i eq1 = cmpeq(_mm256_loadu_si256(p + 1), v, index_size);
+      const __m256i eq2 = cmpeq(_mm256_loadu_si256(p + 2), v, index_size);
+      const __m256i eq3 = cmpeq(_mm256_loadu_si256(p + 3), v, index_size);
+
+      if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(eq0, eq1),
+                                               _mm256_or_si256(eq2, eq3))))
+         break;
+   }
+
+   for (; i + per_vec <= end; i += per_vec) {
+      const __m256i *p = (const __m256i *) &indices[i * index_size];
+      const unsigned mask =
+         _mm256_movemask_epi8(cmpeq(_mm256_loadu_si256(p), v, index_size));
+
+      if (mask)
+         return i + __builtin_ctz(mask) / index_size;
+   }
+
+   for (; i < end; i++) {
+      if (read_index(indices, i, index_size) == value)
+         return i;
+   }
+
+   return end;
+}
+
+unsigned
+_mesa_avx2_find_index(const void *indices, unsigned index_size,
+                      unsigned start, unsigned end, unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      return find_index(indices, 1, start, end, value);
+   case 2:
+      return find_index(indices, 2, start, end, value);
+   default:
+      return find_index(indices, 4, start, end, value);
+   }
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/avx2_minmax.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+/* Unaligned 256-bit loads cost the same as aligned ones on every AVX2 part
+ * when the data happens to be aligned, so unlike the SSE 4.1 version there
+ * is no scalar prologue.
+ */
+
+void
+_mesa_avx2_uint_array_min_max(const unsigned *ui_indices,
+                              unsigned *min_index, unsigned *max_index,
+                              const unsigned count)
+{
+   unsigned max_ui = 0;
+   unsigned min_ui = ~0U;
+   unsigned i = 0;
+
+   if (count >= 16) {
+      unsigned max_arr[8] __attribute__ ((aligned (32)));
+      unsigned min_arr[8] __attribute__ ((aligned (32)));
+      const unsigned vec_count = count & ~0x7;
+      __m256i max_ui8 = _mm256_setzero_si256();
+      __m256i min_ui8 = _mm256_set1_epi32(~0U);
+
+      for (; i < vec_count; i += 8) {
+         const __m256i ui_indices8 =
+            _mm256_loadu_si256((const __m256i *) &ui_indices[i]);
+         max_ui8 = _mm256_max_epu32(ui_indices8, max_ui8);
+         min_ui8 = _mm256_min_epu32(ui_indices8, min_ui8);
+      }
+
+      _mm256_store_si256((__m256i *) max_arr, max_ui8);
+      _mm256_store_si256((__m256i *) min_arr, min_ui8);
+
+      for (unsigned j = 0; j < 8; j++) {
+         if (max_arr[j] > max_ui)
+            max_ui = max_arr[j];
+         if (min_arr[j] < min_ui)
+            min_ui = min_arr[j];
+      }
+   }
+
+   for (; i < count; i++) {
+      if (ui_indices[i] > max_ui)
+         max_ui = ui_indices[i];
+      if (ui_indices[i] < min_ui)
+         min_ui = ui_indices[i];
+   }
+
+   *min_index = min_ui;
+   *max_index = max_ui;
+}
+
+void
+_mesa_avx2_ushort_array_min_max(const unsigned short *us_indices,
+                                unsigned *min_index, unsigned *max_index,
+                                const unsigned count)
+{
+   unsigned max_us = 0;
+   unsigned min_us = ~0U;
+   unsigned i = 0;
+
+   if (count >= 32) {
+      uint16_t max_arr[16] __attribute__ ((aligned (32)));
+      uint16_t min_arr[16] __attribute__ ((aligned (32)));
+      const unsigned vec_count = count & ~0xf;
+      __m256i max_us16 = _mm256_setzero_si256();
+      __m256i min_us16 = _mm256_set1_epi16(-1);
+
+      for (; i < vec_count; i += 16) {
+         const __m256i us_indices16 =
+            _mm256_loadu_si256((const __m256i *) &us_indices[i]);
+         max_us16 = _mm256_max_epu16(us_indices16, max_us16);
+         min_us16 = _mm256_min_epu16(us_indices16, min_us16);
+      }
+
+      _mm256_store_si256((__m256i *) max_arr, max_us16);
+      _mm256_store_si256((__m256i *) min_arr, min_us16);
+
+      for (unsigned j = 0; j < 16; j++) {
+         if (max_arr[j] > max_us)
+            max_us = max_arr[j];
+         if (min_arr[j] < min_us)
+            min_us = min_arr[j];
+      }
+   }
+
+   for (; i < count; i++) {
+      if (us_indices[i] > max_us)
+         max_us = us_indices[i];
+      if (us_indices[i] < min_us)
+         min_us = us_indices[i];
+   }
+
+   *min_index = min_us;
+   *max_index = max_us;
+}
+
+void
+_mesa_avx2_ubyte_array_min_max(const unsigned char *ub_indices,
+                               unsigned *min_index, unsigned *max_index,
+                               const unsigned count)
+{
+   unsigned max_ub = 0;
+   unsigned min_ub = ~0U;
+   unsigned i = 0;
+
+   if (count >= 64) {
+      uint8_t max_arr[32] __attribute__ ((aligned (32)));
+      uint8_t min_arr[32] __attribute__ ((aligned (32)));
+      const unsigned vec_count = count & ~0x1f;
+      __m256i max_ub32 = _mm256_setzero_si256();
+      __m256i min_ub32 = _mm256_set1_epi8(-1);
+
+      for (; i < vec_count; i += 32) {
+         const __m256i ub_indices32 =
+            _mm256_loadu_si256((const __m256i *) &ub_indices[i]);
+         max_ub32 = _mm256_max_epu8(ub_indices32, max_ub32);
+         min_ub32 = _mm256_min_epu8(ub_indices32, min_ub32);
+      }
+
+      _mm256_store_si256((__m256i *) max_arr, max_ub32);
+      _mm256_store_si256((__m256i *) min_arr, min_ub32);
+
+      for (unsigned j = 0; j < 32; j++) {
+         if (max_arr[j] > max_ub)
+            max_ub = max_arr[j];
+         if (min_arr[j] < min_ub)
+            min_ub = min_arr[j];
+      }
+   }
+
+   for (; i < count; i++) {
+      if (ub_indices[i] > max_ub)
+         max_ub = ub_indices[i];
+      if (ub_indices[i] < min_ub)
+         min_ub = ub_indices[i];
+   }
+
+   *min_index = min_ub;
+   *max_index = max_ub;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "main/avx2_mipmap.h"
+#include "util/half_float.h"
+#include <immintrin.h>
+
+static inline __m256
+load_half8(const uint16_t *src)
+{
+   return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) src));
+}
+
+/**
+ * Gather the left (\p j) and right (\p k) texels of the blocks of the 16
+ * channels in \p lo and \p hi.
+ */
+static inline void
+split_blocks(__m256 lo, __m256 hi, unsigned comps, __m256 *j, __m256 *k)
+{
+   if (comps == 4) {
+      *j = _mm256_permute2f128_ps(lo, hi, 0x20);
+      *k = _mm256_permute2f128_ps(lo, hi, 0x31);
+   } else {
+      /* Shuffles work within 128-bit lanes, so the 64-bit quarters come out
+       * in 0, 2, 1, 3 order.
+       */
+      const __m256 j4 = comps == 2 ?
+         _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(1, 0, 1, 0)) :
+         _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+      const __m256 k4 = comps == 2 ?
+         _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 2, 3, 2)) :
+         _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+
+      *j = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(j4),
+                                                  _MM_SHUFFLE(3, 1, 2, 0)));
+      *k = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(k4),
+                                                  _MM_SHUFFLE(3, 1, 2, 0)));
+   }
+}
+
+/* F16C rounds to nearest even like _mesa_float_to_half(), so the results
+ * match do_row() except for NaN payloads.
+ */
+
+void
+_mesa_avx2_downsample_half(uint16_t *dst, const uint16_t *rowA,
+                           const uint16_t *rowB, unsigned comps,
+                           unsigned dst_width)
+{
+   const unsigned n = dst_width * comps;
+   const __m256 quarter = _mm256_set1_ps(0.25F);
+   unsigned i = 0;
+
+   for (; i + 8 <= n; i += 8) {
+      __m256 aj, ak, bj, bk, sum;
+
+      split_blocks(load_half8(&rowA[2 * i]), load_half8(&rowA[2 * i + 8]),
+                   comps, &aj, &ak);
+      split_blocks(load_half8(&rowB[2 * i]), load_half8(&rowB[2 * i + 8]),
+                   comps, &bj, &bk);
+
+      sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(aj, ak), bj), bk);
+      _mm_storeu_si128((__m128i *) &dst[i],
+                       _mm256_cvtps_ph(_mm256_mul_ps(sum, quarter),
+                                       _MM_FROUND_TO_NEAREST_INT));
+   }
+
+   for (; i < n; i++) {
+      const unsigned j = 2 * i - i % comps;
+      const float sum = _mesa_half_to_float(rowA[j]) +
+                        _mesa_half_to_float(rowA[j + comps]) +
+                        _mesa_half_to_float(rowB[j]) +
+                        _mesa_half_to_float(rowB[j + comps]);
+
+      dst[i] = _mesa_float_to_half(sum * 0.25F);
+   }
+}
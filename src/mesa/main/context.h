@@ -122,6 +122,9 @@ _mesa_create_context(gl_api api,
 extern void
 _mesa_free_context_data( struct gl_context *ctx );
 
+extern struct _glapi_table *
+_mesa_alloc_dispatch_table(void);
+
 extern void
 _mesa_destroy_context( struct gl_context *ctx );
 
@@ -66,6 +66,7 @@
 #include "transformfeedback.h"
 
 #include "math/m_matrix.h"
+#include "util/debug.h"
 
 #include "main/dispatch.h"
 
@@ -1205,6 +1206,260 @@ trim_list(struct gl_context *ctx)
 }
 
 
+/**
+ * \name Vertex list merging
+ *
+ * At glEndList time, runs of vertex lists and the attribute commands
+ * (glColor, glNormal, ...) between them are replaced by single indexed
+ * vertex lists.  See vbo_save_merge.c.
+ */
+/*@{*/
+
+static GLuint
+instruction_size(const struct gl_context *ctx, OpCode opcode)
+{
+   if (is_ext_opcode(opcode))
+      return ctx->ListExt->Opcode[opcode - OPCODE_EXT_0].Size;
+   return InstSize[opcode];
+}
+
+
+/**
+ * If \p n sets a single float attribute, return which one and its size.
+ */
+static GLboolean
+get_attr_instruction(const Node *n, GLuint *attr, GLuint *size)
+{
+   switch (n[0].opcode) {
+   case OPCODE_ATTR_1F_NV:
+   case OPCODE_ATTR_2F_NV:
+   case OPCODE_ATTR_3F_NV:
+   case OPCODE_ATTR_4F_NV:
+      *attr = n[1].e;
+      *size = n[0].opcode - OPCODE_ATTR_1F_NV + 1;
+      return GL_TRUE;
+   case OPCODE_ATTR_1F_ARB:
+   case OPCODE_ATTR_2F_ARB:
+   case OPCODE_ATTR_3F_ARB:
+   case OPCODE_ATTR_4F_ARB:
+      /* Generic attribute 0 may alias the vertex position. */
+      if (n[1].e == 0)
+         return GL_FALSE;
+      *attr = VERT_ATTRIB_GENERIC(n[1].e);
+      *size = n[0].opcode - OPCODE_ATTR_1F_ARB + 1;
+      return GL_TRUE;
+   default:
+      return GL_FALSE;
+   }
+}
+
+
+/**
+ * Append a copy of instruction \p n to the list being compiled.  The payload
+ * changes owner, so \p n must not be destroyed afterwards.
+ */
+static void
+copy_instruction(struct gl_context *ctx, const Node *n)
+{
+   const OpCode opcode = n[0].opcode;
+   const GLuint size = instruction_size(ctx, opcode);
+   Node *dst = dlist_alloc(ctx, opcode, (size - 1) * sizeof(Node),
+                           is_ext_opcode(opcode));
+
+   if (dst)
+      memcpy(&dst[1], &n[1], (size - 1) * sizeof(Node));
+}
+
+
+/** Instructions of the run fed to the vbo_save_merge */
+struct merge_run {
+   const Node **nodes;
+   GLuint count, max;
+   GLuint lists_end;            /**< nodes[] index after the last list */
+};
+
+
+static GLboolean
+merge_run_add(struct merge_run *run, const Node *n, GLboolean is_list)
+{
+   if (run->count == run->max) {
+      const GLuint max = MAX2(2 * run->max, 64);
+      const Node **nodes = realloc(run->nodes, max * sizeof(*nodes));
+
+      if (!nodes)
+         return GL_FALSE;
+
+      run->nodes = nodes;
+      run->max = max;
+   }
+
+   run->nodes[run->count++] = n;
+   if (is_list)
+      run->lists_end = run->count;
+   return GL_TRUE;
+}
+
+
+/**
+ * End the current run: replace its lists with a merged one if there is
+ * more than one, otherwise copy its instructions as they are.
+ *
+ * \param keep_trailing  start the next run with the attribute commands that
+ *                       follow the last list, instead of copying them
+ */
+static void
+merge_run_flush(struct gl_context *ctx, struct vbo_save_merge *merge,
+                struct merge_run *run, GLboolean keep_trailing)
+{
+   GLuint i, trailing = 0;
+
+   if (vbo_save_merge_num_lists(merge) >= 2 &&
+       vbo_save_merge_emit(ctx, merge)) {
+      for (i = 0; i < run->lists_end; i++) {
+         Node *n = (Node *) run->nodes[i];
+
+         if (is_ext_opcode(n[0].opcode))
+            ext_opcode_destroy(ctx, n);
+      }
+   }
+   else {
+      for (i = 0; i < run->lists_end; i++)
+         copy_instruction(ctx, run->nodes[i]);
+   }
+
+   vbo_save_merge_reset(merge);
+
+   for (i = run->lists_end; i < run->count; i++) {
+      const Node *n = run->nodes[i];
+      GLuint attr, size;
+
+      if (keep_trailing && get_attr_instruction(n, &attr, &size) &&
+          vbo_save_merge_attr(merge, attr, size, &n[2].f))
+         run->nodes[trailing++] = n;
+      else
+         copy_instruction(ctx, n);
+   }
+
+   run->count = trailing;
+   run->lists_end = 0;
+}
+
+
+/**
+ * Rewrite the display list being compiled, merging its vertex lists.
+ */
+static void
+merge_vertex_lists(struct gl_context *ctx)
+{
+   struct gl_dlist_state *state = &ctx->ListState;
+   const Node *end = state->CurrentBlock + state->CurrentPos;
+   Node *head = state->CurrentList->Head;
+   struct vbo_save_merge *merge;
+   struct merge_run run;
+   Node *n, *block, *new_head;
+   GLuint num_ext = 0;
+
+   /* Most lists have nothing to merge. */
+   for (n = head; n != end && num_ext < 2; ) {
+      const OpCode opcode = n[0].opcode;
+
+      if (opcode == OPCODE_CONTINUE) {
+         n = (Node *) get_pointer(&n[1]);
+         continue;
+      }
+
+      if (is_ext_opcode(opcode))
+         num_ext++;
+      n += instruction_size(ctx, opcode);
+   }
+
+   if (num_ext < 2)
+      return;
+
+   merge = vbo_save_merge_create();
+   new_head = malloc(sizeof(Node) * BLOCK_SIZE);
+   if (!merge || !new_head) {
+      vbo_save_merge_destroy(merge);
+      free(new_head);
+      return;
+   }
+
+   memset(&run, 0, sizeof(run));
+   state->CurrentList->Head = state->CurrentBlock = new_head;
+   state->CurrentPos = 0;
+
+   for (n = head; n != end; ) {
+      const OpCode opcode = n[0].opcode;
+      GLuint attr, size;
+
+      if (opcode == OPCODE_CONTINUE) {
+         n = (Node *) get_pointer(&n[1]);
+         continue;
+      }
+
+      if (get_attr_instruction(n, &attr, &size)) {
+         if (!vbo_save_merge_attr(merge, attr, size, &n[2].f)) {
+            merge_run_flush(ctx, merge, &run, GL_TRUE);
+            if (!vbo_save_merge_attr(merge, attr, size, &n[2].f)) {
+               merge_run_flush(ctx, merge, &run, GL_FALSE);
+               copy_instruction(ctx, n);
+               goto next;
+            }
+         }
+         if (!merge_run_add(&run, n, GL_FALSE)) {
+            /* The merger has taken the command, so it can't be copied
+             * later.  Give up on this run.
+             */
+            vbo_save_merge_reset(merge);
+            merge_run_flush(ctx, merge, &run, GL_FALSE);
+            copy_instruction(ctx, n);
+         }
+      }
+      else if (is_ext_opcode(opcode)) {
+         if (!vbo_save_merge_list(ctx, merge, opcode, &n[1])) {
+            merge_run_flush(ctx, merge, &run, GL_TRUE);
+            if (!vbo_save_merge_list(ctx, merge, opcode, &n[1])) {
+               merge_run_flush(ctx, merge, &run, GL_FALSE);
+               copy_instruction(ctx, n);
+               goto next;
+            }
+         }
+         if (!merge_run_add(&run, n, GL_TRUE)) {
+            vbo_save_merge_reset(merge);
+            merge_run_flush(ctx, merge, &run, GL_FALSE);
+            copy_instruction(ctx, n);
+         }
+      }
+      else if (opcode != OPCODE_NOP) {
+         merge_run_flush(ctx, merge, &run, GL_FALSE);
+         copy_instruction(ctx, n);
+      }
+
+   next:
+      n += instruction_size(ctx, opcode);
+   }
+
+   merge_run_flush(ctx, merge, &run, GL_FALSE);
+
+   free(run.nodes);
+   vbo_save_merge_destroy(merge);
+
+   /* Every instruction was either moved or destroyed; free the old blocks. */
+   for (n = block = head; n != end; ) {
+      if (n[0].opcode == OPCODE_CONTINUE) {
+         n = (Node *) get_pointer(&n[1]);
+         free(block);
+         block = n;
+         continue;
+      }
+      n += instruction_size(ctx, n[0].opcode);
+   }
+   free(block);
+}
+
+/*@}*/
+
+
 
 /*
  * Display List compilation functions
@@ -9011,6 +9266,9 @@ _mesa_EndList(void)
     */
    vbo_save_EndList(ctx);
 
+   if (ctx->ListState.MergeVertexLists)
+      merge_vertex_lists(ctx);
+
    (void) alloc_instruction(ctx, OPCODE_END_OF_LIST, 0);
 
    trim_list(ctx);
@@ -10068,6 +10326,8 @@ _mesa_init_display_list(struct gl_context *ctx)
    ctx->CompileFlag = GL_FALSE;
    ctx->ListState.CurrentBlock = NULL;
    ctx->ListState.CurrentPos = 0;
+   ctx->ListState.MergeVertexLists =
+      env_var_as_boolean("MESA_DLIST_MERGE", false);
 
    /* Display List group */
    ctx->List.ListBase = 0;
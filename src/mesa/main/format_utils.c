@@ -26,6 +26,9 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "sse_format_convert.h"
+#include "avx2_format_convert.h"
+#include "x86/common_x86_asm.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3);
@@ -39,6 +42,27 @@ const mesa_array_format RGBA32_UINT =
 const mesa_array_format RGBA32_INT =
    MESA_ARRAY_FORMAT(4, 1, 0, 0, 4, 0, 1, 2, 3);
 
+/**
+ * _mesa_unpack_rgba_row(), using SIMD code for the formats that have it.
+ */
+static void
+unpack_rgba_row(mesa_format format, size_t n, const void *src,
+                float dst[][4])
+{
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1 &&
+       (format == MESA_FORMAT_R10G10B10A2_UNORM ||
+        format == MESA_FORMAT_B10G10R10A2_UNORM)) {
+      _mesa_sse_unpack_rgb10a2_unorm_float(&dst[0][0], src,
+                                           format == MESA_FORMAT_B10G10R10A2_UNORM,
+                                           n);
+      return;
+   }
+#endif
+
+   _mesa_unpack_rgba_row(format, n, src, dst);
+}
+
 static void
 invert_swizzle(uint8_t dst[4], const uint8_t src[4])
 {
@@ -259,8 +283,8 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
       if (!src_format_is_mesa_array_format) {
          if (dst_array_format == RGBA32_FLOAT) {
             for (row = 0; row < height; ++row) {
-               _mesa_unpack_rgba_row(src_format, width,
-                                     src, (float (*)[4])dst);
+               unpack_rgba_row(src_format, width,
+                               src, (float (*)[4])dst);
                src += src_stride;
                dst += dst_stride;
             }
@@ -492,8 +516,8 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
          }
       } else {
          for (row = 0; row < height; ++row) {
-            _mesa_unpack_rgba_row(src_format, width,
-                                  src, tmp_float + row * width);
+            unpack_rgba_row(src_format, width,
+                            src, tmp_float + row * width);
             if (rebase_swizzle)
                _mesa_swizzle_and_convert(tmp_float + row * width,
                                          MESA_ARRAY_FORMAT_TYPE_FLOAT, 4,
@@ -713,6 +737,101 @@ swizzle_convert_try_memcpy(void *dst,
    return true;
 }
 
+/**
+ * Attempts to perform the given swizzle-and-convert operation with SIMD code
+ *
+ * Only the most common cases have SIMD versions: 4-channel ubyte swizzles,
+ * 4-channel ubyte <-> float and unswizzled half <-> float.  They produce
+ * the same results as the scalar code below, except for NaN payloads in
+ * half-float conversions.
+ *
+ * The arguments are exactly the same as for _mesa_swizzle_and_convert
+ *
+ * \return  true if it performed the operation, false otherwise
+ */
+static bool
+swizzle_convert_try_simd(void *dst,
+                         enum mesa_array_format_datatype dst_type,
+                         int num_dst_channels,
+                         const void *src,
+                         enum mesa_array_format_datatype src_type,
+                         int num_src_channels,
+                         const uint8_t swizzle[4], bool normalized, int count)
+{
+#if defined(USE_SSE41) || defined(USE_AVX2)
+#if defined(USE_AVX2)
+   if (cpu_has_avx2 && cpu_has_f16c &&
+       num_src_channels == num_dst_channels &&
+       ((src_type == MESA_ARRAY_FORMAT_TYPE_HALF &&
+         dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT) ||
+        (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+         dst_type == MESA_ARRAY_FORMAT_TYPE_HALF))) {
+      int i;
+
+      for (i = 0; i < num_dst_channels; ++i)
+         if (swizzle[i] != i)
+            return false;
+
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_HALF)
+         _mesa_avx2_half_to_float(dst, src, count * num_src_channels);
+      else
+         _mesa_avx2_float_to_half(dst, src, count * num_src_channels);
+      return true;
+   }
+#endif
+
+   if (num_src_channels != 4 || num_dst_channels != 4)
+      return false;
+
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE) {
+      const uint8_t one = normalized ? UINT8_MAX : 1;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_swizzle_ubyte4(dst, src, swizzle, one, count);
+         return true;
+      }
+#endif
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_sse_swizzle_ubyte4(dst, src, swizzle, one, count);
+         return true;
+      }
+#endif
+   } else if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+              dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT) {
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_ubyte4_to_float4(dst, src, swizzle, normalized, count);
+         return true;
+      }
+#endif
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_sse_ubyte4_to_float4(dst, src, swizzle, normalized, count);
+         return true;
+      }
+#endif
+   } else if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+              dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE && normalized) {
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_float4_to_unorm8_4(dst, src, swizzle, count);
+         return true;
+      }
+#endif
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_sse_float4_to_unorm8_4(dst, src, swizzle, count);
+         return true;
+      }
+#endif
+   }
+#endif /* USE_SSE41 || USE_AVX2 */
+
+   return false;
+}
+
 /**
  * Represents a single instance of the standard swizzle-and-convert loop
  *
@@ -1432,6 +1551,11 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+   if (swizzle_convert_try_simd(void_dst, dst_type, num_dst_channels,
+                                void_src, src_type, num_src_channels,
+                                swizzle, normalized, count))
+      return;
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
@@ -0,0 +1,376 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** @file glthread.c
+ *
+ * Support functions for the glthread feature of Mesa.
+ *
+ * In multicore systems, many applications end up CPU-bound with about half
+ * their time spent inside their rendering thread and half inside Mesa.  To
+ * alleviate this, we put a shim layer in Mesa at the GL dispatch level that
+ * quickly logs the GL commands to a buffer to be processed by a worker
+ * thread.
+ */
+
+#ifdef HAVE_PTHREAD
+
+#include "main/mtypes.h"
+#include "main/errors.h"
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/marshal_generated.h"
+#include "util/hash_table.h"
+
+
+static void
+glthread_unmarshal_batch(void *job, int thread_index)
+{
+   struct glthread_batch *batch = (struct glthread_batch*)job;
+   struct gl_context *ctx = batch->ctx;
+   const uint8_t *buffer = (const uint8_t *) batch->buffer;
+   size_t pos = 0;
+
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   while (pos < batch->used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, &buffer[pos]);
+
+   assert(pos == batch->used);
+   batch->used = 0;
+}
+
+static void
+glthread_thread_initialization(void *job, int thread_index)
+{
+   struct gl_context *ctx = (struct gl_context*)job;
+
+   ctx->GLThread->worker = thrd_current();
+   _glapi_set_context(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+}
+
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = calloc(1, sizeof(*glthread));
+   struct util_queue_fence fence;
+   unsigned i;
+
+   if (!glthread)
+      return;
+
+   if (!util_queue_init(&glthread->queue, "glthread", MARSHAL_MAX_BATCHES,
+                        1)) {
+      free(glthread);
+      return;
+   }
+
+   glthread->VAOElementBuffers =
+      _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                              _mesa_key_pointer_equal);
+   ctx->MarshalExec = _mesa_create_marshal_table();
+   if (!glthread->VAOElementBuffers || !ctx->MarshalExec) {
+      if (glthread->VAOElementBuffers)
+         _mesa_hash_table_destroy(glthread->VAOElementBuffers, NULL);
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      util_queue_destroy(&glthread->queue);
+      free(glthread);
+      return;
+   }
+
+   for (i = 0; i < MARSHAL_MAX_BATCHES; i++) {
+      glthread->batches[i].ctx = ctx;
+      util_queue_fence_init(&glthread->batches[i].fence);
+   }
+
+   ctx->GLThread = glthread;
+
+   /* Make the context current in the worker thread. */
+   util_queue_fence_init(&fence);
+   util_queue_add_job(&glthread->queue, ctx, &fence,
+                      glthread_thread_initialization);
+   util_queue_fence_wait(&fence);
+   util_queue_fence_destroy(&fence);
+
+   /* If the context is already current, start marshalling right away;
+    * otherwise _mesa_make_current() installs MarshalExec.
+    */
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   unsigned i;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_finish(ctx);
+   util_queue_destroy(&glthread->queue);
+
+   for (i = 0; i < MARSHAL_MAX_BATCHES; i++)
+      util_queue_fence_destroy(&glthread->batches[i].fence);
+
+   _mesa_hash_table_destroy(glthread->VAOElementBuffers, NULL);
+   free(glthread);
+   ctx->GLThread = NULL;
+
+   /* From now on, calls from the application thread go straight to the
+    * regular dispatch table.
+    */
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+/**
+ * Stop marshalling for the rest of the context's lifetime, because \p func
+ * was called in a way the worker thread can't handle (typically with client
+ * memory it would read later).
+ */
+void
+_mesa_glthread_disable(struct gl_context *ctx, const char *func)
+{
+   _mesa_debug(ctx, "glthread disabled by gl%s\n", func);
+   _mesa_glthread_destroy(ctx);
+}
+
+/**
+ * Reinstall the marshalling dispatch table after a function executed on
+ * the application thread may have called _glapi_set_dispatch() (e.g. a
+ * display list doing glBegin/glEnd).
+ */
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+   if (ctx->GLThread && _glapi_get_dispatch() != ctx->MarshalExec)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *next;
+
+   if (!glthread)
+      return;
+
+   next = &glthread->batches[glthread->next];
+   if (!next->used)
+      return;
+
+   util_queue_add_job(&glthread->queue, next, &next->fence,
+                      glthread_unmarshal_batch);
+   glthread->last = glthread->next;
+   glthread->next = (glthread->next + 1) % MARSHAL_MAX_BATCHES;
+
+   /* The batch we are about to fill may still be queued or executing. */
+   util_queue_fence_wait(&glthread->batches[glthread->next].fence);
+}
+
+/**
+ * Waits for all pending batches have been unmarshaled.
+ *
+ * This can be used by the main thread to synchronize access to the context,
+ * since the worker thread will be idle after this.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   /* If this is called from the worker thread, then we've hit a path that
+    * might be called from either the main thread or the worker (such as some
+    * dri interface entrypoints), in which case we don't need to actually
+    * synchronize against ourself.
+    */
+   if (thrd_equal(glthread->worker, thrd_current()))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+   util_queue_fence_wait(&glthread->batches[glthread->last].fence);
+}
+
+
+/**
+ * \name Client-side binding tracking
+ *
+ * These mirror just enough of the buffer and vertex array bindings for the
+ * marshal_fail checks to tell whether vertex pointers and indices refer to
+ * buffer objects or to client memory.
+ */
+/*@{*/
+
+static void
+set_element_buffer(struct glthread_state *glthread, GLuint vao, GLuint buffer)
+{
+   if (vao == glthread->CurrentVAO)
+      glthread->CurrentElementBufferName = buffer;
+
+   if (vao == 0) {
+      glthread->DefaultVAOElementBufferName = buffer;
+   } else {
+      _mesa_hash_table_insert(glthread->VAOElementBuffers,
+                              (void *) (uintptr_t) vao,
+                              (void *) (uintptr_t) buffer);
+   }
+}
+
+static GLuint
+get_element_buffer(struct glthread_state *glthread, GLuint vao)
+{
+   struct hash_entry *entry;
+
+   if (vao == 0)
+      return glthread->DefaultVAOElementBufferName;
+
+   entry = _mesa_hash_table_search(glthread->VAOElementBuffers,
+                                   (void *) (uintptr_t) vao);
+   return entry ? (GLuint) (uintptr_t) entry->data : 0;
+}
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->CurrentArrayBufferName = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      /* The element array buffer binding is part of the VAO. */
+      set_element_buffer(glthread, glthread->CurrentVAO, buffer);
+      break;
+   }
+}
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!glthread || !buffers)
+      return;
+
+   /* Deleting a bound buffer unbinds it from the current context and from
+    * the current VAO.
+    */
+   for (i = 0; i < n; i++) {
+      if (buffers[i] == 0)
+         continue;
+      if (buffers[i] == glthread->CurrentArrayBufferName)
+         glthread->CurrentArrayBufferName = 0;
+      if (buffers[i] == glthread->CurrentElementBufferName)
+         set_element_buffer(glthread, glthread->CurrentVAO, 0);
+   }
+}
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   glthread->CurrentVAO = id;
+   glthread->CurrentElementBufferName = get_element_buffer(glthread, id);
+}
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *ids)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!glthread || !ids)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct hash_entry *entry;
+
+      if (ids[i] == 0)
+         continue;
+
+      /* Deleting the bound VAO binds the default one. */
+      if (ids[i] == glthread->CurrentVAO)
+         _mesa_glthread_BindVertexArray(ctx, 0);
+
+      entry = _mesa_hash_table_search(glthread->VAOElementBuffers,
+                                      (void *) (uintptr_t) ids[i]);
+      if (entry)
+         _mesa_hash_table_remove(glthread->VAOElementBuffers, entry);
+   }
+}
+
+void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread || vaobj == 0)
+      return;
+
+   set_element_buffer(glthread, vaobj, buffer);
+}
+
+/**
+ * glPopClientAttrib restores bindings behind our back; it is marshalled
+ * synchronously, so the worker is idle and the real state can be read.
+ */
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   glthread->CurrentArrayBufferName = ctx->Array.ArrayBufferObj->Name;
+   glthread->CurrentVAO = ctx->Array.VAO->Name;
+   set_element_buffer(glthread, glthread->CurrentVAO,
+                      ctx->Array.VAO->IndexBufferObj->Name);
+}
+
+/*@}*/
+
+#endif /* HAVE_PTHREAD */
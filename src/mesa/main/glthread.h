@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.h
+ * Threaded GL dispatch ("glthread").
+ *
+ * When enabled, the application thread's dispatch table is
+ * ctx->MarshalExec, whose entry points (generated by gl_marshal.py) record
+ * GL calls into batches that are executed by a worker thread bound to the
+ * same context.  Functions that return data, or read client memory of
+ * unknown size, wait for the worker to go idle and run on the application
+ * thread instead.
+ */
+
+#ifndef _GLTHREAD_H
+#define _GLTHREAD_H
+
+#include "main/mtypes.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <stdbool.h>
+#include "c11/threads.h"
+#include "util/u_queue.h"
+
+/**
+ * Maximum size of a batch, and therefore of a single marshalled command.
+ * Commands that don't fit are executed synchronously.
+ */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/**
+ * Number of batches.  One is being filled by the application thread while
+ * the others are queued or executing.
+ */
+#define MARSHAL_MAX_BATCHES 4
+
+struct hash_table;
+
+/** A batch of marshalled commands. */
+struct glthread_batch
+{
+   /** The worker thread will access the context with this. */
+   struct gl_context *ctx;
+
+   /** Signalled once the worker thread has executed the batch. */
+   struct util_queue_fence fence;
+
+   /** Amount of data used by the commands, in bytes. */
+   size_t used;
+
+   /** Data contained in the batch, 8-byte aligned. */
+   uint64_t buffer[MARSHAL_MAX_CMD_SIZE / 8];
+};
+
+struct glthread_state
+{
+   /** Single-threaded queue executing the batches. */
+   struct util_queue queue;
+
+   /** The worker thread, for recursion detection. */
+   thrd_t worker;
+
+   /** The ring of batches. */
+   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+
+   /** Index of the batch being filled by the application thread. */
+   unsigned next;
+
+   /** Index of the last batch submitted to the worker thread. */
+   unsigned last;
+
+   /**
+    * Client-side copy of the bindings that decide whether a call may read
+    * client memory (see the marshal_fail annotations in the GL XML).
+    */
+   /*@{*/
+   GLuint CurrentArrayBufferName;
+   GLuint CurrentVAO;
+   GLuint CurrentElementBufferName;
+   /** VAO name -> element array buffer name, for VAOs other than 0 */
+   struct hash_table *VAOElementBuffers;
+   GLuint DefaultVAOElementBufferName;
+   /*@}*/
+};
+
+void _mesa_glthread_init(struct gl_context *ctx);
+void _mesa_glthread_destroy(struct gl_context *ctx);
+void _mesa_glthread_disable(struct gl_context *ctx, const char *func);
+
+void _mesa_glthread_restore_dispatch(struct gl_context *ctx);
+void _mesa_glthread_flush_batch(struct gl_context *ctx);
+void _mesa_glthread_finish(struct gl_context *ctx);
+
+void _mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                               GLuint buffer);
+void _mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *buffers);
+void _mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint id);
+void _mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                       const GLuint *ids);
+void _mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                             GLuint vaobj, GLuint buffer);
+void _mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+#else /* HAVE_PTHREAD */
+
+static inline void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+}
+
+#endif /* !HAVE_PTHREAD */
+#endif /* _GLTHREAD_H*/
@@ -3,7 +3,8 @@
  * Generic hash table. 
  *
  * Used for display lists, texture objects, vertex/fragment programs,
- * buffer objects, etc.  The hash functions are thread-safe.
+ * buffer objects, etc.  The hash functions are thread-safe, and
+ * _mesa_HashLookup() doesn't lock for small keys.
  * 
  * \note key=0 is illegal.
  *
@@ -38,6 +39,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
@@ -52,6 +54,22 @@
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Keys below DENSE_MAX_KEY are also stored in a two-level array that
+ * _mesa_HashLookup() reads without taking the mutex.
+ *
+ * Since glGen*() hands out small contiguous names, almost every lookup done
+ * by glBind*() hits the array.  Pages are allocated on first use and are
+ * never freed or moved before the table is deleted, so a reader can't see a
+ * page go away under it.  Writers update the array with the mutex held, and
+ * publish pointers with a full barrier so that a reader seeing a pointer
+ * also sees the page (or object) it points to.
+ */
+#define DENSE_PAGE_SHIFT 10
+#define DENSE_PAGE_SIZE (1 << DENSE_PAGE_SHIFT)
+#define DENSE_NUM_PAGES 64
+#define DENSE_MAX_KEY (DENSE_PAGE_SIZE * DENSE_NUM_PAGES)
+
 /**
  * The hash table data structure.  
  */
@@ -63,6 +81,8 @@ struct _mesa_HashTable {
    GLboolean InDeleteAll;                /**< Debug check */
    /** Value that would be in the table for DELETED_KEY_VALUE. */
    void *deleted_key_data;
+   /** Lock-free copy of the entries with keys below DENSE_MAX_KEY */
+   void *volatile *volatile DensePages[DENSE_NUM_PAGES];
 };
 
 /** @{
@@ -152,6 +172,8 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
+   unsigned i;
+
    assert(table);
 
    if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
@@ -160,6 +182,9 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   for (i = 0; i < DENSE_NUM_PAGES; i++)
+      free((void *) table->DensePages[i]);
+
    mtx_destroy(&table->Mutex);
    mtx_destroy(&table->WalkMutex);
    free(table);
@@ -190,6 +215,68 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 }
 
 
+/**
+ * Store \p data for \p key in the dense array.  The mutex must be held.
+ *
+ * If a page can't be allocated, lookups of its keys keep going through the
+ * locked path, so this never fails.
+ */
+static void
+dense_set(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   void *volatile *page;
+   void *volatile *slot;
+
+   if (key >= DENSE_MAX_KEY)
+      return;
+
+   page = table->DensePages[key >> DENSE_PAGE_SHIFT];
+   if (!page) {
+      const GLuint first = key & ~(DENSE_PAGE_SIZE - 1);
+      GLuint i;
+
+      if (!data)
+         return;
+      page = calloc(DENSE_PAGE_SIZE, sizeof(void *));
+      if (!page)
+         return;
+
+      /* Pick up the keys inserted while an earlier allocation failed. */
+      for (i = first ? first : 1; i < first + DENSE_PAGE_SIZE; i++)
+         page[i - first] = _mesa_HashLookup_unlocked(table, i);
+
+      (void) p_atomic_cmpxchg(&table->DensePages[key >> DENSE_PAGE_SHIFT],
+                              NULL, page);
+   }
+
+   slot = &page[key & (DENSE_PAGE_SIZE - 1)];
+   (void) p_atomic_cmpxchg(slot, *slot, data);
+}
+
+
+/**
+ * Look up \p key in the dense array, without locking.
+ *
+ * \return true if the key is covered by an allocated page, in which case
+ * \p data is set to the entry (NULL if there is none).
+ */
+static inline bool
+dense_lookup(const struct _mesa_HashTable *table, GLuint key, void **data)
+{
+   void *volatile *page;
+
+   if (key >= DENSE_MAX_KEY)
+      return false;
+
+   page = p_atomic_read(&table->DensePages[key >> DENSE_PAGE_SHIFT]);
+   if (!page)
+      return false;
+
+   *data = p_atomic_read(&page[key & (DENSE_PAGE_SIZE - 1)]);
+   return true;
+}
+
+
 /**
  * Lookup an entry in the hash table.
  * 
@@ -203,6 +290,14 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
    assert(table);
+   assert(key);
+
+   /* Names from glGen*() are found without touching the mutex, so that
+    * contexts sharing objects don't serialize on every glBind*().
+    */
+   if (dense_lookup(table, key, &res))
+      return res;
+
    mtx_lock(&table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    mtx_unlock(&table->Mutex);
@@ -270,6 +365,8 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
+   dense_set(table, key, data);
+
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = data;
    } else {
@@ -344,6 +441,7 @@ _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
    }
 
    mtx_lock(&table->Mutex);
+   dense_set(table, key, NULL);
    if (key == DELETED_KEY_VALUE) {
       table->deleted_key_data = NULL;
    } else {
@@ -376,10 +474,12 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    mtx_lock(&table->Mutex);
    table->InDeleteAll = GL_TRUE;
    hash_table_foreach(table->ht, entry) {
+      dense_set(table, (uintptr_t)entry->key, NULL);
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
    if (table->deleted_key_data) {
+      dense_set(table, DELETED_KEY_VALUE, NULL);
       callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
       table->deleted_key_data = NULL;
    }
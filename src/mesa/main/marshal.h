@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/** \file marshal.h
+ *
+ * Declarations of functions related to marshalling GL calls from a client
+ * thread to a server thread, used by the code generated by gl_marshal.py.
+ */
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+#include "main/glthread.h"
+#include "main/context.h"
+#include "main/macros.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <stdint.h>
+
+struct marshal_cmd_base
+{
+   /**
+    * Type of command.  See enum marshal_dispatch_cmd_id.
+    */
+   uint16_t cmd_id;
+
+   /**
+    * Size of command, in bytes, including the size of this header.
+    */
+   uint16_t cmd_size;
+};
+
+/**
+ * Reserve \p size bytes for a command in the batch being filled, flushing
+ * it first if the command doesn't fit.  \p size must not exceed
+ * MARSHAL_MAX_CMD_SIZE.
+ */
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id,
+                                size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *next = &glthread->batches[glthread->next];
+   struct marshal_cmd_base *cmd_base;
+   const size_t aligned_size = ALIGN(size, 8);
+
+   assert(size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (unlikely(next->used + aligned_size > MARSHAL_MAX_CMD_SIZE)) {
+      _mesa_glthread_flush_batch(ctx);
+      next = &glthread->batches[glthread->next];
+   }
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) next->buffer + next->used);
+   next->used += aligned_size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = aligned_size;
+   return cmd_base;
+}
+
+/**
+ * Size in bytes of \p a elements of \p b bytes each, or -1 if \p a is
+ * negative or the product overflows.
+ */
+static inline int64_t
+safe_mul(int64_t a, int64_t b)
+{
+   if (a < 0 || b < 0)
+      return -1;
+   if (a == 0 || b == 0)
+      return 0;
+   if (a > INT64_MAX / b)
+      return -1;
+   return a * b;
+}
+
+/**
+ * Whether vertex array pointers set now would point to client memory, which
+ * the worker thread can't be allowed to read at draw time.
+ */
+static inline bool
+_mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE &&
+          ctx->GLThread->CurrentArrayBufferName == 0;
+}
+
+/**
+ * Whether the indices of an indexed draw call would be read from client
+ * memory.
+ */
+static inline bool
+_mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE &&
+          ctx->GLThread->CurrentElementBufferName == 0;
+}
+
+struct _glapi_table *
+_mesa_create_marshal_table(void);
+
+size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+#endif /* HAVE_PTHREAD */
+
+#endif /* MARSHAL_H */
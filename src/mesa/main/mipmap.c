@@ -37,7 +37,11 @@
 #include "texstore.h"
 #include "image.h"
 #include "macros.h"
+#include "parallel_convert.h"
+#include "sse_mipmap.h"
+#include "avx2_mipmap.h"
 #include "util/half_float.h"
+#include "x86/common_x86_asm.h"
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
@@ -138,6 +142,41 @@ bytes_per_pixel(GLenum datatype, GLuint comps)
 /*@}*/
 
 
+/**
+ * do_row() for the 2:1 reductions that have SIMD versions.
+ * \return GL_TRUE if the row was done
+ */
+static GLboolean
+do_row_simd(GLenum datatype, GLuint comps,
+            const GLvoid *srcRowA, const GLvoid *srcRowB,
+            GLint dstWidth, GLvoid *dstRow)
+{
+#if defined(USE_SSE41) || defined(USE_AVX2)
+   if (comps == 3)
+      return GL_FALSE;
+
+#if defined(USE_AVX2)
+   if (datatype == GL_HALF_FLOAT_ARB && cpu_has_avx2 && cpu_has_f16c) {
+      _mesa_avx2_downsample_half(dstRow, srcRowA, srcRowB, comps, dstWidth);
+      return GL_TRUE;
+   }
+#endif
+#if defined(USE_SSE41)
+   if (datatype == GL_UNSIGNED_BYTE && cpu_has_sse4_1) {
+      _mesa_sse_downsample_ubyte(dstRow, srcRowA, srcRowB, comps, dstWidth);
+      return GL_TRUE;
+   }
+   if (datatype == GL_FLOAT && cpu_has_sse4_1) {
+      _mesa_sse_downsample_float(dstRow, srcRowA, srcRowB, comps, dstWidth);
+      return GL_TRUE;
+   }
+#endif
+#endif /* USE_SSE41 || USE_AVX2 */
+
+   return GL_FALSE;
+}
+
+
 /**
  * Average together two rows of a source image to produce a single new
  * row in the dest image.  It's legal for the two source rows to point
@@ -161,6 +200,10 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
+   if (colStride == 2 &&
+       do_row_simd(datatype, comps, srcRowA, srcRowB, dstWidth, dstRow))
+      return;
+
    if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
       GLuint i, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
@@ -1442,17 +1485,20 @@ make_1d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/**
+ * Generate rows [y0, y1) of a 2D mipmap image, not counting the border.
+ */
 static void
-make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
-               GLint srcWidth, GLint srcHeight,
-	       const GLubyte *srcPtr, GLint srcRowStride,
-               GLint dstWidth, GLint dstHeight,
-	       GLubyte *dstPtr, GLint dstRowStride)
+make_2d_mipmap_rows(GLenum datatype, GLuint comps, GLint border,
+                    GLint srcWidth, GLint srcHeight,
+                    const GLubyte *srcPtr, GLint srcRowStride,
+                    GLint dstWidth, GLint dstHeight,
+                    GLubyte *dstPtr, GLint dstRowStride,
+                    GLint y0, GLint y1)
 {
    const GLint bpt = bytes_per_pixel(datatype, comps);
    const GLint srcWidthNB = srcWidth - 2 * border;  /* sizes w/out border */
    const GLint dstWidthNB = dstWidth - 2 * border;
-   const GLint dstHeightNB = dstHeight - 2 * border;
    const GLubyte *srcA, *srcB;
    GLubyte *dst;
    GLint row, srcRowStep;
@@ -1461,24 +1507,46 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
    srcA = srcPtr + border * ((srcWidth + 1) * bpt);
    if (srcHeight > 1 && srcHeight > dstHeight) {
       /* sample from two source rows */
-      srcB = srcA + srcRowStride;
       srcRowStep = 2;
+      srcA += y0 * srcRowStep * srcRowStride;
+      srcB = srcA + srcRowStride;
    }
    else {
       /* sample from one source row */
-      srcB = srcA;
       srcRowStep = 1;
+      srcA += y0 * srcRowStep * srcRowStride;
+      srcB = srcA;
    }
 
-   dst = dstPtr + border * ((dstWidth + 1) * bpt);
+   dst = dstPtr + border * ((dstWidth + 1) * bpt) + y0 * dstRowStride;
 
-   for (row = 0; row < dstHeightNB; row++) {
+   for (row = y0; row < y1; row++) {
       do_row(datatype, comps, srcWidthNB, srcA, srcB,
              dstWidthNB, dst);
       srcA += srcRowStep * srcRowStride;
       srcB += srcRowStep * srcRowStride;
       dst += dstRowStride;
    }
+}
+
+
+static void
+make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
+               GLint srcWidth, GLint srcHeight,
+	       const GLubyte *srcPtr, GLint srcRowStride,
+               GLint dstWidth, GLint dstHeight,
+	       GLubyte *dstPtr, GLint dstRowStride)
+{
+   const GLint bpt = bytes_per_pixel(datatype, comps);
+   const GLint srcWidthNB = srcWidth - 2 * border;  /* sizes w/out border */
+   const GLint dstWidthNB = dstWidth - 2 * border;
+   const GLint dstHeightNB = dstHeight - 2 * border;
+   GLint row;
+
+   make_2d_mipmap_rows(datatype, comps, border,
+                       srcWidth, srcHeight, srcPtr, srcRowStride,
+                       dstWidth, dstHeight, dstPtr, dstRowStride,
+                       0, dstHeightNB);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
@@ -1534,28 +1602,24 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/**
+ * Generate rows [y0, y1) of images [img0, img1) of a 3D mipmap, not counting
+ * the border.
+ */
 static void
-make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
-               GLint srcWidth, GLint srcHeight, GLint srcDepth,
-               const GLubyte **srcPtr, GLint srcRowStride,
-               GLint dstWidth, GLint dstHeight, GLint dstDepth,
-               GLubyte **dstPtr, GLint dstRowStride)
+make_3d_mipmap_rows(GLenum datatype, GLuint comps, GLint border,
+                    GLint srcWidth, GLint srcHeight, GLint srcDepth,
+                    const GLubyte **srcPtr, GLint srcRowStride,
+                    GLint dstWidth, GLint dstHeight, GLint dstDepth,
+                    GLubyte **dstPtr, GLint dstRowStride,
+                    GLint img0, GLint img1, GLint y0, GLint y1)
 {
    const GLint bpt = bytes_per_pixel(datatype, comps);
    const GLint srcWidthNB = srcWidth - 2 * border;  /* sizes w/out border */
-   const GLint srcDepthNB = srcDepth - 2 * border;
    const GLint dstWidthNB = dstWidth - 2 * border;
-   const GLint dstHeightNB = dstHeight - 2 * border;
-   const GLint dstDepthNB = dstDepth - 2 * border;
    GLint img, row;
-   GLint bytesPerSrcImage, bytesPerDstImage;
    GLint srcImageOffset, srcRowOffset;
 
-   (void) srcDepthNB; /* silence warnings */
-
-   bytesPerSrcImage = srcRowStride * srcHeight * bpt;
-   bytesPerDstImage = dstRowStride * dstHeight * bpt;
-
    /* Offset between adjacent src images to be averaged together */
    srcImageOffset = (srcDepth == dstDepth) ? 0 : 1;
 
@@ -1575,7 +1639,7 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
           srcWidth, srcHeight, srcDepth, dstWidth, dstHeight, dstDepth);
    */
 
-   for (img = 0; img < dstDepthNB; img++) {
+   for (img = img0; img < img1; img++) {
       /* first source image pointer, skipping border */
       const GLubyte *imgSrcA = srcPtr[img * 2 + border]
          + srcRowStride * border + bpt * border;
@@ -1588,13 +1652,14 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
          + dstRowStride * border + bpt * border;
 
       /* setup the four source row pointers and the dest row pointer */
-      const GLubyte *srcImgARowA = imgSrcA;
-      const GLubyte *srcImgARowB = imgSrcA + srcRowOffset;
-      const GLubyte *srcImgBRowA = imgSrcB;
-      const GLubyte *srcImgBRowB = imgSrcB + srcRowOffset;
-      GLubyte *dstImgRow = imgDst;
-
-      for (row = 0; row < dstHeightNB; row++) {
+      const GLint srcRowSkip = y0 * (srcRowStride + srcRowOffset);
+      const GLubyte *srcImgARowA = imgSrcA + srcRowSkip;
+      const GLubyte *srcImgARowB = imgSrcA + srcRowSkip + srcRowOffset;
+      const GLubyte *srcImgBRowA = imgSrcB + srcRowSkip;
+      const GLubyte *srcImgBRowB = imgSrcB + srcRowSkip + srcRowOffset;
+      GLubyte *dstImgRow = imgDst + y0 * dstRowStride;
+
+      for (row = y0; row < y1; row++) {
          do_row_3D(datatype, comps, srcWidthNB, 
                    srcImgARowA, srcImgARowB,
                    srcImgBRowA, srcImgBRowB,
@@ -1608,6 +1673,36 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
          dstImgRow += dstRowStride;
       }
    }
+}
+
+
+static void
+make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
+               GLint srcWidth, GLint srcHeight, GLint srcDepth,
+               const GLubyte **srcPtr, GLint srcRowStride,
+               GLint dstWidth, GLint dstHeight, GLint dstDepth,
+               GLubyte **dstPtr, GLint dstRowStride)
+{
+   const GLint bpt = bytes_per_pixel(datatype, comps);
+   const GLint srcDepthNB = srcDepth - 2 * border;
+   const GLint dstHeightNB = dstHeight - 2 * border;
+   const GLint dstDepthNB = dstDepth - 2 * border;
+   GLint img;
+   GLint bytesPerSrcImage, bytesPerDstImage;
+   GLint srcImageOffset;
+
+   (void) srcDepthNB; /* silence warnings */
+
+   bytesPerSrcImage = srcRowStride * srcHeight * bpt;
+   bytesPerDstImage = dstRowStride * dstHeight * bpt;
+
+   /* Offset between adjacent src images to be averaged together */
+   srcImageOffset = (srcDepth == dstDepth) ? 0 : 1;
+
+   make_3d_mipmap_rows(datatype, comps, border,
+                       srcWidth, srcHeight, srcDepth, srcPtr, srcRowStride,
+                       dstWidth, dstHeight, dstDepth, dstPtr, dstRowStride,
+                       0, dstDepthNB, 0, dstHeightNB);
 
 
    /* Luckily we can leverage the make_2d_mipmap() function here! */
@@ -1760,6 +1855,122 @@ _mesa_generate_mipmap_level(GLenum target,
 }
 
 
+/** A mipmap level generated by several threads */
+struct mipmap_level_job {
+   GLenum target;
+   GLenum datatype;
+   GLuint comps;
+   GLint srcWidth, srcHeight, srcDepth;
+   const GLubyte **srcData;
+   GLint srcRowStride;
+   GLint dstWidth, dstHeight, dstDepth;
+   GLubyte **dstData;
+   GLint dstRowStride;
+   /** Whether jobs get ranges of slices rather than of rows */
+   GLboolean splitSlices;
+};
+
+
+static void
+mipmap_level_rows(void *data, unsigned start, unsigned end)
+{
+   const struct mipmap_level_job *job = (const struct mipmap_level_job *) data;
+   const GLint img0 = job->splitSlices ? start : 0;
+   const GLint img1 = job->splitSlices ? end : job->dstDepth;
+   const GLint y0 = job->splitSlices ? 0 : start;
+   const GLint y1 = job->splitSlices ? job->dstHeight : end;
+   GLint i;
+
+   if (job->target == GL_TEXTURE_3D) {
+      make_3d_mipmap_rows(job->datatype, job->comps, 0,
+                          job->srcWidth, job->srcHeight, job->srcDepth,
+                          job->srcData, job->srcRowStride,
+                          job->dstWidth, job->dstHeight, job->dstDepth,
+                          job->dstData, job->dstRowStride,
+                          img0, img1, y0, y1);
+      return;
+   }
+
+   for (i = img0; i < img1; i++) {
+      make_2d_mipmap_rows(job->datatype, job->comps, 0,
+                          job->srcWidth, job->srcHeight,
+                          job->srcData[i], job->srcRowStride,
+                          job->dstWidth, job->dstHeight,
+                          job->dstData[i], job->dstRowStride,
+                          y0, y1);
+   }
+}
+
+
+/**
+ * Same as _mesa_generate_mipmap_level(), but large 2D, cube, array and 3D
+ * levels without border are split across the context's pixel conversion
+ * threads, by rows or, for stacks of small slices, by slices.
+ */
+static void
+generate_mipmap_level(struct gl_context *ctx, GLenum target,
+                      GLenum datatype, GLuint comps,
+                      GLint border,
+                      GLint srcWidth, GLint srcHeight, GLint srcDepth,
+                      const GLubyte **srcData,
+                      GLint srcRowStride,
+                      GLint dstWidth, GLint dstHeight, GLint dstDepth,
+                      GLubyte **dstData,
+                      GLint dstRowStride)
+{
+   struct mipmap_level_job job;
+
+   switch (target) {
+   case GL_TEXTURE_2D:
+   case GL_TEXTURE_CUBE_MAP_POSITIVE_X_ARB:
+   case GL_TEXTURE_CUBE_MAP_NEGATIVE_X_ARB:
+   case GL_TEXTURE_CUBE_MAP_POSITIVE_Y_ARB:
+   case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_ARB:
+   case GL_TEXTURE_CUBE_MAP_POSITIVE_Z_ARB:
+   case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_ARB:
+      dstDepth = 1;
+      /* fallthrough */
+   case GL_TEXTURE_2D_ARRAY_EXT:
+   case GL_TEXTURE_CUBE_MAP_ARRAY:
+   case GL_TEXTURE_3D:
+      if (border == 0)
+         break;
+      /* fallthrough */
+   default:
+      _mesa_generate_mipmap_level(target, datatype, comps, border,
+                                  srcWidth, srcHeight, srcDepth,
+                                  srcData, srcRowStride,
+                                  dstWidth, dstHeight, dstDepth,
+                                  dstData, dstRowStride);
+      return;
+   }
+
+   job.target = target;
+   job.datatype = datatype;
+   job.comps = comps;
+   job.srcWidth = srcWidth;
+   job.srcHeight = srcHeight;
+   job.srcDepth = srcDepth;
+   job.srcData = srcData;
+   job.srcRowStride = srcRowStride;
+   job.dstWidth = dstWidth;
+   job.dstHeight = dstHeight;
+   job.dstDepth = dstDepth;
+   job.dstData = dstData;
+   job.dstRowStride = dstRowStride;
+   job.splitSlices = dstDepth > dstHeight;
+
+   if (job.splitSlices) {
+      _mesa_parallel_rows(ctx, dstWidth * dstHeight, dstDepth, 1,
+                          mipmap_level_rows, &job);
+   }
+   else {
+      _mesa_parallel_rows(ctx, dstWidth * dstDepth, dstHeight, 1,
+                          mipmap_level_rows, &job);
+   }
+}
+
+
 /**
  * compute next (level+1) image size
  * \return GL_FALSE if no smaller size can be generated (eg. src is 1x1x1 size)
@@ -1971,11 +2182,11 @@ generate_mipmap_uncompressed(struct gl_context *ctx, GLenum target,
 
       if (success) {
          /* generate one mipmap level (for 1D/2D/3D/array/etc texture) */
-         _mesa_generate_mipmap_level(target, datatype, comps, border,
-                                     srcWidth, srcHeight, srcDepth,
-                                     (const GLubyte **) srcMaps, srcRowStride,
-                                     dstWidth, dstHeight, dstDepth,
-                                     dstMaps, dstRowStride);
+         generate_mipmap_level(ctx, target, datatype, comps, border,
+                               srcWidth, srcHeight, srcDepth,
+                               (const GLubyte **) srcMaps, srcRowStride,
+                               dstWidth, dstHeight, dstDepth,
+                               dstMaps, dstRowStride);
       }
 
       /* Unmap src image slices */
@@ -2145,12 +2356,12 @@ generate_mipmap_compressed(struct gl_context *ctx, GLenum target,
       /* Rescale src image to dest image.
        * This will loop over the slices of a 2D array.
        */
-      _mesa_generate_mipmap_level(target, temp_datatype, components, border,
-                                  srcWidth, srcHeight, srcDepth,
-                                  (const GLubyte **) temp_src_slices,
-                                  temp_src_row_stride,
-                                  dstWidth, dstHeight, dstDepth,
-                                  temp_dst_slices, temp_dst_row_stride);
+      generate_mipmap_level(ctx, target, temp_datatype, components, border,
+                            srcWidth, srcHeight, srcDepth,
+                            (const GLubyte **) temp_src_slices,
+                            temp_src_row_stride,
+                            dstWidth, dstHeight, dstDepth,
+                            temp_dst_slices, temp_dst_row_stride);
 
       /* The image space was allocated above so use glTexSubImage now */
       ctx->Driver.TexSubImage(ctx, 2, dstImage,
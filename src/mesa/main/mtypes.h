@@ -37,6 +37,7 @@
 #include <stdint.h>             /* uint32_t */
 #include <stdbool.h>
 #include "c11/threads.h"
+#include "util/u_queue.h"
 
 #include "main/glheader.h"
 #include "main/config.h"
@@ -86,6 +87,7 @@ struct gl_program_parameter_list;
 struct set;
 struct set_entry;
 struct vbo_context;
+struct glthread_state;
 /*@}*/
 
 
@@ -1253,6 +1255,9 @@ typedef enum {
    USAGE_TEXTURE_BUFFER = 0x2,
    USAGE_ATOMIC_COUNTER_BUFFER = 0x4,
    USAGE_SHADER_STORAGE_BUFFER = 0x8,
+   USAGE_TRANSFORM_FEEDBACK_BUFFER = 0x10,
+   USAGE_PIXEL_PACK_BUFFER = 0x20,
+   USAGE_DISABLE_MINMAX_CACHE = 0x40,
 } gl_buffer_usage;
 
 
@@ -1275,6 +1280,12 @@ struct gl_buffer_object
    GLboolean Immutable; /**< GL_ARB_buffer_storage */
    gl_buffer_usage UsageHistory; /**< How has this buffer been used so far? */
 
+   /** Memoization of min/max index computations for static index buffers */
+   struct hash_table *MinMaxCache;
+   unsigned MinMaxCacheHitIndices;
+   unsigned MinMaxCacheMissIndices;
+   bool MinMaxCacheDirty;
+
    /** Counters used for buffer usage warnings */
    GLuint NumSubDataCalls;
    GLuint NumMapBufferWriteCalls;
@@ -2227,6 +2238,21 @@ struct gl_shader
    struct gl_program *Program;  /**< Post-compile assembly code */
    GLchar *InfoLog;
 
+   /**
+    * Signalled when a compile handed to gl_context::ShaderCompileQueue has
+    * finished.  CompileStatus, InfoLog and the IR are only valid after
+    * waiting for it with _mesa_finish_shader_compile().
+    */
+   struct util_queue_fence CompileFence;
+
+   /**
+    * Whether the last compile was handed to gl_context::ShaderCompileQueue.
+    * That only happens while debug output is disabled, so such compiles
+    * don't report their messages through GL_ARB_debug_output, which would
+    * call back into the application from a compile thread.
+    */
+   bool CompileAsync;
+
    unsigned Version;       /**< GLSL version used for linking */
 
    /**
@@ -3992,6 +4018,12 @@ struct gl_dlist_state
        */
       GLenum ShadeModel;
    } Current;
+
+   /**
+    * Merge runs of vertex lists into indexed draws at glEndList time
+    * (MESA_DLIST_MERGE, defaults to false).
+    */
+   GLboolean MergeVertexLists;
 };
 
 /** @{
@@ -4214,8 +4246,17 @@ struct gl_context
     * re-set on glXMakeCurrent().
     */
    struct _glapi_table *CurrentDispatch;
+   /**
+    * Dispatch table used to marshal API calls from the client program to a
+    * separate server thread.  NULL if API calls are not being marshalled to
+    * another thread.
+    */
+   struct _glapi_table *MarshalExec;
    /*@}*/
 
+   /** State of the optional threaded dispatch, see glthread.h */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -4342,6 +4383,34 @@ struct gl_context
     */
    struct gl_pipeline_object *_Shader;
 
+   /**
+    * Worker threads running glCompileShader asynchronously.  Only used when
+    * MESA_GLSL_COMPILE_THREADS is set, and created on the first compile.
+    */
+   struct util_queue ShaderCompileQueue;
+   unsigned NumShaderCompileThreads;
+
+   /**
+    * Worker threads converting row slices of large images in texture
+    * uploads and readbacks.  Only used when MESA_PIXEL_CONVERT_THREADS is
+    * set, and created on the first large conversion.
+    */
+   struct util_queue PixelConvertQueue;
+   unsigned NumPixelConvertThreads;
+
+   /**
+    * Whether large memcpy readbacks into pixel buffer objects use
+    * non-temporal stores.  Set with MESA_STREAMING_PIXEL_COPY.
+    */
+   GLboolean StreamingPixelCopy;
+
+   /**
+    * Speed/quality trade-off of the encoders used when uncompressed data is
+    * stored into a compressed texture, from 0 (fastest) to 2 (best).  Set
+    * with MESA_TEXCOMPRESS_QUALITY.
+    */
+   unsigned TextureCompressQuality;
+
    struct gl_query_state Query;  /**< occlusion, timer queries */
 
    struct gl_transform_feedback_state TransformFeedback;
@@ -0,0 +1,291 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file parallel_convert.c
+ *
+ * Texture uploads and readbacks of large images spend most of their time
+ * converting pixels one row after the other.  Rows are independent, so when
+ * MESA_PIXEL_CONVERT_THREADS is set, images above a size threshold are cut
+ * into horizontal slices that are converted by the context's worker threads
+ * and by the calling thread at the same time.  Every row goes through the
+ * same code as in the serial path, so the results are identical.
+ */
+
+#include "glheader.h"
+#include "imports.h"
+#include "macros.h"
+#include "mtypes.h"
+#include "format_utils.h"
+#include "parallel_convert.h"
+#include "streaming-load-memcpy.h"
+#include "util/debug.h"
+#include "util/u_queue.h"
+#include "x86/common_x86_asm.h"
+
+
+/** Images with fewer pixels than this are converted on the calling thread */
+#define MIN_PARALLEL_PIXELS (512 * 512)
+
+/** Smallest number of rows worth handing to another thread */
+#define MIN_SLICE_ROWS 16
+
+#define MAX_THREADS 32
+
+/**
+ * Copies smaller than this go through memcpy(): they fit in the cache, and
+ * whoever reads the destination next may as well find it there.
+ */
+#define MIN_STREAMING_BYTES (256 * 1024)
+
+
+struct row_slice_job {
+   mesa_row_slice_func func;
+   void *data;
+   unsigned y0, y1;
+   struct util_queue_fence fence;
+};
+
+
+void
+_mesa_init_parallel_convert(struct gl_context *ctx)
+{
+   const char *env = getenv("MESA_PIXEL_CONVERT_THREADS");
+
+   if (env && atoi(env) > 0)
+      ctx->NumPixelConvertThreads = MIN2(atoi(env), MAX_THREADS);
+
+   ctx->StreamingPixelCopy =
+      env_var_as_boolean("MESA_STREAMING_PIXEL_COPY", false);
+}
+
+
+void
+_mesa_free_parallel_convert(struct gl_context *ctx)
+{
+   if (util_queue_is_initialized(&ctx->PixelConvertQueue))
+      util_queue_destroy(&ctx->PixelConvertQueue);
+}
+
+
+static void
+row_slice_job_execute(void *data, int thread_index)
+{
+   struct row_slice_job *job = (struct row_slice_job *) data;
+
+   job->func(job->data, job->y0, job->y1);
+}
+
+
+/**
+ * Return the number of slices to cut a \p width x \p height image into, or
+ * 1 if it should be converted on the calling thread.
+ */
+static unsigned
+num_slices(struct gl_context *ctx, unsigned width, unsigned height)
+{
+   if (ctx->NumPixelConvertThreads == 0 ||
+       (uint64_t) width * height < MIN_PARALLEL_PIXELS ||
+       height < 2 * MIN_SLICE_ROWS)
+      return 1;
+
+   if (!util_queue_is_initialized(&ctx->PixelConvertQueue) &&
+       !util_queue_init(&ctx->PixelConvertQueue, "pixconv", MAX_THREADS,
+                        ctx->NumPixelConvertThreads)) {
+      ctx->NumPixelConvertThreads = 0;
+      return 1;
+   }
+
+   /* The calling thread converts a slice too. */
+   return MIN2(ctx->NumPixelConvertThreads + 1, height / MIN_SLICE_ROWS);
+}
+
+
+/**
+ * Call \p func on row ranges covering [0, height), using the context's
+ * pixel conversion threads if the \p width x \p height image is large
+ * enough.  Slices start on multiples of \p row_align rows, so block
+ * compressed formats can be split at block boundaries.  Returns once all
+ * rows have been processed.
+ */
+void
+_mesa_parallel_rows(struct gl_context *ctx, unsigned width, unsigned height,
+                    unsigned row_align, mesa_row_slice_func func, void *data)
+{
+   struct row_slice_job jobs[MAX_THREADS + 1];
+   unsigned slices = num_slices(ctx, width, height);
+   unsigned rows, i;
+
+   if (slices <= 1) {
+      func(data, 0, height);
+      return;
+   }
+
+   rows = ALIGN_NPOT(DIV_ROUND_UP(height, slices), row_align);
+   slices = DIV_ROUND_UP(height, rows);
+
+   for (i = 0; i < slices; i++) {
+      jobs[i].func = func;
+      jobs[i].data = data;
+      jobs[i].y0 = i * rows;
+      jobs[i].y1 = MIN2((i + 1) * rows, height);
+   }
+
+   for (i = 1; i < slices; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&ctx->PixelConvertQueue, &jobs[i], &jobs[i].fence,
+                         row_slice_job_execute);
+   }
+
+   func(data, jobs[0].y0, jobs[0].y1);
+
+   for (i = 1; i < slices; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
+
+struct format_convert_job {
+   uint8_t *dst;
+   uint32_t dst_format;
+   size_t dst_stride;
+   uint8_t *src;
+   uint32_t src_format;
+   size_t src_stride;
+   size_t width;
+   uint8_t *rebase_swizzle;
+};
+
+static void
+format_convert_rows(void *data, unsigned y0, unsigned y1)
+{
+   struct format_convert_job *job = (struct format_convert_job *) data;
+
+   _mesa_format_convert(job->dst + y0 * job->dst_stride, job->dst_format,
+                        job->dst_stride,
+                        job->src + y0 * job->src_stride, job->src_format,
+                        job->src_stride,
+                        job->width, y1 - y0, job->rebase_swizzle);
+}
+
+
+/**
+ * Same as _mesa_format_convert(), but large images are converted by several
+ * threads.
+ */
+void
+_mesa_parallel_format_convert(struct gl_context *ctx,
+                              void *void_dst, uint32_t dst_format,
+                              size_t dst_stride,
+                              void *void_src, uint32_t src_format,
+                              size_t src_stride,
+                              size_t width, size_t height,
+                              uint8_t *rebase_swizzle)
+{
+   struct format_convert_job job;
+
+   job.dst = (uint8_t *) void_dst;
+   job.dst_format = dst_format;
+   job.dst_stride = dst_stride;
+   job.src = (uint8_t *) void_src;
+   job.src_format = src_format;
+   job.src_stride = src_stride;
+   job.width = width;
+   job.rebase_swizzle = rebase_swizzle;
+
+   _mesa_parallel_rows(ctx, width, height, 1, format_convert_rows, &job);
+}
+
+
+struct copy_rows_job {
+   uint8_t *dst;
+   ptrdiff_t dst_stride;
+   const uint8_t *src;
+   ptrdiff_t src_stride;
+   size_t row_bytes;
+   bool streaming;
+};
+
+static inline void
+copy_bytes(void *dst, const void *src, size_t len, bool streaming)
+{
+#if defined(USE_SSE41)
+   if (streaming && cpu_has_sse4_1) {
+      _mesa_streaming_copy(dst, src, len);
+      return;
+   }
+#endif
+
+   memcpy(dst, src, len);
+}
+
+static void
+copy_rows(void *data, unsigned y0, unsigned y1)
+{
+   struct copy_rows_job *job = (struct copy_rows_job *) data;
+   uint8_t *dst = job->dst + (ptrdiff_t) y0 * job->dst_stride;
+   const uint8_t *src = job->src + (ptrdiff_t) y0 * job->src_stride;
+   unsigned y;
+
+   if (job->dst_stride == (ptrdiff_t) job->row_bytes &&
+       job->src_stride == (ptrdiff_t) job->row_bytes) {
+      copy_bytes(dst, src, (y1 - y0) * job->row_bytes, job->streaming);
+      return;
+   }
+
+   for (y = y0; y < y1; y++) {
+      copy_bytes(dst, src, job->row_bytes, job->streaming);
+      dst += job->dst_stride;
+      src += job->src_stride;
+   }
+}
+
+
+/**
+ * Copy \p height rows of \p width pixels, as the memcpy paths of
+ * glReadPixels() and glGetTexImage() do, on several threads for large
+ * images.  If \p streaming is set, which callers do when the destination is
+ * a pixel buffer object and MESA_STREAMING_PIXEL_COPY is enabled, large
+ * copies are written with non-temporal stores so that they don't evict the
+ * rest of the cache.
+ */
+void
+_mesa_parallel_copy_rows(struct gl_context *ctx,
+                         void *dst, ptrdiff_t dst_stride,
+                         const void *src, ptrdiff_t src_stride,
+                         unsigned width, unsigned height,
+                         unsigned bytes_per_pixel, bool streaming)
+{
+   struct copy_rows_job job;
+
+   job.dst = (uint8_t *) dst;
+   job.dst_stride = dst_stride;
+   job.src = (const uint8_t *) src;
+   job.src_stride = src_stride;
+   job.row_bytes = (size_t) width * bytes_per_pixel;
+   job.streaming = streaming &&
+                   job.row_bytes * height >= MIN_STREAMING_BYTES;
+
+   _mesa_parallel_rows(ctx, width, height, 1, copy_rows, &job);
+}
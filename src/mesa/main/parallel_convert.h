@@ -0,0 +1,69 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file parallel_convert.h
+ * Splitting large pixel conversions into row slices run on worker threads.
+ */
+
+#ifndef PARALLEL_CONVERT_H
+#define PARALLEL_CONVERT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct gl_context;
+
+/**
+ * Converts rows [y0, y1) of a job handed to _mesa_parallel_rows().
+ */
+typedef void (*mesa_row_slice_func)(void *data, unsigned y0, unsigned y1);
+
+extern void
+_mesa_init_parallel_convert(struct gl_context *ctx);
+
+extern void
+_mesa_free_parallel_convert(struct gl_context *ctx);
+
+extern void
+_mesa_parallel_rows(struct gl_context *ctx, unsigned width, unsigned height,
+                    unsigned row_align, mesa_row_slice_func func, void *data);
+
+extern void
+_mesa_parallel_format_convert(struct gl_context *ctx,
+                              void *void_dst, uint32_t dst_format,
+                              size_t dst_stride,
+                              void *void_src, uint32_t src_format,
+                              size_t src_stride,
+                              size_t width, size_t height,
+                              uint8_t *rebase_swizzle);
+
+extern void
+_mesa_parallel_copy_rows(struct gl_context *ctx,
+                         void *dst, ptrdiff_t dst_stride,
+                         const void *src, ptrdiff_t src_stride,
+                         unsigned width, unsigned height,
+                         unsigned bytes_per_pixel, bool streaming);
+
+#endif /* PARALLEL_CONVERT_H */
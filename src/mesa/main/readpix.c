@@ -40,6 +40,7 @@
 #include "glformats.h"
 #include "fbobject.h"
 #include "format_utils.h"
+#include "parallel_convert.h"
 #include "pixeltransfer.h"
 
 
@@ -220,7 +221,7 @@ readpixels_memcpy(struct gl_context *ctx,
    struct gl_renderbuffer *rb =
          _mesa_get_read_renderbuffer_for_format(ctx, format);
    GLubyte *dst, *map;
-   int dstStride, stride, j, texelBytes;
+   int dstStride, stride, texelBytes;
 
    /* Fail if memcpy cannot be used. */
    if (!readpixels_can_use_memcpy(ctx, format, type, packing)) {
@@ -240,12 +241,13 @@ readpixels_memcpy(struct gl_context *ctx,
 
    texelBytes = _mesa_get_format_bytes(rb->Format);
 
-   /* memcpy*/
-   for (j = 0; j < height; j++) {
-      memcpy(dst, map, width * texelBytes);
-      dst += dstStride;
-      map += stride;
-   }
+   /* Nothing reads a pixel buffer object back on the CPU soon; optionally
+    * don't let a large readback into one flush the cache.
+    */
+   _mesa_parallel_copy_rows(ctx, dst, dstStride, map, stride,
+                            width, height, texelBytes,
+                            ctx->StreamingPixelCopy &&
+                            _mesa_is_bufferobj(packing->BufferObj));
 
    ctx->Driver.UnmapRenderbuffer(ctx, rb);
    return GL_TRUE;
@@ -537,10 +539,10 @@ read_rgba_pixels( struct gl_context *ctx,
       }
 
       /* Convert to RGBA now */
-      _mesa_format_convert(rgba, rgba_format, rgba_stride,
-                           map, rb_format, rb_stride,
-                           width, height,
-                           needs_rebase ? rebase_swizzle : NULL);
+      _mesa_parallel_format_convert(ctx, rgba, rgba_format, rgba_stride,
+                                    map, rb_format, rb_stride,
+                                    width, height,
+                                    needs_rebase ? rebase_swizzle : NULL);
 
       /* Handle transfer ops if necessary */
       if (transferOps)
@@ -572,10 +574,10 @@ read_rgba_pixels( struct gl_context *ctx,
     * L=R+G+B values.
     */
    if (!convert_rgb_to_lum) {
-      _mesa_format_convert(dst, dst_format, dst_stride,
-                           src, src_format, src_stride,
-                           width, height,
-                           needs_rebase ? rebase_swizzle : NULL);
+      _mesa_parallel_format_convert(ctx, dst, dst_format, dst_stride,
+                                    src, src_format, src_stride,
+                                    width, height,
+                                    needs_rebase ? rebase_swizzle : NULL);
    } else if (!dst_is_integer) {
       /* Compute float Luminance values from RGBA float */
       int luminance_stride, luminance_bytes;
@@ -599,9 +601,9 @@ read_rgba_pixels( struct gl_context *ctx,
        * from float to the type of dst if necessary)
        */
       luminance_format = _mesa_format_from_format_and_type(format, GL_FLOAT);
-      _mesa_format_convert(dst, dst_format, dst_stride,
-                           luminance, luminance_format, luminance_stride,
-                           width, height, NULL);
+      _mesa_parallel_format_convert(ctx, dst, dst_format, dst_stride,
+                                    luminance, luminance_format,
+                                    luminance_stride, width, height, NULL);
       free(luminance);
    } else {
       _mesa_pack_luminance_from_rgba_integer(width * height, src, !src_is_uint,
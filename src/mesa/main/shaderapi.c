@@ -108,6 +108,7 @@ _mesa_init_shader_state(struct gl_context *ctx)
     */
    struct gl_shader_compiler_options options;
    gl_shader_stage sh;
+   const char *env;
    int i;
 
    memset(&options, 0, sizeof(options));
@@ -122,6 +123,13 @@ _mesa_init_shader_state(struct gl_context *ctx)
    if (ctx->Shader.Flags != 0)
       ctx->Const.GenerateTemporaryNames = true;
 
+   /* Number of threads glCompileShader may hand its work to.  The queue
+    * itself is only created on the first compile.
+    */
+   env = getenv("MESA_GLSL_COMPILE_THREADS");
+   if (env && atoi(env) > 0)
+      ctx->NumShaderCompileThreads = MIN2(atoi(env), 64);
+
    /* Extended for ARB_separate_shader_objects */
    ctx->Shader.RefCount = 1;
    mtx_init(&ctx->Shader.Mutex, mtx_plain);
@@ -154,6 +162,10 @@ _mesa_free_shader_state(struct gl_context *ctx)
 
    assert(ctx->Shader.RefCount == 1);
    mtx_destroy(&ctx->Shader.Mutex);
+
+   /* This finishes any compile still in flight before the threads exit. */
+   if (util_queue_is_initialized(&ctx->ShaderCompileQueue))
+      util_queue_destroy(&ctx->ShaderCompileQueue);
 }
 
 
@@ -846,9 +858,11 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
       *params = shader->DeletePending;
       break;
    case GL_COMPILE_STATUS:
+      _mesa_finish_shader_compile(shader);
       *params = shader->CompileStatus;
       break;
    case GL_INFO_LOG_LENGTH:
+      _mesa_finish_shader_compile(shader);
       *params = shader->InfoLog ? strlen(shader->InfoLog) + 1 : 0;
       break;
    case GL_SHADER_SOURCE_LENGTH:
@@ -910,6 +924,7 @@ get_shader_info_log(struct gl_context *ctx, GLuint shader, GLsizei bufSize,
       return;
    }
 
+   _mesa_finish_shader_compile(sh);
    _mesa_copy_string(infoLog, bufSize, length, sh->InfoLog);
 }
 
@@ -945,6 +960,9 @@ shader_source(struct gl_shader *sh, const GLchar *source)
 {
    assert(sh);
 
+   /* a queued compile may still be reading the old source */
+   _mesa_finish_shader_compile(sh);
+
    /* free old shader source string and install new one */
    free((void *)sh->Source);
    sh->Source = source;
@@ -955,6 +973,66 @@ shader_source(struct gl_shader *sh, const GLchar *source)
 }
 
 
+/**
+ * A glCompileShader handed to gl_context::ShaderCompileQueue.
+ */
+struct compile_shader_job {
+   struct gl_context *ctx;
+   struct gl_shader *sh;
+};
+
+
+static void
+compile_shader_job_execute(void *data, int thread_index)
+{
+   struct compile_shader_job *job = (struct compile_shader_job *) data;
+
+   _mesa_glsl_compile_shader(job->ctx, job->sh, false, false);
+   free(job);
+}
+
+
+/**
+ * Try to run the compile of \p sh on the context's compile threads.  The
+ * results are picked up by _mesa_finish_shader_compile() when the
+ * application queries them or links a program using the shader.
+ *
+ * \return false if the shader must be compiled right away instead
+ */
+static bool
+queue_shader_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   struct compile_shader_job *job;
+
+   /* The MESA_GLSL debug options dump and log from compile_shader(), so
+    * keep those compiles synchronous.  So are compiles with debug output
+    * enabled: messages must be logged, or passed to the debug callback,
+    * from within glCompileShader.
+    */
+   if (ctx->NumShaderCompileThreads == 0 || ctx->_Shader->Flags != 0 ||
+       _mesa_get_debug_state_int(ctx, GL_DEBUG_OUTPUT))
+      return false;
+
+   if (!util_queue_is_initialized(&ctx->ShaderCompileQueue) &&
+       !util_queue_init(&ctx->ShaderCompileQueue, "glsl", 64,
+                        ctx->NumShaderCompileThreads)) {
+      ctx->NumShaderCompileThreads = 0;
+      return false;
+   }
+
+   job = malloc(sizeof(*job));
+   if (!job)
+      return false;
+
+   job->ctx = ctx;
+   job->sh = sh;
+   sh->CompileAsync = true;
+   util_queue_add_job(&ctx->ShaderCompileQueue, job, &sh->CompileFence,
+                      compile_shader_job_execute);
+   return true;
+}
+
+
 /**
  * Compile a shader.
  */
@@ -967,6 +1045,9 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
    if (!sh)
       return;
 
+   /* The previous compile of this shader may still be running. */
+   _mesa_finish_shader_compile(sh);
+
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
@@ -979,6 +1060,10 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
          _mesa_log("%s\n", sh->Source);
       }
 
+      sh->CompileAsync = false;
+      if (queue_shader_compile(ctx, sh))
+         return;
+
       /* this call will set the shader->CompileStatus field to indicate if
        * compilation was successful.
        */
@@ -1026,6 +1111,7 @@ static void
 link_program(struct gl_context *ctx, GLuint program)
 {
    struct gl_shader_program *shProg;
+   GLuint i;
 
    shProg = _mesa_lookup_shader_program_err(ctx, program, "glLinkProgram");
    if (!shProg)
@@ -1044,6 +1130,10 @@ link_program(struct gl_context *ctx, GLuint program)
 
    FLUSH_VERTICES(ctx, _NEW_PROGRAM);
 
+   /* Collect the attached shaders still compiling on the compile queue. */
+   for (i = 0; i < shProg->NumShaders; i++)
+      _mesa_finish_shader_compile(shProg->Shaders[i]);
+
    _mesa_glsl_link_shader(ctx, shProg);
 
    if (shProg->LinkStatus == GL_FALSE &&
@@ -1054,8 +1144,6 @@ link_program(struct gl_context *ctx, GLuint program)
 
    /* debug code */
    if (0) {
-      GLuint i;
-
       printf("Link %u shaders in program %u: %s\n",
                    shProg->NumShaders, shProg->Name,
                    shProg->LinkStatus ? "Success" : "Failed");
@@ -92,6 +92,7 @@ void
 _mesa_init_shader(struct gl_context *ctx, struct gl_shader *shader)
 {
    shader->RefCount = 1;
+   util_queue_fence_init(&shader->CompileFence);
 }
 
 /**
@@ -120,6 +121,10 @@ _mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   /* A compile thread may still be using the source and the IR. */
+   _mesa_finish_shader_compile(sh);
+   util_queue_fence_destroy(&sh->CompileFence);
+
    free((void *)sh->Source);
    free(sh->Label);
    _mesa_reference_program(ctx, &sh->Program, NULL);
@@ -85,6 +85,16 @@ _mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type);
 extern void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh);
 
+/**
+ * Wait for an asynchronous compile of \p sh, if one is in flight.
+ */
+static inline void
+_mesa_finish_shader_compile(struct gl_shader *sh)
+{
+   if (!util_queue_fence_is_signalled(&sh->CompileFence))
+      util_queue_fence_wait(&sh->CompileFence);
+}
+
 extern struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name);
 
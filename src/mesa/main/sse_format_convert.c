@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "main/sse_format_convert.h"
+#include "main/formats.h"
+#include <smmintrin.h>
+#include <string.h>
+
+/**
+ * Build the PSHUFB control applying \p swizzle to each of the four 4-byte
+ * pixels of a register, and the value to OR in afterwards for
+ * MESA_FORMAT_SWIZZLE_ONE channels.  Constant channels are zeroed by the
+ * shuffle itself (control byte 0x80).
+ */
+static void
+build_ubyte4_shuffle(const uint8_t swizzle[4], uint8_t one,
+                     __m128i *shuffle, __m128i *ones)
+{
+   uint8_t shuffle_bytes[16], ones_bytes[16];
+   unsigned p, c;
+
+   for (p = 0; p < 4; p++) {
+      for (c = 0; c < 4; c++) {
+         if (swizzle[c] <= MESA_FORMAT_SWIZZLE_W) {
+            shuffle_bytes[p * 4 + c] = p * 4 + swizzle[c];
+            ones_bytes[p * 4 + c] = 0;
+         } else {
+            shuffle_bytes[p * 4 + c] = 0x80;
+            ones_bytes[p * 4 + c] =
+               swizzle[c] == MESA_FORMAT_SWIZZLE_ONE ? one : 0;
+         }
+      }
+   }
+
+   *shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   *ones = _mm_loadu_si128((const __m128i *) ones_bytes);
+}
+
+static inline __m128i
+load_pixel(const void *src)
+{
+   int32_t pixel;
+
+   memcpy(&pixel, src, sizeof(pixel));
+   return _mm_cvtsi32_si128(pixel);
+}
+
+static inline void
+store_pixel(void *dst, __m128i v)
+{
+   const int32_t pixel = _mm_cvtsi128_si32(v);
+
+   memcpy(dst, &pixel, sizeof(pixel));
+}
+
+void
+_mesa_sse_swizzle_ubyte4(uint8_t *dst, const uint8_t *src,
+                         const uint8_t swizzle[4], uint8_t one,
+                         unsigned count)
+{
+   __m128i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, one, &shuffle, &ones);
+
+   for (; i + 4 <= count; i += 4) {
+      __m128i px = _mm_loadu_si128((const __m128i *) &src[i * 4]);
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      _mm_storeu_si128((__m128i *) &dst[i * 4], px);
+   }
+
+   for (; i < count; i++) {
+      __m128i px = load_pixel(&src[i * 4]);
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      store_pixel(&dst[i * 4], px);
+   }
+}
+
+void
+_mesa_sse_ubyte4_to_float4(float *dst, const uint8_t *src,
+                           const uint8_t swizzle[4], bool normalized,
+                           unsigned count)
+{
+   /* Same expression as _mesa_unorm_to_float(), so the results are
+    * bit-identical to the scalar path.
+    */
+   const __m128 scale = _mm_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+   __m128i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, normalized ? 255 : 1, &shuffle, &ones);
+
+   for (; i + 4 <= count; i += 4) {
+      __m128i px = _mm_loadu_si128((const __m128i *) &src[i * 4]);
+      unsigned p;
+
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      for (p = 0; p < 4; p++) {
+         const __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(px));
+         _mm_storeu_ps(&dst[(i + p) * 4], _mm_mul_ps(f, scale));
+         px = _mm_srli_si128(px, 4);
+      }
+   }
+
+   for (; i < count; i++) {
+      __m128i px = load_pixel(&src[i * 4]);
+      __m128 f;
+
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(px));
+      _mm_storeu_ps(&dst[i * 4], _mm_mul_ps(f, scale));
+   }
+}
+
+/**
+ * Equivalent of _mesa_float_to_unorm(x, 8) on four channels: MAXPS returns
+ * its second operand when the first is NaN, so NaN becomes 0 like in the
+ * scalar version, and CVTPS2DQ rounds to nearest even like
+ * _mesa_lroundevenf().
+ */
+static inline __m128i
+float4_to_unorm8(__m128 f)
+{
+   f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   return _mm_cvtps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.0f)));
+}
+
+void
+_mesa_sse_float4_to_unorm8_4(uint8_t *dst, const float *src,
+                             const uint8_t swizzle[4], unsigned count)
+{
+   __m128i shuffle, ones;
+   unsigned i = 0;
+
+   build_ubyte4_shuffle(swizzle, 255, &shuffle, &ones);
+
+   for (; i + 4 <= count; i += 4) {
+      const __m128i p0 = float4_to_unorm8(_mm_loadu_ps(&src[i * 4 + 0]));
+      const __m128i p1 = float4_to_unorm8(_mm_loadu_ps(&src[i * 4 + 4]));
+      const __m128i p2 = float4_to_unorm8(_mm_loadu_ps(&src[i * 4 + 8]));
+      const __m128i p3 = float4_to_unorm8(_mm_loadu_ps(&src[i * 4 + 12]));
+      __m128i px = _mm_packus_epi16(_mm_packus_epi32(p0, p1),
+                                    _mm_packus_epi32(p2, p3));
+
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      _mm_storeu_si128((__m128i *) &dst[i * 4], px);
+   }
+
+   for (; i < count; i++) {
+      const __m128i p = float4_to_unorm8(_mm_loadu_ps(&src[i * 4]));
+      __m128i px = _mm_packus_epi16(_mm_packus_epi32(p, p), p);
+
+      px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), ones);
+      store_pixel(&dst[i * 4], px);
+   }
+}
+
+void
+_mesa_sse_unpack_rgb10a2_unorm_float(float *dst, const uint32_t *src,
+                                     bool bgr, unsigned count)
+{
+   /* Same expressions as _mesa_unorm_to_float() in the generated unpack
+    * functions.
+    */
+   const __m128 scale10 = _mm_set1_ps(1.0f / 1023.0f);
+   const __m128 scale2 = _mm_set1_ps(1.0f / 3.0f);
+   const __m128i mask10 = _mm_set1_epi32(0x3ff);
+   unsigned i = 0;
+
+   /* Unpack four pixels into one register per channel, then transpose. */
+   for (; i + 4 <= count; i += 4) {
+      const __m128i px = _mm_loadu_si128((const __m128i *) &src[i]);
+      __m128 c0 = _mm_cvtepi32_ps(_mm_and_si128(px, mask10));
+      __m128 c1 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 10),
+                                                mask10));
+      __m128 c2 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 20),
+                                                mask10));
+      __m128 c3 = _mm_cvtepi32_ps(_mm_srli_epi32(px, 30));
+      __m128 r, g, b, a;
+
+      c0 = _mm_mul_ps(c0, scale10);
+      c1 = _mm_mul_ps(c1, scale10);
+      c2 = _mm_mul_ps(c2, scale10);
+      c3 = _mm_mul_ps(c3, scale2);
+
+      r = bgr ? c2 : c0;
+      g = c1;
+      b = bgr ? c0 : c2;
+      a = c3;
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+
+      _mm_storeu_ps(&dst[(i + 0) * 4], r);
+      _mm_storeu_ps(&dst[(i + 1) * 4], g);
+      _mm_storeu_ps(&dst[(i + 2) * 4], b);
+      _mm_storeu_ps(&dst[(i + 3) * 4], a);
+   }
+
+   for (; i < count; i++) {
+      const uint32_t px = src[i];
+      const float c0 = (float) (px & 0x3ff) * (1.0f / 1023.0f);
+      const float c2 = (float) ((px >> 20) & 0x3ff) * (1.0f / 1023.0f);
+
+      dst[i * 4 + 0] = bgr ? c2 : c0;
+      dst[i * 4 + 1] = (float) ((px >> 10) & 0x3ff) * (1.0f / 1023.0f);
+      dst[i * 4 + 2] = bgr ? c0 : c2;
+      dst[i * 4 + 3] = (float) (px >> 30) * (1.0f / 3.0f);
+   }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* SSSE3/SSE 4.1 kernels for the most common _mesa_swizzle_and_convert()
+ * and _mesa_format_convert() cases.
+ *
+ * All of them handle 4-channel pixels.  The swizzle has the same meaning as
+ * for _mesa_swizzle_and_convert(), with MESA_FORMAT_SWIZZLE_ZERO/ONE for
+ * constant channels.  Source and destination may only alias when they have
+ * the same pixel size.
+ */
+
+#ifndef SSE_FORMAT_CONVERT_H
+#define SSE_FORMAT_CONVERT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void
+_mesa_sse_swizzle_ubyte4(uint8_t *dst, const uint8_t *src,
+                         const uint8_t swizzle[4], uint8_t one,
+                         unsigned count);
+
+void
+_mesa_sse_ubyte4_to_float4(float *dst, const uint8_t *src,
+                           const uint8_t swizzle[4], bool normalized,
+                           unsigned count);
+
+void
+_mesa_sse_float4_to_unorm8_4(uint8_t *dst, const float *src,
+                             const uint8_t swizzle[4], unsigned count);
+
+void
+_mesa_sse_unpack_rgb10a2_unorm_float(float *dst, const uint32_t *src,
+                                     bool bgr, unsigned count);
+
+#endif /* SSE_FORMAT_CONVERT_H */
@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "main/sse_index.h"
+#include <smmintrin.h>
+#include <string.h>
+
+static inline __m128i
+splat(unsigned value, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_set1_epi8(value);
+   case 2:
+      return _mm_set1_epi16(value);
+   default:
+      return _mm_set1_epi32(value);
+   }
+}
+
+static inline __m128i
+cmpeq(__m128i a, __m128i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_cmpeq_epi8(a, b);
+   case 2:
+      return _mm_cmpeq_epi16(a, b);
+   default:
+      return _mm_cmpeq_epi32(a, b);
+   }
+}
+
+static inline __m128i
+sub(__m128i a, __m128i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_sub_epi8(a, b);
+   case 2:
+      return _mm_sub_epi16(a, b);
+   default:
+      return _mm_sub_epi32(a, b);
+   }
+}
+
+static inline unsigned
+read_index(const uint8_t *indices, unsigned i, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return indices[i];
+   case 2:
+      return ((const uint16_t *) indices)[i];
+   default:
+      return ((const uint32_t *) indices)[i];
+   }
+}
+
+static inline void
+write_index(uint8_t *indices, unsigned i, unsigned index_size,
+            unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      indices[i] = value;
+      break;
+   case 2:
+      ((uint16_t *) indices)[i] = value;
+      break;
+   default:
+      ((uint32_t *) indices)[i] = value;
+      break;
+   }
+}
+
+/**
+ * Compare 64 bytes of indices at a time, which finds nothing in the common
+ * case, then locate the match within the vector that hit.
+ */
+static inline unsigned
+find_index(const uint8_t *indices, unsigned index_size,
+           unsigned i, unsigned end, unsigned value)
+{
+   const unsigned per_vec = 16 / index_size;
+   const __m128i v = splat(value, index_size);
+
+   for (; i + 4 * per_vec <= end; i += 4 * per_vec) {
+      const __m128i *p = (const __m128i *) &indices[i * index_size];
+      const __m128i eq0 = cmpeq(_mm_loadu_si128(p + 0), v, index_size);
+      const __m128i eq1 = cmpeq(_mm_loadu_si128(p + 1), v, index_size);
+      const __m128i eq2 = cmpeq(_mm_loadu_si128(p + 2), v, index_size);
+      const __m128i eq3 = cmpeq(_mm_loadu_si128(p + 3), v, index_size);
+
+      if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(eq0, eq1),
+                                         _mm_or_si128(eq2, eq3))))
+         break;
+   }
+
+   for (; i + per_vec <= end; i += per_vec) {
+      const __m128i *p = (const __m128i *) &indices[i * index_size];
+      const int mask =
+         _mm_movemask_epi8(cmpeq(_mm_loadu_si128(p), v, index_size));
+
+      if (mask)
+         return i + __builtin_ctz(mask) / index_size;
+   }
+
+   for (; i < end; i++) {
+      if (read_index(indices, i, index_size) == value)
+         return i;
+   }
+
+   return end;
+}
+
+/**
+ * Return the position of the first element of [\p start, \p end) in
+ * \p indices that equals \p value, or \p end if there is none.  \p value
+ * must fit in \p index_size bytes.
+ */
+unsigned
+_mesa_sse_find_index(const void *indices, unsigned index_size,
+                     unsigned start, unsigned end, unsigned value)
+{
+   switch (index_size) {
+   case 1:
+      return find_index(indices, 1, start, end, value);
+   case 2:
+      return find_index(indices, 2, start, end, value);
+   default:
+      return find_index(indices, 4, start, end, value);
+   }
+}
+
+static inline void
+rebase_indices(uint8_t *dst, const uint8_t *src, unsigned index_size,
+               unsigned count, unsigned min_index)
+{
+   const unsigned per_vec = 16 / index_size;
+   const __m128i min = splat(min_index, index_size);
+   unsigned i;
+
+   for (i = 0; i + per_vec <= count; i += per_vec) {
+      const __m128i in =
+         _mm_loadu_si128((const __m128i *) &src[i * index_size]);
+
+      _mm_storeu_si128((__m128i *) &dst[i * index_size],
+                       sub(in, min, index_size));
+   }
+
+   for (; i < count; i++) {
+      write_index(dst, i, index_size,
+                  read_index(src, i, index_size) - min_index);
+   }
+}
+
+/**
+ * dst[i] = src[i] - min_index, wrapping around like the scalar code does.
+ */
+void
+_mesa_sse_rebase_indices(void *dst, const void *src, unsigned index_size,
+                         unsigned count, unsigned min_index)
+{
+   switch (index_size) {
+   case 1:
+      rebase_indices(dst, src, 1, count, min_index);
+      break;
+   case 2:
+      rebase_indices(dst, src, 2, count, min_index);
+      break;
+   default:
+      rebase_indices(dst, src, 4, count, min_index);
+      break;
+   }
+}
+
+/**
+ * Zero-extend \p count 1- or 2-byte indices to 32 bits.
+ */
+void
+_mesa_sse_widen_indices(uint32_t *dst, const void *src, unsigned index_size,
+                        unsigned count)
+{
+   unsigned i = 0;
+
+   if (index_size == 1) {
+      const uint8_t *in = src;
+
+      for (; i + 16 <= count; i += 16) {
+         const __m128i b = _mm_loadu_si128((const __m128i *) &in[i]);
+
+         _mm_storeu_si128((__m128i *) &dst[i + 0], _mm_cvtepu8_epi32(b));
+         _mm_storeu_si128((__m128i *) &dst[i + 4],
+                          _mm_cvtepu8_epi32(_mm_srli_si128(b, 4)));
+         _mm_storeu_si128((__m128i *) &dst[i + 8],
+                          _mm_cvtepu8_epi32(_mm_srli_si128(b, 8)));
+         _mm_storeu_si128((__m128i *) &dst[i + 12],
+                          _mm_cvtepu8_epi32(_mm_srli_si128(b, 12)));
+      }
+
+      for (; i < count; i++)
+         dst[i] = in[i];
+   } else {
+      const uint16_t *in = src;
+
+      for (; i + 8 <= count; i += 8) {
+         const __m128i w = _mm_loadu_si128((const __m128i *) &in[i]);
+
+         _mm_storeu_si128((__m128i *) &dst[i + 0], _mm_cvtepu16_epi32(w));
+         _mm_storeu_si128((__m128i *) &dst[i + 4],
+                          _mm_cvtepu16_epi32(_mm_srli_si128(w, 8)));
+      }
+
+      for (; i < count; i++)
+         dst[i] = in[i];
+   }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* SSE 4.1 helpers for the software primitive restart and index rebasing
+ * paths of the vbo module.  Index sizes are 1, 2 or 4 bytes.
+ */
+
+#ifndef SSE_INDEX_H
+#define SSE_INDEX_H
+
+#include <stdint.h>
+
+unsigned
+_mesa_sse_find_index(const void *indices, unsigned index_size,
+                     unsigned start, unsigned end, unsigned value);
+
+void
+_mesa_sse_rebase_indices(void *dst, const void *src, unsigned index_size,
+                         unsigned count, unsigned min_index);
+
+void
+_mesa_sse_widen_indices(uint32_t *dst, const void *src, unsigned index_size,
+                        unsigned count);
+
+#endif /* SSE_INDEX_H */
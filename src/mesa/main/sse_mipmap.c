@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "main/sse_mipmap.h"
+#include <smmintrin.h>
+
+/**
+ * Add horizontally adjacent 2- or 4-channel texels of \p lo and \p hi,
+ * which hold 16-bit channel sums of 16 consecutive source bytes.
+ */
+static inline __m128i
+add_texel_pairs_epi16(__m128i lo, __m128i hi, unsigned comps)
+{
+   if (comps == 4) {
+      return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                           _mm_unpackhi_epi64(lo, hi));
+   } else {
+      const __m128 l = _mm_castsi128_ps(lo), h = _mm_castsi128_ps(hi);
+
+      return _mm_add_epi16(
+         _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(2, 0, 2, 0))),
+         _mm_castps_si128(_mm_shuffle_ps(l, h, _MM_SHUFFLE(3, 1, 3, 1))));
+   }
+}
+
+/**
+ * Sum of the 2x2 blocks of 16 source bytes from each row, as 16-bit
+ * channels.
+ */
+static inline __m128i
+sum_blocks_epi16(__m128i a, __m128i b, unsigned comps)
+{
+   const __m128i zero = _mm_setzero_si128();
+
+   if (comps == 1) {
+      const __m128i ones = _mm_set1_epi8(1);
+
+      return _mm_add_epi16(_mm_maddubs_epi16(a, ones),
+                           _mm_maddubs_epi16(b, ones));
+   }
+
+   return add_texel_pairs_epi16(
+      _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+      _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+      comps);
+}
+
+void
+_mesa_sse_downsample_ubyte(uint8_t *dst, const uint8_t *rowA,
+                           const uint8_t *rowB, unsigned comps,
+                           unsigned dst_width)
+{
+   const unsigned n = dst_width * comps;
+   unsigned i = 0;
+
+   for (; i + 16 <= n; i += 16) {
+      const __m128i a0 = _mm_loadu_si128((const __m128i *) &rowA[2 * i]);
+      const __m128i a1 = _mm_loadu_si128((const __m128i *) &rowA[2 * i + 16]);
+      const __m128i b0 = _mm_loadu_si128((const __m128i *) &rowB[2 * i]);
+      const __m128i b1 = _mm_loadu_si128((const __m128i *) &rowB[2 * i + 16]);
+      const __m128i s0 = _mm_srli_epi16(sum_blocks_epi16(a0, b0, comps), 2);
+      const __m128i s1 = _mm_srli_epi16(sum_blocks_epi16(a1, b1, comps), 2);
+
+      _mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(s0, s1));
+   }
+
+   for (; i < n; i++) {
+      const unsigned j = 2 * i - i % comps;
+
+      dst[i] = (rowA[j] + rowA[j + comps] + rowB[j] + rowB[j + comps]) >> 2;
+   }
+}
+
+void
+_mesa_sse_downsample_float(float *dst, const float *rowA, const float *rowB,
+                           unsigned comps, unsigned dst_width)
+{
+   const unsigned n = dst_width * comps;
+   const __m128 quarter = _mm_set1_ps(0.25F);
+   unsigned i = 0;
+
+   for (; i + 4 <= n; i += 4) {
+      const __m128 a0 = _mm_loadu_ps(&rowA[2 * i]);
+      const __m128 a1 = _mm_loadu_ps(&rowA[2 * i + 4]);
+      const __m128 b0 = _mm_loadu_ps(&rowB[2 * i]);
+      const __m128 b1 = _mm_loadu_ps(&rowB[2 * i + 4]);
+      __m128 aj, ak, bj, bk, sum;
+
+      /* Split the left (j) and right (k) texels of each block. */
+      if (comps == 4) {
+         aj = a0, ak = a1, bj = b0, bk = b1;
+      } else if (comps == 2) {
+         aj = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 1, 0));
+         ak = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 2, 3, 2));
+         bj = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(1, 0, 1, 0));
+         bk = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 2, 3, 2));
+      } else {
+         aj = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0));
+         ak = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1));
+         bj = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0));
+         bk = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1));
+      }
+
+      /* Same order of operations as do_row(). */
+      sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(aj, ak), bj), bk);
+      _mm_storeu_ps(&dst[i], _mm_mul_ps(sum, quarter));
+   }
+
+   for (; i < n; i++) {
+      const unsigned j = 2 * i - i % comps;
+
+      dst[i] = (rowA[j] + rowA[j + comps] + rowB[j] + rowB[j + comps]) * 0.25F;
+   }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* SSSE3/SSE 4.1 versions of the 2:1 box filters of mipmap.c's do_row().
+ *
+ * Each averages 2x2 blocks of texels from two source rows into dst_width
+ * destination texels of 1, 2 or 4 channels, with the same rounding as the
+ * scalar code.
+ */
+
+#ifndef SSE_MIPMAP_H
+#define SSE_MIPMAP_H
+
+#include <stdint.h>
+
+void
+_mesa_sse_downsample_ubyte(uint8_t *dst, const uint8_t *rowA,
+                           const uint8_t *rowB, unsigned comps,
+                           unsigned dst_width);
+
+void
+_mesa_sse_downsample_float(float *dst, const float *rowA, const float *rowB,
+                           unsigned comps, unsigned dst_width);
+
+#endif /* SSE_MIPMAP_H */
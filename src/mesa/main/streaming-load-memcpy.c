@@ -86,3 +86,78 @@ _mesa_streaming_load_memcpy(void *restrict dst, void *restrict src, size_t len)
       memcpy(d, s, len);
    }
 }
+
+/* Same as _mesa_streaming_load_memcpy(), but also writes dst with
+ * non-temporal stores.
+ */
+void
+_mesa_streaming_copy(void *restrict dst, const void *restrict src, size_t len)
+{
+   char *restrict d = dst;
+   char *restrict s = (char *) src;
+
+   /* memcpy() up to the first 16-byte boundary of the destination, which
+    * MOVNTDQ requires.
+    */
+   if ((uintptr_t)d & 15) {
+      const size_t head = MIN2(16 - ((uintptr_t)d & 15), len);
+
+      memcpy(d, s, head);
+      d += head;
+      s += head;
+      len -= head;
+   }
+
+   if (len < 64) {
+      memcpy(d, s, len);
+      return;
+   }
+
+   if (((uintptr_t)s & 15) == 0) {
+      _mm_mfence();
+
+      while (len >= 64) {
+         __m128i *src_cacheline = (__m128i *)s;
+         __m128i temp1 = _mm_stream_load_si128(src_cacheline + 0);
+         __m128i temp2 = _mm_stream_load_si128(src_cacheline + 1);
+         __m128i temp3 = _mm_stream_load_si128(src_cacheline + 2);
+         __m128i temp4 = _mm_stream_load_si128(src_cacheline + 3);
+
+         _mm_stream_si128((__m128i *)d + 0, temp1);
+         _mm_stream_si128((__m128i *)d + 1, temp2);
+         _mm_stream_si128((__m128i *)d + 2, temp3);
+         _mm_stream_si128((__m128i *)d + 3, temp4);
+
+         d += 64;
+         s += 64;
+         len -= 64;
+      }
+   }
+   else {
+      /* The source isn't co-aligned; streaming stores still help. */
+      while (len >= 64) {
+         __m128i *src_cacheline = (__m128i *)s;
+         __m128i temp1 = _mm_loadu_si128(src_cacheline + 0);
+         __m128i temp2 = _mm_loadu_si128(src_cacheline + 1);
+         __m128i temp3 = _mm_loadu_si128(src_cacheline + 2);
+         __m128i temp4 = _mm_loadu_si128(src_cacheline + 3);
+
+         _mm_stream_si128((__m128i *)d + 0, temp1);
+         _mm_stream_si128((__m128i *)d + 1, temp2);
+         _mm_stream_si128((__m128i *)d + 2, temp3);
+         _mm_stream_si128((__m128i *)d + 3, temp4);
+
+         d += 64;
+         s += 64;
+         len -= 64;
+      }
+   }
+
+   /* Make the non-temporal stores visible before the buffer is unmapped. */
+   _mm_sfence();
+
+   /* memcpy() the tail. */
+   if (len) {
+      memcpy(d, s, len);
+   }
+}
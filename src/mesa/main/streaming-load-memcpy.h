@@ -31,3 +31,10 @@
  */
 void
 _mesa_streaming_load_memcpy(void *restrict dst, void *restrict src, size_t len);
+
+/* Same as _mesa_streaming_load_memcpy(), but also writes dst with
+ * non-temporal stores, so that large copies into memory the CPU won't read
+ * again soon (a pixel buffer object, typically) don't evict the cache.
+ */
+void
+_mesa_streaming_copy(void *restrict dst, const void *restrict src, size_t len);
@@ -0,0 +1,821 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name dlist_merge.cpp
+ *
+ * Check that a run of vertex lists and attribute commands merged by
+ * vbo_save_merge (MESA_DLIST_MERGE) replays the same primitives, with the
+ * same vertex attributes, as the unmerged run, and leaves the same current
+ * values behind.
+ *
+ * Both forms are replayed on the CPU the way vbo_save_playback_vertex_list()
+ * does it: attributes missing from a list come from the current values, and
+ * each list updates the current values when it is done.  Primitives are
+ * compared after splitting strips, fans and loops into independent points,
+ * lines and triangles, since the merger joins consecutive glBegin/End blocks.
+ *
+ * DlistMergeContextTest does the same through a real context: it compiles
+ * one display list with merging and one without, replays both with
+ * glCallList() into a draw function that records what it is given, and
+ * compares the recordings.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/mtypes.h"
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/vtxfmt.h"
+#include "drivers/common/driverfuncs.h"
+#include "vbo/vbo_context.h"
+
+extern "C" {
+#include "main/bufferobj.h"
+#include "main/framebuffer.h"
+}
+
+#ifndef GLAPIENTRYP
+#define GLAPIENTRYP GL_APIENTRYP
+#endif
+
+#include "main/dispatch.h"
+
+namespace {
+
+/** Any extension opcode works, the merger only compares it. */
+const GLuint opcode_vertex_list = 0xfff0;
+
+/** Display list nodes are 4 bytes, a block is 256 of them. */
+const unsigned block_nodes = 256;
+
+/** The attributes the tests use, in vertex order. */
+const GLuint test_attribs[] = {
+   VBO_ATTRIB_POS,
+   VBO_ATTRIB_NORMAL,
+   VBO_ATTRIB_COLOR0,
+   VBO_ATTRIB_TEX0,
+};
+
+struct vertex {
+   GLfloat v[ARRAY_SIZE(test_attribs)][4];
+
+   bool operator==(const vertex &other) const
+   {
+      return memcmp(v, other.v, sizeof(v)) == 0;
+   }
+};
+
+/** An independent point, line or triangle. */
+struct primitive {
+   GLenum mode;
+   GLfloat line_width;          /**< only set by DlistMergeContextTest */
+   std::vector<vertex> verts;
+};
+
+typedef GLfloat current_values[VBO_ATTRIB_MAX][4];
+
+/** Store \p size floats as a 4-component attribute, like the GL does. */
+void
+set_attr(GLfloat *dst, const GLfloat *src, GLuint size)
+{
+   static const GLfloat defaults[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+   memcpy(dst, defaults, sizeof(defaults));
+   memcpy(dst, src, size * sizeof(GLfloat));
+}
+
+/**
+ * Split a primitive of \p mode into independent points, lines and
+ * triangles.
+ */
+void
+split_primitive(GLenum mode, const std::vector<vertex> &v,
+                std::vector<primitive> &out)
+{
+   const unsigned n = v.size();
+   primitive p;
+
+   p.line_width = 0.0f;
+
+#define EMIT(m, ...)                                      \
+   do {                                                   \
+      const unsigned idx[] = { __VA_ARGS__ };             \
+      p.mode = m;                                         \
+      p.verts.clear();                                    \
+      for (unsigned k = 0; k < ARRAY_SIZE(idx); k++)      \
+         p.verts.push_back(v[idx[k]]);                    \
+      out.push_back(p);                                   \
+   } while (0)
+
+   switch (mode) {
+   case GL_POINTS:
+      for (unsigned i = 0; i < n; i++)
+         EMIT(GL_POINTS, i);
+      break;
+   case GL_LINES:
+      for (unsigned i = 0; i + 1 < n; i += 2)
+         EMIT(GL_LINES, i, i + 1);
+      break;
+   case GL_LINE_STRIP:
+   case GL_LINE_LOOP:
+      for (unsigned i = 0; i + 1 < n; i++)
+         EMIT(GL_LINES, i, i + 1);
+      if (mode == GL_LINE_LOOP && n > 2)
+         EMIT(GL_LINES, n - 1, 0);
+      break;
+   case GL_TRIANGLES:
+      for (unsigned i = 0; i + 2 < n; i += 3)
+         EMIT(GL_TRIANGLES, i, i + 1, i + 2);
+      break;
+   case GL_TRIANGLE_STRIP:
+      for (unsigned i = 0; i + 2 < n; i++) {
+         if (i % 2)
+            EMIT(GL_TRIANGLES, i + 1, i, i + 2);
+         else
+            EMIT(GL_TRIANGLES, i, i + 1, i + 2);
+      }
+      break;
+   case GL_TRIANGLE_FAN:
+      for (unsigned i = 1; i + 1 < n; i++)
+         EMIT(GL_TRIANGLES, 0, i, i + 1);
+      break;
+   default:
+      ADD_FAILURE() << "unexpected primitive mode " << mode;
+      break;
+   }
+
+#undef EMIT
+}
+
+class DlistMergeTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void attr(GLuint attr, GLuint size, const GLfloat *v);
+   void list(const GLubyte *attrsz, const std::vector<GLfloat> &verts,
+             const std::vector<struct _mesa_prim> &prims);
+   struct vbo_save_vertex_list *emit();
+   void replay_list(const struct vbo_save_vertex_list *node,
+                    current_values current, std::vector<primitive> &out);
+   void check_merge();
+
+   struct gl_context ctx;
+   struct vbo_context *vbo;
+   struct vbo_save_merge *merge;
+   std::vector<GLuint> block;
+
+   /** The run, in order: lists, or NULL for attribute commands */
+   std::vector<struct vbo_save_vertex_list *> items;
+   std::vector<std::vector<GLfloat> > attr_values;
+   std::vector<GLuint> attr_index;
+
+   /** What the merged list ended up with */
+   GLuint merged_prims, merged_verts;
+};
+
+void
+DlistMergeTest::SetUp()
+{
+   memset(&ctx, 0, sizeof(ctx));
+   _mesa_init_buffer_object_functions(&ctx.Driver);
+   ctx.Const.MinMapBufferAlignment = 64;
+
+   vbo = (struct vbo_context *) calloc(1, sizeof(*vbo));
+   vbo->save.opcode_vertex_list = opcode_vertex_list;
+   ctx.vbo_context = vbo;
+
+   /* Where vbo_save_merge_emit() puts the merged list. */
+   block.resize(block_nodes);
+   ctx.ListState.CurrentBlock = (union gl_dlist_node *) &block[0];
+   ctx.ListState.CurrentPos = 0;
+
+   merged_prims = 0;
+   merged_verts = 0;
+
+   merge = vbo_save_merge_create();
+   ASSERT_TRUE(merge != NULL);
+}
+
+void
+DlistMergeTest::TearDown()
+{
+   for (unsigned i = 0; i < items.size(); i++) {
+      struct vbo_save_vertex_list *node = items[i];
+
+      if (node) {
+         _mesa_reference_buffer_object(&ctx, &node->vertex_store->bufferobj,
+                                       NULL);
+         free(node->vertex_store);
+         free(node->prim);
+         free(node);
+      }
+   }
+
+   vbo_save_merge_destroy(merge);
+   free(vbo);
+}
+
+/** Add an attribute command to the run. */
+void
+DlistMergeTest::attr(GLuint attr, GLuint size, const GLfloat *v)
+{
+   EXPECT_TRUE(vbo_save_merge_attr(merge, attr, size, v));
+
+   items.push_back(NULL);
+   attr_values.push_back(std::vector<GLfloat>(v, v + size));
+   attr_index.push_back(attr);
+}
+
+/**
+ * Add a vertex list to the run, as vbo_save would compile it from a
+ * glBegin/End block.
+ */
+void
+DlistMergeTest::list(const GLubyte *attrsz, const std::vector<GLfloat> &verts,
+                     const std::vector<struct _mesa_prim> &prims)
+{
+   struct vbo_save_vertex_list *node =
+      (struct vbo_save_vertex_list *) calloc(1, sizeof(*node));
+   struct gl_buffer_object *obj;
+
+   for (unsigned i = 0; i < VBO_ATTRIB_MAX; i++) {
+      node->attrsz[i] = attrsz[i];
+      node->attrtype[i] = GL_FLOAT;
+      node->vertex_size += attrsz[i];
+   }
+   node->count = verts.size() / node->vertex_size;
+   node->prim_count = prims.size();
+   node->prim = (struct _mesa_prim *)
+      malloc(prims.size() * sizeof(struct _mesa_prim));
+   memcpy(node->prim, &prims[0], prims.size() * sizeof(struct _mesa_prim));
+
+   /* Put the vertices at an offset into the buffer, like vbo_save does
+    * when lists share a vertex store.
+    */
+   node->buffer_offset = 16;
+   obj = ctx.Driver.NewBufferObject(&ctx, 1);
+   ASSERT_TRUE(ctx.Driver.BufferData(&ctx, GL_ARRAY_BUFFER_ARB,
+                                     16 + verts.size() * sizeof(GLfloat),
+                                     NULL, GL_STATIC_DRAW_ARB,
+                                     GL_MAP_WRITE_BIT |
+                                     GL_DYNAMIC_STORAGE_BIT, obj));
+   ctx.Driver.BufferSubData(&ctx, 16, verts.size() * sizeof(GLfloat),
+                            &verts[0], obj);
+   node->vertex_store = (struct vbo_save_vertex_store *)
+      calloc(1, sizeof(*node->vertex_store));
+   node->vertex_store->bufferobj = obj;
+   node->vertex_store->refcount = 1;
+
+   EXPECT_TRUE(vbo_save_merge_list(&ctx, merge, opcode_vertex_list, node));
+
+   items.push_back(node);
+   attr_values.push_back(std::vector<GLfloat>());
+   attr_index.push_back(0);
+}
+
+/** Merge the run and return the new vertex list. */
+struct vbo_save_vertex_list *
+DlistMergeTest::emit()
+{
+   const unsigned payload_nodes =
+      (sizeof(struct vbo_save_vertex_list) + 3) / 4;
+
+   if (!vbo_save_merge_emit(&ctx, merge))
+      return NULL;
+
+   /* The list is the payload of the last instruction in the block. */
+   return (struct vbo_save_vertex_list *)
+      &block[ctx.ListState.CurrentPos - payload_nodes];
+}
+
+/**
+ * Replay a vertex list the way vbo_save_playback_vertex_list() and
+ * _playback_copy_to_current() do.
+ */
+void
+DlistMergeTest::replay_list(const struct vbo_save_vertex_list *node,
+                            current_values current,
+                            std::vector<primitive> &out)
+{
+   struct gl_buffer_object *obj = node->vertex_store->bufferobj;
+   const char *buffer = (const char *)
+      ctx.Driver.MapBufferRange(&ctx, 0, obj->Size, GL_MAP_READ_BIT, obj,
+                                MAP_INTERNAL);
+   const GLfloat *src = (const GLfloat *) (buffer + node->buffer_offset);
+   const GLushort *elts = (const GLushort *) (buffer + node->index_offset);
+   std::vector<vertex> verts(node->count);
+   unsigned offset[VBO_ATTRIB_MAX];
+   unsigned pos = 0;
+
+   ASSERT_TRUE(buffer != NULL);
+
+   for (unsigned attr = 0; attr < VBO_ATTRIB_MAX; attr++) {
+      offset[attr] = pos;
+      pos += node->attrsz[attr];
+   }
+
+   for (unsigned i = 0; i < node->count; i++) {
+      const GLfloat *in = src + i * node->vertex_size;
+
+      for (unsigned j = 0; j < ARRAY_SIZE(test_attribs); j++) {
+         const GLuint attr = test_attribs[j];
+
+         if (node->attrsz[attr])
+            set_attr(verts[i].v[j], in + offset[attr], node->attrsz[attr]);
+         else
+            memcpy(verts[i].v[j], current[attr], 4 * sizeof(GLfloat));
+      }
+   }
+
+   for (unsigned i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prim[i];
+      std::vector<vertex> prim_verts;
+
+      for (unsigned j = 0; j < prim->count; j++) {
+         const unsigned index = node->index_count ?
+            elts[prim->start + j] : prim->start + j;
+
+         ASSERT_LT(index, node->count);
+         prim_verts.push_back(verts[index]);
+      }
+
+      split_primitive(prim->mode, prim_verts, out);
+   }
+
+   const GLfloat *last = node->current_data ?
+      (const GLfloat *) node->current_data :
+      src + (node->count - 1) * node->vertex_size + node->attrsz[0];
+
+   for (unsigned attr = VBO_ATTRIB_POS + 1; attr < VBO_ATTRIB_MAX; attr++) {
+      if (node->attrsz[attr]) {
+         set_attr(current[attr], last, node->attrsz[attr]);
+         last += node->attrsz[attr];
+      }
+   }
+
+   ctx.Driver.UnmapBuffer(&ctx, obj, MAP_INTERNAL);
+}
+
+/**
+ * Merge the run, then replay it merged and unmerged and compare the
+ * results.
+ */
+void
+DlistMergeTest::check_merge()
+{
+   current_values unmerged_current, merged_current;
+   std::vector<primitive> unmerged, merged;
+
+   /* Whatever was current when the display list was called. */
+   for (unsigned attr = 0; attr < VBO_ATTRIB_MAX; attr++) {
+      for (unsigned c = 0; c < 4; c++)
+         unmerged_current[attr][c] = 0.25f * c - 0.5f * (attr % 3);
+   }
+   memcpy(merged_current, unmerged_current, sizeof(current_values));
+
+   for (unsigned i = 0; i < items.size(); i++) {
+      if (items[i]) {
+         replay_list(items[i], unmerged_current, unmerged);
+      }
+      else {
+         set_attr(unmerged_current[attr_index[i]], &attr_values[i][0],
+                  attr_values[i].size());
+      }
+   }
+
+   struct vbo_save_vertex_list *node = emit();
+   ASSERT_TRUE(node != NULL);
+
+   EXPECT_GT(node->index_count, 0u);
+   merged_prims = node->prim_count;
+   merged_verts = node->count;
+
+   replay_list(node, merged_current, merged);
+
+   ASSERT_EQ(unmerged.size(), merged.size());
+   for (unsigned i = 0; i < unmerged.size(); i++) {
+      EXPECT_EQ(unmerged[i].mode, merged[i].mode) << "primitive " << i;
+      EXPECT_TRUE(unmerged[i].verts == merged[i].verts) << "primitive " << i;
+   }
+
+   for (unsigned attr = VBO_ATTRIB_POS + 1; attr < VBO_ATTRIB_MAX; attr++) {
+      EXPECT_EQ(0, memcmp(unmerged_current[attr], merged_current[attr],
+                          4 * sizeof(GLfloat)))
+         << "current value of attribute " << attr;
+   }
+
+   _mesa_reference_buffer_object(&ctx, &node->vertex_store->bufferobj, NULL);
+   free(node->vertex_store);
+   free(node->prim);
+   free(node->current_data);
+}
+
+struct _mesa_prim
+make_prim(GLenum mode, GLuint start, GLuint count)
+{
+   struct _mesa_prim prim;
+
+   memset(&prim, 0, sizeof(prim));
+   prim.mode = mode;
+   prim.begin = 1;
+   prim.end = 1;
+   prim.start = start;
+   prim.count = count;
+   prim.num_instances = 1;
+   return prim;
+}
+
+} /* anonymous namespace */
+
+
+/**
+ * The CAD pattern: glColor and glNormal between single-primitive
+ * glBegin/End blocks that only have positions.
+ */
+TEST_F(DlistMergeTest, AttributesBetweenBlocks)
+{
+   GLubyte attrsz[VBO_ATTRIB_MAX] = { 0 };
+   attrsz[VBO_ATTRIB_POS] = 3;
+
+   for (unsigned i = 0; i < 8; i++) {
+      const GLfloat color[3] = { i * 0.125f, 1.0f - i * 0.125f, 0.5f };
+      const GLfloat normal[3] = { 0.0f, 0.0f, i % 2 ? 1.0f : -1.0f };
+      std::vector<GLfloat> verts;
+      std::vector<struct _mesa_prim> prims;
+
+      attr(VBO_ATTRIB_COLOR0, 3, color);
+      attr(VBO_ATTRIB_NORMAL, 3, normal);
+
+      for (unsigned j = 0; j < 3; j++) {
+         verts.push_back(i + j);
+         verts.push_back(j * 2.0f);
+         verts.push_back(0.0f);
+      }
+      prims.push_back(make_prim(GL_TRIANGLES, 0, 3));
+      list(attrsz, verts, prims);
+   }
+
+   check_merge();
+
+   /* One GL_TRIANGLES draw of 24 distinct vertices. */
+   EXPECT_EQ(1u, merged_prims);
+   EXPECT_EQ(24u, merged_verts);
+}
+
+/**
+ * Lists carrying their own colors mixed with lists taking it from a
+ * glColor before them, with line strips and fans that get converted to
+ * independent primitives and shared vertices.
+ */
+TEST_F(DlistMergeTest, MixedFormatsAndModes)
+{
+   const GLfloat color[4] = { 1.0f, 0.0f, 0.0f, 0.5f };
+   GLubyte pos_only[VBO_ATTRIB_MAX] = { 0 };
+   GLubyte pos_color[VBO_ATTRIB_MAX] = { 0 };
+   static const GLenum modes[] = {
+      GL_LINES, GL_LINE_STRIP, GL_TRIANGLE_FAN, GL_TRIANGLE_STRIP,
+      GL_POINTS, GL_LINE_LOOP, GL_TRIANGLES,
+   };
+
+   pos_only[VBO_ATTRIB_POS] = 2;
+   pos_color[VBO_ATTRIB_POS] = 2;
+   pos_color[VBO_ATTRIB_COLOR0] = 4;
+
+   attr(VBO_ATTRIB_COLOR0, 4, color);
+
+   srand(42);
+   for (unsigned i = 0; i < 40; i++) {
+      const bool has_color = rand() % 2;
+      const GLubyte *attrsz = has_color ? pos_color : pos_only;
+      std::vector<GLfloat> verts;
+      std::vector<struct _mesa_prim> prims;
+      unsigned start = 0;
+
+      if (rand() % 4 == 0) {
+         const GLfloat c[4] = { (GLfloat) (rand() % 2), 0.0f, 1.0f, 1.0f };
+         attr(VBO_ATTRIB_COLOR0, 4, c);
+      }
+
+      for (unsigned p = 0; p < 1 + (unsigned) rand() % 3; p++) {
+         const GLenum mode = modes[rand() % ARRAY_SIZE(modes)];
+         const unsigned count = 2 + rand() % 5;
+
+         for (unsigned j = 0; j < count; j++) {
+            /* Few distinct positions and colors, so vertices get shared. */
+            verts.push_back((GLfloat) (rand() % 3));
+            verts.push_back((GLfloat) (rand() % 3));
+            if (has_color) {
+               verts.push_back((GLfloat) (rand() % 2));
+               verts.push_back(1.0f);
+               verts.push_back(0.0f);
+               verts.push_back(1.0f);
+            }
+         }
+
+         prims.push_back(make_prim(mode, start, count));
+         start += count;
+      }
+
+      list(attrsz, verts, prims);
+   }
+
+   check_merge();
+
+   /* 9 positions with 5 colors, so vertices are shared. */
+   EXPECT_LE(merged_verts, 45u);
+}
+
+/**
+ * Lists with several attributes and primitives, so the current values
+ * are left as the last vertex of the last list set them.
+ */
+TEST_F(DlistMergeTest, CurrentValuesFromLists)
+{
+   GLubyte attrsz[VBO_ATTRIB_MAX] = { 0 };
+   attrsz[VBO_ATTRIB_POS] = 3;
+   attrsz[VBO_ATTRIB_NORMAL] = 3;
+   attrsz[VBO_ATTRIB_TEX0] = 2;
+
+   for (unsigned i = 0; i < 4; i++) {
+      std::vector<GLfloat> verts;
+      std::vector<struct _mesa_prim> prims;
+
+      for (unsigned j = 0; j < 4; j++) {
+         const GLfloat v[8] = {
+            (GLfloat) j, (GLfloat) i, 1.0f,
+            0.0f, 1.0f, 0.0f,
+            j * 0.25f, i * 0.25f,
+         };
+         verts.insert(verts.end(), v, v + 8);
+      }
+      prims.push_back(make_prim(GL_LINES, 0, 2));
+      prims.push_back(make_prim(GL_LINES, 2, 2));
+      list(attrsz, verts, prims);
+   }
+
+   check_merge();
+}
+
+
+namespace {
+
+/** What record_draw() appends to */
+std::vector<primitive> *recording;
+unsigned recorded_draws;
+
+/**
+ * Return the address of the storage of \p obj, mapping it if needed, or 0
+ * for client memory.
+ */
+uintptr_t
+buffer_address(struct gl_context *ctx, struct gl_buffer_object *obj)
+{
+   if (!obj || !_mesa_is_bufferobj(obj))
+      return 0;
+
+   if (!_mesa_bufferobj_mapped(obj, MAP_INTERNAL)) {
+      ctx->Driver.MapBufferRange(ctx, 0, obj->Size, GL_MAP_READ_BIT, obj,
+                                 MAP_INTERNAL);
+   }
+   return (uintptr_t) obj->Mappings[MAP_INTERNAL].Pointer;
+}
+
+void
+unmap_buffer(struct gl_context *ctx, struct gl_buffer_object *obj)
+{
+   if (obj && _mesa_bufferobj_mapped(obj, MAP_INTERNAL))
+      ctx->Driver.UnmapBuffer(ctx, obj, MAP_INTERNAL);
+}
+
+/**
+ * A vbo_draw_func that fetches the vertices of every primitive from the
+ * bound arrays and records them, with the line width they are drawn with.
+ */
+void
+record_draw(struct gl_context *ctx, const struct _mesa_prim *prims,
+            GLuint nr_prims, const struct _mesa_index_buffer *ib,
+            GLboolean index_bounds_valid, GLuint min_index, GLuint max_index,
+            struct gl_transform_feedback_object *tfb_vertcount,
+            unsigned stream, struct gl_buffer_object *indirect)
+{
+   const struct gl_client_array **arrays = ctx->Array._DrawArrays;
+   const GLushort *elts = NULL;
+
+   recorded_draws++;
+
+   if (ib) {
+      EXPECT_EQ((GLenum) GL_UNSIGNED_SHORT, ib->type);
+      elts = (const GLushort *)
+         (buffer_address(ctx, ib->obj) + (uintptr_t) ib->ptr);
+   }
+
+   for (unsigned i = 0; i < nr_prims; i++) {
+      const struct _mesa_prim *prim = &prims[i];
+      const size_t first = recording->size();
+      std::vector<vertex> verts(prim->count);
+
+      for (unsigned j = 0; j < prim->count; j++) {
+         const GLuint index = prim->indexed ?
+            elts[prim->start + j] + prim->basevertex : prim->start + j;
+
+         for (unsigned k = 0; k < ARRAY_SIZE(test_attribs); k++) {
+            const struct gl_client_array *array = arrays[test_attribs[k]];
+            const GLfloat *v = (const GLfloat *)
+               (buffer_address(ctx, array->BufferObj) +
+                (uintptr_t) array->Ptr + index * array->StrideB);
+
+            EXPECT_EQ((GLenum) GL_FLOAT, array->Type);
+            set_attr(verts[j].v[k], v, array->Size);
+         }
+      }
+
+      split_primitive(prim->mode, verts, *recording);
+      for (size_t p = first; p < recording->size(); p++)
+         (*recording)[p].line_width = ctx->Line.Width;
+   }
+
+   for (unsigned k = 0; k < ARRAY_SIZE(test_attribs); k++)
+      unmap_buffer(ctx, arrays[test_attribs[k]]->BufferObj);
+   if (ib)
+      unmap_buffer(ctx, ib->obj);
+}
+
+void
+update_state(struct gl_context *ctx, GLuint new_state)
+{
+   _vbo_InvalidateState(ctx, new_state);
+}
+
+class DlistMergeContextTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void compile(GLuint list, bool merge);
+   void replay(GLuint list, std::vector<primitive> &out,
+               struct gl_current_attrib *current, GLfloat *line_width);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+   struct gl_framebuffer *fb;
+};
+
+void
+DlistMergeContextTest::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.UpdateState = update_state;
+   ASSERT_TRUE(_mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual,
+                                        NULL, &driver_functions));
+   _vbo_CreateContext(&ctx);
+   vbo_set_draw_func(&ctx, record_draw);
+
+   ctx.Version = 21;
+   _mesa_initialize_dispatch_tables(&ctx);
+   _mesa_initialize_vbo_vtxfmt(&ctx);
+
+   /* Drawing updates the framebuffer state, so there has to be one. */
+   fb = _mesa_create_framebuffer(&visual);
+   ASSERT_TRUE(fb != NULL);
+   _mesa_make_current(&ctx, fb, fb);
+}
+
+void
+DlistMergeContextTest::TearDown()
+{
+   _vbo_DestroyContext(&ctx);
+   _mesa_free_context_data(&ctx);
+   _mesa_reference_framebuffer(&fb, NULL);
+}
+
+/**
+ * Compile the same CAD-like sequence every time: glBegin/End blocks with
+ * glColor and glNormal between them, which can be merged, and a glLineWidth
+ * now and then, which can't.  The list spans several blocks.
+ */
+void
+DlistMergeContextTest::compile(GLuint list, bool merge)
+{
+   static const GLenum modes[] = {
+      GL_LINES, GL_LINE_STRIP, GL_TRIANGLES, GL_TRIANGLE_FAN, GL_POINTS,
+   };
+
+   ctx.ListState.MergeVertexLists = merge;
+   CALL_NewList(ctx.CurrentDispatch, (list, GL_COMPILE));
+
+   for (unsigned i = 0; i < 40; i++) {
+      if (i % 7 == 6)
+         CALL_LineWidth(ctx.CurrentDispatch, (1.0f + i));
+
+      CALL_Color3f(ctx.CurrentDispatch, (i * 0.025f, 1.0f, 0.5f));
+      if (i % 3 == 0) {
+         const GLfloat z = i % 2 ? 1.0f : -1.0f;
+         CALL_Normal3f(ctx.CurrentDispatch, (0.0f, 0.0f, z));
+      }
+
+      CALL_Begin(ctx.CurrentDispatch, (modes[i % ARRAY_SIZE(modes)]));
+      for (unsigned j = 0; j < 3 + i % 4; j++) {
+         if (i % 4 == 1)
+            CALL_TexCoord2f(ctx.CurrentDispatch, (j * 0.5f, i * 0.125f));
+         CALL_Vertex3f(ctx.CurrentDispatch, ((GLfloat) i, (GLfloat) j, 1.0f));
+      }
+      CALL_End(ctx.CurrentDispatch, ());
+   }
+
+   CALL_EndList(ctx.CurrentDispatch, ());
+   ctx.ListState.MergeVertexLists = false;
+}
+
+/**
+ * Call \p list from the same state every time and record what it draws and
+ * the state it leaves behind.
+ */
+void
+DlistMergeContextTest::replay(GLuint list, std::vector<primitive> &out,
+                              struct gl_current_attrib *current,
+                              GLfloat *line_width)
+{
+   CALL_Color4f(ctx.CurrentDispatch, (0.25f, 0.5f, 0.75f, 1.0f));
+   CALL_Normal3f(ctx.CurrentDispatch, (1.0f, 0.0f, 0.0f));
+   CALL_TexCoord2f(ctx.CurrentDispatch, (0.5f, 0.5f));
+   CALL_LineWidth(ctx.CurrentDispatch, (1.0f));
+
+   recording = &out;
+   recorded_draws = 0;
+   CALL_CallList(ctx.CurrentDispatch, (list));
+   vbo_exec_FlushVertices(&ctx, FLUSH_UPDATE_CURRENT);
+   recording = NULL;
+
+   *current = ctx.Current;
+   *line_width = ctx.Line.Width;
+}
+
+} /* anonymous namespace */
+
+
+/**
+ * Merge through glEndList, with the instructions that can't be merged
+ * copied to the new blocks in order, and check that glCallList draws the
+ * same thing with fewer draws.
+ */
+TEST_F(DlistMergeContextTest, MergedListDrawsTheSame)
+{
+   struct gl_current_attrib unmerged_current, merged_current;
+   std::vector<primitive> unmerged, merged;
+   GLfloat unmerged_width, merged_width;
+   unsigned unmerged_draws;
+
+   compile(1, false);
+   compile(2, true);
+   ASSERT_EQ((GLenum) GL_NO_ERROR, ctx.ErrorValue);
+
+   replay(1, unmerged, &unmerged_current, &unmerged_width);
+   unmerged_draws = recorded_draws;
+   replay(2, merged, &merged_current, &merged_width);
+   ASSERT_EQ((GLenum) GL_NO_ERROR, ctx.ErrorValue);
+
+   EXPECT_LT(recorded_draws, unmerged_draws);
+   EXPECT_GT(recorded_draws, 1u);
+
+   ASSERT_EQ(unmerged.size(), merged.size());
+   for (unsigned i = 0; i < unmerged.size(); i++) {
+      EXPECT_EQ(unmerged[i].mode, merged[i].mode) << "primitive " << i;
+      EXPECT_EQ(unmerged[i].line_width, merged[i].line_width)
+         << "primitive " << i;
+      EXPECT_TRUE(unmerged[i].verts == merged[i].verts) << "primitive " << i;
+   }
+
+   EXPECT_EQ(0, memcmp(unmerged_current.Attrib, merged_current.Attrib,
+                       sizeof(unmerged_current.Attrib)));
+   EXPECT_EQ(unmerged_width, merged_width);
+}
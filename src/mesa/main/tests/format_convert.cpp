@@ -0,0 +1,208 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name format_convert.cpp
+ *
+ * Check that the SIMD paths of _mesa_swizzle_and_convert() and the SSE
+ * RGB10_A2 unpacking give the same results as the scalar code.
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/formats.h"
+#include "main/format_utils.h"
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "main/format_unpack.h"
+#include "main/sse_format_convert.h"
+}
+
+#if defined(USE_X86_ASM) || defined(USE_X86_64_ASM)
+
+namespace {
+
+struct conversion {
+   const char *name;
+   enum mesa_array_format_datatype src_type;
+   enum mesa_array_format_datatype dst_type;
+   unsigned src_size;
+   unsigned dst_size;
+   bool normalized;
+   bool swizzled;
+};
+
+const conversion conversions[] = {
+   { "ubyte4 swizzle", MESA_ARRAY_FORMAT_TYPE_UBYTE,
+     MESA_ARRAY_FORMAT_TYPE_UBYTE, 1, 1, true, true },
+   { "unorm8 -> float", MESA_ARRAY_FORMAT_TYPE_UBYTE,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, 1, 4, true, true },
+   { "ubyte -> float", MESA_ARRAY_FORMAT_TYPE_UBYTE,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, 1, 4, false, true },
+   { "float -> unorm8", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_UBYTE, 4, 1, true, true },
+   { "half -> float", MESA_ARRAY_FORMAT_TYPE_HALF,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, 2, 4, false, false },
+   { "float -> half", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_HALF, 4, 2, false, false },
+};
+
+/**
+ * Fill \p data with random channels of the given type.  Floats stay
+ * mostly in [0, 1] but include out of range values; NaN is left out, since
+ * the half-float paths don't preserve NaN payloads.
+ */
+void
+fill_random(std::vector<uint8_t> &data, enum mesa_array_format_datatype type)
+{
+   size_t i;
+
+   switch (type) {
+   case MESA_ARRAY_FORMAT_TYPE_FLOAT:
+      for (i = 0; i + 4 <= data.size(); i += 4) {
+         float f = (float) rand() / RAND_MAX;
+         switch (rand() % 8) {
+         case 0: f = -f; break;
+         case 1: f *= 70000.0f; break;
+         case 2: f *= 1e-6f; break;
+         }
+         memcpy(&data[i], &f, sizeof(f));
+      }
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_HALF:
+      for (i = 0; i + 2 <= data.size(); i += 2) {
+         uint16_t h;
+         do {
+            h = rand();
+         } while ((h & 0x7c00) == 0x7c00 && (h & 0x3ff));
+         memcpy(&data[i], &h, sizeof(h));
+      }
+      break;
+   default:
+      for (i = 0; i < data.size(); i++)
+         data[i] = rand();
+      break;
+   }
+}
+
+/**
+ * Run the conversion with only the CPU features in \p features enabled.
+ */
+void
+convert(const conversion &conv, const uint8_t swizzle[4], void *dst,
+        const void *src, int count, int features)
+{
+   const int saved_features = _mesa_x86_cpu_features;
+
+   _mesa_x86_cpu_features &= features;
+   _mesa_swizzle_and_convert(dst, conv.dst_type, 4, src, conv.src_type, 4,
+                             swizzle, conv.normalized, count);
+   _mesa_x86_cpu_features = saved_features;
+}
+
+void
+random_swizzle(const conversion &conv, uint8_t swizzle[4])
+{
+   for (unsigned c = 0; c < 4; c++) {
+      swizzle[c] = conv.swizzled ? rand() % (MESA_FORMAT_SWIZZLE_ONE + 1) :
+                                   c;
+   }
+}
+
+} /* anonymous namespace */
+
+TEST(FormatConvertTest, SimdMatchesScalar)
+{
+   /* All features, then everything but AVX2 to cover the SSE paths. */
+   const int feature_sets[] = { ~0, ~X86_FEATURE_AVX2 };
+
+   _mesa_get_cpu_features();
+   srand(42);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(conversions); i++) {
+      const conversion &conv = conversions[i];
+      SCOPED_TRACE(conv.name);
+
+      for (int count = 1; count < 80; count++) {
+         std::vector<uint8_t> src(count * 4 * conv.src_size);
+         std::vector<uint8_t> dst_simd(count * 4 * conv.dst_size);
+         std::vector<uint8_t> dst_scalar(count * 4 * conv.dst_size);
+         uint8_t swizzle[4];
+
+         fill_random(src, conv.src_type);
+         random_swizzle(conv, swizzle);
+
+         convert(conv, swizzle, &dst_scalar[0], &src[0], count, 0);
+
+         for (unsigned f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+            convert(conv, swizzle, &dst_simd[0], &src[0], count,
+                    feature_sets[f]);
+            EXPECT_EQ(dst_scalar, dst_simd) << "count " << count
+                                            << ", features " << f;
+         }
+      }
+   }
+}
+
+#if defined(USE_SSE41)
+
+TEST(FormatConvertTest, SseRgb10a2UnpackMatchesScalar)
+{
+   /* Every 10-bit value in every channel, with a count that also runs the
+    * tail loop.
+    */
+   const unsigned count = 1027;
+   std::vector<uint32_t> src(count);
+   std::vector<float> dst_sse(count * 4), dst_scalar(count * 4);
+
+   _mesa_get_cpu_features();
+   if (!cpu_has_sse4_1)
+      return;
+
+   for (unsigned i = 0; i < count; i++) {
+      src[i] = (i & 0x3ff) | ((1023 - (i & 0x3ff)) << 10) |
+               (((i * 7) & 0x3ff) << 20) | ((uint32_t) (i & 3) << 30);
+   }
+
+   for (int bgr = 0; bgr < 2; bgr++) {
+      const mesa_format format = bgr ? MESA_FORMAT_B10G10R10A2_UNORM :
+                                       MESA_FORMAT_R10G10B10A2_UNORM;
+
+      _mesa_sse_unpack_rgb10a2_unorm_float(&dst_sse[0], &src[0], bgr,
+                                           count);
+      _mesa_unpack_rgba_row(format, count, &src[0],
+                            (float (*)[4]) &dst_scalar[0]);
+      EXPECT_EQ(0, memcmp(&dst_scalar[0], &dst_sse[0],
+                          dst_sse.size() * sizeof(float)))
+         << _mesa_get_format_name(format);
+   }
+}
+
+#endif
+
+#endif
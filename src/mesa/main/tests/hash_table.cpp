@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name hash_table.cpp
+ *
+ * Check that _mesa_HashLookup() agrees with the rest of the _mesa_HashTable
+ * API for keys on both sides of the lock-free range, also with several
+ * threads looking up keys at once.
+ */
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include "c11/threads.h"
+#include "util/macros.h"
+
+extern "C" {
+#include "main/glheader.h"
+#include "main/hash.h"
+}
+
+static void *
+key_data(GLuint key)
+{
+   return (void *) (uintptr_t) (key * 2 + 2);
+}
+
+static void
+count_entry(GLuint key, void *data, void *userData)
+{
+   unsigned *count = (unsigned *) userData;
+
+   EXPECT_EQ(key_data(key), data);
+   (*count)++;
+}
+
+TEST(HashTableTest, LookupMatchesInsertRemove)
+{
+   /* Small genned names, the deleted-key marker, and names past the
+    * lock-free range.
+    */
+   static const GLuint keys[] = {
+      1, 2, 3, 1023, 1024, 1025, 65535, 65536, 65537, 1000000, 0xfffffffe
+   };
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   unsigned count = 0;
+
+   ASSERT_TRUE(table != NULL);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, keys[i]));
+      _mesa_HashInsert(table, keys[i], key_data(keys[i]));
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      EXPECT_EQ(key_data(keys[i]), _mesa_HashLookup(table, keys[i]));
+      EXPECT_EQ(key_data(keys[i]), _mesa_HashLookupLocked(table, keys[i]));
+   }
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 4));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 70000));
+
+   _mesa_HashWalk(table, count_entry, &count);
+   EXPECT_EQ(ARRAY_SIZE(keys), count);
+   EXPECT_EQ(ARRAY_SIZE(keys), _mesa_HashNumEntries(table));
+
+   /* Replace then remove every other key. */
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i += 2) {
+      _mesa_HashInsert(table, keys[i], key_data(keys[i] + 1));
+      EXPECT_EQ(key_data(keys[i] + 1), _mesa_HashLookup(table, keys[i]));
+      _mesa_HashRemove(table, keys[i]);
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++) {
+      EXPECT_EQ(i % 2 ? key_data(keys[i]) : NULL,
+                _mesa_HashLookup(table, keys[i]));
+   }
+
+   count = 0;
+   _mesa_HashDeleteAll(table, count_entry, &count);
+   EXPECT_EQ(ARRAY_SIZE(keys) / 2, count);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ(NULL, _mesa_HashLookup(table, keys[i]));
+
+   _mesa_DeleteHashTable(table);
+}
+
+struct lookup_thread
+{
+   struct _mesa_HashTable *table;
+   GLuint num_keys;
+   unsigned iterations;
+   uintptr_t sum;
+};
+
+static int
+lookup_thread_func(void *data)
+{
+   struct lookup_thread *t = (struct lookup_thread *) data;
+   uintptr_t sum = 0;
+
+   for (unsigned i = 0; i < t->iterations; i++) {
+      for (GLuint key = 1; key <= t->num_keys; key++)
+         sum += (uintptr_t) _mesa_HashLookup(t->table, key);
+   }
+
+   t->sum = sum;
+   return 0;
+}
+
+TEST(HashTableTest, ConcurrentLookups)
+{
+   const GLuint num_keys = 256;
+   const unsigned num_threads = 4, iterations = 1000;
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   struct lookup_thread threads[4];
+   thrd_t handles[4];
+   uintptr_t expected = 0;
+
+   ASSERT_TRUE(table != NULL);
+
+   for (GLuint key = 1; key <= num_keys; key++) {
+      _mesa_HashInsert(table, key, key_data(key));
+      expected += (uintptr_t) key_data(key) * iterations;
+   }
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      threads[i].table = table;
+      threads[i].num_keys = num_keys;
+      threads[i].iterations = iterations;
+      ASSERT_EQ(thrd_success,
+                thrd_create(&handles[i], lookup_thread_func, &threads[i]));
+   }
+   for (unsigned i = 0; i < num_threads; i++) {
+      thrd_join(handles[i], NULL);
+      EXPECT_EQ(expected, threads[i].sum);
+   }
+
+   for (GLuint key = 1; key <= num_keys; key++)
+      _mesa_HashRemove(table, key);
+   _mesa_DeleteHashTable(table);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name mipmap.cpp
+ *
+ * Check that the SIMD box filters used by _mesa_generate_mipmap_level() give
+ * the same results as the scalar code.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/mtypes.h"
+
+extern "C" {
+#include "main/mipmap.h"
+#include "main/cpuinfo.h"
+}
+
+#if defined(USE_X86_ASM) || defined(USE_X86_64_ASM)
+
+namespace {
+
+struct mip_format {
+   const char *name;
+   GLenum datatype;
+   GLuint comps;
+   GLuint size;
+};
+
+const mip_format formats[] = {
+   { "RGBA8", GL_UNSIGNED_BYTE, 4, 1 },
+   { "RG8", GL_UNSIGNED_BYTE, 2, 1 },
+   { "R8", GL_UNSIGNED_BYTE, 1, 1 },
+   { "RGBA16F", GL_HALF_FLOAT_ARB, 4, 2 },
+   { "RG16F", GL_HALF_FLOAT_ARB, 2, 2 },
+   { "R16F", GL_HALF_FLOAT_ARB, 1, 2 },
+   { "RGBA32F", GL_FLOAT, 4, 4 },
+   { "RG32F", GL_FLOAT, 2, 4 },
+   { "R32F", GL_FLOAT, 1, 4 },
+};
+
+/**
+ * Fill \p data with random channels.  Half floats are kept finite, since
+ * the F16C path doesn't preserve NaN payloads; floats stay in [-1, 1].
+ */
+void
+fill_random(std::vector<uint8_t> &data, const mip_format &fmt)
+{
+   size_t i;
+
+   switch (fmt.datatype) {
+   case GL_FLOAT:
+      for (i = 0; i + 4 <= data.size(); i += 4) {
+         const float f = 2.0f * rand() / RAND_MAX - 1.0f;
+         memcpy(&data[i], &f, sizeof(f));
+      }
+      break;
+   case GL_HALF_FLOAT_ARB:
+      for (i = 0; i + 2 <= data.size(); i += 2) {
+         uint16_t h;
+         do {
+            h = rand();
+         } while ((h & 0x7c00) == 0x7c00);
+         memcpy(&data[i], &h, sizeof(h));
+      }
+      break;
+   default:
+      for (i = 0; i < data.size(); i++)
+         data[i] = rand();
+      break;
+   }
+}
+
+/**
+ * Generate the 2D level below the \p width x \p height image \p src with
+ * only the CPU features in \p features enabled.
+ */
+void
+downsample(const mip_format &fmt, int width, int height,
+           const std::vector<uint8_t> &src, std::vector<uint8_t> &dst,
+           int features)
+{
+   const int saved_features = _mesa_x86_cpu_features;
+   GLint dstWidth, dstHeight, dstDepth;
+   const GLubyte *srcData = &src[0];
+   GLubyte *dstData;
+
+   _mesa_next_mipmap_level_size(GL_TEXTURE_2D, 0, width, height, 1,
+                                &dstWidth, &dstHeight, &dstDepth);
+   dst.resize(dstWidth * dstHeight * fmt.comps * fmt.size);
+   dstData = &dst[0];
+
+   _mesa_x86_cpu_features &= features;
+   _mesa_generate_mipmap_level(GL_TEXTURE_2D, fmt.datatype, fmt.comps, 0,
+                               width, height, 1,
+                               &srcData, width * fmt.comps * fmt.size,
+                               dstWidth, dstHeight, 1,
+                               &dstData, dstWidth * fmt.comps * fmt.size);
+   _mesa_x86_cpu_features = saved_features;
+}
+
+} /* anonymous namespace */
+
+TEST(MipmapTest, SimdMatchesScalar)
+{
+   /* All features, then everything but AVX2 to cover the SSE paths. */
+   const int feature_sets[] = { ~0, ~X86_FEATURE_AVX2 };
+   static const int sizes[][2] = {
+      { 2, 2 }, { 3, 5 }, { 16, 1 }, { 1, 16 }, { 33, 7 }, { 64, 64 },
+      { 127, 31 },
+   };
+
+   _mesa_get_cpu_features();
+   srand(42);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(formats); i++) {
+      const mip_format &fmt = formats[i];
+      SCOPED_TRACE(fmt.name);
+
+      for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+         const int width = sizes[s][0], height = sizes[s][1];
+         std::vector<uint8_t> src(width * height * fmt.comps * fmt.size);
+         std::vector<uint8_t> dst_scalar, dst_simd;
+
+         fill_random(src, fmt);
+         downsample(fmt, width, height, src, dst_scalar, 0);
+
+         for (unsigned f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+            downsample(fmt, width, height, src, dst_simd, feature_sets[f]);
+            EXPECT_EQ(dst_scalar, dst_simd) << width << "x" << height
+                                            << ", features " << f;
+         }
+      }
+   }
+}
+
+#endif
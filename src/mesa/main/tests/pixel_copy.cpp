@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name pixel_copy.cpp
+ *
+ * Check the row copies used by the memcpy paths of glReadPixels() and
+ * glGetTexImage() against memcpy(), including the non-temporal variant used
+ * for pixel buffer objects, and check that converting an image on several
+ * threads gives the same result as on one.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/mtypes.h"
+#include "main/formats.h"
+#include "main/format_utils.h"
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "main/parallel_convert.h"
+#include "main/streaming-load-memcpy.h"
+}
+
+namespace {
+
+void
+fill_random(std::vector<uint8_t> &data)
+{
+   for (size_t i = 0; i < data.size(); i++)
+      data[i] = rand();
+}
+
+struct gl_context *
+create_context(unsigned threads)
+{
+   struct gl_context *ctx =
+      (struct gl_context *) calloc(1, sizeof(struct gl_context));
+
+   ctx->NumPixelConvertThreads = threads;
+   return ctx;
+}
+
+void
+destroy_context(struct gl_context *ctx)
+{
+   _mesa_free_parallel_convert(ctx);
+   free(ctx);
+}
+
+} /* anonymous namespace */
+
+#if defined(USE_SSE41)
+TEST(PixelCopyTest, StreamingCopyMatchesMemcpy)
+{
+   static const size_t sizes[] = {
+      0, 1, 15, 16, 17, 63, 64, 65, 127, 128, 1000, 4096, 65536 + 33,
+   };
+   std::vector<uint8_t> src(65536 + 256), dst(src.size()), ref(src.size());
+
+   _mesa_get_cpu_features();
+   if (!cpu_has_sse4_1)
+      return;
+
+   srand(42);
+   fill_random(src);
+
+   for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+      for (unsigned src_off = 0; src_off < 32; src_off += 3) {
+         for (unsigned dst_off = 0; dst_off < 32; dst_off += 5) {
+            fill_random(dst);
+            ref = dst;
+
+            memcpy(&ref[dst_off], &src[src_off], sizes[s]);
+            _mesa_streaming_copy(&dst[dst_off], &src[src_off], sizes[s]);
+
+            EXPECT_EQ(ref, dst) << sizes[s] << " bytes, offsets "
+                                << src_off << ", " << dst_off;
+         }
+      }
+   }
+}
+#endif
+
+TEST(PixelCopyTest, CopyRowsMatchesMemcpy)
+{
+   /* The last image is large enough to use threads and streaming stores. */
+   static const unsigned sizes[][2] = {
+      { 1, 1 }, { 7, 3 }, { 64, 64 }, { 1024, 600 },
+   };
+   const unsigned bpp = 4;
+
+   _mesa_get_cpu_features();
+   srand(42);
+
+   for (unsigned threads = 0; threads <= 3; threads += 3) {
+      struct gl_context *ctx = create_context(threads);
+
+      for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+         const unsigned width = sizes[s][0], height = sizes[s][1];
+         const size_t row_bytes = width * bpp;
+
+         /* Tightly packed, padded, and bottom-up (as with
+          * GL_PACK_INVERT_MESA) destinations.
+          */
+         for (unsigned layout = 0; layout < 3; layout++) {
+            const size_t dst_stride = row_bytes + (layout ? 12 : 0);
+            std::vector<uint8_t> src(row_bytes * height);
+            std::vector<uint8_t> dst(dst_stride * height), ref(dst.size());
+            uint8_t *dst_start = &dst[0], *ref_start = &ref[0];
+            ptrdiff_t stride = dst_stride;
+
+            if (layout == 2) {
+               dst_start += (height - 1) * dst_stride;
+               ref_start += (height - 1) * dst_stride;
+               stride = -stride;
+            }
+
+            fill_random(src);
+            fill_random(dst);
+            ref = dst;
+
+            for (unsigned y = 0; y < height; y++)
+               memcpy(ref_start + y * stride, &src[y * row_bytes], row_bytes);
+
+            for (int streaming = 0; streaming < 2; streaming++) {
+               _mesa_parallel_copy_rows(ctx, dst_start, stride,
+                                        &src[0], row_bytes,
+                                        width, height, bpp, streaming);
+               EXPECT_EQ(ref, dst) << width << "x" << height
+                                   << ", layout " << layout
+                                   << ", threads " << threads
+                                   << ", streaming " << streaming;
+            }
+         }
+      }
+
+      destroy_context(ctx);
+   }
+}
+
+TEST(PixelCopyTest, ParallelFormatConvertMatchesSingleThread)
+{
+   /* Larger than MIN_PARALLEL_PIXELS, with padded rows. */
+   const unsigned width = 1024, height = 600;
+   const size_t src_stride = width * 4 + 12;
+   const uint32_t bgra8_unorm = MESA_ARRAY_FORMAT(1, 0, 0, 1, 4, 2, 1, 0, 3);
+   const uint32_t dst_formats[] = { RGBA8_UBYTE, RGBA32_FLOAT };
+   std::vector<uint8_t> src(src_stride * height);
+
+   _mesa_get_cpu_features();
+   srand(42);
+   fill_random(src);
+
+   for (unsigned f = 0; f < ARRAY_SIZE(dst_formats); f++) {
+      const size_t dst_stride = width * 4 *
+         (dst_formats[f] == RGBA32_FLOAT ? sizeof(float) : 1) + 20;
+      std::vector<uint8_t> single(dst_stride * height);
+      std::vector<uint8_t> multi(single.size());
+      struct gl_context *ctx;
+
+      fill_random(single);
+      multi = single;
+
+      ctx = create_context(0);
+      _mesa_parallel_format_convert(ctx, &single[0], dst_formats[f],
+                                    dst_stride, &src[0], bgra8_unorm,
+                                    src_stride, width, height, NULL);
+      destroy_context(ctx);
+
+      ctx = create_context(3);
+      _mesa_parallel_format_convert(ctx, &multi[0], dst_formats[f],
+                                    dst_stride, &src[0], bgra8_unorm,
+                                    src_stride, width, height, NULL);
+      destroy_context(ctx);
+
+      EXPECT_EQ(0, memcmp(&single[0], &multi[0], single.size()))
+         << "format " << f;
+   }
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name primitive_restart.cpp
+ *
+ * Check that the SIMD restart index search gives the same sub-primitives as
+ * a plain scalar scan, that the SIMD index rebasing and widening match the
+ * scalar loops, and that sub-primitive lists are cached until the buffer
+ * object is modified.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "main/mtypes.h"
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "main/sse_index.h"
+#include "vbo/vbo.h"
+}
+
+#if defined(USE_X86_ASM) || defined(USE_X86_64_ASM)
+
+namespace {
+
+/**
+ * A mesh of \p count indices of \p index_size bytes, made of strips of
+ * about \p strip_length indices separated by \p restart_index.
+ */
+std::vector<uint8_t>
+make_strips(unsigned index_size, unsigned count, unsigned strip_length,
+            unsigned restart_index)
+{
+   std::vector<uint8_t> data(count * index_size);
+   const unsigned mask = index_size == 4 ? ~0u : (1u << (index_size * 8)) - 1;
+   unsigned next = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      unsigned value;
+
+      if (rand() % strip_length == 0)
+         value = restart_index;
+      else
+         value = (next++ + rand() % 16) & mask;
+
+      memcpy(&data[i * index_size], &value, index_size);
+   }
+
+   return data;
+}
+
+std::vector<vbo_sub_primitive>
+find_sub_primitives(const std::vector<uint8_t> &data, unsigned index_size,
+                    unsigned restart_index, int features)
+{
+   const int saved_features = _mesa_x86_cpu_features;
+   const unsigned count = data.size() / index_size;
+   std::vector<vbo_sub_primitive> result;
+   vbo_sub_primitive *sub_prims;
+   unsigned num_sub_prims;
+
+   _mesa_x86_cpu_features &= features;
+   sub_prims = vbo_find_sub_primitives(&data[0], index_size, 0, count,
+                                       restart_index, &num_sub_prims);
+   _mesa_x86_cpu_features = saved_features;
+
+   result.assign(sub_prims, sub_prims + num_sub_prims);
+   free(sub_prims);
+   return result;
+}
+
+/** The sub-primitives, computed one index at a time. */
+std::vector<vbo_sub_primitive>
+reference_sub_primitives(const std::vector<uint8_t> &data,
+                         unsigned index_size, unsigned restart_index)
+{
+   const unsigned count = data.size() / index_size;
+   std::vector<vbo_sub_primitive> result;
+   vbo_sub_primitive cur = { 0, 0, ~0u, 0 };
+
+   for (unsigned i = 0; i < count; i++) {
+      unsigned value = 0;
+
+      memcpy(&value, &data[i * index_size], index_size);
+      if (value == restart_index) {
+         if (cur.count)
+            result.push_back(cur);
+         cur.start = i + 1;
+         cur.count = 0;
+         cur.min_index = ~0u;
+         cur.max_index = 0;
+      } else {
+         cur.count++;
+         cur.min_index = std::min(cur.min_index, value);
+         cur.max_index = std::max(cur.max_index, value);
+      }
+   }
+   if (cur.count)
+      result.push_back(cur);
+
+   return result;
+}
+
+void
+expect_equal(const std::vector<vbo_sub_primitive> &a,
+             const std::vector<vbo_sub_primitive> &b)
+{
+   ASSERT_EQ(a.size(), b.size());
+   for (unsigned i = 0; i < a.size(); i++) {
+      EXPECT_EQ(a[i].start, b[i].start) << "sub-primitive " << i;
+      EXPECT_EQ(a[i].count, b[i].count) << "sub-primitive " << i;
+      EXPECT_EQ(a[i].min_index, b[i].min_index) << "sub-primitive " << i;
+      EXPECT_EQ(a[i].max_index, b[i].max_index) << "sub-primitive " << i;
+   }
+}
+
+} /* anonymous namespace */
+
+TEST(PrimitiveRestartTest, SimdMatchesScalar)
+{
+   /* No SIMD, everything but AVX2, then all features. */
+   const int feature_sets[] = { 0, ~X86_FEATURE_AVX2, ~0 };
+   static const unsigned sizes[] = { 1, 2, 4 };
+   static const unsigned counts[] = { 0, 1, 7, 31, 64, 257, 5000 };
+   static const unsigned strip_lengths[] = { 1, 3, 40, 100000 };
+
+   _mesa_get_cpu_features();
+   srand(42);
+
+   for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+      const unsigned index_size = sizes[s];
+      const unsigned restart_index =
+         index_size == 4 ? ~0u : (1u << (index_size * 8)) - 1;
+
+      for (unsigned c = 0; c < ARRAY_SIZE(counts); c++) {
+         for (unsigned l = 0; l < ARRAY_SIZE(strip_lengths); l++) {
+            const std::vector<uint8_t> data =
+               make_strips(index_size, counts[c], strip_lengths[l],
+                           restart_index);
+            const std::vector<vbo_sub_primitive> ref =
+               reference_sub_primitives(data, index_size, restart_index);
+
+            for (unsigned f = 0; f < ARRAY_SIZE(feature_sets); f++) {
+               SCOPED_TRACE(testing::Message() << index_size << "-byte, "
+                            << counts[c] << " indices, strips of "
+                            << strip_lengths[l] << ", features " << f);
+               expect_equal(ref, find_sub_primitives(data, index_size,
+                                                     restart_index,
+                                                     feature_sets[f]));
+            }
+         }
+      }
+   }
+}
+
+TEST(PrimitiveRestartTest, RestartIndexOutOfRange)
+{
+   /* A restart index that doesn't fit in the index type never matches,
+    * even though its low bits do.
+    */
+   const std::vector<uint8_t> data(100, 0xff);
+
+   _mesa_get_cpu_features();
+   expect_equal(reference_sub_primitives(data, 1, 0x1ff),
+                find_sub_primitives(data, 1, 0x1ff, ~0));
+   EXPECT_EQ(100u, vbo_find_index(&data[0], 1, 0, 100, 0x1ff));
+   EXPECT_EQ(50u, vbo_find_index(&data[0], 2, 0, 50, 0x1ffff));
+}
+
+#if defined(USE_SSE41)
+TEST(PrimitiveRestartTest, RebaseAndWidenMatchScalar)
+{
+   static const unsigned sizes[] = { 1, 2, 4 };
+   const unsigned count = 1000, min_index = 300;
+
+   _mesa_get_cpu_features();
+   if (!cpu_has_sse4_1)
+      return;
+
+   srand(42);
+
+   for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+      const unsigned index_size = sizes[s];
+      std::vector<uint8_t> src(count * index_size);
+
+      for (unsigned i = 0; i < src.size(); i++)
+         src[i] = rand();
+
+      /* Odd counts and offsets cover the unaligned heads and tails. */
+      for (unsigned n = 0; n < 40; n += 7) {
+         std::vector<uint8_t> rebased(n * index_size), ref(n * index_size);
+         std::vector<uint32_t> widened(n), ref_widened(n);
+
+         for (unsigned i = 0; i < n; i++) {
+            unsigned value = 0;
+
+            memcpy(&value, &src[(i + 1) * index_size], index_size);
+            ref_widened[i] = value;
+            value -= min_index;
+            memcpy(&ref[i * index_size], &value, index_size);
+         }
+
+         _mesa_sse_rebase_indices(rebased.data(), &src[index_size],
+                                  index_size, n, min_index);
+         EXPECT_EQ(ref, rebased) << index_size << "-byte, " << n;
+
+         if (index_size < 4) {
+            _mesa_sse_widen_indices(widened.data(), &src[index_size],
+                                    index_size, n);
+            EXPECT_EQ(ref_widened, widened) << index_size << "-byte, " << n;
+         }
+      }
+   }
+}
+#endif
+
+TEST(PrimitiveRestartTest, SubPrimitiveCache)
+{
+   struct gl_buffer_object obj;
+   vbo_sub_primitive prims[] = { { 0, 3, 1, 5 }, { 4, 10, 0, 9 } };
+   vbo_sub_primitive *cached = NULL;
+   unsigned num_cached = 0;
+
+   memset(&obj, 0, sizeof(obj));
+   mtx_init(&obj.Mutex, mtx_plain);
+
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 16, 14, 2, 0xffff,
+                                              &cached, &num_cached));
+   vbo_store_sub_primitives(&obj, 16, 14, 2, 0xffff, prims, 2);
+
+   ASSERT_TRUE(vbo_get_sub_primitives_cached(&obj, 16, 14, 2, 0xffff,
+                                             &cached, &num_cached));
+   ASSERT_EQ(2u, num_cached);
+   EXPECT_EQ(0, memcmp(prims, cached, sizeof(prims)));
+   free(cached);
+
+   /* Another range, restart index or index size misses. */
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 18, 14, 2, 0xffff,
+                                              &cached, &num_cached));
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 16, 14, 2, 0xfffe,
+                                              &cached, &num_cached));
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 16, 14, 4, 0xffff,
+                                              &cached, &num_cached));
+
+   /* Modifying the buffer drops the cache. */
+   obj.MinMaxCacheDirty = true;
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 16, 14, 2, 0xffff,
+                                              &cached, &num_cached));
+   EXPECT_FALSE(vbo_get_sub_primitives_cached(&obj, 16, 14, 2, 0xffff,
+                                              &cached, &num_cached));
+
+   vbo_delete_minmax_cache(&obj);
+   mtx_destroy(&obj.Mutex);
+}
+
+#endif
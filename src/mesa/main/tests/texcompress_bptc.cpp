@@ -0,0 +1,266 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name texcompress_bptc.cpp
+ *
+ * Encode images into BPTC unorm blocks at each MESA_TEXCOMPRESS_QUALITY
+ * level, decode them again with the BPTC fetch functions, and check the
+ * error against the source texels.
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "main/mtypes.h"
+
+extern "C" {
+#include "main/parallel_convert.h"
+#include "main/texcompress.h"
+#include "main/texcompress_bptc.h"
+
+extern GLfloat _mesa_ubyte_to_float_color_tab[256];
+}
+
+namespace {
+
+const unsigned width = 64;
+const unsigned height = 64;
+
+enum image_kind {
+   IMAGE_GRADIENT,
+   IMAGE_ALPHA_GRADIENT,
+   IMAGE_NOISE,
+   IMAGE_SOLID_BLOCKS,
+   IMAGE_COUNT
+};
+
+/** RGBA8 test image of \p kind, \p w x \p h texels. */
+std::vector<GLubyte>
+make_image(image_kind kind, unsigned w, unsigned h)
+{
+   std::vector<GLubyte> image(w * h * 4);
+
+   srand(1234);
+   for (unsigned y = 0; y < h; y++) {
+      for (unsigned x = 0; x < w; x++) {
+         GLubyte *p = &image[(y * w + x) * 4];
+
+         switch (kind) {
+         case IMAGE_GRADIENT:
+            p[0] = x * 255 / std::max(w - 1, 1u);
+            p[1] = y * 255 / std::max(h - 1, 1u);
+            p[2] = (x + y) * 255 / std::max(w + h - 2, 1u);
+            p[3] = 255;
+            break;
+         case IMAGE_ALPHA_GRADIENT:
+            p[0] = 200;
+            p[1] = x * 4;
+            p[2] = 40;
+            p[3] = y * 255 / std::max(h - 1, 1u);
+            break;
+         case IMAGE_NOISE:
+            for (unsigned c = 0; c < 4; c++)
+               p[c] = rand() % 256;
+            break;
+         case IMAGE_SOLID_BLOCKS:
+            p[0] = (x / 4) * 37;
+            p[1] = (y / 4) * 53;
+            p[2] = ((x / 4) ^ (y / 4)) * 29;
+            p[3] = 255 - (x / 4) * 7;
+            break;
+         default:
+            break;
+         }
+      }
+   }
+
+   return image;
+}
+
+class BptcEncodeTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   std::vector<GLubyte> encode(const std::vector<GLubyte> &image,
+                               unsigned w, unsigned h, unsigned quality);
+   double error(const std::vector<GLubyte> &image,
+                const std::vector<GLubyte> &blocks,
+                unsigned w, unsigned h, int *max_error);
+
+   struct gl_context ctx;
+   struct gl_pixelstore_attrib packing;
+};
+
+void
+BptcEncodeTest::SetUp()
+{
+   memset(&ctx, 0, sizeof(ctx));
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 1;
+
+   /* The BPTC fetch functions convert through this table, which is
+    * normally filled in when the first context is created.
+    */
+   for (unsigned i = 0; i < 256; i++)
+      _mesa_ubyte_to_float_color_tab[i] = (GLfloat) i / 255.0F;
+}
+
+void
+BptcEncodeTest::TearDown()
+{
+   _mesa_free_parallel_convert(&ctx);
+}
+
+/** Store \p image into a BPTC unorm texture at \p quality. */
+std::vector<GLubyte>
+BptcEncodeTest::encode(const std::vector<GLubyte> &image,
+                       unsigned w, unsigned h, unsigned quality)
+{
+   const unsigned row_stride = (w + 3) / 4 * 16;
+   std::vector<GLubyte> blocks(row_stride * ((h + 3) / 4));
+   GLubyte *slice = &blocks[0];
+
+   ctx.TextureCompressQuality = quality;
+   EXPECT_TRUE(_mesa_texstore_bptc_rgba_unorm(&ctx, 2, GL_RGBA,
+                                              MESA_FORMAT_BPTC_RGBA_UNORM,
+                                              row_stride, &slice, w, h, 1,
+                                              GL_RGBA, GL_UNSIGNED_BYTE,
+                                              &image[0], &packing));
+   return blocks;
+}
+
+/**
+ * Decode \p blocks and return the mean squared error against \p image,
+ * per component in 0..255 units.
+ */
+double
+BptcEncodeTest::error(const std::vector<GLubyte> &image,
+                      const std::vector<GLubyte> &blocks,
+                      unsigned w, unsigned h, int *max_error)
+{
+   std::vector<GLfloat> decoded(w * h * 4);
+   double sum = 0.0;
+
+   _mesa_decompress_image(MESA_FORMAT_BPTC_RGBA_UNORM, w, h, &blocks[0],
+                          (w + 3) / 4 * 16, &decoded[0]);
+
+   *max_error = 0;
+   for (unsigned i = 0; i < w * h * 4; i++) {
+      const int value = (int) lroundf(decoded[i] * 255.0f);
+      const int diff = abs(value - image[i]);
+
+      sum += diff * diff;
+      if (diff > *max_error)
+         *max_error = diff;
+   }
+
+   return sum / (w * h * 4);
+}
+
+} /* anonymous namespace */
+
+
+/**
+ * Every quality level stays close to the source.  On smooth images, the
+ * principal axis encoder of levels 1 and 2 is at least as good as the mode 4
+ * encoder of level 0.
+ */
+TEST_F(BptcEncodeTest, DecodesCloseToSource)
+{
+   /* Mean squared error bounds per quality level and image. */
+   static const double max_mse[3][IMAGE_COUNT] = {
+      /* gradient, alpha gradient, noise, solid blocks */
+      { 12.0,  16.0,  3500.0, 12.0 },
+      {  6.0,   6.0,  3500.0,  1.0 },
+      {  6.0,   6.0,  3500.0,  1.0 },
+   };
+
+   for (unsigned kind = 0; kind < IMAGE_COUNT; kind++) {
+      const std::vector<GLubyte> image =
+         make_image((image_kind) kind, width, height);
+      double mse[3];
+
+      for (unsigned quality = 0; quality <= 2; quality++) {
+         int max_error;
+
+         mse[quality] = error(image, encode(image, width, height, quality),
+                              width, height, &max_error);
+         EXPECT_LE(mse[quality], max_mse[quality][kind])
+            << "image " << kind << ", quality " << quality;
+      }
+
+      if (kind != IMAGE_NOISE) {
+         EXPECT_LE(mse[1], mse[0] + 0.5) << "image " << kind;
+         EXPECT_LE(mse[2], mse[1] + 0.5) << "image " << kind;
+      }
+   }
+}
+
+/**
+ * Blocks of one color come back within rounding of the p-bits at levels 1
+ * and 2, also when the image ends inside the blocks.
+ */
+TEST_F(BptcEncodeTest, SolidBlocks)
+{
+   static const unsigned sizes[][2] = {
+      { width, height }, { 1, 1 }, { 3, 5 }, { 13, 7 },
+   };
+   static const int max_errors[3] = { 8, 1, 1 };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++) {
+      const unsigned w = sizes[i][0], h = sizes[i][1];
+      const std::vector<GLubyte> image =
+         make_image(IMAGE_SOLID_BLOCKS, w, h);
+
+      for (unsigned quality = 0; quality <= 2; quality++) {
+         int max_error;
+
+         error(image, encode(image, w, h, quality), w, h, &max_error);
+         EXPECT_LE(max_error, max_errors[quality])
+            << w << "x" << h << ", quality " << quality;
+      }
+   }
+}
+
+/** The block-parallel path writes the same blocks as the serial one. */
+TEST_F(BptcEncodeTest, ThreadsMatchSerial)
+{
+   const unsigned w = 512, h = 512;
+   const std::vector<GLubyte> image = make_image(IMAGE_NOISE, w, h);
+
+   for (unsigned quality = 0; quality <= 2; quality++) {
+      const std::vector<GLubyte> serial = encode(image, w, h, quality);
+
+      ctx.NumPixelConvertThreads = 3;
+      const std::vector<GLubyte> threaded = encode(image, w, h, quality);
+      ctx.NumPixelConvertThreads = 0;
+
+      EXPECT_TRUE(serial == threaded) << "quality " << quality;
+   }
+}
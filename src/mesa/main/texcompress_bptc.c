@@ -27,6 +27,8 @@
  */
 
 #include <stdbool.h>
+#include <float.h>
+#include <limits.h>
 #include "texcompress.h"
 #include "texcompress_bptc.h"
 #include "util/format_srgb.h"
@@ -34,6 +36,8 @@
 #include "texstore.h"
 #include "macros.h"
 #include "image.h"
+#include "mtypes.h"
+#include "parallel_convert.h"
 
 #define BLOCK_SIZE 4
 #define N_PARTITIONS 64
@@ -1036,7 +1040,7 @@ get_rgba_endpoints_unorm(int width, int height,
          for (i = 0; i < 3; i++)
             sums[endpoint][i] += p[i];
 
-         if (p[2] < average_alpha) {
+         if (p[3] < average_alpha) {
             endpoint = 0;
             alpha_left_endpoint_count++;
          } else {
@@ -1204,9 +1208,9 @@ write_alpha_indices_unorm(struct bit_writer *writer,
 }
 
 static void
-compress_rgba_unorm_block(int src_width, int src_height,
-                          const uint8_t *src, int src_rowstride,
-                          uint8_t *dst)
+compress_rgba_unorm_block_mode4(int src_width, int src_height,
+                                const uint8_t *src, int src_rowstride,
+                                uint8_t *dst)
 {
    int average_luminance, average_alpha;
    uint8_t endpoints[2][4];
@@ -1246,29 +1250,458 @@ compress_rgba_unorm_block(int src_width, int src_height,
                              endpoints);
 }
 
+/**
+ * Returns the sum of the squared errors of the texels of a 4x4 region of
+ * \p src when decoded from \p block.
+ */
+static int
+get_block_error_unorm(int src_width, int src_height,
+                      const uint8_t *src, int src_rowstride,
+                      const uint8_t *block)
+{
+   uint8_t texel[4];
+   int error = 0;
+   int y, x, i;
+
+   for (y = 0; y < src_height; y++) {
+      for (x = 0; x < src_width; x++) {
+         fetch_rgba_unorm_from_block(block, texel, y * BLOCK_SIZE + x);
+         for (i = 0; i < 4; i++)
+            error += (texel[i] - src[x * 4 + i]) * (texel[i] - src[x * 4 + i]);
+      }
+      src += src_rowstride;
+   }
+
+   return error;
+}
+
+/**
+ * Finds the line through the texels of a block that best fits them, by
+ * power iteration on their covariance matrix.  Returns false if all of the
+ * texels are the same.
+ */
+static bool
+get_principal_axis_unorm(int n_texels, const int texels[][4],
+                         float mean[4], float axis[4])
+{
+   float covariance[4][4];
+   float v[4], max;
+   int i, j, k, iteration;
+
+   memset(mean, 0, sizeof mean[0] * 4);
+   for (k = 0; k < n_texels; k++)
+      for (i = 0; i < 4; i++)
+         mean[i] += texels[k][i];
+   for (i = 0; i < 4; i++)
+      mean[i] /= n_texels;
+
+   memset(covariance, 0, sizeof covariance);
+   for (k = 0; k < n_texels; k++) {
+      for (i = 0; i < 4; i++) {
+         for (j = i; j < 4; j++) {
+            covariance[i][j] += ((texels[k][i] - mean[i]) *
+                                 (texels[k][j] - mean[j]));
+         }
+      }
+   }
+   for (i = 0; i < 4; i++)
+      for (j = 0; j < i; j++)
+         covariance[i][j] = covariance[j][i];
+
+   /* Start from the column of the component with the largest variance, it
+    * can't be orthogonal to the principal axis.
+    */
+   j = 0;
+   for (i = 1; i < 4; i++) {
+      if (covariance[i][i] > covariance[j][j])
+         j = i;
+   }
+   if (covariance[j][j] <= 0.0f)
+      return false;
+   memcpy(axis, covariance[j], sizeof axis[0] * 4);
+
+   for (iteration = 0; iteration < 8; iteration++) {
+      max = 0.0f;
+      for (i = 0; i < 4; i++) {
+         v[i] = (covariance[i][0] * axis[0] + covariance[i][1] * axis[1] +
+                 covariance[i][2] * axis[2] + covariance[i][3] * axis[3]);
+         max = MAX2(max, fabsf(v[i]));
+      }
+      if (max == 0.0f)
+         return false;
+      for (i = 0; i < 4; i++)
+         axis[i] = v[i] / max;
+   }
+
+   return true;
+}
+
+/**
+ * Rounds an endpoint of mode 6 to 7 bits plus the given p-bit.  Returns the
+ * squared error.
+ */
+static float
+quantize_endpoint_mode6(const float endpoint[4], int pbit, uint8_t result[4])
+{
+   float error = 0.0f;
+   int i, value;
+
+   for (i = 0; i < 4; i++) {
+      value = (int) ((endpoint[i] - pbit) / 2.0f + 0.5f);
+      value = CLAMP(value, 0, 127) * 2 + pbit;
+      error += (value - endpoint[i]) * (value - endpoint[i]);
+      result[i] = value;
+   }
+
+   return error;
+}
+
+/**
+ * Picks the 4-bit index of each texel that decodes closest to it.  The
+ * palette lies on a line, so only the entries next to the projection of the
+ * texel on that line are compared.  Returns the sum of the squared errors.
+ */
+static int
+choose_indices_mode6(int n_texels, const int texels[][4],
+                     const uint8_t endpoints[2][4], int indices[])
+{
+   int palette[16][4];
+   int direction[4];
+   int length2 = 0, projection;
+   float scale;
+   int error = 0;
+   int best, best_error, texel_error, d;
+   int k, index, first, last, i;
+
+   for (i = 0; i < 4; i++) {
+      direction[i] = endpoints[1][i] - endpoints[0][i];
+      length2 += direction[i] * direction[i];
+   }
+
+   for (index = 0; index < 16; index++) {
+      for (i = 0; i < 4; i++) {
+         palette[index][i] = interpolate(endpoints[0][i], endpoints[1][i],
+                                         index, 4);
+      }
+   }
+
+   scale = length2 ? 15.0f / length2 : 0.0f;
+
+   for (k = 0; k < n_texels; k++) {
+      if (length2 == 0) {
+         first = last = 0;
+      } else {
+         projection = 0;
+         for (i = 0; i < 4; i++)
+            projection += (texels[k][i] - endpoints[0][i]) * direction[i];
+         index = (int) (projection * scale + 0.5f);
+         index = CLAMP(index, 0, 15);
+         first = MAX2(index - 1, 0);
+         last = MIN2(index + 1, 15);
+      }
+
+      best = first;
+      best_error = INT_MAX;
+      for (index = first; index <= last; index++) {
+         texel_error = 0;
+         for (i = 0; i < 4; i++) {
+            d = texels[k][i] - palette[index][i];
+            texel_error += d * d;
+         }
+         if (texel_error < best_error) {
+            best_error = texel_error;
+            best = index;
+         }
+      }
+      indices[k] = best;
+      error += best_error;
+   }
+
+   return error;
+}
+
+/**
+ * Quantizes a pair of endpoints and picks the indices for them.  The fast
+ * path chooses each p-bit on its own, otherwise all four combinations are
+ * tried.  Returns the sum of the squared errors.
+ */
+static int
+fit_endpoints_mode6(int n_texels, const int texels[][4],
+                    float endpoints[2][4], int quality,
+                    uint8_t result[2][4], int pbits[2], int indices[])
+{
+   uint8_t candidate[2][4], temp[4];
+   int candidate_indices[BLOCK_SIZE * BLOCK_SIZE];
+   int best_error = INT_MAX, error;
+   int endpoint, combination;
+
+   if (quality < 2) {
+      for (endpoint = 0; endpoint < 2; endpoint++) {
+         pbits[endpoint] =
+            (quantize_endpoint_mode6(endpoints[endpoint], 1, temp) <
+             quantize_endpoint_mode6(endpoints[endpoint], 0, temp));
+         quantize_endpoint_mode6(endpoints[endpoint], pbits[endpoint],
+                                 result[endpoint]);
+      }
+      return choose_indices_mode6(n_texels, texels, result, indices);
+   }
+
+   for (combination = 0; combination < 4; combination++) {
+      quantize_endpoint_mode6(endpoints[0], combination & 1, candidate[0]);
+      quantize_endpoint_mode6(endpoints[1], combination >> 1, candidate[1]);
+      error = choose_indices_mode6(n_texels, texels, candidate,
+                                   candidate_indices);
+      if (error < best_error) {
+         best_error = error;
+         memcpy(result, candidate, sizeof candidate);
+         memcpy(indices, candidate_indices,
+                sizeof indices[0] * n_texels);
+         pbits[0] = combination & 1;
+         pbits[1] = combination >> 1;
+      }
+   }
+
+   return best_error;
+}
+
+/**
+ * Solves for the endpoints that minimize the squared error of the texels
+ * given their indices.  Returns false if the system is degenerate, which
+ * happens when all of the texels use the same index.
+ */
+static bool
+refine_endpoints_mode6(int n_texels, const int texels[][4],
+                       const int indices[], float endpoints[2][4])
+{
+   static const uint8_t weights4[] =
+      { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+   float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+   float ax[4] = { 0.0f }, bx[4] = { 0.0f };
+   float a, b, det;
+   int k, i;
+
+   for (k = 0; k < n_texels; k++) {
+      b = weights4[indices[k]] / 64.0f;
+      a = 1.0f - b;
+      aa += a * a;
+      bb += b * b;
+      ab += a * b;
+      for (i = 0; i < 4; i++) {
+         ax[i] += a * texels[k][i];
+         bx[i] += b * texels[k][i];
+      }
+   }
+
+   det = aa * bb - ab * ab;
+   if (fabsf(det) < 1e-6f)
+      return false;
+
+   for (i = 0; i < 4; i++) {
+      endpoints[0][i] = CLAMP((ax[i] * bb - bx[i] * ab) / det, 0.0f, 255.0f);
+      endpoints[1][i] = CLAMP((bx[i] * aa - ax[i] * ab) / det, 0.0f, 255.0f);
+   }
+
+   return true;
+}
+
+/**
+ * Encodes a block with mode 6: a single subset with 7.7.7.7 endpoints plus
+ * a p-bit each, and 4-bit indices shared by color and alpha.  The endpoints
+ * start at the extremes of the texels along their principal axis and are
+ * then refined by least squares.  Returns the sum of the squared errors.
+ */
+static int
+compress_rgba_unorm_block_mode6(int src_width, int src_height,
+                                const uint8_t *src, int src_rowstride,
+                                uint8_t *dst, int quality)
+{
+   int texels[BLOCK_SIZE * BLOCK_SIZE][4];
+   int indices[BLOCK_SIZE * BLOCK_SIZE], best_indices[BLOCK_SIZE * BLOCK_SIZE];
+   int block_indices[BLOCK_SIZE * BLOCK_SIZE];
+   float mean[4], axis[4], endpoints[2][4];
+   float t, t_min = FLT_MAX, t_max = -FLT_MAX, axis_length2;
+   uint8_t quantized[2][4], best_quantized[2][4], temp[4];
+   int pbits[2], best_pbits[2];
+   int n_texels = src_width * src_height;
+   int error, best_error;
+   int iteration, n_iterations = quality >= 2 ? 3 : 1;
+   struct bit_writer writer;
+   int y, x, k, i;
+
+   for (y = 0; y < src_height; y++) {
+      for (x = 0; x < src_width; x++) {
+         for (i = 0; i < 4; i++)
+            texels[y * src_width + x][i] = src[y * src_rowstride + x * 4 + i];
+      }
+   }
+
+   if (get_principal_axis_unorm(n_texels, (const int (*)[4]) texels,
+                                mean, axis)) {
+      axis_length2 = (axis[0] * axis[0] + axis[1] * axis[1] +
+                      axis[2] * axis[2] + axis[3] * axis[3]);
+      for (k = 0; k < n_texels; k++) {
+         t = 0.0f;
+         for (i = 0; i < 4; i++)
+            t += (texels[k][i] - mean[i]) * axis[i];
+         t /= axis_length2;
+         t_min = MIN2(t_min, t);
+         t_max = MAX2(t_max, t);
+      }
+   } else {
+      t_min = t_max = 0.0f;
+      memset(axis, 0, sizeof axis);
+   }
+
+   for (i = 0; i < 4; i++) {
+      endpoints[0][i] = CLAMP(mean[i] + t_min * axis[i], 0.0f, 255.0f);
+      endpoints[1][i] = CLAMP(mean[i] + t_max * axis[i], 0.0f, 255.0f);
+   }
+
+   best_error = fit_endpoints_mode6(n_texels, (const int (*)[4]) texels,
+                                    endpoints, quality,
+                                    best_quantized, best_pbits, best_indices);
+
+   for (iteration = 0; iteration < n_iterations && best_error > 0;
+        iteration++) {
+      memcpy(indices, best_indices, sizeof indices[0] * n_texels);
+      if (!refine_endpoints_mode6(n_texels, (const int (*)[4]) texels,
+                                  indices, endpoints))
+         break;
+
+      error = fit_endpoints_mode6(n_texels, (const int (*)[4]) texels,
+                                  endpoints, quality,
+                                  quantized, pbits, indices);
+      if (error >= best_error)
+         break;
+
+      best_error = error;
+      memcpy(best_quantized, quantized, sizeof quantized);
+      memcpy(best_pbits, pbits, sizeof pbits);
+      memcpy(best_indices, indices, sizeof indices[0] * n_texels);
+   }
+
+   /* Lay the indices out in the 4x4 block, padding with index 0 */
+   memset(block_indices, 0, sizeof block_indices);
+   for (y = 0; y < src_height; y++) {
+      for (x = 0; x < src_width; x++)
+         block_indices[y * BLOCK_SIZE + x] = best_indices[y * src_width + x];
+   }
+
+   /* The most-significant bit of the first index is implicitly zero, so swap
+    * the endpoints if it is set.  The weights are symmetric so this doesn't
+    * change the decoded texels.
+    */
+   if (block_indices[0] & 8) {
+      memcpy(temp, best_quantized[0], 4);
+      memcpy(best_quantized[0], best_quantized[1], 4);
+      memcpy(best_quantized[1], temp, 4);
+      i = best_pbits[0];
+      best_pbits[0] = best_pbits[1];
+      best_pbits[1] = i;
+      for (k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++)
+         block_indices[k] = 15 - block_indices[k];
+   }
+
+   writer.dst = dst;
+   writer.pos = 0;
+   writer.buf = 0;
+
+   write_bits(&writer, 7, 0x40); /* mode 6 */
+
+   for (i = 0; i < 4; i++) {
+      write_bits(&writer, 7, best_quantized[0][i] >> 1);
+      write_bits(&writer, 7, best_quantized[1][i] >> 1);
+   }
+
+   write_bits(&writer, 1, best_pbits[0]);
+   write_bits(&writer, 1, best_pbits[1]);
+
+   for (k = 0; k < BLOCK_SIZE * BLOCK_SIZE; k++)
+      write_bits(&writer, k == 0 ? 3 : 4, block_indices[k]);
+
+   return best_error;
+}
+
+/**
+ * Encodes a block at the requested quality level:
+ *
+ * 0: mode 4 with endpoints found by splitting the texels around their
+ *    average luminance, the historical encoder.
+ * 1: mode 6 fitted along the principal axis of the texels, with one
+ *    least-squares refinement.
+ * 2: like 1 with more refinement and an exhaustive p-bit search, keeping
+ *    the mode 4 encoding if that happens to be better.
+ */
 static void
-compress_rgba_unorm(int width, int height,
-                    const uint8_t *src, int src_rowstride,
-                    uint8_t *dst, int dst_rowstride)
+compress_rgba_unorm_block(int src_width, int src_height,
+                          const uint8_t *src, int src_rowstride,
+                          uint8_t *dst, int quality)
 {
-   int dst_row_diff;
-   int y, x;
+   uint8_t mode4_block[BLOCK_BYTES];
+   int error;
+
+   if (quality == 0) {
+      compress_rgba_unorm_block_mode4(src_width, src_height,
+                                      src, src_rowstride, dst);
+      return;
+   }
+
+   error = compress_rgba_unorm_block_mode6(src_width, src_height,
+                                           src, src_rowstride,
+                                           dst, quality);
+
+   if (quality >= 2 && error > 0) {
+      compress_rgba_unorm_block_mode4(src_width, src_height,
+                                      src, src_rowstride, mode4_block);
+      if (get_block_error_unorm(src_width, src_height, src, src_rowstride,
+                                mode4_block) < error)
+         memcpy(dst, mode4_block, BLOCK_BYTES);
+   }
+}
+
+/**
+ * An image region handed to the compressors running on row slices.
+ */
+struct compress_job {
+   int width;
+   const void *src;
+   int src_rowstride;
+   uint8_t *dst;
+   int dst_rowstride;
+   int quality;
+   bool is_signed;
+};
 
-   if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
+static int
+get_block_row_stride(const struct compress_job *job)
+{
+   if (job->dst_rowstride >= job->width * 4)
+      return job->dst_rowstride;
    else
-      dst_row_diff = 0;
-
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
-                                   MIN2(height - y, BLOCK_SIZE),
-                                   src + x * 4 + y * src_rowstride,
-                                   src_rowstride,
-                                   dst);
+      return ((job->width + 3) & ~3) * 4;
+}
+
+static void
+compress_rgba_unorm_rows(void *data, unsigned y0, unsigned y1)
+{
+   const struct compress_job *job = (const struct compress_job *) data;
+   const uint8_t *src = (const uint8_t *) job->src;
+   const int block_row_stride = get_block_row_stride(job);
+   uint8_t *dst;
+   int y, x;
+
+   for (y = y0; y < y1; y += BLOCK_SIZE) {
+      dst = job->dst + y / BLOCK_SIZE * block_row_stride;
+
+      for (x = 0; x < job->width; x += BLOCK_SIZE) {
+         compress_rgba_unorm_block(MIN2(job->width - x, BLOCK_SIZE),
+                                   MIN2(y1 - y, BLOCK_SIZE),
+                                   src + x * 4 + y * job->src_rowstride,
+                                   job->src_rowstride,
+                                   dst,
+                                   job->quality);
          dst += BLOCK_BYTES;
       }
-      dst += dst_row_diff;
    }
 }
 
@@ -1277,6 +1710,7 @@ _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
 {
    const GLubyte *pixels;
    const GLubyte *tempImage = NULL;
+   struct compress_job job;
    int rowstride;
 
    if (srcFormat != GL_RGBA ||
@@ -1308,9 +1742,15 @@ _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
                                          srcFormat, srcType);
    }
 
-   compress_rgba_unorm(srcWidth, srcHeight,
-                       pixels, rowstride,
-                       dstSlices[0], dstRowStride);
+   job.width = srcWidth;
+   job.src = pixels;
+   job.src_rowstride = rowstride;
+   job.dst = dstSlices[0];
+   job.dst_rowstride = dstRowStride;
+   job.quality = ctx->TextureCompressQuality;
+
+   _mesa_parallel_rows(ctx, srcWidth, srcHeight, BLOCK_SIZE,
+                       compress_rgba_unorm_rows, &job);
 
    free((void *) tempImage);
 
@@ -1555,31 +1995,27 @@ compress_rgb_float_block(int src_width, int src_height,
 }
 
 static void
-compress_rgb_float(int width, int height,
-                   const float *src, int src_rowstride,
-                   uint8_t *dst, int dst_rowstride,
-                   bool is_signed)
+compress_rgb_float_rows(void *data, unsigned y0, unsigned y1)
 {
-   int dst_row_diff;
+   const struct compress_job *job = (const struct compress_job *) data;
+   const float *src = (const float *) job->src;
+   const int block_row_stride = get_block_row_stride(job);
+   uint8_t *dst;
    int y, x;
 
-   if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
-   else
-      dst_row_diff = 0;
+   for (y = y0; y < y1; y += BLOCK_SIZE) {
+      dst = job->dst + y / BLOCK_SIZE * block_row_stride;
 
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgb_float_block(MIN2(width - x, BLOCK_SIZE),
-                                  MIN2(height - y, BLOCK_SIZE),
+      for (x = 0; x < job->width; x += BLOCK_SIZE) {
+         compress_rgb_float_block(MIN2(job->width - x, BLOCK_SIZE),
+                                  MIN2(y1 - y, BLOCK_SIZE),
                                   src + x * 3 +
-                                  y * src_rowstride / sizeof (float),
-                                  src_rowstride,
+                                  y * job->src_rowstride / sizeof (float),
+                                  job->src_rowstride,
                                   dst,
-                                  is_signed);
+                                  job->is_signed);
          dst += BLOCK_BYTES;
       }
-      dst += dst_row_diff;
    }
 }
 
@@ -1589,6 +2025,7 @@ texstore_bptc_rgb_float(TEXSTORE_PARAMS,
 {
    const float *pixels;
    const float *tempImage = NULL;
+   struct compress_job job;
    int rowstride;
 
    if (srcFormat != GL_RGB ||
@@ -1619,10 +2056,15 @@ texstore_bptc_rgb_float(TEXSTORE_PARAMS,
                                          srcFormat, srcType);
    }
 
-   compress_rgb_float(srcWidth, srcHeight,
-                      pixels, rowstride,
-                      dstSlices[0], dstRowStride,
-                      is_signed);
+   job.width = srcWidth;
+   job.src = pixels;
+   job.src_rowstride = rowstride;
+   job.dst = dstSlices[0];
+   job.dst_rowstride = dstRowStride;
+   job.is_signed = is_signed;
+
+   _mesa_parallel_rows(ctx, srcWidth, srcHeight, BLOCK_SIZE,
+                       compress_rgb_float_rows, &job);
 
    free((void *) tempImage);
 
@@ -38,6 +38,7 @@
 #include "image.h"
 #include "macros.h"
 #include "mipmap.h"
+#include "parallel_convert.h"
 #include "texcompress.h"
 #include "util/rgtc.h"
 #include "texcompress_rgtc.h"
@@ -72,17 +73,93 @@ static void extractsrc_s( GLbyte srcpixels[4][4], const GLfloat *srcaddr,
 }
 
 
+/**
+ * An image region handed to the encoders running on row slices.  The
+ * source is a tightly packed image with \c comps channels, each of which is
+ * encoded to its own 8-byte block.
+ */
+struct rgtc_job {
+   const void *src;
+   int width;
+   int comps;
+   bool is_signed;
+   GLubyte *dst;
+   GLint dst_row_stride;
+};
+
+static void
+compress_rgtc_rows(void *data, unsigned y0, unsigned y1)
+{
+   const struct rgtc_job *job = (const struct rgtc_job *) data;
+   const int width = job->width, comps = job->comps;
+   GLint blockRowStride;
+   int i, j, c;
+   int numxpixels, numypixels;
+   GLubyte *blkaddr;
+
+   if (job->dst_row_stride >= width * 2 * comps)
+      blockRowStride = job->dst_row_stride;
+   else
+      blockRowStride = ((width + 3) & ~3) * 2 * comps;
+
+   for (j = y0; j < y1; j += 4) {
+      numypixels = MIN2(y1 - j, 4);
+      blkaddr = job->dst + j / 4 * blockRowStride;
+      for (i = 0; i < width; i += 4) {
+         numxpixels = MIN2(width - i, 4);
+         for (c = 0; c < comps; c++) {
+            if (job->is_signed) {
+               const GLfloat *srcaddr = (const GLfloat *) job->src +
+                                        (j * width + i) * comps + c;
+               GLbyte srcpixels[4][4];
+
+               extractsrc_s(srcpixels, srcaddr, width,
+                            numxpixels, numypixels, comps);
+               util_format_signed_encode_rgtc_ubyte((GLbyte *) blkaddr,
+                                                    srcpixels,
+                                                    numxpixels, numypixels);
+            } else {
+               const GLubyte *srcaddr = (const GLubyte *) job->src +
+                                        (j * width + i) * comps + c;
+               GLubyte srcpixels[4][4];
+
+               extractsrc_u(srcpixels, srcaddr, width,
+                            numxpixels, numypixels, comps);
+               util_format_unsigned_encode_rgtc_ubyte(blkaddr, srcpixels,
+                                                      numxpixels, numypixels);
+            }
+            blkaddr += 8;
+         }
+      }
+   }
+}
+
+/**
+ * Encode the tightly packed \p tempImage into \p dst, splitting the work
+ * across the context's pixel conversion threads for large images.
+ */
+static void
+compress_rgtc(struct gl_context *ctx, const void *tempImage,
+              GLint srcWidth, GLint srcHeight, GLint comps, bool is_signed,
+              GLubyte *dst, GLint dstRowStride)
+{
+   struct rgtc_job job;
+
+   job.src = tempImage;
+   job.width = srcWidth;
+   job.comps = comps;
+   job.is_signed = is_signed;
+   job.dst = dst;
+   job.dst_row_stride = dstRowStride;
+
+   _mesa_parallel_rows(ctx, srcWidth, srcHeight, 4, compress_rgtc_rows, &job);
+}
+
 GLboolean
 _mesa_texstore_red_rgtc1(TEXSTORE_PARAMS)
 {
-   GLubyte *dst;
    const GLubyte *tempImage = NULL;
-   int i, j;
-   int numxpixels, numypixels;
-   const GLubyte *srcaddr;
-   GLubyte srcpixels[4][4];
-   GLubyte *blkaddr;
-   GLint dstRowDiff, redRowStride;
+   GLint redRowStride;
    GLubyte *tempImageSlices[1];
 
    assert(dstFormat == MESA_FORMAT_R_RGTC1_UNORM ||
@@ -101,24 +178,8 @@ _mesa_texstore_red_rgtc1(TEXSTORE_PARAMS)
                   srcFormat, srcType, srcAddr,
                   srcPacking);
 
-   dst = dstSlices[0];
-
-   blkaddr = dst;
-   dstRowDiff = dstRowStride >= (srcWidth * 2) ? dstRowStride - (((srcWidth + 3) & ~3) * 2) : 0;
-   for (j = 0; j < srcHeight; j+=4) {
-      if (srcHeight > j + 3) numypixels = 4;
-      else numypixels = srcHeight - j;
-      srcaddr = tempImage + j * srcWidth;
-      for (i = 0; i < srcWidth; i += 4) {
-	 if (srcWidth > i + 3) numxpixels = 4;
-	 else numxpixels = srcWidth - i;
-	 extractsrc_u(srcpixels, srcaddr, srcWidth, numxpixels, numypixels, 1);
-	 util_format_unsigned_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-	 srcaddr += numxpixels;
-	 blkaddr += 8;
-      }
-      blkaddr += dstRowDiff;
-   }
+   compress_rgtc(ctx, tempImage, srcWidth, srcHeight, 1, false,
+                 dstSlices[0], dstRowStride);
 
    free((void *) tempImage);
 
@@ -128,14 +189,8 @@ _mesa_texstore_red_rgtc1(TEXSTORE_PARAMS)
 GLboolean
 _mesa_texstore_signed_red_rgtc1(TEXSTORE_PARAMS)
 {
-   GLbyte *dst;
    const GLfloat *tempImage = NULL;
-   int i, j;
-   int numxpixels, numypixels;
-   const GLfloat *srcaddr;
-   GLbyte srcpixels[4][4];
-   GLbyte *blkaddr;
-   GLint dstRowDiff, redRowStride;
+   GLint redRowStride;
    GLfloat *tempImageSlices[1];
 
    assert(dstFormat == MESA_FORMAT_R_RGTC1_SNORM ||
@@ -154,24 +209,8 @@ _mesa_texstore_signed_red_rgtc1(TEXSTORE_PARAMS)
                   srcFormat, srcType, srcAddr,
                   srcPacking);
 
-   dst = (GLbyte *) dstSlices[0];
-
-   blkaddr = dst;
-   dstRowDiff = dstRowStride >= (srcWidth * 2) ? dstRowStride - (((srcWidth + 3) & ~3) * 2) : 0;
-   for (j = 0; j < srcHeight; j+=4) {
-      if (srcHeight > j + 3) numypixels = 4;
-      else numypixels = srcHeight - j;
-      srcaddr = tempImage + j * srcWidth;
-      for (i = 0; i < srcWidth; i += 4) {
-	 if (srcWidth > i + 3) numxpixels = 4;
-	 else numxpixels = srcWidth - i;
-	 extractsrc_s(srcpixels, srcaddr, srcWidth, numxpixels, numypixels, 1);
-	 util_format_signed_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-	 srcaddr += numxpixels;
-	 blkaddr += 8;
-      }
-      blkaddr += dstRowDiff;
-   }
+   compress_rgtc(ctx, tempImage, srcWidth, srcHeight, 1, true,
+                 dstSlices[0], dstRowStride);
 
    free((void *) tempImage);
 
@@ -181,14 +220,8 @@ _mesa_texstore_signed_red_rgtc1(TEXSTORE_PARAMS)
 GLboolean
 _mesa_texstore_rg_rgtc2(TEXSTORE_PARAMS)
 {
-   GLubyte *dst;
    const GLubyte *tempImage = NULL;
-   int i, j;
-   int numxpixels, numypixels;
-   const GLubyte *srcaddr;
-   GLubyte srcpixels[4][4];
-   GLubyte *blkaddr;
-   GLint dstRowDiff, rgRowStride;
+   GLint rgRowStride;
    mesa_format tempFormat;
    GLubyte *tempImageSlices[1];
 
@@ -215,30 +248,8 @@ _mesa_texstore_rg_rgtc2(TEXSTORE_PARAMS)
                   srcFormat, srcType, srcAddr,
                   srcPacking);
 
-   dst = dstSlices[0];
-
-   blkaddr = dst;
-   dstRowDiff = dstRowStride >= (srcWidth * 4) ? dstRowStride - (((srcWidth + 3) & ~3) * 4) : 0;
-   for (j = 0; j < srcHeight; j+=4) {
-      if (srcHeight > j + 3) numypixels = 4;
-      else numypixels = srcHeight - j;
-      srcaddr = tempImage + j * srcWidth * 2;
-      for (i = 0; i < srcWidth; i += 4) {
-	 if (srcWidth > i + 3) numxpixels = 4;
-	 else numxpixels = srcWidth - i;
-	 extractsrc_u(srcpixels, srcaddr, srcWidth, numxpixels, numypixels, 2);
-	 util_format_unsigned_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-
-	 blkaddr += 8;
-	 extractsrc_u(srcpixels, (GLubyte *)srcaddr + 1, srcWidth, numxpixels, numypixels, 2);
-	 util_format_unsigned_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-
-	 blkaddr += 8;
-
-	 srcaddr += numxpixels * 2;
-      }
-      blkaddr += dstRowDiff;
-   }
+   compress_rgtc(ctx, tempImage, srcWidth, srcHeight, 2, false,
+                 dstSlices[0], dstRowStride);
 
    free((void *) tempImage);
 
@@ -248,14 +259,8 @@ _mesa_texstore_rg_rgtc2(TEXSTORE_PARAMS)
 GLboolean
 _mesa_texstore_signed_rg_rgtc2(TEXSTORE_PARAMS)
 {
-   GLbyte *dst;
    const GLfloat *tempImage = NULL;
-   int i, j;
-   int numxpixels, numypixels;
-   const GLfloat *srcaddr;
-   GLbyte srcpixels[4][4];
-   GLbyte *blkaddr;
-   GLint dstRowDiff, rgRowStride;
+   GLint rgRowStride;
    mesa_format tempFormat;
    GLfloat *tempImageSlices[1];
 
@@ -280,31 +285,8 @@ _mesa_texstore_signed_rg_rgtc2(TEXSTORE_PARAMS)
                   srcFormat, srcType, srcAddr,
                   srcPacking);
 
-   dst = (GLbyte *) dstSlices[0];
-
-   blkaddr = dst;
-   dstRowDiff = dstRowStride >= (srcWidth * 4) ? dstRowStride - (((srcWidth + 3) & ~3) * 4) : 0;
-   for (j = 0; j < srcHeight; j += 4) {
-      if (srcHeight > j + 3) numypixels = 4;
-      else numypixels = srcHeight - j;
-      srcaddr = tempImage + j * srcWidth * 2;
-      for (i = 0; i < srcWidth; i += 4) {
-	 if (srcWidth > i + 3) numxpixels = 4;
-	 else numxpixels = srcWidth - i;
-
-	 extractsrc_s(srcpixels, srcaddr, srcWidth, numxpixels, numypixels, 2);
-	 util_format_signed_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-	 blkaddr += 8;
-
-	 extractsrc_s(srcpixels, srcaddr + 1, srcWidth, numxpixels, numypixels, 2);
-	 util_format_signed_encode_rgtc_ubyte(blkaddr, srcpixels, numxpixels, numypixels);
-	 blkaddr += 8;
-
-	 srcaddr += numxpixels * 2;
-
-      }
-      blkaddr += dstRowDiff;
-   }
+   compress_rgtc(ctx, tempImage, srcWidth, srcHeight, 2, true,
+                 dstSlices[0], dstRowStride);
 
    free((void *) tempImage);
 
@@ -47,6 +47,7 @@
 #include "texobj.h"
 #include "texstore.h"
 #include "format_utils.h"
+#include "parallel_convert.h"
 #include "pixeltransfer.h"
 
 /**
@@ -348,10 +349,10 @@ get_tex_rgba_compressed(struct gl_context *ctx, GLuint dimensions,
       void *dest = _mesa_image_address(dimensions, &ctx->Pack, pixels,
                                        width, height, format, type,
                                        slice, 0, 0);
-      _mesa_format_convert(dest, dstFormat, dstStride,
-                           tempSlice, RGBA32_FLOAT, srcStride,
-                           width, height,
-                           needsRebase ? rebaseSwizzle : NULL);
+      _mesa_parallel_format_convert(ctx, dest, dstFormat, dstStride,
+                                    tempSlice, RGBA32_FLOAT, srcStride,
+                                    width, height,
+                                    needsRebase ? rebaseSwizzle : NULL);
 
       /* Handle byte swapping if required */
       if (ctx->Pack.SwapBytes) {
@@ -512,10 +513,10 @@ get_tex_rgba_uncompressed(struct gl_context *ctx, GLuint dimensions,
             }
          }
 
-         _mesa_format_convert(rgba, rgba_format, rgba_stride,
-                              img_src, texFormat, rowstride,
-                              width, height,
-                              needsRebase ? rebaseSwizzle : NULL);
+         _mesa_parallel_format_convert(ctx, rgba, rgba_format, rgba_stride,
+                                       img_src, texFormat, rowstride,
+                                       width, height,
+                                       needsRebase ? rebaseSwizzle : NULL);
 
          /* Handle transfer ops now */
          _mesa_apply_rgba_transfer_ops(ctx, transferOps, width * height, rgba);
@@ -541,10 +542,10 @@ get_tex_rgba_uncompressed(struct gl_context *ctx, GLuint dimensions,
       }
 
       /* Do the conversion to destination format */
-      _mesa_format_convert(dest, dst_format, dst_stride,
-                           src, src_format, src_stride,
-                           width, height,
-                           needsRebase ? rebaseSwizzle : NULL);
+      _mesa_parallel_format_convert(ctx, dest, dst_format, dst_stride,
+                                    src, src_format, src_stride,
+                                    width, height,
+                                    needsRebase ? rebaseSwizzle : NULL);
 
    do_swap:
       /* Handle byte swapping if required */
@@ -644,7 +645,6 @@ get_tex_memcpy(struct gl_context *ctx,
 
    if (memCopy) {
       const GLuint bpp = _mesa_get_format_bytes(texImage->TexFormat);
-      const GLint bytesPerRow = width * bpp;
       GLubyte *dst =
          _mesa_image_address2d(&ctx->Pack, pixels, width, height,
                                format, type, 0, 0);
@@ -659,17 +659,10 @@ get_tex_memcpy(struct gl_context *ctx,
                                   GL_MAP_READ_BIT, &src, &srcRowStride);
 
       if (src) {
-         if (bytesPerRow == dstRowStride && bytesPerRow == srcRowStride) {
-            memcpy(dst, src, bytesPerRow * texImage->Height);
-         }
-         else {
-            GLuint row;
-            for (row = 0; row < height; row++) {
-               memcpy(dst, src, bytesPerRow);
-               dst += dstRowStride;
-               src += srcRowStride;
-            }
-         }
+         _mesa_parallel_copy_rows(ctx, dst, dstRowStride, src, srcRowStride,
+                                  width, height, bpp,
+                                  ctx->StreamingPixelCopy &&
+                                  _mesa_is_bufferobj(ctx->Pack.BufferObj));
 
          /* unmap src texture buffer */
          ctx->Driver.UnmapTextureImage(ctx, texImage, zoffset);
@@ -869,6 +869,7 @@ init_texture_unit( struct gl_context *ctx, GLuint unit )
 GLboolean
 _mesa_init_texture(struct gl_context *ctx)
 {
+   const char *env;
    GLuint u;
 
    /* Texture group */
@@ -891,6 +892,9 @@ _mesa_init_texture(struct gl_context *ctx)
     */
    ctx->Texture.CubeMapSeamless = ctx->API == API_OPENGLES2;
 
+   env = getenv("MESA_TEXCOMPRESS_QUALITY");
+   ctx->TextureCompressQuality = env ? CLAMP(atoi(env), 0, 2) : 0;
+
    for (u = 0; u < ARRAY_SIZE(ctx->Texture.Unit); u++)
       init_texture_unit(ctx, u);
 
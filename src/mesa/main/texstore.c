@@ -72,6 +72,7 @@
 #include "texstore.h"
 #include "enums.h"
 #include "glformats.h"
+#include "parallel_convert.h"
 #include "pixeltransfer.h"
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
@@ -774,9 +775,10 @@ texstore_rgba(TEXSTORE_PARAMS)
       src = (GLubyte *) srcAddr;
       dst = (GLubyte *) tempRGBA;
       for (img = 0; img < srcDepth; img++) {
-         _mesa_format_convert(dst, RGBA32_FLOAT, 4 * srcWidth * sizeof(float),
-                              src, srcMesaFormat, srcRowStride,
-                              srcWidth, srcHeight, NULL);
+         _mesa_parallel_format_convert(ctx, dst, RGBA32_FLOAT,
+                                       4 * srcWidth * sizeof(float),
+                                       src, srcMesaFormat, srcRowStride,
+                                       srcWidth, srcHeight, NULL);
          src += srcHeight * srcRowStride;
          dst += srcHeight * 4 * srcWidth * sizeof(float);
       }
@@ -809,10 +811,11 @@ texstore_rgba(TEXSTORE_PARAMS)
    }
 
    for (img = 0; img < srcDepth; img++) {
-      _mesa_format_convert(dstSlices[img], dstFormat, dstRowStride,
-                           src, srcMesaFormat, srcRowStride,
-                           srcWidth, srcHeight,
-                           needRebase ? rebaseSwizzle : NULL);
+      _mesa_parallel_format_convert(ctx,
+                                    dstSlices[img], dstFormat, dstRowStride,
+                                    src, srcMesaFormat, srcRowStride,
+                                    srcWidth, srcHeight,
+                                    needRebase ? rebaseSwizzle : NULL);
       src += srcHeight * srcRowStride;
    }
 
@@ -26,11 +26,15 @@
  **************************************************************************/
 
 
+#include <inttypes.h>  /* for PRIu64 macro */
 #include <stdio.h>
 #include "main/glheader.h"
 #include "main/context.h"
 
 #include "pipe/p_defines.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "os/os_time.h"
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_program.h"
@@ -83,41 +87,110 @@ static const struct st_tracked_state *atoms[] =
 };
 
 
+/**
+ * Calls and cumulative time of an atom's update(), see ST_PROFILE_ATOMS.
+ */
+struct st_atom_profile
+{
+   uint64_t calls;
+   uint64_t ns;
+};
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(profile_atoms, "ST_PROFILE_ATOMS", FALSE)
+
+
 void st_init_atoms( struct st_context *st )
 {
-   /* no-op */
+   unsigned i, bit;
+
+   STATIC_ASSERT(ARRAY_SIZE(atoms) <= 64);
+   STATIC_ASSERT(sizeof(st->dirty.mesa) * 8 ==
+                 ARRAY_SIZE(st->atoms_for_mesa_bit));
+   STATIC_ASSERT(sizeof(st->dirty.st) * 8 ==
+                 ARRAY_SIZE(st->atoms_for_st_bit));
+
+   memset(st->atoms_for_mesa_bit, 0, sizeof(st->atoms_for_mesa_bit));
+   memset(st->atoms_for_st_bit, 0, sizeof(st->atoms_for_st_bit));
+
+   for (i = 0; i < ARRAY_SIZE(atoms); i++) {
+      const struct st_tracked_state *atom = atoms[i];
+      GLbitfield mesa = atom->dirty.mesa;
+      uint64_t st_flags = atom->dirty.st;
+
+      if (!(atom->dirty.mesa || atom->dirty.st) || !atom->update) {
+         printf("malformed atom %s\n", atom->name);
+         assert(0);
+      }
+
+      while (mesa) {
+         bit = u_bit_scan(&mesa);
+         st->atoms_for_mesa_bit[bit] |= BITFIELD64_BIT(i);
+      }
+      while (st_flags) {
+         bit = u_bit_scan64(&st_flags);
+         st->atoms_for_st_bit[bit] |= BITFIELD64_BIT(i);
+      }
+   }
+
+   if (debug_get_option_profile_atoms())
+      st->atom_profile = calloc(ARRAY_SIZE(atoms), sizeof(*st->atom_profile));
 }
 
 
 void st_destroy_atoms( struct st_context *st )
 {
-   /* no-op */
-}
+   unsigned i;
 
+   if (!st->atom_profile)
+      return;
 
+   debug_printf("%-28s %10s %12s %10s\n", "atom", "calls", "total ms",
+                "avg us");
+   for (i = 0; i < ARRAY_SIZE(atoms); i++) {
+      const struct st_atom_profile *prof = &st->atom_profile[i];
 
-static bool
-check_state(const struct st_state_flags *a, const struct st_state_flags *b)
-{
-   return (a->mesa & b->mesa) || (a->st & b->st);
+      if (!prof->calls)
+         continue;
+
+      debug_printf("%-28s %10"PRIu64" %12.3f %10.3f\n", atoms[i]->name,
+                   prof->calls, prof->ns / 1e6,
+                   prof->ns / 1e3 / prof->calls);
+   }
+
+   free(st->atom_profile);
+   st->atom_profile = NULL;
 }
 
 
-static void
-accumulate_state(struct st_state_flags *a, const struct st_state_flags *b)
+
+/**
+ * Return the bitmask of the atoms that check any of the given flags.
+ */
+static uint64_t
+atoms_for_state(const struct st_context *st, GLbitfield mesa,
+                uint64_t st_flags)
 {
-   a->mesa |= b->mesa;
-   a->st |= b->st;
+   uint64_t mask = 0;
+
+   while (mesa)
+      mask |= st->atoms_for_mesa_bit[u_bit_scan(&mesa)];
+   while (st_flags)
+      mask |= st->atoms_for_st_bit[u_bit_scan64(&st_flags)];
+
+   return mask;
 }
 
 
 static void
-xor_states(struct st_state_flags *result,
-           const struct st_state_flags *a,
-           const struct st_state_flags *b)
+profile_update(struct st_context *st, unsigned i)
 {
-   result->mesa = a->mesa ^ b->mesa;
-   result->st = a->st ^ b->st;
+   int64_t start = os_time_get_nano();
+
+   atoms[i]->update(st);
+
+   st->atom_profile[i].ns += os_time_get_nano() - start;
+   st->atom_profile[i].calls++;
 }
 
 
@@ -171,7 +244,9 @@ static void check_attrib_edgeflag(struct st_context *st)
 void st_validate_state( struct st_context *st )
 {
    struct st_state_flags *state = &st->dirty;
-   GLuint i;
+   struct st_state_flags prev;
+   uint64_t pending;
+   unsigned i;
 
    /* Get Mesa driver state. */
    st->dirty.st |= st->ctx->NewDriverState;
@@ -186,55 +261,29 @@ void st_validate_state( struct st_context *st )
    if (state->st == 0 && state->mesa == 0)
       return;
 
-   /*printf("%s %x/%x\n", __func__, state->mesa, state->st);*/
-
-#ifdef DEBUG
-   if (1) {
-#else
-   if (0) {
-#endif
-      /* Debug version which enforces various sanity checks on the
-       * state flags which are generated and checked to help ensure
-       * state atoms are ordered correctly in the list.
-       */
-      struct st_state_flags examined, prev;      
-      memset(&examined, 0, sizeof(examined));
-      prev = *state;
-
-      for (i = 0; i < ARRAY_SIZE(atoms); i++) {	 
-	 const struct st_tracked_state *atom = atoms[i];
-	 struct st_state_flags generated;
-	 
-	 /*printf("atom %s %x/%x\n", atom->name, atom->dirty.mesa, atom->dirty.st);*/
-
-	 if (!(atom->dirty.mesa || atom->dirty.st) ||
-	     !atom->update) {
-	    printf("malformed atom %s\n", atom->name);
-	    assert(0);
-	 }
-
-	 if (check_state(state, &atom->dirty)) {
-	    atoms[i]->update( st );
-	    /*printf("after: %x\n", atom->dirty.mesa);*/
-	 }
-
-	 accumulate_state(&examined, &atom->dirty);
-
-	 /* generated = (prev ^ state)
-	  * if (examined & generated)
-	  *     fail;
-	  */
-	 xor_states(&generated, &prev, state);
-	 assert(!check_state(&examined, &generated));
-	 prev = *state;
-      }
-      /*printf("\n");*/
-
-   }
-   else {
-      for (i = 0; i < ARRAY_SIZE(atoms); i++) {	 
-	 if (check_state(state, &atoms[i]->dirty))
-	    atoms[i]->update( st );
+   /* Only visit the atoms that check the dirty flags, in list order.  An
+    * update() may flag more state, which only atoms later in the list are
+    * allowed to check.
+    */
+   pending = atoms_for_state(st, state->mesa, state->st);
+   prev = *state;
+
+   while (pending) {
+      i = u_bit_scan64(&pending);
+
+      if (unlikely(st->atom_profile))
+         profile_update(st, i);
+      else
+         atoms[i]->update(st);
+
+      if (state->mesa != prev.mesa || state->st != prev.st) {
+         uint64_t generated = atoms_for_state(st, state->mesa ^ prev.mesa,
+                                              state->st ^ prev.st);
+
+         /* The atoms up to this one have been examined already. */
+         assert(!(generated & BITFIELD64_MASK(i + 1)));
+         pending |= generated & ~BITFIELD64_MASK(i + 1);
+         prev = *state;
       }
    }
 
@@ -63,24 +63,7 @@ update_fp( struct st_context *st )
    stfp = st_fragment_program(st->ctx->FragmentProgram._Current);
    assert(stfp->Base.Base.Target == GL_FRAGMENT_PROGRAM_ARB);
 
-   memset(&key, 0, sizeof(key));
-   key.st = st->has_shareable_shaders ? NULL : st;
-
-   /* _NEW_FRAG_CLAMP */
-   key.clamp_color = st->clamp_frag_color_in_shader &&
-                     st->ctx->Color._ClampFragmentColor;
-
-   /* Don't set it if the driver can force the interpolation by itself.
-    * If SAMPLE_ID or SAMPLE_POS are used, the interpolation is set
-    * automatically.
-    * Ignore sample qualifier while computing this flag.
-    */
-   key.persample_shading =
-      st->force_persample_in_shader &&
-      !(stfp->Base.Base.SystemValuesRead & (SYSTEM_BIT_SAMPLE_ID |
-                                            SYSTEM_BIT_SAMPLE_POS)) &&
-      _mesa_get_min_invocations_per_fragment(st->ctx, &stfp->Base, true) > 1;
-
+   st_init_fp_variant_key(st, stfp, &key);
    st->fp_variant = st_get_fp_variant(st, stfp, &key);
 
    st_reference_fragprog(st, &st->fp, stfp);
@@ -118,25 +101,7 @@ update_vp( struct st_context *st )
    stvp = st_vertex_program(st->ctx->VertexProgram._Current);
    assert(stvp->Base.Base.Target == GL_VERTEX_PROGRAM_ARB);
 
-   memset(&key, 0, sizeof key);
-   key.st = st->has_shareable_shaders ? NULL : st;
-
-   /* When this is true, we will add an extra input to the vertex
-    * shader translation (for edgeflags), an extra output with
-    * edgeflag semantics, and extend the vertex shader to pass through
-    * the input to the output.  We'll need to use similar logic to set
-    * up the extra vertex_element input for edgeflags.
-    */
-   key.passthrough_edgeflags = st->vertdata_edgeflags;
-
-   key.clamp_color = st->clamp_vert_color_in_shader &&
-                     st->ctx->Light._ClampVertexColor &&
-                     (stvp->Base.Base.OutputsWritten &
-                      (VARYING_SLOT_COL0 |
-                       VARYING_SLOT_COL1 |
-                       VARYING_SLOT_BFC0 |
-                       VARYING_SLOT_BFC1));
-
+   st_init_vp_variant_key(st, stvp, &key);
    st->vp_variant = st_get_vp_variant(st, stvp, &key);
 
    st_reference_vertprog(st, &st->vp, stvp);
@@ -45,6 +45,21 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
+#include "cso_cache/cso_context.h"
+
+
+/**
+ * Drop vertices translated from the buffer's contents, which are about to
+ * change.
+ */
+static void
+st_bufferobj_invalidate_vertices(struct gl_context *ctx,
+                                 struct st_buffer_object *st_obj)
+{
+   if (st_obj->buffer)
+      cso_invalidate_vertex_buffer(st_context(ctx)->cso_context,
+                                   st_obj->buffer);
+}
 
 
 /**
@@ -79,6 +94,7 @@ st_bufferobj_free(struct gl_context *ctx, struct gl_buffer_object *obj)
 
    assert(obj->RefCount == 0);
    _mesa_buffer_unmap_all_mappings(ctx, obj);
+   st_bufferobj_invalidate_vertices(ctx, st_obj);
 
    if (st_obj->buffer)
       pipe_resource_reference(&st_obj->buffer, NULL);
@@ -123,6 +139,8 @@ st_bufferobj_subdata(struct gl_context *ctx,
       return;
    }
 
+   st_bufferobj_invalidate_vertices(ctx, st_obj);
+
    /* Now that transfers are per-context, we don't have to figure out
     * flushing here.  Usually drivers won't need to flush in this case
     * even if the buffer is currently referenced by hardware - they
@@ -185,6 +203,8 @@ st_bufferobj_data(struct gl_context *ctx,
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    unsigned bind, pipe_usage, pipe_flags = 0;
 
+   st_bufferobj_invalidate_vertices(ctx, st_obj);
+
    if (target != GL_EXTERNAL_VIRTUAL_MEMORY_BUFFER_AMD &&
        size && data && st_obj->buffer &&
        st_obj->Base.Size == size &&
@@ -340,8 +360,10 @@ st_bufferobj_map_range(struct gl_context *ctx,
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    enum pipe_transfer_usage flags = 0x0;
 
-   if (access & GL_MAP_WRITE_BIT)
+   if (access & GL_MAP_WRITE_BIT) {
       flags |= PIPE_TRANSFER_WRITE;
+      st_bufferobj_invalidate_vertices(ctx, st_obj);
+   }
 
    if (access & GL_MAP_READ_BIT)
       flags |= PIPE_TRANSFER_READ;
@@ -464,6 +486,8 @@ st_copy_buffer_subdata(struct gl_context *ctx,
    assert(!_mesa_check_disallowed_mapping(src));
    assert(!_mesa_check_disallowed_mapping(dst));
 
+   st_bufferobj_invalidate_vertices(ctx, dstObj);
+
    u_box_1d(readOffset, size, &box);
 
    pipe->resource_copy_region(pipe, dstObj->buffer, 0, writeOffset, 0, 0,
@@ -493,6 +517,8 @@ st_clear_buffer_subdata(struct gl_context *ctx,
    if (!clearValue)
       clearValue = zeros;
 
+   st_bufferobj_invalidate_vertices(ctx, buf);
+
    pipe->clear_buffer(pipe, buf->buffer, offset, size,
                       clearValue, clearValueSize);
 }
@@ -31,6 +31,8 @@
   *   Brian Paul
   */
 
+#include <inttypes.h>  /* for PRIu64 macro */
+
 #include "main/glheader.h"
 #include "main/macros.h"
 #include "main/context.h"
@@ -39,11 +41,13 @@
 #include "st_cb_flush.h"
 #include "st_cb_clear.h"
 #include "st_cb_fbo.h"
+#include "st_debug.h"
 #include "st_manager.h"
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "util/u_gen_mipmap.h"
+#include "util/u_upload_mgr.h"
 
 
 /** Check if we have a front color buffer and if it's been drawn to. */
@@ -75,6 +79,57 @@ display_front_buffer(struct st_context *st)
 }
 
 
+/**
+ * Hand the flush fence to the upload rings, so that their full buffers can
+ * be reused, and report the uploads of the frame.
+ */
+static void
+st_flush_uploaders(struct st_context *st, struct pipe_fence_handle **fence,
+                   unsigned flags)
+{
+   struct u_upload_mgr *uploaders[] = {
+      st->uploader, st->indexbuf_uploader, st->constbuf_uploader
+   };
+   static const char *names[] = { "vertex", "index", "constant" };
+   struct pipe_screen *screen = st->pipe->screen;
+   struct pipe_fence_handle *upload_fence = NULL;
+   boolean needs_fence = FALSE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(uploaders); i++) {
+      if (uploaders[i] && u_upload_needs_fence(uploaders[i]))
+         needs_fence = TRUE;
+   }
+
+   if (!fence && needs_fence)
+      fence = &upload_fence;
+
+   st->pipe->flush(st->pipe, fence, flags);
+
+   for (i = 0; i < ARRAY_SIZE(uploaders); i++) {
+      struct u_upload_stats stats;
+
+      if (!uploaders[i])
+         continue;
+
+      if (needs_fence && *fence)
+         u_upload_fence(uploaders[i], *fence);
+
+      if (flags & PIPE_FLUSH_END_OF_FRAME) {
+         u_upload_end_frame(uploaders[i], &stats);
+         if (stats.num_buffers_created || stats.bytes_uploaded) {
+            ST_DBG(DEBUG_BUFFER, "%s uploads: %"PRIu64" bytes, "
+                   "%u new buffers\n", names[i], stats.bytes_uploaded,
+                   stats.num_buffers_created);
+         }
+      }
+   }
+
+   if (upload_fence)
+      screen->fence_reference(screen, &upload_fence, NULL);
+}
+
+
 void st_flush(struct st_context *st,
               struct pipe_fence_handle **fence,
               unsigned flags)
@@ -84,7 +139,7 @@ void st_flush(struct st_context *st,
 
    st_flush_bitmap_cache(st);
 
-   st->pipe->flush(st->pipe, fence, flags);
+   st_flush_uploaders(st, fence, flags);
 }
 
 
@@ -105,10 +105,12 @@ st_new_program(struct gl_context *ctx, GLenum target, GLuint id)
    switch (target) {
    case GL_VERTEX_PROGRAM_ARB: {
       struct st_vertex_program *prog = ST_CALLOC_STRUCT(st_vertex_program);
+      mtx_init(&prog->variants_mutex, mtx_plain);
       return _mesa_init_gl_program(&prog->Base.Base, target, id);
    }
    case GL_FRAGMENT_PROGRAM_ARB: {
       struct st_fragment_program *prog = ST_CALLOC_STRUCT(st_fragment_program);
+      mtx_init(&prog->variants_mutex, mtx_plain);
       return _mesa_init_gl_program(&prog->Base.Base, target, id);
    }
    case GL_GEOMETRY_PROGRAM_NV: {
@@ -146,6 +148,8 @@ st_delete_program(struct gl_context *ctx, struct gl_program *prog)
          
          if (stvp->glsl_to_tgsi)
             free_glsl_to_tgsi_visitor(stvp->glsl_to_tgsi);
+
+         mtx_destroy(&stvp->variants_mutex);
       }
       break;
    case GL_GEOMETRY_PROGRAM_NV:
@@ -168,6 +172,8 @@ st_delete_program(struct gl_context *ctx, struct gl_program *prog)
          
          if (stfp->glsl_to_tgsi)
             free_glsl_to_tgsi_visitor(stfp->glsl_to_tgsi);
+
+         mtx_destroy(&stfp->variants_mutex);
       }
       break;
    case GL_TESS_CONTROL_PROGRAM_NV:
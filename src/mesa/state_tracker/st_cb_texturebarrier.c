@@ -38,6 +38,7 @@
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "cso_cache/cso_context.h"
 #include "st_context.h"
 #include "st_cb_texturebarrier.h"
 
@@ -60,12 +61,18 @@ st_TextureBarrier(struct gl_context *ctx)
 static void
 st_MemoryBarrier(struct gl_context *ctx, GLbitfield barriers)
 {
-   struct pipe_context *pipe = st_context(ctx)->pipe;
+   struct st_context *st = st_context(ctx);
+   struct pipe_context *pipe = st->pipe;
    unsigned flags = 0;
 
    if (barriers & GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT)
       flags |= PIPE_BARRIER_MAPPED_BUFFER;
 
+   /* Shader writes to buffers become visible to vertex fetch after this
+    * barrier, so vertices translated from any buffer may be stale. */
+   if (barriers & GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT)
+      cso_invalidate_vertex_buffer(st->cso_context, NULL);
+
    if (flags && pipe->memory_barrier)
       pipe->memory_barrier(pipe, flags);
 }
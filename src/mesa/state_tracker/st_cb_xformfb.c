@@ -155,12 +155,28 @@ st_begin_transform_feedback(struct gl_context *ctx, GLenum mode,
 }
 
 
+/* Drop vertices translated from the targets, which have been written. */
+static void
+st_invalidate_so_targets(struct st_context *st,
+                         struct st_transform_feedback_object *sobj)
+{
+   unsigned i;
+
+   for (i = 0; i < sobj->num_targets; i++) {
+      if (sobj->targets[i])
+         cso_invalidate_vertex_buffer(st->cso_context,
+                                      sobj->targets[i]->buffer);
+   }
+}
+
+
 static void
 st_pause_transform_feedback(struct gl_context *ctx,
                            struct gl_transform_feedback_object *obj)
 {
    struct st_context *st = st_context(ctx);
    cso_set_stream_outputs(st->cso_context, 0, NULL, NULL);
+   st_invalidate_so_targets(st, st_transform_feedback_object(obj));
 }
 
 
@@ -192,6 +208,7 @@ st_end_transform_feedback(struct gl_context *ctx,
    unsigned i;
 
    cso_set_stream_outputs(st->cso_context, 0, NULL, NULL);
+   st_invalidate_so_targets(st, sobj);
 
    /* The next call to glDrawTransformFeedbackStream should use the vertex
     * count from the last call to glEndTransformFeedback.
@@ -77,6 +77,7 @@
 
 
 DEBUG_GET_ONCE_BOOL_OPTION(mesa_mvp_dp4, "MESA_MVP_DP4", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(vbuf_cache_mb, "ST_VBUF_CACHE_MB", 0)
 
 
 /**
@@ -189,21 +190,25 @@ st_create_context_priv( struct gl_context *ctx, struct pipe_context *pipe,
    /* Create upload manager for vertex data for glBitmap, glDrawPixels,
     * glClear, etc.
     */
-   st->uploader = u_upload_create(st->pipe, 65536, PIPE_BIND_VERTEX_BUFFER,
-                                  PIPE_USAGE_STREAM);
+   st->uploader = u_upload_create_ring(st->pipe, 65536,
+                                       PIPE_BIND_VERTEX_BUFFER,
+                                       PIPE_USAGE_STREAM, 4);
 
    if (!screen->get_param(screen, PIPE_CAP_USER_INDEX_BUFFERS)) {
-      st->indexbuf_uploader = u_upload_create(st->pipe, 128 * 1024,
-                                              PIPE_BIND_INDEX_BUFFER,
-                                              PIPE_USAGE_STREAM);
+      st->indexbuf_uploader = u_upload_create_ring(st->pipe, 128 * 1024,
+                                                   PIPE_BIND_INDEX_BUFFER,
+                                                   PIPE_USAGE_STREAM, 4);
    }
 
    if (!screen->get_param(screen, PIPE_CAP_USER_CONSTANT_BUFFERS))
-      st->constbuf_uploader = u_upload_create(pipe, 128 * 1024,
-                                              PIPE_BIND_CONSTANT_BUFFER,
-                                              PIPE_USAGE_STREAM);
+      st->constbuf_uploader = u_upload_create_ring(pipe, 128 * 1024,
+                                                   PIPE_BIND_CONSTANT_BUFFER,
+                                                   PIPE_USAGE_STREAM, 4);
 
    st->cso_context = cso_create_context(pipe);
+   cso_set_vertex_translate_cache_size(st->cso_context,
+                                       debug_get_option_vbuf_cache_mb() *
+                                       1024 * 1024);
 
    st_init_atoms( st );
    st_init_bitmap(st);
@@ -45,6 +45,7 @@ struct draw_context;
 struct draw_stage;
 struct gen_mipmap_state;
 struct st_context;
+struct st_atom_profile;
 struct st_fragment_program;
 struct st_perf_monitor_group;
 struct u_upload_mgr;
@@ -152,6 +153,13 @@ struct st_context
 
    struct st_state_flags dirty;
 
+   /** Bitmasks of the atoms that check each dirty bit, see st_atom.c */
+   uint64_t atoms_for_mesa_bit[32];
+   uint64_t atoms_for_st_bit[64];
+
+   /** Per-atom update() calls and time, only with ST_PROFILE_ATOMS */
+   struct st_atom_profile *atom_profile;
+
    GLboolean vertdata_edgeflags;
    GLboolean edgeflag_culls_prims;
 
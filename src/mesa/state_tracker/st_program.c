@@ -37,11 +37,13 @@
 #include "program/prog_parameter.h"
 #include "program/prog_print.h"
 #include "program/programopt.h"
+#include "util/hash_table.h"
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
+#include "os/os_time.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_emulate.h"
 #include "tgsi/tgsi_parse.h"
@@ -57,6 +59,42 @@
 
 
 
+/**
+ * Number of variants a program may have before lookups switch from walking
+ * the variant list to a hash table keyed by the variant key.  For a couple
+ * of variants a memcmp per list entry is cheaper than hashing the key.
+ */
+#define ST_VARIANT_HASH_THRESHOLD 4
+
+
+static uint32_t
+vp_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct st_vp_variant_key));
+}
+
+
+static bool
+vp_variant_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct st_vp_variant_key)) == 0;
+}
+
+
+static uint32_t
+fp_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct st_fp_variant_key));
+}
+
+
+static bool
+fp_variant_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct st_fp_variant_key)) == 0;
+}
+
+
 /**
  * Delete a vertex program variant.  Note the caller must unlink
  * the variant from the linked list.
@@ -87,6 +125,7 @@ st_release_vp_variants( struct st_context *st,
 {
    struct st_vp_variant *vpv;
 
+   mtx_lock(&stvp->variants_mutex);
    for (vpv = stvp->variants; vpv; ) {
       struct st_vp_variant *next = vpv->next;
       delete_vp_variant(st, vpv);
@@ -94,6 +133,13 @@ st_release_vp_variants( struct st_context *st,
    }
 
    stvp->variants = NULL;
+   stvp->num_variants = 0;
+
+   if (stvp->variants_ht) {
+      _mesa_hash_table_destroy(stvp->variants_ht, NULL);
+      stvp->variants_ht = NULL;
+   }
+   mtx_unlock(&stvp->variants_mutex);
 
    if (stvp->tgsi.tokens) {
       tgsi_free_tokens(stvp->tgsi.tokens);
@@ -124,6 +170,7 @@ st_release_fp_variants(struct st_context *st, struct st_fragment_program *stfp)
 {
    struct st_fp_variant *fpv;
 
+   mtx_lock(&stfp->variants_mutex);
    for (fpv = stfp->variants; fpv; ) {
       struct st_fp_variant *next = fpv->next;
       delete_fp_variant(st, fpv);
@@ -131,6 +178,13 @@ st_release_fp_variants(struct st_context *st, struct st_fragment_program *stfp)
    }
 
    stfp->variants = NULL;
+   stfp->num_variants = 0;
+
+   if (stfp->variants_ht) {
+      _mesa_hash_table_destroy(stfp->variants_ht, NULL);
+      stfp->variants_ht = NULL;
+   }
+   mtx_unlock(&stfp->variants_mutex);
 
    if (stfp->tgsi.tokens) {
       ureg_free_tokens(stfp->tgsi.tokens);
@@ -501,6 +555,35 @@ st_create_vp_variant(struct st_context *st,
 }
 
 
+/**
+ * Fill in the vertex program variant key for the current GL state.
+ */
+void
+st_init_vp_variant_key(struct st_context *st,
+                       struct st_vertex_program *stvp,
+                       struct st_vp_variant_key *key)
+{
+   memset(key, 0, sizeof(*key));
+   key->st = st->has_shareable_shaders ? NULL : st;
+
+   /* When this is true, we will add an extra input to the vertex
+    * shader translation (for edgeflags), an extra output with
+    * edgeflag semantics, and extend the vertex shader to pass through
+    * the input to the output.  We'll need to use similar logic to set
+    * up the extra vertex_element input for edgeflags.
+    */
+   key->passthrough_edgeflags = st->vertdata_edgeflags;
+
+   key->clamp_color = st->clamp_vert_color_in_shader &&
+                      st->ctx->Light._ClampVertexColor &&
+                      (stvp->Base.Base.OutputsWritten &
+                       (VARYING_SLOT_COL0 |
+                        VARYING_SLOT_COL1 |
+                        VARYING_SLOT_BFC0 |
+                        VARYING_SLOT_BFC1));
+}
+
+
 /**
  * Find/create a vertex program variant.
  */
@@ -510,23 +593,60 @@ st_get_vp_variant(struct st_context *st,
                   const struct st_vp_variant_key *key)
 {
    struct st_vp_variant *vpv;
+   int64_t start;
 
    /* Search for existing variant */
-   for (vpv = stvp->variants; vpv; vpv = vpv->next) {
-      if (memcmp(&vpv->key, key, sizeof(*key)) == 0) {
-         break;
+   mtx_lock(&stvp->variants_mutex);
+   if (stvp->variants_ht) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(stvp->variants_ht, key);
+
+      vpv = entry ? entry->data : NULL;
+   }
+   else {
+      for (vpv = stvp->variants; vpv; vpv = vpv->next) {
+         if (memcmp(&vpv->key, key, sizeof(*key)) == 0)
+            break;
       }
    }
+   mtx_unlock(&stvp->variants_mutex);
 
-   if (!vpv) {
-      /* create now */
-      vpv = st_create_vp_variant(st, stvp, key);
-      if (vpv) {
-         /* insert into list */
-         vpv->next = stvp->variants;
-         stvp->variants = vpv;
+   if (vpv)
+      return vpv;
+
+   /* create now */
+   start = os_time_get_nano();
+   vpv = st_create_vp_variant(st, stvp, key);
+   if (!vpv)
+      return NULL;
+
+   mtx_lock(&stvp->variants_mutex);
+   stvp->variants_create_ns += os_time_get_nano() - start;
+   stvp->num_variants++;
+
+   ST_DBG(DEBUG_VARIANTS,
+          "st: vertex program %u: variant %u created, %.3f ms total\n",
+          stvp->Base.Base.Id, stvp->num_variants,
+          stvp->variants_create_ns * 1e-6);
+
+   /* insert into list */
+   vpv->next = stvp->variants;
+   stvp->variants = vpv;
+
+   if (stvp->variants_ht) {
+      _mesa_hash_table_insert(stvp->variants_ht, &vpv->key, vpv);
+   }
+   else if (stvp->num_variants >= ST_VARIANT_HASH_THRESHOLD) {
+      struct st_vp_variant *v;
+
+      stvp->variants_ht = _mesa_hash_table_create(NULL, vp_variant_key_hash,
+                                                  vp_variant_key_equal);
+      if (stvp->variants_ht) {
+         for (v = stvp->variants; v; v = v->next)
+            _mesa_hash_table_insert(stvp->variants_ht, &v->key, v);
       }
    }
+   mtx_unlock(&stvp->variants_mutex);
 
    return vpv;
 }
@@ -979,6 +1099,34 @@ st_create_fp_variant(struct st_context *st,
    return variant;
 }
 
+/**
+ * Fill in the fragment program variant key for the current GL state.
+ */
+void
+st_init_fp_variant_key(struct st_context *st,
+                       struct st_fragment_program *stfp,
+                       struct st_fp_variant_key *key)
+{
+   memset(key, 0, sizeof(*key));
+   key->st = st->has_shareable_shaders ? NULL : st;
+
+   /* _NEW_FRAG_CLAMP */
+   key->clamp_color = st->clamp_frag_color_in_shader &&
+                      st->ctx->Color._ClampFragmentColor;
+
+   /* Don't set it if the driver can force the interpolation by itself.
+    * If SAMPLE_ID or SAMPLE_POS are used, the interpolation is set
+    * automatically.
+    * Ignore sample qualifier while computing this flag.
+    */
+   key->persample_shading =
+      st->force_persample_in_shader &&
+      !(stfp->Base.Base.SystemValuesRead & (SYSTEM_BIT_SAMPLE_ID |
+                                            SYSTEM_BIT_SAMPLE_POS)) &&
+      _mesa_get_min_invocations_per_fragment(st->ctx, &stfp->Base, true) > 1;
+}
+
+
 /**
  * Translate fragment program if needed.
  */
@@ -988,23 +1136,60 @@ st_get_fp_variant(struct st_context *st,
                   const struct st_fp_variant_key *key)
 {
    struct st_fp_variant *fpv;
+   int64_t start;
 
    /* Search for existing variant */
-   for (fpv = stfp->variants; fpv; fpv = fpv->next) {
-      if (memcmp(&fpv->key, key, sizeof(*key)) == 0) {
-         break;
+   mtx_lock(&stfp->variants_mutex);
+   if (stfp->variants_ht) {
+      struct hash_entry *entry =
+         _mesa_hash_table_search(stfp->variants_ht, key);
+
+      fpv = entry ? entry->data : NULL;
+   }
+   else {
+      for (fpv = stfp->variants; fpv; fpv = fpv->next) {
+         if (memcmp(&fpv->key, key, sizeof(*key)) == 0)
+            break;
       }
    }
+   mtx_unlock(&stfp->variants_mutex);
 
-   if (!fpv) {
-      /* create new */
-      fpv = st_create_fp_variant(st, stfp, key);
-      if (fpv) {
-         /* insert into list */
-         fpv->next = stfp->variants;
-         stfp->variants = fpv;
+   if (fpv)
+      return fpv;
+
+   /* create new */
+   start = os_time_get_nano();
+   fpv = st_create_fp_variant(st, stfp, key);
+   if (!fpv)
+      return NULL;
+
+   mtx_lock(&stfp->variants_mutex);
+   stfp->variants_create_ns += os_time_get_nano() - start;
+   stfp->num_variants++;
+
+   ST_DBG(DEBUG_VARIANTS,
+          "st: fragment program %u: variant %u created, %.3f ms total\n",
+          stfp->Base.Base.Id, stfp->num_variants,
+          stfp->variants_create_ns * 1e-6);
+
+   /* insert into list */
+   fpv->next = stfp->variants;
+   stfp->variants = fpv;
+
+   if (stfp->variants_ht) {
+      _mesa_hash_table_insert(stfp->variants_ht, &fpv->key, fpv);
+   }
+   else if (stfp->num_variants >= ST_VARIANT_HASH_THRESHOLD) {
+      struct st_fp_variant *v;
+
+      stfp->variants_ht = _mesa_hash_table_create(NULL, fp_variant_key_hash,
+                                                  fp_variant_key_equal);
+      if (stfp->variants_ht) {
+         for (v = stfp->variants; v; v = v->next)
+            _mesa_hash_table_insert(stfp->variants_ht, &v->key, v);
       }
    }
+   mtx_unlock(&stfp->variants_mutex);
 
    return fpv;
 }
@@ -1559,11 +1744,17 @@ destroy_program_variants(struct st_context *st, struct gl_program *program)
          struct st_vertex_program *stvp = (struct st_vertex_program *) program;
          struct st_vp_variant *vpv, **prevPtr = &stvp->variants;
 
+         mtx_lock(&stvp->variants_mutex);
          for (vpv = stvp->variants; vpv; ) {
             struct st_vp_variant *next = vpv->next;
             if (vpv->key.st == st) {
                /* unlink from list */
                *prevPtr = next;
+               if (stvp->variants_ht) {
+                  _mesa_hash_table_remove(stvp->variants_ht,
+                     _mesa_hash_table_search(stvp->variants_ht, &vpv->key));
+               }
+               stvp->num_variants--;
                /* destroy this variant */
                delete_vp_variant(st, vpv);
             }
@@ -1572,6 +1763,7 @@ destroy_program_variants(struct st_context *st, struct gl_program *program)
             }
             vpv = next;
          }
+         mtx_unlock(&stvp->variants_mutex);
       }
       break;
    case GL_FRAGMENT_PROGRAM_ARB:
@@ -1580,11 +1772,17 @@ destroy_program_variants(struct st_context *st, struct gl_program *program)
             (struct st_fragment_program *) program;
          struct st_fp_variant *fpv, **prevPtr = &stfp->variants;
 
+         mtx_lock(&stfp->variants_mutex);
          for (fpv = stfp->variants; fpv; ) {
             struct st_fp_variant *next = fpv->next;
             if (fpv->key.st == st) {
                /* unlink from list */
                *prevPtr = next;
+               if (stfp->variants_ht) {
+                  _mesa_hash_table_remove(stfp->variants_ht,
+                     _mesa_hash_table_search(stfp->variants_ht, &fpv->key));
+               }
+               stfp->num_variants--;
                /* destroy this variant */
                delete_fp_variant(st, fpv);
             }
@@ -1593,6 +1791,7 @@ destroy_program_variants(struct st_context *st, struct gl_program *program)
             }
             fpv = next;
          }
+         mtx_unlock(&stfp->variants_mutex);
       }
       break;
    case GL_GEOMETRY_PROGRAM_NV:
@@ -1767,7 +1966,10 @@ st_print_current_vertex_program(void)
 
 
 /**
- * Compile one shader variant.
+ * Compile the shader variants a program is most likely to be used with:
+ * the one for the default state, and for vertex and fragment programs
+ * also the one for the current clamping, edge flag and sample shading
+ * state if that differs.
  */
 void
 st_precompile_shader_variant(struct st_context *st,
@@ -1781,6 +1983,9 @@ st_precompile_shader_variant(struct st_context *st,
       memset(&key, 0, sizeof(key));
       key.st = st->has_shareable_shaders ? NULL : st;
       st_get_vp_variant(st, p, &key);
+
+      st_init_vp_variant_key(st, p, &key);
+      st_get_vp_variant(st, p, &key);
       break;
    }
 
@@ -1821,6 +2026,9 @@ st_precompile_shader_variant(struct st_context *st,
       memset(&key, 0, sizeof(key));
       key.st = st->has_shareable_shaders ? NULL : st;
       st_get_fp_variant(st, p, &key);
+
+      st_init_fp_variant_key(st, p, &key);
+      st_get_fp_variant(st, p, &key);
       break;
    }
 
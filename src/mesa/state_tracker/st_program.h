@@ -47,6 +47,8 @@ extern "C" {
 
 #define ST_DOUBLE_ATTRIB_PLACEHOLDER 0xffffffff
 
+struct hash_table;
+
 /** Fragment program variant key */
 struct st_fp_variant_key
 {
@@ -101,6 +103,16 @@ struct st_fragment_program
    struct glsl_to_tgsi_visitor* glsl_to_tgsi;
 
    struct st_fp_variant *variants;
+
+   /** Variants indexed by key, once there are enough of them */
+   struct hash_table *variants_ht;
+
+   /** Guards the variant list and table, programs are shared by contexts */
+   mtx_t variants_mutex;
+
+   /** Number of live variants and total time spent creating variants */
+   unsigned num_variants;
+   uint64_t variants_create_ns;
 };
 
 
@@ -167,6 +179,16 @@ struct st_vertex_program
    /** List of translated variants of this vertex program.
     */
    struct st_vp_variant *variants;
+
+   /** Variants indexed by key, once there are enough of them */
+   struct hash_table *variants_ht;
+
+   /** Guards the variant list and table, programs are shared by contexts */
+   mtx_t variants_mutex;
+
+   /** Number of live variants and total time spent creating variants */
+   unsigned num_variants;
+   uint64_t variants_create_ns;
 };
 
 
@@ -386,6 +408,16 @@ st_get_generic_varying_index(struct st_context *st, GLuint attr)
 }
 
 
+extern void
+st_init_vp_variant_key(struct st_context *st,
+                       struct st_vertex_program *stvp,
+                       struct st_vp_variant_key *key);
+
+extern void
+st_init_fp_variant_key(struct st_context *st,
+                       struct st_fragment_program *stfp,
+                       struct st_fp_variant_key *key);
+
 extern struct st_vp_variant *
 st_get_vp_variant(struct st_context *st,
                   struct st_vertex_program *stvp,
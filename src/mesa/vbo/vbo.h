@@ -97,6 +97,20 @@ void vbo_save_EndList(struct gl_context *ctx);
 void vbo_save_BeginCallList(struct gl_context *ctx, struct gl_display_list *list);
 void vbo_save_EndCallList(struct gl_context *ctx);
 
+struct vbo_save_merge;
+
+struct vbo_save_merge *vbo_save_merge_create(void);
+void vbo_save_merge_destroy(struct vbo_save_merge *merge);
+void vbo_save_merge_reset(struct vbo_save_merge *merge);
+GLuint vbo_save_merge_num_lists(const struct vbo_save_merge *merge);
+GLboolean vbo_save_merge_attr(struct vbo_save_merge *merge, GLuint attr,
+                              GLuint size, const GLfloat *v);
+GLboolean vbo_save_merge_list(struct gl_context *ctx,
+                              struct vbo_save_merge *merge,
+                              GLuint opcode, const void *data);
+GLboolean vbo_save_merge_emit(struct gl_context *ctx,
+                              struct vbo_save_merge *merge);
+
 
 typedef void (*vbo_draw_func)( struct gl_context *ctx,
 			       const struct _mesa_prim *prims,
@@ -185,6 +199,48 @@ vbo_get_minmax_indices(struct gl_context *ctx, const struct _mesa_prim *prim,
                        const struct _mesa_index_buffer *ib,
                        GLuint *min_index, GLuint *max_index, GLuint nr_prims);
 
+void
+vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj);
+
+/**
+ * A range of indices between primitive restart indices, for drivers that
+ * don't support primitive restart.
+ */
+struct vbo_sub_primitive
+{
+   GLuint start;
+   GLuint count;
+   GLuint min_index;
+   GLuint max_index;
+};
+
+unsigned
+vbo_find_index(const void *indices, unsigned index_size,
+               unsigned start, unsigned end, unsigned value);
+
+void
+vbo_index_array_min_max(const void *indices, unsigned index_size,
+                        unsigned count, GLuint *min_index, GLuint *max_index);
+
+bool
+vbo_get_sub_primitives_cached(struct gl_buffer_object *bufferObj,
+                              GLintptr offset, unsigned count,
+                              unsigned index_size, unsigned restart_index,
+                              struct vbo_sub_primitive **sub_prims,
+                              unsigned *num_sub_prims);
+
+void
+vbo_store_sub_primitives(struct gl_buffer_object *bufferObj,
+                         GLintptr offset, unsigned count,
+                         unsigned index_size, unsigned restart_index,
+                         const struct vbo_sub_primitive *sub_prims,
+                         unsigned num_sub_prims);
+
+struct vbo_sub_primitive *
+vbo_find_sub_primitives(const void *elements, unsigned element_size,
+                        unsigned start, unsigned end, unsigned restart_index,
+                        unsigned *num_sub_prims);
+
 void vbo_use_buffer_objects(struct gl_context *ctx);
 
 void vbo_always_unmap_buffers(struct gl_context *ctx);
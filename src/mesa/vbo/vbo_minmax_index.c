@@ -0,0 +1,591 @@
+/**************************************************************************
+ *
+ * Copyright 2003 VMware, Inc.
+ * Copyright 2009 VMware, Inc.
+ * Copyright 2016 Intel Corporation
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include "main/glheader.h"
+#include "main/context.h"
+#include "main/varray.h"
+#include "main/macros.h"
+#include "main/sse_minmax.h"
+#include "main/sse_index.h"
+#include "main/avx2_minmax.h"
+#include "main/avx2_index.h"
+#include "x86/common_x86_asm.h"
+#include "util/hash_table.h"
+
+#include "vbo.h"
+
+
+/**
+ * Maximum number of cached ranges per buffer object.  When this is
+ * exceeded, the whole cache of the buffer object is dropped.
+ */
+#define MAX_ENTRIES 128
+
+/**
+ * The cache key.  It is hashed and compared as raw memory, so it is always
+ * zeroed before being filled in, and copied with memcpy().  The pad field
+ * makes the trailing padding after sub_primitives on 64-bit targets part of
+ * the key.
+ */
+struct minmax_cache_key {
+   GLintptr offset;
+   GLuint count;
+   GLuint index_size;
+   GLuint restart;
+   GLuint restart_index;
+   /** Whether the entry is a sub_primitive_cache_entry */
+   GLuint sub_primitives;
+   GLuint pad;
+};
+
+
+struct minmax_cache_entry {
+   struct minmax_cache_key key;
+   GLuint min;
+   GLuint max;
+};
+
+
+/**
+ * The ranges between restart indices found by vbo_sw_primitive_restart(),
+ * cached along with the min/max ranges of the same buffer object.
+ */
+struct sub_primitive_cache_entry {
+   struct minmax_cache_key key;
+   GLuint num_sub_prims;
+   struct vbo_sub_primitive sub_prims[];
+};
+
+
+static uint32_t
+vbo_minmax_cache_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct minmax_cache_key));
+}
+
+
+static bool
+vbo_minmax_cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct minmax_cache_key)) == 0;
+}
+
+
+static void
+vbo_minmax_cache_delete_entry(struct hash_entry *entry)
+{
+   free(entry->data);
+}
+
+
+/**
+ * Whether the contents of the buffer may change without the
+ * MinMaxCacheDirty flag being set, or the cache has been found to be
+ * useless for this buffer.
+ */
+static bool
+vbo_use_minmax_cache(const struct gl_buffer_object *bufferObj)
+{
+   /* The GPU may write to these. */
+   if (bufferObj->UsageHistory & (USAGE_TEXTURE_BUFFER |
+                                  USAGE_ATOMIC_COUNTER_BUFFER |
+                                  USAGE_SHADER_STORAGE_BUFFER |
+                                  USAGE_TRANSFORM_FEEDBACK_BUFFER |
+                                  USAGE_PIXEL_PACK_BUFFER |
+                                  USAGE_DISABLE_MINMAX_CACHE))
+      return false;
+
+   /* The application may write through a persistent mapping at any time. */
+   if ((bufferObj->Mappings[MAP_USER].AccessFlags &
+        (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT)) ==
+       (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT))
+      return false;
+
+   return true;
+}
+
+
+void
+vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
+{
+   _mesa_hash_table_destroy(bufferObj->MinMaxCache,
+                            vbo_minmax_cache_delete_entry);
+   bufferObj->MinMaxCache = NULL;
+}
+
+
+/**
+ * Look \p key up in the cache of \p bufferObj, whose mutex must be held.
+ * Returns the cache entry, or NULL.
+ */
+static const void *
+vbo_minmax_cache_lookup(struct gl_buffer_object *bufferObj,
+                        const struct minmax_cache_key *key, uint32_t hash)
+{
+   struct hash_entry *result = NULL;
+
+   if (bufferObj->MinMaxCacheDirty) {
+      /* Disable the cache permanently for this buffer object if it is
+       * modified more often than its cached ranges are reused, which is
+       * what happens with streaming index data.  Uploads that happen
+       * before the first draw don't count against it.
+       */
+      if (bufferObj->MinMaxCacheHitIndices <
+          bufferObj->MinMaxCacheMissIndices)
+         bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+
+      vbo_delete_minmax_cache(bufferObj);
+      bufferObj->MinMaxCacheDirty = false;
+      goto out;
+   }
+
+   if (bufferObj->MinMaxCache) {
+      result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache,
+                                                  hash, key);
+   }
+
+out:
+   if (result)
+      bufferObj->MinMaxCacheHitIndices += key->count;
+   else
+      bufferObj->MinMaxCacheMissIndices += key->count;
+
+   return result ? result->data : NULL;
+}
+
+
+static bool
+vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
+                      const struct minmax_cache_key *key, uint32_t hash,
+                      GLuint *min_index, GLuint *max_index)
+{
+   const struct minmax_cache_entry *entry;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return false;
+
+   mtx_lock(&bufferObj->Mutex);
+
+   entry = vbo_minmax_cache_lookup(bufferObj, key, hash);
+   if (entry) {
+      *min_index = entry->min;
+      *max_index = entry->max;
+   }
+
+   mtx_unlock(&bufferObj->Mutex);
+   return entry != NULL;
+}
+
+
+/**
+ * Add \p entry, which starts with \p key, to the cache of \p bufferObj.
+ * The cache takes ownership of the entry.
+ */
+static void
+vbo_minmax_cache_insert(struct gl_buffer_object *bufferObj,
+                        const struct minmax_cache_key *key, uint32_t hash,
+                        void *entry)
+{
+   mtx_lock(&bufferObj->Mutex);
+
+   /* Another context modified the buffer while we were scanning it. */
+   if (bufferObj->MinMaxCacheDirty)
+      goto out;
+
+   if (bufferObj->MinMaxCache &&
+       bufferObj->MinMaxCache->entries >= MAX_ENTRIES)
+      vbo_delete_minmax_cache(bufferObj);
+
+   if (!bufferObj->MinMaxCache) {
+      bufferObj->MinMaxCache =
+         _mesa_hash_table_create(NULL, vbo_minmax_cache_hash,
+                                 vbo_minmax_cache_key_equal);
+      if (!bufferObj->MinMaxCache)
+         goto out;
+   }
+
+   /* Another context may have stored the same range in the meantime. */
+   if (_mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, key))
+      goto out;
+
+   _mesa_hash_table_insert_pre_hashed(bufferObj->MinMaxCache, hash,
+                                      entry, entry);
+   entry = NULL;
+
+out:
+   mtx_unlock(&bufferObj->Mutex);
+   free(entry);
+}
+
+
+static void
+vbo_minmax_cache_store(struct gl_buffer_object *bufferObj,
+                       const struct minmax_cache_key *key, uint32_t hash,
+                       GLuint min, GLuint max)
+{
+   struct minmax_cache_entry *entry;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return;
+
+   entry = MALLOC_STRUCT(minmax_cache_entry);
+   if (!entry)
+      return;
+
+   memcpy(&entry->key, key, sizeof(*key));
+   entry->min = min;
+   entry->max = max;
+
+   vbo_minmax_cache_insert(bufferObj, key, hash, entry);
+}
+
+
+static void
+vbo_sub_primitive_cache_key(struct minmax_cache_key *key, GLintptr offset,
+                            unsigned count, unsigned index_size,
+                            unsigned restart_index)
+{
+   memset(key, 0, sizeof(*key));
+   key->offset = offset;
+   key->count = count;
+   key->index_size = index_size;
+   key->restart = 1;
+   key->restart_index = restart_index;
+   key->sub_primitives = 1;
+}
+
+
+/**
+ * Look up the sub-primitives of the \p count indices at \p offset in
+ * \p bufferObj, as computed by vbo_find_sub_primitives().  On success,
+ * returns true and a malloc'ed copy of the list that the caller must free.
+ */
+bool
+vbo_get_sub_primitives_cached(struct gl_buffer_object *bufferObj,
+                              GLintptr offset, unsigned count,
+                              unsigned index_size, unsigned restart_index,
+                              struct vbo_sub_primitive **sub_prims,
+                              unsigned *num_sub_prims)
+{
+   const struct sub_primitive_cache_entry *entry;
+   struct minmax_cache_key key;
+   bool found = false;
+   uint32_t hash;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return false;
+
+   vbo_sub_primitive_cache_key(&key, offset, count, index_size,
+                               restart_index);
+   hash = vbo_minmax_cache_hash(&key);
+
+   mtx_lock(&bufferObj->Mutex);
+
+   entry = vbo_minmax_cache_lookup(bufferObj, &key, hash);
+   if (entry) {
+      const size_t size =
+         MAX2(entry->num_sub_prims, 1) * sizeof(struct vbo_sub_primitive);
+
+      *sub_prims = malloc(size);
+      if (*sub_prims) {
+         memcpy(*sub_prims, entry->sub_prims,
+                entry->num_sub_prims * sizeof(struct vbo_sub_primitive));
+         *num_sub_prims = entry->num_sub_prims;
+         found = true;
+      }
+   }
+
+   mtx_unlock(&bufferObj->Mutex);
+   return found;
+}
+
+
+void
+vbo_store_sub_primitives(struct gl_buffer_object *bufferObj,
+                         GLintptr offset, unsigned count,
+                         unsigned index_size, unsigned restart_index,
+                         const struct vbo_sub_primitive *sub_prims,
+                         unsigned num_sub_prims)
+{
+   struct sub_primitive_cache_entry *entry;
+   uint32_t hash;
+
+   if (!vbo_use_minmax_cache(bufferObj))
+      return;
+
+   entry = malloc(sizeof(*entry) +
+                  num_sub_prims * sizeof(struct vbo_sub_primitive));
+   if (!entry)
+      return;
+
+   vbo_sub_primitive_cache_key(&entry->key, offset, count, index_size,
+                               restart_index);
+   entry->num_sub_prims = num_sub_prims;
+   memcpy(entry->sub_prims, sub_prims,
+          num_sub_prims * sizeof(struct vbo_sub_primitive));
+   hash = vbo_minmax_cache_hash(&entry->key);
+
+   vbo_minmax_cache_insert(bufferObj, &entry->key, hash, entry);
+}
+
+
+/**
+ * Return the position of the first element of [\p start, \p end) in
+ * \p indices that equals \p value, or \p end if there is none.
+ */
+unsigned
+vbo_find_index(const void *indices, unsigned index_size,
+               unsigned start, unsigned end, unsigned value)
+{
+   unsigned i;
+
+   /* A restart index that doesn't fit in the index type never matches. */
+   if (index_size < 4 && (value >> (index_size * 8)))
+      return end;
+
+#if defined(USE_AVX2)
+   if (cpu_has_avx2)
+      return _mesa_avx2_find_index(indices, index_size, start, end, value);
+#endif
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1)
+      return _mesa_sse_find_index(indices, index_size, start, end, value);
+#endif
+
+   switch (index_size) {
+   case 4:
+      for (i = start; i < end; i++) {
+         if (((const GLuint *) indices)[i] == value)
+            return i;
+      }
+      break;
+   case 2:
+      for (i = start; i < end; i++) {
+         if (((const GLushort *) indices)[i] == value)
+            return i;
+      }
+      break;
+   default:
+      for (i = start; i < end; i++) {
+         if (((const GLubyte *) indices)[i] == value)
+            return i;
+      }
+      break;
+   }
+
+   return end;
+}
+
+
+/**
+ * Compute the min and max of \p count indices, none of which is a restart
+ * index.
+ */
+void
+vbo_index_array_min_max(const void *indices, unsigned index_size,
+                        unsigned count, GLuint *min_index, GLuint *max_index)
+{
+   GLuint i;
+
+   switch (index_size) {
+   case 4: {
+      const GLuint *ui_indices = (const GLuint *)indices;
+      GLuint max_ui = 0;
+      GLuint min_ui = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+      }
+      else
+#endif
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+      }
+      else
+#endif
+         for (i = 0; i < count; i++) {
+            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
+         }
+      *min_index = min_ui;
+      *max_index = max_ui;
+      break;
+   }
+   case 2: {
+      const GLushort *us_indices = (const GLushort *)indices;
+      GLuint max_us = 0;
+      GLuint min_us = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_ushort_array_min_max(us_indices, &min_us, &max_us, count);
+      }
+      else
+#endif
+         for (i = 0; i < count; i++) {
+            if (us_indices[i] > max_us) max_us = us_indices[i];
+            if (us_indices[i] < min_us) min_us = us_indices[i];
+         }
+      *min_index = min_us;
+      *max_index = max_us;
+      break;
+   }
+   case 1: {
+      const GLubyte *ub_indices = (const GLubyte *)indices;
+      GLuint max_ub = 0;
+      GLuint min_ub = ~0U;
+#if defined(USE_AVX2)
+      if (cpu_has_avx2) {
+         _mesa_avx2_ubyte_array_min_max(ub_indices, &min_ub, &max_ub, count);
+      }
+      else
+#endif
+         for (i = 0; i < count; i++) {
+            if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
+            if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
+         }
+      *min_index = min_ub;
+      *max_index = max_ub;
+      break;
+   }
+   default:
+      unreachable("not reached");
+   }
+}
+
+
+
+/**
+ * Compute min and max elements by scanning the index buffer for
+ * glDraw[Range]Elements() calls.
+ * If primitive restart is enabled, we need to ignore restart
+ * indexes when computing min/max.
+ * Results for buffer objects are cached per range until the buffer is
+ * modified.
+ */
+static void
+vbo_get_minmax_index(struct gl_context *ctx,
+		     const struct _mesa_prim *prim,
+		     const struct _mesa_index_buffer *ib,
+		     GLuint *min_index, GLuint *max_index,
+		     const GLuint count)
+{
+   const GLboolean restart = ctx->Array._PrimitiveRestart;
+   const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
+   const int index_size = vbo_sizeof_ib_type(ib->type);
+   struct minmax_cache_key key;
+   uint32_t hash = 0;
+   const char *indices;
+   GLuint i;
+
+   indices = (char *) ib->ptr + prim->start * index_size;
+   if (_mesa_is_bufferobj(ib->obj)) {
+      GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
+
+      memset(&key, 0, sizeof(key));
+      key.offset = (GLintptr) indices;
+      key.count = count;
+      key.index_size = index_size;
+      key.restart = restart;
+      key.restart_index = restart ? restartIndex : 0;
+      hash = vbo_minmax_cache_hash(&key);
+
+      if (vbo_get_minmax_cached(ib->obj, &key, hash, min_index, max_index))
+         return;
+
+      indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
+                                           GL_MAP_READ_BIT, ib->obj,
+                                           MAP_INTERNAL);
+   }
+
+   if (restart) {
+      /* Scan the ranges between restart indices. */
+      *min_index = ~0U;
+      *max_index = 0;
+
+      for (i = 0; i < count; ) {
+         const GLuint end = vbo_find_index(indices, index_size, i, count,
+                                           restartIndex);
+
+         if (end > i) {
+            GLuint sub_min, sub_max;
+
+            vbo_index_array_min_max(indices + i * index_size, index_size,
+                                    end - i, &sub_min, &sub_max);
+            *min_index = MIN2(*min_index, sub_min);
+            *max_index = MAX2(*max_index, sub_max);
+         }
+         i = end + 1;
+      }
+   }
+   else {
+      vbo_index_array_min_max(indices, index_size, count,
+                              min_index, max_index);
+   }
+
+   if (_mesa_is_bufferobj(ib->obj)) {
+      vbo_minmax_cache_store(ib->obj, &key, hash, *min_index, *max_index);
+      ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+   }
+}
+
+/**
+ * Compute min and max elements for nr_prims
+ */
+void
+vbo_get_minmax_indices(struct gl_context *ctx,
+                       const struct _mesa_prim *prims,
+                       const struct _mesa_index_buffer *ib,
+                       GLuint *min_index,
+                       GLuint *max_index,
+                       GLuint nr_prims)
+{
+   GLuint tmp_min, tmp_max;
+   GLuint i;
+   GLuint count;
+
+   *min_index = ~0;
+   *max_index = 0;
+
+   for (i = 0; i < nr_prims; i++) {
+      const struct _mesa_prim *start_prim;
+
+      start_prim = &prims[i];
+      count = start_prim->count;
+      /* Do combination if possible to reduce map/unmap count */
+      while ((i + 1 < nr_prims) &&
+             (prims[i].start + prims[i].count == prims[i+1].start)) {
+         count += prims[i+1].count;
+         i++;
+      }
+      vbo_get_minmax_index(ctx, start_prim, ib, &tmp_min, &tmp_max, count);
+      *min_index = MIN2(*min_index, tmp_min);
+      *max_index = MAX2(*max_index, tmp_max);
+   }
+}
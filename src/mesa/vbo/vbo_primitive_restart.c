@@ -36,8 +36,6 @@
 #include "vbo.h"
 #include "vbo_context.h"
 
-#define UPDATE_MIN2(a, b) (a) = MIN2((a), (b))
-#define UPDATE_MAX2(a, b) (a) = MAX2((a), (b))
 
 /*
  * Notes on primitive restart:
@@ -46,15 +44,16 @@
  *
  * We map the index buffer, find the restart indexes, unmap
  * the index buffer then draw the sub-primitives delineated by the restarts.
+ * The restart indexes are searched for with SIMD compares, and the list of
+ * sub-primitives of a buffer object range is cached along with the min/max
+ * index ranges of the buffer (see vbo_minmax_index.c), so that drawing the
+ * same unmodified buffer again doesn't even map it.
  *
- * A couple possible optimizations:
- * 1. Save the list of sub-primitive (start, count) values in a list attached
- *    to the index buffer for re-use in subsequent draws.  The list would be
- *    invalidated when the contents of the buffer changed.
- * 2. If drawing triangle strips or quad strips, create a new index buffer
- *    that uses duplicated vertices to render the disjoint strips as one
- *    long strip.  We'd have to be careful to avoid using too much memory
- *    for this.
+ * A possible optimization:
+ * If drawing triangle strips or quad strips, create a new index buffer
+ * that uses duplicated vertices to render the disjoint strips as one
+ * long strip.  We'd have to be careful to avoid using too much memory
+ * for this.
  *
  * Finally, some apps might perform better if they don't use primitive restart
  * at all rather than this fallback path.  Set MESA_EXTENSION_OVERRIDE to
@@ -62,90 +61,47 @@
  */
 
 
-struct sub_primitive
-{
-   GLuint start;
-   GLuint count;
-   GLuint min_index;
-   GLuint max_index;
-};
-
-
 /**
  * Scan the elements array to find restart indexes.  Return an array
- * of struct sub_primitive to indicate how to draw the sub-primitives
+ * of struct vbo_sub_primitive to indicate how to draw the sub-primitives
  * are delineated by the restart index.
  */
-static struct sub_primitive *
-find_sub_primitives(const void *elements, unsigned element_size,
-                    unsigned start, unsigned end, unsigned restart_index,
-                    unsigned *num_sub_prims)
+struct vbo_sub_primitive *
+vbo_find_sub_primitives(const void *elements, unsigned element_size,
+                        unsigned start, unsigned end, unsigned restart_index,
+                        unsigned *num_sub_prims)
 {
    const unsigned max_prims = end - start;
-   struct sub_primitive *sub_prims;
-   unsigned i, cur_start, cur_count;
-   GLuint scan_index;
-   unsigned scan_num;
+   struct vbo_sub_primitive *sub_prims;
+   unsigned i, scan_num;
 
    sub_prims =
-      malloc(max_prims * sizeof(struct sub_primitive));
+      malloc(max_prims * sizeof(struct vbo_sub_primitive));
 
    if (!sub_prims) {
       *num_sub_prims = 0;
       return NULL;
    }
 
-   cur_start = start;
-   cur_count = 0;
    scan_num = 0;
 
-#define IB_INDEX_READ(TYPE, INDEX) (((const GL##TYPE *) elements)[INDEX])
-
-#define SCAN_ELEMENTS(TYPE) \
-   sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-   sub_prims[scan_num].max_index = 0; \
-   for (i = start; i < end; i++) { \
-      scan_index = IB_INDEX_READ(TYPE, i); \
-      if (scan_index == restart_index) { \
-         if (cur_count > 0) { \
-            assert(scan_num < max_prims); \
-            sub_prims[scan_num].start = cur_start; \
-            sub_prims[scan_num].count = cur_count; \
-            scan_num++; \
-            sub_prims[scan_num].min_index = (GL##TYPE) 0xffffffff; \
-            sub_prims[scan_num].max_index = 0; \
-         } \
-         cur_start = i + 1; \
-         cur_count = 0; \
-      } \
-      else { \
-         UPDATE_MIN2(sub_prims[scan_num].min_index, scan_index); \
-         UPDATE_MAX2(sub_prims[scan_num].max_index, scan_index); \
-         cur_count++; \
-      } \
-   } \
-   if (cur_count > 0) { \
-      assert(scan_num < max_prims); \
-      sub_prims[scan_num].start = cur_start; \
-      sub_prims[scan_num].count = cur_count; \
-      scan_num++; \
-   }
+   for (i = start; i < end; ) {
+      const unsigned restart = vbo_find_index(elements, element_size,
+                                              i, end, restart_index);
 
-   switch (element_size) {
-   case 1:
-      SCAN_ELEMENTS(ubyte);
-      break;
-   case 2:
-      SCAN_ELEMENTS(ushort);
-      break;
-   case 4:
-      SCAN_ELEMENTS(uint);
-      break;
-   default:
-      assert(0 && "bad index_size in find_sub_primitives()");
-   }
+      if (restart > i) {
+         struct vbo_sub_primitive *sub_prim = &sub_prims[scan_num++];
 
-#undef SCAN_ELEMENTS
+         assert(scan_num <= max_prims);
+         sub_prim->start = i;
+         sub_prim->count = restart - i;
+         vbo_index_array_min_max((const GLubyte *) elements +
+                                 i * element_size,
+                                 element_size, sub_prim->count,
+                                 &sub_prim->min_index, &sub_prim->max_index);
+      }
+      i = restart + 1;
+   }
 
    *num_sub_prims = scan_num;
 
@@ -169,8 +125,8 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
    GLuint prim_num;
    struct _mesa_prim new_prim;
    struct _mesa_index_buffer new_ib;
-   struct sub_primitive *sub_prims;
-   struct sub_primitive *sub_prim;
+   struct vbo_sub_primitive *sub_prims;
+   struct vbo_sub_primitive *sub_prim;
    GLuint num_sub_prims;
    GLuint sub_prim_num;
    GLuint end_index;
@@ -180,6 +136,8 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
    struct vbo_context *vbo = vbo_context(ctx);
    vbo_draw_func draw_prims_func = vbo->draw_prims;
    GLboolean map_ib = ib->obj->Name && !ib->obj->Mappings[MAP_INTERNAL].Pointer;
+   GLboolean cache_ib;
+   unsigned index_size;
    void *ptr;
 
    /* If there is an indirect buffer, map it and extract the draw params */
@@ -216,22 +174,36 @@ vbo_sw_primitive_restart(struct gl_context *ctx,
       ctx->Driver.UnmapBuffer(ctx, indirect, MAP_INTERNAL);
    }
 
+   cache_ib = _mesa_is_bufferobj(ib->obj);
+   index_size = vbo_sizeof_ib_type(ib->type);
+
    /* Find the sub-primitives. These are regions in the index buffer which
     * are split based on the primitive restart index value.
     */
-   if (map_ib) {
-      ctx->Driver.MapBufferRange(ctx, 0, ib->obj->Size, GL_MAP_READ_BIT,
-                                 ib->obj, MAP_INTERNAL);
-   }
+   if (!cache_ib ||
+       !vbo_get_sub_primitives_cached(ib->obj, (GLintptr) ib->ptr, ib->count,
+                                      index_size, restart_index,
+                                      &sub_prims, &num_sub_prims)) {
+      if (map_ib) {
+         ctx->Driver.MapBufferRange(ctx, 0, ib->obj->Size, GL_MAP_READ_BIT,
+                                    ib->obj, MAP_INTERNAL);
+      }
 
-   ptr = ADD_POINTERS(ib->obj->Mappings[MAP_INTERNAL].Pointer, ib->ptr);
+      ptr = ADD_POINTERS(ib->obj->Mappings[MAP_INTERNAL].Pointer, ib->ptr);
 
-   sub_prims = find_sub_primitives(ptr, vbo_sizeof_ib_type(ib->type),
-                                   0, ib->count, restart_index,
-                                   &num_sub_prims);
+      sub_prims = vbo_find_sub_primitives(ptr, index_size,
+                                          0, ib->count, restart_index,
+                                          &num_sub_prims);
 
-   if (map_ib) {
-      ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+      if (cache_ib && sub_prims) {
+         vbo_store_sub_primitives(ib->obj, (GLintptr) ib->ptr, ib->count,
+                                  index_size, restart_index,
+                                  sub_prims, num_sub_prims);
+      }
+
+      if (map_ib) {
+         ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+      }
    }
 
    /* Loop over the primitives, and use the located sub-primitives to draw
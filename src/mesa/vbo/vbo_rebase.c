@@ -50,10 +50,30 @@
 #include "main/glheader.h"
 #include "main/imports.h"
 #include "main/mtypes.h"
+#include "main/sse_index.h"
+#include "x86/common_x86_asm.h"
 
 #include "vbo.h"
 
 
+/**
+ * Rebase the indices with SIMD instructions if possible.
+ */
+static inline GLboolean
+rebase_simd(void *dst, const void *src, unsigned index_size,
+            GLuint count, GLuint min_index)
+{
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      _mesa_sse_rebase_indices(dst, src, index_size, count, min_index);
+      return GL_TRUE;
+   }
+#endif
+
+   return GL_FALSE;
+}
+
+
 #define REBASE(TYPE) 						\
 static void *rebase_##TYPE( const void *ptr,			\
 			  GLuint count, 			\
@@ -68,6 +88,9 @@ static void *rebase_##TYPE( const void *ptr,			\
       return NULL;                                              \
    }                                                            \
 								\
+   if (rebase_simd(tmp_indices, in, sizeof(TYPE), count, min_index)) \
+      return (void *)tmp_indices;				\
+								\
    for (i = 0; i < count; i++)  				\
       tmp_indices[i] = in[i] - min_index;			\
 								\
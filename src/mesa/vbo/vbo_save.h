@@ -81,6 +81,13 @@ struct vbo_save_vertex_list {
    struct _mesa_prim *prim;
    GLuint prim_count;
 
+   /* Lists merged at glEndList time (see vbo_save_merge.c) are drawn with
+    * GL_UNSIGNED_SHORT indices stored after the vertices.  Their prims are
+    * malloc'ed rather than living in a prim_store.
+    */
+   GLuint index_offset;         /**< in bytes, from the start of the buffer */
+   GLuint index_count;          /**< 0 if the list isn't indexed */
+
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
 };
@@ -103,6 +110,9 @@ struct vbo_save_vertex_list {
 
 #define VBO_SAVE_FALLBACK    0x10000000
 
+/* An interesting VBO number/name to help with debugging */
+#define VBO_BUF_ID  12345
+
 /* Storage to be shared among several vertex_lists.
  */
 struct vbo_save_vertex_store {
@@ -171,7 +181,8 @@ void vbo_loopback_vertex_list( struct gl_context *ctx,
 			       const struct _mesa_prim *prim,
 			       GLuint prim_count,
 			       GLuint wrap_count,
-			       GLuint vertex_size);
+			       GLuint vertex_size,
+			       const GLushort *elts);
 
 /* Callbacks:
  */
@@ -88,10 +88,6 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif
 
 
-/* An interesting VBO number/name to help with debugging */
-#define VBO_BUF_ID  12345
-
-
 /*
  * NOTE: Old 'parity' issue is gone, but copying can still be
  * wrong-footed on replay.
@@ -439,6 +435,8 @@ _save_compile_vertex_list(struct gl_context *ctx)
    node->dangling_attr_ref = save->dangling_attr_ref;
    node->prim = save->prim;
    node->prim_count = save->prim_count;
+   node->index_offset = 0;
+   node->index_count = 0;
    node->vertex_store = save->vertex_store;
    node->prim_store = save->prim_store;
 
@@ -504,7 +502,7 @@ _save_compile_vertex_list(struct gl_context *ctx)
                                                   vertex_store->buffer +
                                                   node->buffer_offset),
                                node->attrsz, node->prim, node->prim_count,
-                               node->wrap_count, node->vertex_size);
+                               node->wrap_count, node->vertex_size, NULL);
 
       _glapi_set_dispatch(dispatch);
    }
@@ -1578,7 +1576,9 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
    if (--node->vertex_store->refcount == 0)
       free_vertex_store(ctx, node->vertex_store);
 
-   if (--node->prim_store->refcount == 0)
+   if (!node->prim_store)
+      free(node->prim);
+   else if (--node->prim_store->refcount == 0)
       free(node->prim_store);
 
    free(node->current_data);
@@ -1600,6 +1600,10 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
            node->count, node->prim_count, node->vertex_size,
            buffer);
 
+   if (node->index_count)
+      fprintf(f, "   %u indices at offset %u\n",
+              node->index_count, node->index_offset);
+
    for (i = 0; i < node->prim_count; i++) {
       struct _mesa_prim *prim = &node->prim[i];
       fprintf(f, "   prim %d: %s%s %d..%d %s %s\n",
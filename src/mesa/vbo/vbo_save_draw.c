@@ -34,6 +34,7 @@
 #include "main/macros.h"
 #include "main/light.h"
 #include "main/state.h"
+#include "main/varray.h"
 
 #include "vbo_context.h"
 
@@ -233,7 +234,10 @@ vbo_save_loopback_vertex_list(struct gl_context *ctx,
                             list->prim,
                             list->prim_count,
                             list->wrap_count,
-                            list->vertex_size);
+                            list->vertex_size,
+                            list->index_count ?
+                            (const GLushort *)(buffer + list->index_offset) :
+                            NULL);
 
    ctx->Driver.UnmapBuffer(ctx, list->vertex_store->bufferobj,
                            MAP_INTERNAL);
@@ -277,9 +281,14 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
                      "draw operation inside glBegin/End");
          goto end;
       }
-      else if (save->replay_flags) {
+      else if (save->replay_flags ||
+               (node->index_count && ctx->Array._PrimitiveRestart &&
+                _mesa_primitive_restart_index(ctx, GL_UNSIGNED_SHORT) <
+                node->count)) {
 	 /* Various degenerate cases: translate into immediate mode
-	  * calls rather than trying to execute in place.
+	  * calls rather than trying to execute in place.  Merged lists
+	  * also end up here if the application's restart index could
+	  * match one of their indices.
 	  */
 	 vbo_save_loopback_vertex_list( ctx, node );
 
@@ -307,10 +316,19 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
 	 _mesa_update_state( ctx );
 
       if (node->count > 0) {
+         struct _mesa_index_buffer ib;
+
+         if (node->index_count) {
+            ib.count = node->index_count;
+            ib.type = GL_UNSIGNED_SHORT;
+            ib.obj = node->vertex_store->bufferobj;
+            ib.ptr = (const void *) (uintptr_t) node->index_offset;
+         }
+
          vbo_context(ctx)->draw_prims(ctx, 
                                       node->prim,
                                       node->prim_count,
-                                      NULL,
+                                      node->index_count ? &ib : NULL,
                                       GL_TRUE,
                                       0,    /* Node is a VBO, so this is ok */
                                       node->count - 1,
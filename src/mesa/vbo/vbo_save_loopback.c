@@ -80,17 +80,20 @@ struct loopback_attr {
 /* Don't emit ends and begins on wrapped primitives.  Don't replay
  * wrapped vertices.  If we get here, it's probably because the
  * precalculated wrapping is wrong.
+ *
+ * If elts is non-null, prim->start and prim->count refer to it rather
+ * than to the vertices.
  */
 static void loopback_prim( struct gl_context *ctx,
 			   const GLfloat *buffer,
 			   const struct _mesa_prim *prim,
 			   GLuint wrap_count,
 			   GLuint vertex_size,
-			   const struct loopback_attr *la, GLuint nr )
+			   const struct loopback_attr *la, GLuint nr,
+			   const GLushort *elts )
 {
    GLint start = prim->start;
    GLint end = start + prim->count;
-   const GLfloat *data;
    GLint j;
    GLuint k;
 
@@ -110,9 +113,8 @@ static void loopback_prim( struct gl_context *ctx,
       start += wrap_count;
    }
 
-   data = buffer + start * vertex_size;
-
    for (j = start ; j < end ; j++) {
+      const GLfloat *data = buffer + (elts ? elts[j] : j) * vertex_size;
       const GLfloat *tmp = data + la[0].sz;
 
       for (k = 1 ; k < nr ; k++) {
@@ -123,7 +125,6 @@ static void loopback_prim( struct gl_context *ctx,
       /* Fire the vertex
        */
       la[0].func( ctx, VBO_ATTRIB_POS, data );
-      data = tmp;
    }
 
    if (prim->end) {
@@ -159,7 +160,8 @@ void vbo_loopback_vertex_list( struct gl_context *ctx,
 			       const struct _mesa_prim *prim,
 			       GLuint prim_count,
 			       GLuint wrap_count,
-			       GLuint vertex_size)
+			       GLuint vertex_size,
+			       const GLushort *elts)
 {
    struct loopback_attr la[VBO_ATTRIB_MAX];
    GLuint i, nr = 0;
@@ -184,7 +186,8 @@ void vbo_loopback_vertex_list( struct gl_context *ctx,
       }
       else
       {
-	 loopback_prim( ctx, buffer, &prim[i], wrap_count, vertex_size, la, nr );
+	 loopback_prim( ctx, buffer, &prim[i], wrap_count, vertex_size, la, nr,
+			elts );
       }
    }
 }
@@ -0,0 +1,574 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file vbo_save_merge.c
+ *
+ * Merging of vertex lists at glEndList time.
+ *
+ * Legacy applications (CAD in particular) build display lists out of
+ * thousands of small glBegin/End blocks separated by glColor, glNormal and
+ * the like.  Each of these attribute commands ends the current vertex list,
+ * so the list is replayed as thousands of tiny draws.
+ *
+ * When the display list is ended, dlist.c feeds runs of vertex lists and
+ * the attribute commands between them to a vbo_save_merge.  The attribute
+ * values are baked into the vertices of the lists that would have used
+ * them as current values, identical vertices are shared, and the whole run
+ * becomes a single vertex list drawn with GL_UNSIGNED_SHORT indices.  The
+ * merged list updates the current values at the end just like the last
+ * list and attribute commands of the run did, so the commands it replaces
+ * can be dropped.
+ *
+ * Lists which need execute-time fixups (wrapped primitives, dangling
+ * attribute references) or that don't update the current values are left
+ * alone.
+ */
+
+#include "main/glheader.h"
+#include "main/bufferobj.h"
+#include "main/dlist.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "util/hash_table.h"
+
+#include "vbo_context.h"
+
+
+/**
+ * Keeps every index of a merged list below 0xffff, the fixed restart
+ * index for GL_UNSIGNED_SHORT.
+ */
+#define MAX_MERGED_VERTS 0xffff
+
+
+/** An instruction of the run being merged. */
+struct merge_item {
+   /** The vertex list, or NULL for an attribute command */
+   const struct vbo_save_vertex_list *list;
+   GLuint attr;
+   GLuint size;
+   GLfloat value[4];
+};
+
+struct vbo_save_merge {
+   struct merge_item *items;
+   GLuint num_items, max_items;
+   GLuint last_list;            /**< items[] index after the last list */
+
+   GLuint num_lists;
+   GLuint num_verts;            /**< of all lists, before deduplication */
+   GLuint num_elts;
+   GLuint num_prims;
+   GLuint max_list_verts;
+
+   GLbitfield64 format;         /**< attributes of the merged vertex */
+   GLbitfield64 known;          /**< attributes set before the first list */
+   GLubyte attrsz[VBO_ATTRIB_MAX];
+};
+
+
+struct vbo_save_merge *
+vbo_save_merge_create(void)
+{
+   return CALLOC_STRUCT(vbo_save_merge);
+}
+
+
+void
+vbo_save_merge_destroy(struct vbo_save_merge *merge)
+{
+   if (merge) {
+      free(merge->items);
+      free(merge);
+   }
+}
+
+
+/**
+ * Forget the current run.
+ */
+void
+vbo_save_merge_reset(struct vbo_save_merge *merge)
+{
+   merge->num_items = 0;
+   merge->last_list = 0;
+   merge->num_lists = 0;
+   merge->num_verts = 0;
+   merge->num_elts = 0;
+   merge->num_prims = 0;
+   merge->max_list_verts = 0;
+   merge->format = 0;
+   merge->known = 0;
+   memset(merge->attrsz, 0, sizeof(merge->attrsz));
+}
+
+
+GLuint
+vbo_save_merge_num_lists(const struct vbo_save_merge *merge)
+{
+   return merge->num_lists;
+}
+
+
+static struct merge_item *
+add_item(struct vbo_save_merge *merge)
+{
+   if (merge->num_items == merge->max_items) {
+      const GLuint max_items = MAX2(2 * merge->max_items, 64);
+      struct merge_item *items =
+         realloc(merge->items, max_items * sizeof(*items));
+
+      if (!items)
+         return NULL;
+
+      merge->items = items;
+      merge->max_items = max_items;
+   }
+
+   return &merge->items[merge->num_items++];
+}
+
+
+/**
+ * Add an attribute command (glColor3f, glVertexAttrib4fv, ...) to the run.
+ *
+ * \param attr  VERT_ATTRIB_x, which is also VBO_ATTRIB_x
+ * \return GL_FALSE if the command can't be part of the run; the caller
+ *         should merge what it has, then start a new run with it.
+ */
+GLboolean
+vbo_save_merge_attr(struct vbo_save_merge *merge, GLuint attr, GLuint size,
+                    const GLfloat *v)
+{
+   const GLbitfield64 bit = BITFIELD64_BIT(attr);
+   struct merge_item *item;
+
+   if (attr == VBO_ATTRIB_POS || attr >= VBO_ATTRIB_MAX ||
+       size < 1 || size > 4)
+      return GL_FALSE;
+
+   if (merge->num_lists) {
+      /* The lists before this command would need a value for the attribute
+       * as well, but they used whatever was current when the display list
+       * was called.
+       */
+      if (!(merge->format & bit) || merge->attrsz[attr] != size)
+         return GL_FALSE;
+   }
+
+   item = add_item(merge);
+   if (!item)
+      return GL_FALSE;
+
+   item->list = NULL;
+   item->attr = attr;
+   item->size = size;
+   memcpy(item->value, v, size * sizeof(GLfloat));
+
+   if (!merge->num_lists) {
+      merge->known |= bit;
+      merge->attrsz[attr] = size;
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Can \p node be merged with others at all?
+ */
+static GLboolean
+list_is_mergeable(const struct vbo_save_vertex_list *node)
+{
+   GLuint i;
+
+   if (node->count == 0 || node->prim_count == 0 || node->wrap_count ||
+       node->dangling_attr_ref || node->index_count ||
+       node->vertex_store->bufferobj->Size == 0)
+      return GL_FALSE;
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      if (node->attrsz[i] && node->attrtype[i] != GL_FLOAT)
+         return GL_FALSE;
+   }
+
+   for (i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prim[i];
+
+      if (!prim->begin || !prim->end || prim->weak ||
+          prim->no_current_update || prim->indexed || prim->is_indirect ||
+          prim->num_instances != 1)
+         return GL_FALSE;
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Add the instruction \p opcode with payload \p data to the run, if it is
+ * a vertex list that can be merged with the rest of the run.
+ *
+ * \return GL_FALSE if the instruction can't be part of the run.
+ */
+GLboolean
+vbo_save_merge_list(struct gl_context *ctx, struct vbo_save_merge *merge,
+                    GLuint opcode, const void *data)
+{
+   const struct vbo_save_vertex_list *node =
+      (const struct vbo_save_vertex_list *) data;
+   GLbitfield64 format = 0;
+   struct merge_item *item;
+   GLuint i;
+
+   if (opcode != vbo_context(ctx)->save.opcode_vertex_list ||
+       !list_is_mergeable(node) ||
+       merge->num_verts + node->count > MAX_MERGED_VERTS)
+      return GL_FALSE;
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      if (node->attrsz[i])
+         format |= BITFIELD64_BIT(i);
+   }
+
+   if (merge->num_lists) {
+      /* The earlier lists can't provide values for new attributes. */
+      if (format & ~merge->format)
+         return GL_FALSE;
+
+      for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+         if (node->attrsz[i] && node->attrsz[i] != merge->attrsz[i])
+            return GL_FALSE;
+      }
+   }
+
+   item = add_item(merge);
+   if (!item)
+      return GL_FALSE;
+
+   item->list = node;
+
+   if (!merge->num_lists) {
+      /* Attributes set before the first list are baked into the merged
+       * vertices too.  After this, every attribute of the merged vertex has
+       * a value known at compile time: the list's last vertex updated it.
+       */
+      merge->format = format | merge->known;
+      for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+         if (node->attrsz[i])
+            merge->attrsz[i] = node->attrsz[i];
+      }
+   }
+
+   merge->num_lists++;
+   merge->num_verts += node->count;
+   merge->num_prims += node->prim_count;
+   for (i = 0; i < node->prim_count; i++)
+      merge->num_elts += node->prim[i].count;
+   merge->max_list_verts = MAX2(merge->max_list_verts, node->count);
+   merge->last_list = merge->num_items;
+
+   return GL_TRUE;
+}
+
+
+/** Output of vbo_save_merge_emit() being built. */
+struct merge_state {
+   GLuint vertex_size;
+
+   GLfloat *verts;
+   GLuint num_verts;
+
+   /** Open-addressed table of indices into verts, -1 when empty */
+   GLint *table;
+   GLuint table_mask;
+
+   GLushort *elts;
+   GLuint num_elts;
+
+   struct _mesa_prim *prims;
+   GLuint num_prims;
+
+   /** Maps a vertex of the list being added to its merged index */
+   GLushort *remap;
+
+   /** What the current values are at this point of the run */
+   GLfloat current[VBO_ATTRIB_MAX][4];
+};
+
+
+/**
+ * Return the index of the vertex at the end of state->verts, adding it
+ * unless an identical vertex is already there.
+ */
+static GLushort
+find_or_add_vertex(struct merge_state *state)
+{
+   const GLuint size = state->vertex_size * sizeof(GLfloat);
+   const GLfloat *v = state->verts + state->num_verts * state->vertex_size;
+   GLuint slot = _mesa_hash_data(v, size) & state->table_mask;
+
+   while (state->table[slot] >= 0) {
+      const GLfloat *other =
+         state->verts + state->table[slot] * state->vertex_size;
+
+      if (memcmp(v, other, size) == 0)
+         return state->table[slot];
+
+      slot = (slot + 1) & state->table_mask;
+   }
+
+   state->table[slot] = state->num_verts;
+   return state->num_verts++;
+}
+
+
+static GLboolean
+add_list(struct gl_context *ctx, const struct vbo_save_merge *merge,
+         struct merge_state *state, const struct vbo_save_vertex_list *node)
+{
+   struct gl_buffer_object *obj = node->vertex_store->bufferobj;
+   const GLfloat *buffer, *src;
+   const fi_type *current;
+   GLuint i, j, attr;
+
+   buffer = ctx->Driver.MapBufferRange(ctx, 0, obj->Size, GL_MAP_READ_BIT,
+                                       obj, MAP_INTERNAL);
+   if (!buffer)
+      return GL_FALSE;
+
+   src = (const GLfloat *) ((const char *) buffer + node->buffer_offset);
+
+   for (i = 0; i < node->count; i++) {
+      const GLfloat *in = src + i * node->vertex_size;
+      GLfloat *out = state->verts + state->num_verts * state->vertex_size;
+
+      for (attr = 0; attr < VBO_ATTRIB_MAX; attr++) {
+         const GLuint sz = merge->attrsz[attr];
+
+         if (!(merge->format & BITFIELD64_BIT(attr)))
+            continue;
+
+         if (node->attrsz[attr]) {
+            memcpy(out, in, sz * sizeof(GLfloat));
+            in += sz;
+         }
+         else {
+            memcpy(out, state->current[attr], sz * sizeof(GLfloat));
+         }
+         out += sz;
+      }
+
+      state->remap[i] = find_or_add_vertex(state);
+   }
+
+   for (i = 0; i < node->prim_count; i++) {
+      const struct _mesa_prim *prim = &node->prim[i];
+      struct _mesa_prim *out = &state->prims[state->num_prims++];
+
+      memset(out, 0, sizeof(*out));
+      out->mode = prim->mode;
+      out->indexed = 1;
+      out->begin = 1;
+      out->end = 1;
+      out->start = state->num_elts;
+      out->count = prim->count;
+      out->num_instances = 1;
+
+      for (j = 0; j < prim->count; j++)
+         state->elts[state->num_elts++] = state->remap[prim->start + j];
+   }
+
+   /* Same as _playback_copy_to_current(). */
+   if (node->current_data)
+      current = node->current_data;
+   else
+      current = (const fi_type *) src +
+                (node->count - 1) * node->vertex_size + node->attrsz[0];
+
+   for (attr = VBO_ATTRIB_POS + 1; attr < VBO_ATTRIB_MAX; attr++) {
+      if (node->attrsz[attr]) {
+         memcpy(state->current[attr], current,
+                node->attrsz[attr] * sizeof(GLfloat));
+         current += node->attrsz[attr];
+      }
+   }
+
+   ctx->Driver.UnmapBuffer(ctx, obj, MAP_INTERNAL);
+   return GL_TRUE;
+}
+
+
+/**
+ * Merge the lists of the run into a new vertex list instruction, appended
+ * to the display list being compiled.  Attribute commands following the
+ * last list of the run aren't part of it.
+ *
+ * On success, the caller drops the instructions of the run up to the last
+ * list; on failure, nothing is appended.  Either way, the run is left as it
+ * was, for vbo_save_merge_reset().
+ */
+GLboolean
+vbo_save_merge_emit(struct gl_context *ctx, struct vbo_save_merge *merge)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct vbo_save_vertex_list *node;
+   struct vbo_save_vertex_store *store = NULL;
+   struct merge_state state;
+   fi_type *current_data = NULL;
+   GLuint current_size, index_offset, table_size, i, j;
+   GLboolean ok = GL_FALSE;
+
+   memset(&state, 0, sizeof(state));
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      if (merge->format & BITFIELD64_BIT(i))
+         state.vertex_size += merge->attrsz[i];
+   }
+
+   table_size = _mesa_next_pow_two_32(2 * merge->num_verts);
+   state.table_mask = table_size - 1;
+   state.table = malloc(table_size * sizeof(GLint));
+   state.verts = malloc(merge->num_verts * state.vertex_size *
+                        sizeof(GLfloat));
+   state.elts = malloc(merge->num_elts * sizeof(GLushort));
+   state.prims = malloc(merge->num_prims * sizeof(struct _mesa_prim));
+   state.remap = malloc(merge->max_list_verts * sizeof(GLushort));
+   if (!state.table || !state.verts || !state.elts || !state.prims ||
+       !state.remap)
+      goto done;
+
+   memset(state.table, 0xff, table_size * sizeof(GLint));
+
+   for (i = 0; i < merge->last_list; i++) {
+      const struct merge_item *item = &merge->items[i];
+
+      if (item->list) {
+         if (!add_list(ctx, merge, &state, item->list))
+            goto done;
+      }
+      else {
+         memcpy(state.current[item->attr], item->value,
+                item->size * sizeof(GLfloat));
+      }
+   }
+
+   /* Join primitives that follow each other in the index buffer, such as
+    * the GL_LINES of consecutive glBegin/End blocks.
+    */
+   for (i = 0, j = 0; i < state.num_prims; i++) {
+      vbo_try_prim_conversion(&state.prims[i]);
+
+      if (i > 0 && vbo_can_merge_prims(&state.prims[j], &state.prims[i]))
+         vbo_merge_prims(&state.prims[j], &state.prims[i]);
+      else if (i > 0)
+         state.prims[++j] = state.prims[i];
+   }
+   state.num_prims = j + 1;
+
+   current_size = state.vertex_size - merge->attrsz[VBO_ATTRIB_POS];
+   if (current_size) {
+      fi_type *data;
+
+      current_data = malloc(current_size * sizeof(GLfloat));
+      if (!current_data)
+         goto done;
+
+      data = current_data;
+      for (i = VBO_ATTRIB_POS + 1; i < VBO_ATTRIB_MAX; i++) {
+         if (merge->format & BITFIELD64_BIT(i)) {
+            memcpy(data, state.current[i], merge->attrsz[i] * sizeof(GLfloat));
+            data += merge->attrsz[i];
+         }
+      }
+   }
+
+   /* The indices go right after the vertices, in the same buffer. */
+   index_offset = state.num_verts * state.vertex_size * sizeof(GLfloat);
+
+   store = CALLOC_STRUCT(vbo_save_vertex_store);
+   if (!store)
+      goto done;
+
+   store->bufferobj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+   if (!store->bufferobj ||
+       !ctx->Driver.BufferData(ctx, GL_ARRAY_BUFFER_ARB,
+                               index_offset +
+                               state.num_elts * sizeof(GLushort),
+                               NULL, GL_STATIC_DRAW_ARB,
+                               GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT,
+                               store->bufferobj))
+      goto done;
+
+   ctx->Driver.BufferSubData(ctx, 0, index_offset, state.verts,
+                             store->bufferobj);
+   ctx->Driver.BufferSubData(ctx, index_offset,
+                             state.num_elts * sizeof(GLushort), state.elts,
+                             store->bufferobj);
+   store->refcount = 1;
+
+   node = (struct vbo_save_vertex_list *)
+      _mesa_dlist_alloc_aligned(ctx, save->opcode_vertex_list, sizeof(*node));
+   if (!node)
+      goto done;
+
+   for (i = 0; i < VBO_ATTRIB_MAX; i++) {
+      const GLboolean enabled = (merge->format & BITFIELD64_BIT(i)) != 0;
+
+      node->attrsz[i] = enabled ? merge->attrsz[i] : 0;
+      node->attrtype[i] = GL_FLOAT;
+   }
+   node->vertex_size = state.vertex_size;
+   node->current_data = current_data;
+   node->current_size = current_size;
+   node->buffer_offset = 0;
+   node->count = state.num_verts;
+   node->wrap_count = 0;
+   node->dangling_attr_ref = GL_FALSE;
+   node->prim = state.prims;
+   node->prim_count = state.num_prims;
+   node->index_offset = index_offset;
+   node->index_count = state.num_elts;
+   node->vertex_store = store;
+   node->prim_store = NULL;
+
+   state.prims = NULL;
+   current_data = NULL;
+   store = NULL;
+   ok = GL_TRUE;
+
+done:
+   if (store) {
+      _mesa_reference_buffer_object(ctx, &store->bufferobj, NULL);
+      free(store);
+   }
+   free(current_data);
+   free(state.table);
+   free(state.verts);
+   free(state.elts);
+   free(state.prims);
+   free(state.remap);
+   return ok;
+}
@@ -37,6 +37,8 @@
 #include "main/glformats.h"
 #include "main/macros.h"
 #include "main/mtypes.h"
+#include "main/sse_index.h"
+#include "x86/common_x86_asm.h"
 
 #include "vbo_split.h"
 #include "vbo.h"
@@ -484,6 +486,13 @@ replay_init( struct copy_context *copy )
       copy->translated_elt_buf = malloc(sizeof(GLuint) * copy->ib->count);
       copy->srcelt = copy->translated_elt_buf;
 
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_sse_widen_indices(copy->translated_elt_buf, srcptr, 1,
+                                 copy->ib->count);
+         break;
+      }
+#endif
       for (i = 0; i < copy->ib->count; i++)
 	 copy->translated_elt_buf[i] = ((const GLubyte *)srcptr)[i];
       break;
@@ -492,6 +501,13 @@ replay_init( struct copy_context *copy )
       copy->translated_elt_buf = malloc(sizeof(GLuint) * copy->ib->count);
       copy->srcelt = copy->translated_elt_buf;
 
+#if defined(USE_SSE41)
+      if (cpu_has_sse4_1) {
+         _mesa_sse_widen_indices(copy->translated_elt_buf, srcptr, 2,
+                                 copy->ib->count);
+         break;
+      }
+#endif
       for (i = 0; i < copy->ib->count; i++)
 	 copy->translated_elt_buf[i] = ((const GLushort *)srcptr)[i];
       break;